@@ -0,0 +1,343 @@
+// bench_crypto.c
+//
+// Пропускная способность горячих путей сервера: BLAKE3 буфера, AES-256-GCM
+// загрузки и выдачи (контекст EVP на каждый вызов, как в server.c),
+// crypto_encrypt_aes_gcm (ещё и RAND_bytes на IV) и отдельно цена
+// EVP_CIPHER_CTX_new + инициализации ключа — для сравнения с тем же
+// шифрованием на переиспользуемом контексте.
+//
+// Размеры от 1 KiB до --max-size с шагом x4, потоки 1, 2, 4 ... все ядра.
+// Каждый поток шифрует свой буфер; прогоны, которым не хватает --mem-limit
+// (2 буфера на поток), пропускаются. Результат — JSON в stdout, таблица в
+// stderr; для сравнения между коммитами: bench_crypto --label $(git rev-parse --short HEAD)
+//
+// cycles/byte — по TSC (x86), на остальных платформах null. Выделения —
+// через CRYPTO_set_mem_functions, то есть только память OpenSSL; BLAKE3
+// и обёртки сервера сами ничего не выделяют.
+//
+// Запуск: bench_crypto [--max-size 1G] [--min-time-ms 200] [--mem-limit 4G] [--label name]
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/opensslv.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "../src/common/hash_utils.h"
+#include "../src/crypto/aes_gcm.h"
+
+#define MIN_SIZE       1024ull
+#define MAX_THREADS    256
+#define CTX_BATCH      1024 // вызовов между проверками часов для ctx_new
+
+typedef enum {
+    OP_BLAKE3,
+    OP_SERVER_ENCRYPT,   // enhanced_aes_gcm_encrypt в server.c
+    OP_SERVER_DECRYPT,   // enhanced_aes_gcm_decrypt в server.c
+    OP_MODULE_ENCRYPT,   // crypto_encrypt_aes_gcm из crypto/aes_gcm.c
+    OP_REUSED_ENCRYPT,   // то же шифрование без EVP_CIPHER_CTX_new на вызов
+    OP_CTX_NEW,          // только EVP_CIPHER_CTX_new + init + free, без данных
+    OP_COUNT
+} bench_op_t;
+
+static const char *const g_op_names[OP_COUNT] = {
+    [OP_BLAKE3] = "blake3",
+    [OP_SERVER_ENCRYPT] = "server_encrypt",
+    [OP_SERVER_DECRYPT] = "server_decrypt",
+    [OP_MODULE_ENCRYPT] = "crypto_encrypt_aes_gcm",
+    [OP_REUSED_ENCRYPT] = "reused_ctx_encrypt",
+    [OP_CTX_NEW] = "ctx_new_free",
+};
+
+static _Atomic uint64_t g_allocs;
+
+static void *count_malloc(size_t n, const char *file, int line) {
+    (void)file;
+    (void)line;
+    atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+    return malloc(n);
+}
+
+static void *count_realloc(void *p, size_t n, const char *file, int line) {
+    (void)file;
+    (void)line;
+    if (!p) atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+    return realloc(p, n);
+}
+
+static void count_free(void *p, const char *file, int line) {
+    (void)file;
+    (void)line;
+    free(p);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t ticks(void) {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+typedef struct {
+    bench_op_t op;
+    size_t size;
+    uint64_t min_ns;
+    pthread_barrier_t *ready;  // подготовка закончена
+    pthread_barrier_t *start;  // счётчики сняты, можно мерить
+    uint8_t *pt;
+    uint8_t *ct;
+    uint64_t calls;
+    bool failed;
+} worker_t;
+
+static const uint8_t g_key[32] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+static const uint8_t g_iv[12] = { 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9 };
+
+static bool ctx_new_free(void) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) return false;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) == 1 &&
+              EVP_EncryptInit_ex(ctx, NULL, NULL, g_key, g_iv) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+// Шифрование как в crypto_encrypt_aes_gcm_iv, но на готовом контексте
+static bool reused_encrypt(EVP_CIPHER_CTX *ctx, const uint8_t *pt, size_t len, uint8_t *ct,
+                           uint8_t *tag) {
+    int n, m;
+    return EVP_EncryptInit_ex(ctx, NULL, NULL, g_key, g_iv) == 1 &&
+           EVP_EncryptUpdate(ctx, ct, &n, pt, (int)len) == 1 &&
+           EVP_EncryptFinal_ex(ctx, ct + n, &m) == 1 &&
+           EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag) == 1;
+}
+
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+    uint8_t tag[16], iv[12], hash[HASH_SIZE];
+
+    EVP_CIPHER_CTX *reused = EVP_CIPHER_CTX_new();
+    if (!reused || EVP_EncryptInit_ex(reused, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1) {
+        w->failed = true;
+    }
+    // Для расшифровки нужен настоящий тег этого буфера
+    uint8_t enc_tag[16];
+    if (crypto_encrypt_aes_gcm_iv(w->pt, w->size, g_key, g_iv, w->ct, enc_tag) < 0) {
+        w->failed = true;
+    }
+
+    pthread_barrier_wait(w->ready);
+    pthread_barrier_wait(w->start);
+    uint64_t deadline = now_ns() + w->min_ns;
+    do {
+        unsigned batch = w->op == OP_CTX_NEW ? CTX_BATCH : 1;
+        for (unsigned i = 0; i < batch && !w->failed; i++) {
+            switch (w->op) {
+                case OP_BLAKE3:
+                    compute_buffer_blake3(w->pt, w->size, hash);
+                    break;
+                case OP_SERVER_ENCRYPT:
+                    w->failed = crypto_encrypt_aes_gcm_iv(w->pt, w->size, g_key, g_iv, w->ct, tag) < 0;
+                    break;
+                case OP_SERVER_DECRYPT:
+                    w->failed = crypto_decrypt_aes_gcm(w->ct, w->size, g_key, g_iv, enc_tag, w->pt) < 0;
+                    break;
+                case OP_MODULE_ENCRYPT:
+                    w->failed = crypto_encrypt_aes_gcm(w->pt, w->size, g_key, w->ct, iv, tag) < 0;
+                    break;
+                case OP_REUSED_ENCRYPT:
+                    w->failed = !reused_encrypt(reused, w->pt, w->size, w->ct, tag);
+                    break;
+                case OP_CTX_NEW:
+                    w->failed = !ctx_new_free();
+                    break;
+                case OP_COUNT:
+                    break;
+            }
+        }
+        w->calls += batch;
+    } while (!w->failed && now_ns() < deadline);
+
+    EVP_CIPHER_CTX_free(reused);
+    return NULL;
+}
+
+typedef struct {
+    uint64_t calls;
+    uint64_t elapsed_ns;
+    uint64_t ticks;
+    uint64_t allocs;
+    bool failed;
+} run_result_t;
+
+static run_result_t run(bench_op_t op, size_t size, unsigned nthreads, uint64_t min_ns,
+                        uint8_t **bufs) {
+    worker_t workers[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    pthread_barrier_t ready, start;
+    pthread_barrier_init(&ready, NULL, nthreads + 1);
+    pthread_barrier_init(&start, NULL, nthreads + 1);
+
+    for (unsigned t = 0; t < nthreads; t++) {
+        workers[t] = (worker_t){
+            .op = op, .size = size, .min_ns = min_ns, .ready = &ready, .start = &start,
+            .pt = bufs[2 * t], .ct = bufs[2 * t + 1],
+        };
+        pthread_create(&threads[t], NULL, worker_main, &workers[t]);
+    }
+
+    pthread_barrier_wait(&ready);
+    uint64_t allocs = atomic_load(&g_allocs);
+    uint64_t t0 = now_ns(), c0 = ticks();
+    pthread_barrier_wait(&start);
+    run_result_t r = {0};
+    for (unsigned t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+        r.calls += workers[t].calls;
+        r.failed |= workers[t].failed;
+    }
+    r.elapsed_ns = now_ns() - t0;
+    r.ticks = ticks() - c0;
+    r.allocs = atomic_load(&g_allocs) - allocs;
+    pthread_barrier_destroy(&ready);
+    pthread_barrier_destroy(&start);
+    return r;
+}
+
+static size_t parse_size(const char *s) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'K': case 'k': v <<= 10; break;
+        case 'M': case 'm': v <<= 20; break;
+        case 'G': case 'g': v <<= 30; break;
+        default: break;
+    }
+    return (size_t)v;
+}
+
+int main(int argc, char **argv) {
+    size_t max_size = 1ull << 30;
+    uint64_t min_ns = 200000000ull;
+    const char *label = "";
+    long pages = sysconf(_SC_PHYS_PAGES), page = sysconf(_SC_PAGESIZE);
+    size_t mem_limit = pages > 0 && page > 0 ? (size_t)pages * (size_t)page / 2 : 4ull << 30;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--max-size") == 0) max_size = parse_size(argv[i + 1]);
+        else if (strcmp(argv[i], "--min-time-ms") == 0) min_ns = strtoull(argv[i + 1], NULL, 10) * 1000000ull;
+        else if (strcmp(argv[i], "--mem-limit") == 0) mem_limit = parse_size(argv[i + 1]);
+        else if (strcmp(argv[i], "--label") == 0) label = argv[i + 1];
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // До первого вызова OpenSSL, иначе замена не принимается
+    if (!CRYPTO_set_mem_functions(count_malloc, count_realloc, count_free)) {
+        fprintf(stderr, "CRYPTO_set_mem_functions failed, allocations not counted\n");
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned ncores = cores > 0 ? (unsigned)cores : 1;
+    if (ncores > MAX_THREADS) ncores = MAX_THREADS;
+    unsigned thread_counts[16], nthread_counts = 0;
+    for (unsigned t = 1; t < ncores && nthread_counts < 15; t *= 2) thread_counts[nthread_counts++] = t;
+    thread_counts[nthread_counts++] = ncores;
+
+    // TSC тикает с номинальной частотой: пересчёт в такты не учитывает турбо
+    double ticks_per_ns = 0;
+#ifdef HAVE_TSC
+    uint64_t n0 = now_ns(), c0 = ticks();
+    usleep(100000);
+    ticks_per_ns = (double)(ticks() - c0) / (double)(now_ns() - n0);
+#endif
+
+    printf("{\n  \"label\": \"%s\",\n  \"openssl\": \"%s\",\n  \"cores\": %u,\n"
+           "  \"tsc_ghz\": %.3f,\n  \"results\": [", label, OPENSSL_VERSION_TEXT, ncores,
+           ticks_per_ns);
+    fprintf(stderr, "%-24s %10s %7s %10s %12s %10s\n", "op", "size", "threads", "GB/s",
+            "cycles/byte", "allocs");
+
+    uint8_t *bufs[2 * MAX_THREADS] = {0};
+    bool first = true;
+    for (unsigned k = 0; k < nthread_counts; k++) {
+        unsigned nthreads = thread_counts[k];
+
+        for (int op = 0; op < OP_COUNT; op++) {
+            for (size_t size = MIN_SIZE; size <= max_size; size *= 4) {
+                // У ctx_new нет данных: один прогон на число потоков
+                size_t data = op == OP_CTX_NEW ? 0 : size;
+                if (2 * size * nthreads > mem_limit) {
+                    fprintf(stderr, "%-24s %10zu %7u   skipped: over --mem-limit\n",
+                            g_op_names[op], size, nthreads);
+                    continue;
+                }
+
+                for (unsigned b = 0; b < 2 * nthreads; b++) {
+                    free(bufs[b]);
+                    bufs[b] = malloc(size + 16);
+                    if (!bufs[b]) {
+                        perror("malloc");
+                        return EXIT_FAILURE;
+                    }
+                    memset(bufs[b], (int)b + 1, size + 16);
+                }
+
+                run_result_t r = run((bench_op_t)op, size, nthreads, min_ns, bufs);
+                if (r.failed) {
+                    fprintf(stderr, "%s failed at %zu bytes\n", g_op_names[op], size);
+                    return EXIT_FAILURE;
+                }
+
+                double bytes = (double)data * (double)r.calls;
+                double gbps = bytes / (double)r.elapsed_ns;
+                // Тики суммарно по потокам на байт; для ctx_new — на вызов
+                double per = op == OP_CTX_NEW ? (double)r.calls : bytes;
+                double cpb = ticks_per_ns > 0 ? (double)r.ticks * nthreads / per : 0;
+                double allocs = (double)r.allocs / (double)r.calls;
+
+                printf("%s\n    {\"op\": \"%s\", \"size\": %zu, \"threads\": %u, \"calls\": %llu, "
+                       "\"seconds\": %.6f, \"gb_per_s\": %.4f, \"ns_per_call\": %.1f, ",
+                       first ? "" : ",", g_op_names[op], data, nthreads,
+                       (unsigned long long)r.calls, (double)r.elapsed_ns / 1e9, gbps,
+                       (double)r.elapsed_ns * nthreads / (double)r.calls);
+                if (ticks_per_ns > 0) {
+                    printf("\"%s\": %.3f, ", op == OP_CTX_NEW ? "cycles_per_call" : "cycles_per_byte", cpb);
+                } else {
+                    printf("\"%s\": null, ", op == OP_CTX_NEW ? "cycles_per_call" : "cycles_per_byte");
+                }
+                printf("\"allocs_per_call\": %.2f}", allocs);
+                first = false;
+
+                fprintf(stderr, "%-24s %10zu %7u %10.3f %12.2f %10.2f\n", g_op_names[op], data,
+                        nthreads, gbps, cpb, allocs);
+                if (op == OP_CTX_NEW) break;
+            }
+        }
+        fflush(stdout);
+    }
+    printf("\n  ]\n}\n");
+
+    for (unsigned b = 0; b < 2 * MAX_THREADS; b++) free(bufs[b]);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,443 @@
+// bench_handlers.c
+//
+// Цена одного запроса в обработчиках сервера без сети, сертификатов на
+// диске и MongoDB. server.c включается целиком (main переименован), так что
+// работают настоящие handle_upload_request / handle_download_request /
+// handle_list_request со своими метриками и журналом. Вокруг них:
+//  - mTLS из tests/mocks/mock_ssl.h: CA и сертификаты в памяти, соединение
+//    поверх socketpair; клиент — client_proto, как у client.c и loadgen;
+//  - метаданные — memory-реализация meta_store (--meta задаёт задержку);
+//  - файлы — во временном каталоге вместо STORAGE_DIR; кэш расшифрованных
+//    кусков — как у сервера (EXCHANGE_CHUNK_CACHE="budget=0" выключает).
+//
+// Поток сервера читает заголовок и вызывает обработчик, как handle_client.
+// На запрос меряется только этот поток: процессорное время по
+// CLOCK_THREAD_CPUTIME_ID (ожидание клиента в него не входит) и выделения
+// памяти — malloc/calloc/realloc кода сервера (--wrap при сборке) плюс
+// OpenSSL (CRYPTO_set_mem_functions). Выделения внутри libc (fopen,
+// open_memstream) не видны. Число выделений на запрос от запуска к запуску
+// не меняется, поэтому его удобно сравнивать между коммитами.
+//
+// Результат — JSON в stdout, таблица в stderr.
+//
+// Запуск: bench_handlers [--requests 200] [--warmup 10] [--max-size 1M]
+//                        [--meta latency_us=200] [--log-level info] [--label name]
+
+#define _GNU_SOURCE
+#define main exchange_server_main
+#define STORAGE_DIR g_storage_dir
+static char g_storage_dir[64];
+#include "../src/server/server.c"
+#undef main
+
+#include <ftw.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <openssl/crypto.h>
+#include <openssl/opensslv.h>
+
+#include "../src/client/client_proto.h"
+#include "../tests/mocks/mock_ssl.h"
+
+#define MIN_SIZE 1024ull
+
+typedef struct {
+    uint64_t cpu_ns;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+} sample_t;
+
+// Счётчики потока сервера; включены только внутри запроса
+static __thread bool t_counting;
+static __thread uint64_t t_allocs;
+static __thread uint64_t t_alloc_bytes;
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+
+static void count_alloc(size_t n) {
+    if (!t_counting) return;
+    t_allocs++;
+    t_alloc_bytes += n;
+}
+
+void *__wrap_malloc(size_t n) {
+    count_alloc(n);
+    return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    count_alloc(n * size);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t n) {
+    count_alloc(n);
+    return __real_realloc(p, n);
+}
+
+static void *ossl_malloc(size_t n, const char *file, int line) {
+    (void)file;
+    (void)line;
+    count_alloc(n);
+    return __real_malloc(n);
+}
+
+static void *ossl_realloc(void *p, size_t n, const char *file, int line) {
+    (void)file;
+    (void)line;
+    count_alloc(n);
+    return __real_realloc(p, n);
+}
+
+static void ossl_free(void *p, const char *file, int line) {
+    (void)file;
+    (void)line;
+    free(p);
+}
+
+// MongoDB стенду не нужна: init_metadata сервера ссылается, но не вызывается
+meta_store_t *meta_store_open_mongo(const char *uri, const char *database,
+                                    const char *collection, meta_error_t *error) {
+    (void)uri;
+    (void)database;
+    (void)collection;
+    meta_set_error(error, "MongoDB is not linked into bench_handlers");
+    return NULL;
+}
+
+// Замеры потока сервера; запрос i пишет g_samples[i] и только потом g_served
+static sample_t *g_samples;
+static size_t g_samples_cap;
+static _Atomic size_t g_served;
+
+static uint64_t thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Цикл запросов handle_client без рукопожатия и подписки
+static void *serve(void *arg) {
+    SSL *ssl = arg;
+    char fingerprint[FINGERPRINT_LEN];
+    if (!mock_ssl_fingerprint(ssl, fingerprint)) return NULL;
+
+    for (;;) {
+        t_allocs = 0;
+        t_alloc_bytes = 0;
+        uint64_t cpu0 = thread_cpu_ns();
+        t_counting = true;
+
+        // Разбор записи с заголовком — тоже часть запроса
+        RequestHeader req;
+        if (SSL_read(ssl, &req, sizeof(req)) != sizeof(req)) break;
+        metrics_add(g_metrics.bytes_in, sizeof(RequestHeader));
+
+        int command = (int)req.command >= 0 && req.command < CMD_UNKNOWN ? (int)req.command : CMD_UNKNOWN;
+        request_trace_t trace;
+        trace_begin(&trace, command);
+        metrics_inc(g_metrics.requests[command]);
+        switch (req.command) {
+            case CMD_UPLOAD:   handle_upload_request(ssl, &req, fingerprint, &trace); break;
+            case CMD_DOWNLOAD: handle_download_request(ssl, &req, fingerprint, &trace); break;
+            case CMD_LIST:     handle_list_request(ssl, fingerprint); break;
+            default: {
+                ResponseHeader resp = { .status = RESP_UNKNOWN_COMMAND };
+                ssl_send_all(ssl, &resp, sizeof(resp));
+                break;
+            }
+        }
+        finish_request(&trace, &req, fingerprint);
+
+        t_counting = false;
+        size_t i = atomic_load_explicit(&g_served, memory_order_relaxed);
+        if (i < g_samples_cap) {
+            g_samples[i] = (sample_t){
+                .cpu_ns = thread_cpu_ns() - cpu0,
+                .allocs = t_allocs,
+                .alloc_bytes = t_alloc_bytes,
+            };
+        }
+        atomic_store_explicit(&g_served, i + 1, memory_order_release);
+    }
+    t_counting = false;
+    return NULL;
+}
+
+typedef enum { OP_UPLOAD, OP_DOWNLOAD, OP_LIST } bench_op_t;
+
+static const char *const g_op_names[] = { "upload", "download", "list" };
+
+typedef struct {
+    SSL *ssl;
+    uint8_t *data;
+    size_t size;
+    uint8_t hash[BLAKE3_HASH_LEN];
+} client_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int request(client_t *c, bench_op_t op, unsigned i, uint64_t *payload) {
+    char name[64];
+    int status = RESP_SUCCESS;
+    long long size = 0;
+    int rc = -1;
+    switch (op) {
+        case OP_UPLOAD:
+            // Несколько имён: хранилище растёт, как при обычной работе
+            snprintf(name, sizeof(name), "bench-%zu-%u", c->size, i % 8);
+            rc = proto_upload(c->ssl, name, c->data, c->size, c->hash, NULL, &status);
+            size = (long long)c->size;
+            break;
+        case OP_DOWNLOAD:
+            snprintf(name, sizeof(name), "bench-%zu-0", c->size);
+            rc = proto_download(c->ssl, name, NULL, NULL, &size, &status);
+            break;
+        case OP_LIST:
+            rc = proto_list(c->ssl, &size, &status);
+            break;
+    }
+    if (rc != 0) {
+        fprintf(stderr, "%s of %zu bytes failed: %s %d\n", g_op_names[op], c->size,
+                rc < 0 ? "connection error" : "status", status);
+        return -1;
+    }
+    *payload = (uint64_t)size;
+    return 0;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(uint64_t *v, size_t n, double p) {
+    qsort(v, n, sizeof(*v), cmp_u64);
+    size_t idx = (size_t)(p * (double)(n - 1) + 0.5);
+    return v[idx];
+}
+
+// Прогрев, затем requests замеров; false — запрос не прошёл
+static bool run(client_t *c, bench_op_t op, unsigned warmup, unsigned requests, bool *first) {
+    uint64_t payload = 0;
+    for (unsigned i = 0; i < warmup; i++) {
+        if (request(c, op, i, &payload) != 0) return false;
+    }
+
+    size_t base = atomic_load_explicit(&g_served, memory_order_acquire);
+    uint64_t *wall = malloc(requests * sizeof(*wall));
+    uint64_t *column = malloc(requests * sizeof(*column));
+    if (!wall || !column || base + requests > g_samples_cap) {
+        fprintf(stderr, "too many requests for the sample buffer\n");
+        free(wall);
+        free(column);
+        return false;
+    }
+    for (unsigned i = 0; i < requests; i++) {
+        uint64_t t0 = now_ns();
+        if (request(c, op, warmup + i, &payload) != 0) {
+            free(wall);
+            free(column);
+            return false;
+        }
+        wall[i] = now_ns() - t0;
+    }
+    // Ответ уже у клиента, а сервер может ещё дописывать замер
+    while (atomic_load_explicit(&g_served, memory_order_acquire) < base + requests) sched_yield();
+
+    const sample_t *s = &g_samples[base];
+    double cpu_mean = 0;
+    for (unsigned i = 0; i < requests; i++) {
+        column[i] = s[i].cpu_ns;
+        cpu_mean += (double)s[i].cpu_ns / requests;
+    }
+    uint64_t cpu_p50 = percentile(column, requests, 0.5);
+    uint64_t cpu_p99 = percentile(column, requests, 0.99);
+    for (unsigned i = 0; i < requests; i++) column[i] = s[i].allocs;
+    uint64_t allocs_p50 = percentile(column, requests, 0.5);
+    uint64_t allocs_max = column[requests - 1];
+    for (unsigned i = 0; i < requests; i++) column[i] = s[i].alloc_bytes;
+    uint64_t bytes_p50 = percentile(column, requests, 0.5);
+    uint64_t wall_p50 = percentile(wall, requests, 0.5);
+
+    size_t size = op == OP_LIST ? 0 : c->size;
+    printf("%s\n    {\"op\": \"%s\", \"size\": %zu, \"payload\": %llu, \"requests\": %u, "
+           "\"cpu_ns_p50\": %llu, \"cpu_ns_p99\": %llu, \"cpu_ns_mean\": %.0f, "
+           "\"allocs_p50\": %llu, \"allocs_max\": %llu, \"alloc_bytes_p50\": %llu, "
+           "\"wall_us_p50\": %.1f}",
+           *first ? "" : ",", g_op_names[op], size, (unsigned long long)payload, requests,
+           (unsigned long long)cpu_p50, (unsigned long long)cpu_p99, cpu_mean,
+           (unsigned long long)allocs_p50, (unsigned long long)allocs_max,
+           (unsigned long long)bytes_p50, (double)wall_p50 / 1e3);
+    fprintf(stderr, "%-9s %9zu %12.1f %12.1f %9llu %9llu %12llu %10.1f\n",
+            g_op_names[op], size, (double)cpu_p50 / 1e3, (double)cpu_p99 / 1e3,
+            (unsigned long long)allocs_p50, (unsigned long long)allocs_max,
+            (unsigned long long)bytes_p50, (double)wall_p50 / 1e3);
+    *first = false;
+
+    free(wall);
+    free(column);
+    return true;
+}
+
+static size_t parse_size(const char *s) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'K': case 'k': v <<= 10; break;
+        case 'M': case 'm': v <<= 20; break;
+        case 'G': case 'g': v <<= 30; break;
+        default: break;
+    }
+    return (size_t)v;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    if (type == FTW_DP) rmdir(path);
+    else unlink(path);
+    return 0;
+}
+
+// Объекты лежат в каталогах веера xx/yy: удаляем снизу вверх
+static void remove_storage(void) {
+    object_store_close(g_objects);
+    g_objects = NULL;
+    nftw(g_storage_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+int main(int argc, char **argv) {
+    unsigned requests = 200, warmup = 10;
+    size_t max_size = 1u << 20;
+    const char *meta_spec = "";
+    const char *label = "";
+    log_level_t level = LOG_INFO;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--requests") == 0) requests = (unsigned)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--warmup") == 0) warmup = (unsigned)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--max-size") == 0) max_size = parse_size(argv[i + 1]);
+        else if (strcmp(argv[i], "--meta") == 0) meta_spec = argv[i + 1];
+        else if (strcmp(argv[i], "--log-level") == 0) {
+            if (!log_parse_level(argv[i + 1], &level)) {
+                fprintf(stderr, "invalid --log-level %s\n", argv[i + 1]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "--label") == 0) label = argv[i + 1];
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (requests == 0) requests = 1;
+
+    meta_mem_options_t meta_options;
+    if (!meta_mem_parse_options(meta_spec, &meta_options)) {
+        fprintf(stderr, "invalid --meta %s\n", meta_spec);
+        return EXIT_FAILURE;
+    }
+
+    // До первого вызова OpenSSL, иначе замена не принимается
+    if (!CRYPTO_set_mem_functions(ossl_malloc, ossl_realloc, ossl_free)) {
+        fprintf(stderr, "CRYPTO_set_mem_functions failed, OpenSSL allocations not counted\n");
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // Журнал форматируется, как на сервере, но никуда не пишется
+    if (!log_init("/dev/null", level)) return EXIT_FAILURE;
+    setenv("EXCHANGE_METRICS_PORT", "0", 0);
+    init_metrics();
+
+    snprintf(g_storage_dir, sizeof(g_storage_dir), "/tmp/bench-handlers.XXXXXX");
+    if (!mkdtemp(g_storage_dir)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    g_meta = meta_store_open_memory(&meta_options);
+    int store_err = 0;
+    g_objects = object_store_open(g_storage_dir, NULL, &store_err);
+    init_chunk_cache();
+    g_flights = flight_group_create();
+    g_uploads = flight_group_create();
+
+    unsigned nsizes = 0;
+    for (size_t size = MIN_SIZE; size <= max_size; size *= 4) nsizes++;
+    g_samples_cap = (size_t)(nsizes * 2 + 1) * (requests + warmup);
+    g_samples = calloc(g_samples_cap, sizeof(*g_samples));
+
+    mock_ssl_env_t env;
+    mock_ssl_conn_t conn;
+    if (!g_meta || !g_objects || !g_samples || !init_cryptography() || !mock_ssl_env_init(&env)) {
+        fprintf(stderr, "setup failed\n");
+        remove_storage();
+        return EXIT_FAILURE;
+    }
+    if (!mock_ssl_connect(&env, &conn)) {
+        fprintf(stderr, "TLS handshake over socketpair failed\n");
+        remove_storage();
+        return EXIT_FAILURE;
+    }
+    pthread_t server;
+    if (pthread_create(&server, NULL, serve, conn.server) != 0) {
+        perror("pthread_create");
+        remove_storage();
+        return EXIT_FAILURE;
+    }
+
+    printf("{\n  \"label\": \"%s\",\n  \"openssl\": \"%s\",\n  \"meta\": \"%s\",\n"
+           "  \"results\": [", label, OPENSSL_VERSION_TEXT, meta_spec);
+    fprintf(stderr, "%-9s %9s %12s %12s %9s %9s %12s %10s\n", "op", "size", "cpu_us_p50",
+            "cpu_us_p99", "allocs", "allocs_max", "alloc_bytes", "wall_us");
+
+    client_t client = { .ssl = conn.client };
+    bool ok = true, first = true;
+    uint64_t rng = 0x9e3779b97f4a7c15ull;
+    for (size_t size = MIN_SIZE; ok && size <= max_size; size *= 4) {
+        uint8_t *data = malloc(size);
+        if (!data) {
+            ok = false;
+            break;
+        }
+        for (size_t i = 0; i < size; i++) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            data[i] = (uint8_t)rng;
+        }
+        client.data = data;
+        client.size = size;
+        blake3_hasher hasher;
+        blake3_hasher_init(&hasher);
+        blake3_hasher_update(&hasher, data, size);
+        blake3_hasher_finalize(&hasher, client.hash, BLAKE3_HASH_LEN);
+
+        ok = run(&client, OP_UPLOAD, warmup, requests, &first) &&
+             run(&client, OP_DOWNLOAD, warmup, requests, &first);
+        free(data);
+    }
+    // Список всего загруженного выше
+    if (ok) ok = run(&client, OP_LIST, warmup, requests, &first);
+    printf("\n  ]\n}\n");
+
+    SSL_shutdown(conn.client);
+    shutdown(conn.fds[1], SHUT_WR);
+    pthread_join(server, NULL);
+    mock_ssl_conn_close(&conn);
+    mock_ssl_env_free(&env);
+    meta_store_close(g_meta);
+    chunk_cache_destroy(g_chunks);
+    flight_group_destroy(g_flights);
+    flight_group_destroy(g_uploads);
+    free(g_samples);
+    remove_storage();
+    log_shutdown();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,141 @@
+// bench_logger.c
+//
+// Стоимость журнала на запрос: прежний logger (localtime, fprintf и fflush
+// на каждую строку под блокировкой FILE) против асинхронного. «Запрос» —
+// столько строк, сколько пишет загрузка файла на сервере: четыре INFO и
+// две DEBUG, которые при уровне INFO отфильтровываются.
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/utils/logger.h"
+
+#define REQUESTS_PER_THREAD 5000
+
+static FILE *g_sync_file;
+static int g_sync_min_level = LOG_INFO;
+
+// Прежняя реализация, как была в server.c и main.c
+static void sync_logger(log_level_t level, const char *format, ...) {
+    if ((int)level < g_sync_min_level) return;
+
+    const char *level_str[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+    time_t now = time(NULL);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    char timestamp[20];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+
+    flockfile(g_sync_file);
+    fprintf(g_sync_file, "[%s] [%s] ", timestamp, level_str[level]);
+    va_list args;
+    va_start(args, format);
+    vfprintf(g_sync_file, format, args);
+    va_end(args);
+    fprintf(g_sync_file, "\n");
+    fflush(g_sync_file);
+    funlockfile(g_sync_file);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Между запросами поток ждёт сеть (~50 мкс сна), иначе бенчмарк измеряет
+// только переполнение буферов
+static void simulate_request(void) {
+    struct timespec ts = {0, 50000};
+    nanosleep(&ts, NULL);
+}
+
+typedef enum { MODE_SYNC, MODE_ASYNC } bench_mode_t;
+static bench_mode_t g_mode;
+
+#define LOG_REQUEST(log, id, i)                                                  \
+    do {                                                                         \
+        log(LOG_INFO, "Upload request: file_%d_%d.bin (%d bytes)", id, i, 4096); \
+        log(LOG_DEBUG, "Client %d chunk %d received", id, i);                    \
+        log(LOG_DEBUG, "Client %d integrity check passed", id);                  \
+        log(LOG_INFO, "Stored file_%d_%d.bin to storage", id, i);                \
+        log(LOG_INFO, "Added event upload to file_%d_%d.bin: success", id, i);   \
+        log(LOG_INFO, "File uploaded successfully: file_%d_%d.bin", id, i);      \
+    } while (0)
+
+// Время, которое журнал отнимает у потока-обработчика: замер только вокруг
+// строк журнала, медиана по запросам (на одном ядре среднее портят вытеснения)
+static uint64_t g_samples[64][REQUESTS_PER_THREAD];
+
+static void *worker(void *arg) {
+    int id = (int)(intptr_t)arg;
+    for (int i = 0; i < REQUESTS_PER_THREAD; i++) {
+        simulate_request();
+        uint64_t start = now_ns();
+        if (g_mode == MODE_SYNC) LOG_REQUEST(sync_logger, id, i);
+        else LOG_REQUEST(logger, id, i);
+        g_samples[id][i] = now_ns() - start;
+    }
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t run(bench_mode_t mode, int nthreads) {
+    pthread_t threads[64];
+    g_mode = mode;
+    for (int t = 0; t < nthreads; t++) {
+        pthread_create(&threads[t], NULL, worker, (void *)(intptr_t)t);
+    }
+    for (int t = 0; t < nthreads; t++) pthread_join(threads[t], NULL);
+
+    size_t n = (size_t)nthreads * REQUESTS_PER_THREAD;
+    qsort(g_samples, n, sizeof(uint64_t), cmp_u64);
+    return g_samples[0][n / 2];
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "/tmp/bench_logger.log";
+    int thread_counts[] = {1, 4, 16};
+
+    printf("%-8s %14s %14s %10s %10s\n", "threads", "sync p50 ns", "async p50 ns",
+           "speedup", "dropped");
+
+    for (size_t k = 0; k < sizeof(thread_counts) / sizeof(thread_counts[0]); k++) {
+        int nthreads = thread_counts[k];
+
+        g_sync_file = fopen(path, "w");
+        if (!g_sync_file) {
+            perror("fopen");
+            return EXIT_FAILURE;
+        }
+        double sync_ns = (double)run(MODE_SYNC, nthreads);
+        fclose(g_sync_file);
+
+        unlink(path);
+        if (!log_init(path, LOG_INFO)) {
+            fprintf(stderr, "log_init failed\n");
+            return EXIT_FAILURE;
+        }
+        log_stats_t before = log_get_stats();
+        double async_ns = (double)run(MODE_ASYNC, nthreads);
+        log_shutdown();
+        log_stats_t after = log_get_stats();
+
+        printf("%-8d %14.0f %14.0f %9.1fx %10llu\n", nthreads, sync_ns, async_ns,
+               async_ns > 0 ? sync_ns / async_ns : 0.0,
+               (unsigned long long)(after.dropped - before.dropped));
+    }
+
+    unlink(path);
+    return EXIT_SUCCESS;
+}
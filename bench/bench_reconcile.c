@@ -0,0 +1,157 @@
+// bench_reconcile.c
+//
+// Стоимость сверки на большом дереве: сортировка записанного состояния
+// (после загрузки из MongoDB), сравнение снимков и обход реального дерева.
+// Всё это идёт в фоновом потоке; цикл событий платит только за выдачу
+// расхождений порциями по RECONCILE_EMIT_SLICE в склейку — её тоже меряем.
+//
+// Запуск: bench_reconcile [файлов] [каталог для обхода]
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/core/event_coalescer.h"
+#include "../src/core/reconcile.h"
+
+#define FILES_PER_DIR 1000
+#define EMIT_SLICE    4096 // как RECONCILE_EMIT_SLICE в main.c
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void file_path(char *buf, size_t len, const char *root, size_t i) {
+    snprintf(buf, len, "%s/d%04zu/f%07zu", root, i / FILES_PER_DIR, i);
+}
+
+typedef struct {
+    reconcile_change_t *kinds;
+    const file_state_t **states;
+    size_t n;
+} changes_t;
+
+static void collect(void *ctx, reconcile_change_t change, const file_state_t *st) {
+    changes_t *c = ctx;
+    c->kinds[c->n] = change;
+    c->states[c->n++] = st;
+}
+
+static void drop(void *ctx, const fs_event_t *ev) {
+    (void)ctx;
+    (void)ev;
+}
+
+// Обычные файлы в count / FILES_PER_DIR каталогах; уже созданные не трогаем
+static int build_tree(const char *root, size_t count) {
+    char path[4096];
+    mkdir(root, 0755);
+    for (size_t i = 0; i < count; i++) {
+        if (i % FILES_PER_DIR == 0) {
+            snprintf(path, sizeof(path), "%s/d%04zu", root, i / FILES_PER_DIR);
+            if (mkdir(path, 0755) != 0 && access(path, F_OK) != 0) return -1;
+        }
+        file_path(path, sizeof(path), root, i);
+        int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1) return -1;
+        close(fd);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    const char *tree = argc > 2 ? argv[2] : NULL;
+    const char *root = "/srv/exchange";
+    char path[4096];
+
+    // Записанное приходит из MongoDB в произвольном порядке; на диске
+    // 1% файлов изменён, 0.5% удалён и 0.5% создан заново
+    file_state_set_t recorded = {0}, actual = {0};
+    srand(1);
+    size_t *order = malloc(count * sizeof(size_t));
+    for (size_t i = 0; i < count; i++) order[i] = i;
+    for (size_t i = count - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % (i + 1);
+        size_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (size_t k = 0; k < count; k++) {
+        size_t i = order[k];
+        file_path(path, sizeof(path), root, i);
+        if (i % 200 != 1) file_state_set_add(&recorded, path, 4096, 1000);
+        if (i % 200 != 0) file_state_set_add(&actual, path, 4096, i % 100 == 2 ? 2000 : 1000);
+    }
+    free(order);
+    file_state_set_sort(&actual);
+
+    uint64_t t0 = now_ns();
+    file_state_set_sort(&recorded);
+    uint64_t t1 = now_ns();
+
+    changes_t changes = {
+        .kinds = malloc(count * sizeof(reconcile_change_t)),
+        .states = malloc(count * sizeof(file_state_t *)),
+    };
+    reconcile_stats_t rs = reconcile_diff(&recorded, &actual, collect, &changes);
+    uint64_t t2 = now_ns();
+
+    printf("%zu recorded, %zu on disk: %llu created, %llu modified, %llu deleted\n",
+           recorded.len, actual.len, (unsigned long long)rs.created,
+           (unsigned long long)rs.modified, (unsigned long long)rs.deleted);
+    printf("sort recorded   %8.1f ms  (background thread)\n", (double)(t1 - t0) / 1e6);
+    printf("diff            %8.1f ms  (background thread)\n", (double)(t2 - t1) / 1e6);
+
+    // Выдача в склейку на цикле событий: худшая порция
+    coalescer_t *c = coalescer_new(200000000ull, 65536, drop, NULL);
+    uint64_t worst = 0, total = 0;
+    for (size_t i = 0; i < changes.n; i += EMIT_SLICE) {
+        size_t end = i + EMIT_SLICE < changes.n ? i + EMIT_SLICE : changes.n;
+        uint64_t s = now_ns();
+        for (size_t k = i; k < end; k++) {
+            switch (changes.kinds[k]) {
+                case RECONCILE_CREATED:  coalescer_created(c, changes.states[k]->path, s); break;
+                case RECONCILE_MODIFIED: coalescer_modified(c, changes.states[k]->path, s); break;
+                case RECONCILE_DELETED:  coalescer_deleted(c, changes.states[k]->path, s); break;
+            }
+        }
+        uint64_t e = now_ns() - s;
+        total += e;
+        if (e > worst) worst = e;
+    }
+    coalescer_free(c);
+    printf("emit %zu changes %8.1f ms total, worst slice of %d: %.2f ms  (event loop)\n",
+           changes.n, (double)total / 1e6, EMIT_SLICE, (double)worst / 1e6);
+
+    free(changes.kinds);
+    free(changes.states);
+    file_state_set_free(&recorded);
+    file_state_set_free(&actual);
+
+    if (tree) {
+        if (build_tree(tree, count) != 0) {
+            perror("build_tree");
+            return EXIT_FAILURE;
+        }
+        file_state_set_t scanned = {0};
+        tree_walk_stats_t ws = {0};
+        uint64_t s = now_ns();
+        if (reconcile_scan(tree, tree_walk_default_threads(), &scanned, &ws) != 0) {
+            fprintf(stderr, "reconcile_scan failed\n");
+            return EXIT_FAILURE;
+        }
+        printf("scan %zu files   %8.1f ms  (background thread, %u walker threads)\n",
+               scanned.len, (double)(now_ns() - s) / 1e6, tree_walk_default_threads());
+        file_state_set_free(&scanned);
+    }
+
+    return EXIT_SUCCESS;
+}
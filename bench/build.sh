@@ -0,0 +1,40 @@
+#!/bin/bash
+set -e
+
+# Микробенчмарки модулей; собираются с оптимизацией, без MongoDB
+gcc -O2 -o bench_logger bench_logger.c ../src/utils/logger.c -Wall -Wextra -lpthread
+gcc -O2 -o bench_reconcile bench_reconcile.c ../src/core/reconcile.c ../src/core/tree_walk.c \
+    ../src/core/event_coalescer.c -Wall -Wextra -lpthread
+
+# BLAKE3 с теми же SIMD-вариантами, что и у сервера
+BLAKE3_DIR=../deps/blake3
+gcc -O2 -c $BLAKE3_DIR/blake3_sse2.c -o blake3_sse2.o -msse2
+gcc -O2 -c $BLAKE3_DIR/blake3_sse41.c -o blake3_sse41.o -msse4.1
+gcc -O2 -c $BLAKE3_DIR/blake3_avx2.c -o blake3_avx2.o -mavx2
+gcc -O2 -o bench_crypto bench_crypto.c ../src/common/hash_utils.c ../src/crypto/aes_gcm.c \
+    $BLAKE3_DIR/blake3.c $BLAKE3_DIR/blake3_dispatch.c $BLAKE3_DIR/blake3_portable.c \
+    blake3_sse2.o blake3_sse41.o blake3_avx2.o -I$BLAKE3_DIR -DBLAKE3_NO_AVX512 \
+    -Wall -Wextra -lcrypto -lpthread
+
+# Генератор нагрузки: нужен запущенный сервер, поэтому только собираем
+gcc -O2 -o loadgen loadgen.c ../src/client/client_proto.c ../src/utils/metrics.c \
+    ../src/common/hash_utils.c $BLAKE3_DIR/blake3.c $BLAKE3_DIR/blake3_dispatch.c \
+    $BLAKE3_DIR/blake3_portable.c blake3_sse2.o blake3_sse41.o blake3_avx2.o \
+    -I$BLAKE3_DIR -DBLAKE3_NO_AVX512 -Wall -Wextra -lssl -lcrypto -lpthread -lm
+# Обработчики сервера на socketpair с mTLS в памяти (tests/mocks) и
+# метаданными в памяти; malloc кода сервера считается через --wrap
+gcc -O2 -o bench_handlers bench_handlers.c ../src/client/client_proto.c \
+    ../src/db/meta_store.c ../src/db/meta_store_mem.c ../src/storage/object_store.c \
+    ../src/storage/pack_store.c ../src/storage/sync_group.c ../src/storage/buffer_pool.c \
+    ../src/storage/chunk_cache.c ../src/storage/flight_group.c ../src/crypto/aes_gcm.c \
+    ../src/net/notify_bus.c ../src/net/metrics_http.c ../src/utils/logger.c \
+    ../src/utils/metrics.c ../src/utils/request_trace.c \
+    $BLAKE3_DIR/blake3.c $BLAKE3_DIR/blake3_dispatch.c $BLAKE3_DIR/blake3_portable.c \
+    blake3_sse2.o blake3_sse41.o blake3_avx2.o -I$BLAKE3_DIR -DBLAKE3_NO_AVX512 \
+    -Wall -Wextra -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc -lssl -lcrypto -lpthread
+rm -f blake3_sse2.o blake3_sse41.o blake3_avx2.o
+
+./bench_logger
+./bench_reconcile
+./bench_crypto --label "$(git rev-parse --short HEAD 2>/dev/null)" > bench_crypto.json
+./bench_handlers --label "$(git rev-parse --short HEAD 2>/dev/null)" > bench_handlers.json
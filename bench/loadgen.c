@@ -0,0 +1,513 @@
+// loadgen.c
+//
+// Нагрузка на сервер по mTLS: тысячи клиентов, у каждого своё соединение
+// и свой сертификат (EC P-256, выписывается при старте от того же CA, что
+// проверяет сервер), смесь upload/download/list и размеры файлов из
+// логнормального распределения. Протокол — общий с client.c (client_proto).
+//
+// Нагрузка открытая: каждый клиент планирует запросы по пуассоновскому
+// потоку с частотой rate/clients. Задержка считается от запланированного
+// момента, а не от фактической отправки, — иначе медленный ответ сдвигает
+// следующие запросы и хвост задержек прячется (coordinated omission).
+// Рядом выводится и время обслуживания от отправки, для сравнения.
+//
+// Только localhost: сервер и mongod (или заглушка метаданных) запускаются
+// локально, адрес вне 127.0.0.0/8 не принимается.
+//
+// Запуск из bench/:
+//   loadgen [--clients 1000] [--rate 500] [--duration 30] [--mix upload=20,download=70,list=10]
+//           [--size-median 64K] [--size-sigma 1.5] [--max-size 16M] [--files 4]
+//           [--ip 127.0.0.1] [--port 5151] [--ca ../src/ca.pem] [--ca-key ../src/ca-key.pem]
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include "../src/client/client_proto.h"
+#include "../src/common/hash_utils.h"
+#include "../src/utils/metrics.h"
+
+#define CLIENT_STACK      (256 * 1024)
+#define RECONNECT_WAIT_NS 100000000ull
+
+typedef enum {
+    OP_UPLOAD,
+    OP_DOWNLOAD,
+    OP_LIST,
+    OP_COUNT
+} op_t;
+
+static const char *const g_op_names[OP_COUNT] = { "upload", "download", "list" };
+
+static struct {
+    unsigned clients;
+    double rate;             // запросов в секунду на всех клиентов
+    unsigned duration_s;
+    unsigned mix[OP_COUNT];  // веса
+    size_t size_median;
+    double size_sigma;
+    size_t max_size;
+    unsigned files;          // файлов на клиента
+    struct sockaddr_in addr;
+    const char *ca;
+    const char *ca_key;
+} g_opt = {
+    .clients = 1000, .rate = 500, .duration_s = 30, .mix = { 20, 70, 10 },
+    .size_median = 64 * 1024, .size_sigma = 1.5, .max_size = 16 << 20, .files = 4,
+    .ca = "../src/ca.pem", .ca_key = "../src/ca-key.pem",
+};
+
+static SSL_CTX *g_ctx;
+static X509 *g_ca_cert;
+static EVP_PKEY *g_ca_key;
+static uint8_t *g_pool;       // случайные данные, файлы — срезы пула
+static size_t g_pool_len;
+static pthread_barrier_t g_ready;
+static uint64_t g_start_ns;   // общий старт измерения, выставляет main
+static _Atomic unsigned g_setup_failed;
+
+static struct {
+    metric_id_t latency[OP_COUNT];  // от запланированного момента
+    metric_id_t service[OP_COUNT];  // от отправки
+    metric_id_t ops[OP_COUNT];
+    metric_id_t errors[OP_COUNT];
+    metric_id_t bytes[OP_COUNT];
+    metric_id_t reconnects;
+} g_m;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t) {
+    struct timespec ts = { .tv_sec = (time_t)(t / 1000000000ull), .tv_nsec = (long)(t % 1000000000ull) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+// xorshift64*: у каждого клиента свой поток случайных чисел
+static uint64_t next_rand(uint64_t *s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 2685821657736338717ull;
+}
+
+static double rand_unit(uint64_t *s) {
+    return ((double)(next_rand(s) >> 11) + 0.5) / 9007199254740992.0; // (0, 1)
+}
+
+static double rand_exp(uint64_t *s, double mean) {
+    return -log(rand_unit(s)) * mean;
+}
+
+static size_t rand_size(uint64_t *s) {
+    // Бокс — Мюллер, логнормальное с заданной медианой
+    double z = sqrt(-2.0 * log(rand_unit(s))) * cos(2.0 * M_PI * rand_unit(s));
+    double v = (double)g_opt.size_median * exp(g_opt.size_sigma * z);
+    if (v < 1) v = 1;
+    if (v > (double)g_opt.max_size) v = (double)g_opt.max_size;
+    return (size_t)v;
+}
+
+static op_t rand_op(uint64_t *s) {
+    unsigned total = 0;
+    for (int i = 0; i < OP_COUNT; i++) total += g_opt.mix[i];
+    unsigned r = (unsigned)(next_rand(s) % total);
+    for (int i = 0; i < OP_COUNT; i++) {
+        if (r < g_opt.mix[i]) return (op_t)i;
+        r -= g_opt.mix[i];
+    }
+    return OP_LIST;
+}
+
+// Ключ и сертификат клиента, подписанный CA сервера
+static bool make_identity(unsigned id, EVP_PKEY **key_out, X509 **cert_out) {
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *cert = X509_new();
+    if (!key || !cert) goto fail;
+
+    char cn[64];
+    snprintf(cn, sizeof(cn), "loadgen-%d-%u", (int)getpid(), id);
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), (long)((unsigned)getpid() * 100000u + id));
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                               (const unsigned char *)cn, -1, -1, 0);
+    if (X509_set_issuer_name(cert, X509_get_subject_name(g_ca_cert)) != 1 ||
+        X509_set_pubkey(cert, key) != 1 ||
+        X509_sign(cert, g_ca_key, EVP_sha256()) <= 0) {
+        goto fail;
+    }
+    *key_out = key;
+    *cert_out = cert;
+    return true;
+
+fail:
+    EVP_PKEY_free(key);
+    X509_free(cert);
+    return false;
+}
+
+typedef struct {
+    unsigned id;
+    uint64_t rng;
+    EVP_PKEY *key;
+    X509 *cert;
+    int fd;
+    SSL *ssl;
+    struct {
+        char name[FILENAME_MAX_LEN];
+        const uint8_t *data;
+        size_t len;
+        uint8_t hash[HASH_SIZE];
+    } *files;
+} client_t;
+
+static void disconnect(client_t *c) {
+    if (c->ssl) {
+        SSL_free(c->ssl);
+        c->ssl = NULL;
+    }
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+}
+
+static bool connect_client(client_t *c) {
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (c->fd < 0 || connect(c->fd, (struct sockaddr *)&g_opt.addr, sizeof(g_opt.addr)) != 0) {
+        disconnect(c);
+        return false;
+    }
+    c->ssl = SSL_new(g_ctx);
+    if (!c->ssl ||
+        SSL_use_certificate(c->ssl, c->cert) != 1 ||
+        SSL_use_PrivateKey(c->ssl, c->key) != 1 ||
+        SSL_set_fd(c->ssl, c->fd) != 1 ||
+        SSL_connect(c->ssl) != 1) {
+        disconnect(c);
+        return false;
+    }
+    return true;
+}
+
+// Один запрос; false — соединение потеряно
+static bool run_op(client_t *c, op_t op, uint64_t *bytes, bool *ok) {
+    int status = 0, rc;
+    long long size = 0;
+    unsigned k = (unsigned)(next_rand(&c->rng) % g_opt.files);
+
+    switch (op) {
+        case OP_UPLOAD:
+            rc = proto_upload(c->ssl, c->files[k].name, c->files[k].data, c->files[k].len,
+                              c->files[k].hash, NULL, &status);
+            *bytes = c->files[k].len;
+            break;
+        case OP_DOWNLOAD:
+            rc = proto_download(c->ssl, c->files[k].name, NULL, NULL, &size, &status);
+            *bytes = size > 0 ? (uint64_t)size : 0;
+            break;
+        default:
+            rc = proto_list(c->ssl, &size, &status);
+            *bytes = size > 0 ? (uint64_t)size : 0;
+            break;
+    }
+    *ok = rc == 0;
+    return rc >= 0;
+}
+
+static void *client_main(void *arg) {
+    client_t *c = arg;
+    bool ready = make_identity(c->id, &c->key, &c->cert) && connect_client(c);
+
+    // Разогрев: у каждого клиента на сервере уже лежат его файлы
+    for (unsigned k = 0; ready && k < g_opt.files; k++) {
+        int status;
+        ready = proto_upload(c->ssl, c->files[k].name, c->files[k].data, c->files[k].len,
+                             c->files[k].hash, NULL, &status) == 0;
+    }
+    if (!ready) atomic_fetch_add(&g_setup_failed, 1);
+
+    pthread_barrier_wait(&g_ready);
+    pthread_barrier_wait(&g_ready); // main выставил g_start_ns
+    if (atomic_load(&g_setup_failed)) {
+        disconnect(c);
+        return NULL;
+    }
+
+    double mean_gap_ns = 1e9 * g_opt.clients / g_opt.rate;
+    uint64_t end = g_start_ns + (uint64_t)g_opt.duration_s * 1000000000ull;
+    // Клиенты стартуют вразнобой, а не все в первую наносекунду
+    uint64_t intended = g_start_ns + (uint64_t)rand_exp(&c->rng, mean_gap_ns);
+
+    while (intended < end) {
+        sleep_until(intended);
+        op_t op = rand_op(&c->rng);
+
+        if (!c->ssl) {
+            metrics_inc(g_m.reconnects);
+            if (!connect_client(c)) {
+                metrics_inc(g_m.errors[op]);
+                sleep_until(now_ns() + RECONNECT_WAIT_NS);
+                intended += (uint64_t)rand_exp(&c->rng, mean_gap_ns);
+                continue;
+            }
+        }
+
+        uint64_t sent = now_ns(), bytes = 0;
+        bool ok;
+        if (!run_op(c, op, &bytes, &ok)) disconnect(c);
+        uint64_t done = now_ns();
+
+        metrics_inc(g_m.ops[op]);
+        if (ok) {
+            metrics_observe(g_m.latency[op], done - intended);
+            metrics_observe(g_m.service[op], done - sent);
+            metrics_add(g_m.bytes[op], bytes);
+        } else {
+            metrics_inc(g_m.errors[op]);
+        }
+        // Следующий запрос по расписанию, даже если этот опоздал
+        intended += (uint64_t)rand_exp(&c->rng, mean_gap_ns);
+    }
+
+    if (c->ssl) SSL_shutdown(c->ssl);
+    disconnect(c);
+    return NULL;
+}
+
+static size_t parse_size(const char *s) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'K': case 'k': v <<= 10; break;
+        case 'M': case 'm': v <<= 20; break;
+        case 'G': case 'g': v <<= 30; break;
+        default: break;
+    }
+    return (size_t)v;
+}
+
+static bool parse_mix(char *s) {
+    unsigned mix[OP_COUNT] = {0}, total = 0;
+    for (char *tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+        char *eq = strchr(tok, '=');
+        if (!eq) return false;
+        *eq = '\0';
+        int op = -1;
+        for (int i = 0; i < OP_COUNT; i++) {
+            if (strcmp(tok, g_op_names[i]) == 0) op = i;
+        }
+        if (op < 0) return false;
+        mix[op] = (unsigned)strtoul(eq + 1, NULL, 10);
+        total += mix[op];
+    }
+    if (total == 0) return false;
+    memcpy(g_opt.mix, mix, sizeof(mix));
+    return true;
+}
+
+static bool parse_args(int argc, char **argv) {
+    const char *ip = "127.0.0.1";
+    int port = 5151;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *k = argv[i], *v = argv[i + 1];
+        if (strcmp(k, "--clients") == 0) g_opt.clients = (unsigned)strtoul(v, NULL, 10);
+        else if (strcmp(k, "--rate") == 0) g_opt.rate = strtod(v, NULL);
+        else if (strcmp(k, "--duration") == 0) g_opt.duration_s = (unsigned)strtoul(v, NULL, 10);
+        else if (strcmp(k, "--mix") == 0) {
+            if (!parse_mix(argv[i + 1])) return false;
+        }
+        else if (strcmp(k, "--size-median") == 0) g_opt.size_median = parse_size(v);
+        else if (strcmp(k, "--size-sigma") == 0) g_opt.size_sigma = strtod(v, NULL);
+        else if (strcmp(k, "--max-size") == 0) g_opt.max_size = parse_size(v);
+        else if (strcmp(k, "--files") == 0) g_opt.files = (unsigned)strtoul(v, NULL, 10);
+        else if (strcmp(k, "--ip") == 0) ip = v;
+        else if (strcmp(k, "--port") == 0) port = atoi(v);
+        else if (strcmp(k, "--ca") == 0) g_opt.ca = v;
+        else if (strcmp(k, "--ca-key") == 0) g_opt.ca_key = v;
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return false;
+        }
+    }
+    if (g_opt.clients == 0 || g_opt.rate <= 0 || g_opt.files == 0 || g_opt.max_size == 0 ||
+        g_opt.size_median == 0) {
+        fprintf(stderr, "clients, rate, files, sizes must be positive\n");
+        return false;
+    }
+
+    g_opt.addr.sin_family = AF_INET;
+    g_opt.addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, ip, &g_opt.addr.sin_addr) != 1 ||
+        (ntohl(g_opt.addr.sin_addr.s_addr) >> 24) != 127) {
+        fprintf(stderr, "%s: only loopback addresses (127.0.0.0/8) are allowed\n", ip);
+        return false;
+    }
+    return true;
+}
+
+static bool load_ca(void) {
+    FILE *fp = fopen(g_opt.ca, "r");
+    if (fp) {
+        g_ca_cert = PEM_read_X509(fp, NULL, NULL, NULL);
+        fclose(fp);
+    }
+    fp = fopen(g_opt.ca_key, "r");
+    if (fp) {
+        g_ca_key = PEM_read_PrivateKey(fp, NULL, NULL, NULL);
+        fclose(fp);
+    }
+    if (!g_ca_cert || !g_ca_key) {
+        fprintf(stderr, "cannot load CA from %s / %s\n", g_opt.ca, g_opt.ca_key);
+        return false;
+    }
+
+    g_ctx = SSL_CTX_new(TLS_client_method());
+    if (!g_ctx || SSL_CTX_load_verify_locations(g_ctx, g_opt.ca, NULL) != 1) {
+        ERR_print_errors_fp(stderr);
+        return false;
+    }
+    SSL_CTX_set_verify(g_ctx, SSL_VERIFY_PEER, NULL);
+    return true;
+}
+
+static void register_metrics(void) {
+    char labels[64];
+    for (int i = 0; i < OP_COUNT; i++) {
+        snprintf(labels, sizeof(labels), "op=\"%s\"", g_op_names[i]);
+        g_m.latency[i] = metrics_histogram("loadgen_latency", labels, NULL, METRICS_UNIT_NANOSECONDS);
+        g_m.service[i] = metrics_histogram("loadgen_service", labels, NULL, METRICS_UNIT_NANOSECONDS);
+        g_m.ops[i] = metrics_counter("loadgen_ops", labels, NULL);
+        g_m.errors[i] = metrics_counter("loadgen_errors", labels, NULL);
+        g_m.bytes[i] = metrics_counter("loadgen_bytes", labels, NULL);
+    }
+    g_m.reconnects = metrics_counter("loadgen_reconnects", NULL, NULL);
+}
+
+static void report(double seconds) {
+    printf("%-9s %9s %9s %7s %10s %10s %10s %10s %12s\n", "op", "ops", "ops/s", "errors",
+           "p50 ms", "p99 ms", "p999 ms", "MB/s", "p99 svc ms");
+    for (int i = 0; i < OP_COUNT; i++) {
+        uint64_t ops = metrics_counter_value(g_m.ops[i]);
+        if (ops == 0) continue;
+        printf("%-9s %9llu %9.1f %7llu %10.2f %10.2f %10.2f %10.2f %12.2f\n", g_op_names[i],
+               (unsigned long long)ops, (double)ops / seconds,
+               (unsigned long long)metrics_counter_value(g_m.errors[i]),
+               (double)metrics_histogram_percentile(g_m.latency[i], 50) / 1e6,
+               (double)metrics_histogram_percentile(g_m.latency[i], 99) / 1e6,
+               (double)metrics_histogram_percentile(g_m.latency[i], 99.9) / 1e6,
+               (double)metrics_counter_value(g_m.bytes[i]) / seconds / 1e6,
+               (double)metrics_histogram_percentile(g_m.service[i], 99) / 1e6);
+    }
+    printf("reconnects %llu; latency from intended start (coordinated omission corrected), "
+           "svc from send; percentiles within 12.5%%\n",
+           (unsigned long long)metrics_counter_value(g_m.reconnects));
+}
+
+int main(int argc, char **argv) {
+    if (!parse_args(argc, argv) || !load_ca()) return EXIT_FAILURE;
+    register_metrics();
+
+    // Пул на max_size + запас: файл клиента — срез со случайного смещения
+    g_pool_len = g_opt.max_size + (1 << 20);
+    g_pool = malloc(g_pool_len);
+    for (size_t off = 0; g_pool && off < g_pool_len; off += 1 << 20) {
+        size_t n = g_pool_len - off < (1u << 20) ? g_pool_len - off : (1u << 20);
+        if (RAND_bytes(g_pool + off, (int)n) != 1) {
+            free(g_pool);
+            g_pool = NULL;
+        }
+    }
+    if (!g_pool) {
+        fprintf(stderr, "cannot prepare %zu bytes of payload\n", g_pool_len);
+        return EXIT_FAILURE;
+    }
+
+    client_t *clients = calloc(g_opt.clients, sizeof(client_t));
+    pthread_t *threads = calloc(g_opt.clients, sizeof(pthread_t));
+    if (!clients || !threads) return EXIT_FAILURE;
+
+    size_t total_bytes = 0;
+    for (unsigned i = 0; i < g_opt.clients; i++) {
+        client_t *c = &clients[i];
+        c->id = i;
+        c->fd = -1;
+        c->rng = 0x9e3779b97f4a7c15ull * (i + 1) ^ (uint64_t)getpid();
+        c->files = calloc(g_opt.files, sizeof(*c->files));
+        if (!c->files) return EXIT_FAILURE;
+        for (unsigned k = 0; k < g_opt.files; k++) {
+            size_t len = rand_size(&c->rng);
+            size_t off = (size_t)(next_rand(&c->rng) % (g_pool_len - len + 1));
+            snprintf(c->files[k].name, FILENAME_MAX_LEN, "loadgen-%d-%u-%u", (int)getpid(), i, k);
+            c->files[k].data = g_pool + off;
+            c->files[k].len = len;
+            compute_buffer_blake3(c->files[k].data, len, c->files[k].hash);
+            total_bytes += len;
+        }
+    }
+    fprintf(stderr, "%u clients, %u files each (%.1f MB), %.0f req/s for %u s\n",
+            g_opt.clients, g_opt.files, (double)total_bytes / 1e6, g_opt.rate, g_opt.duration_s);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, CLIENT_STACK);
+    pthread_barrier_init(&g_ready, NULL, g_opt.clients + 1);
+    for (unsigned i = 0; i < g_opt.clients; i++) {
+        if (pthread_create(&threads[i], &attr, client_main, &clients[i]) != 0) {
+            fprintf(stderr, "cannot start client %u\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Все соединены и загрузили свои файлы — общий старт
+    pthread_barrier_wait(&g_ready);
+    unsigned failed = atomic_load(&g_setup_failed);
+    if (failed) {
+        fprintf(stderr, "%u clients failed to connect or upload their files\n", failed);
+    }
+    g_start_ns = now_ns() + 10000000ull;
+    pthread_barrier_wait(&g_ready);
+
+    for (unsigned i = 0; i < g_opt.clients; i++) pthread_join(threads[i], NULL);
+    double seconds = (double)(now_ns() - g_start_ns) / 1e9;
+    if (failed) return EXIT_FAILURE;
+
+    report(seconds);
+
+    for (unsigned i = 0; i < g_opt.clients; i++) {
+        X509_free(clients[i].cert);
+        EVP_PKEY_free(clients[i].key);
+        free(clients[i].files);
+    }
+    free(clients);
+    free(threads);
+    free(g_pool);
+    SSL_CTX_free(g_ctx);
+    X509_free(g_ca_cert);
+    EVP_PKEY_free(g_ca_key);
+    return EXIT_SUCCESS;
+}
@@ -1 +1,17 @@
-gcc -o exchange-daemon src/main.c src/db/mongo_ops.c $(pkg-config --cflags --libs libmongoc-1.0)
\ No newline at end of file
+#!/bin/bash
+set -e
+
+# BLAKE3 для хеширования содержимого: SIMD-варианты с флагами на файл,
+# выбор реализации — в рантайме (blake3_dispatch.c). AVX-512 не собираем.
+BLAKE3_DIR=deps/blake3
+BLAKE3_OBJS=""
+for src in blake3 blake3_dispatch blake3_portable; do
+    gcc -c $BLAKE3_DIR/$src.c -o $src.o -DBLAKE3_NO_AVX512 -O2
+    BLAKE3_OBJS="$BLAKE3_OBJS $src.o"
+done
+gcc -c $BLAKE3_DIR/blake3_sse2.c -o blake3_sse2.o -O2 -msse2
+gcc -c $BLAKE3_DIR/blake3_sse41.c -o blake3_sse41.o -O2 -msse4.1
+gcc -c $BLAKE3_DIR/blake3_avx2.c -o blake3_avx2.o -O2 -mavx2
+BLAKE3_OBJS="$BLAKE3_OBJS blake3_sse2.o blake3_sse41.o blake3_avx2.o"
+
+gcc -o exchange-daemon src/main.c src/db/mongo_ops.c src/db/meta_store.c src/db/meta_store_mem.c src/db/meta_store_mongo.c src/core/checkpoint.c src/core/event_coalescer.c src/core/event_pipeline.c src/core/hash_cache.c src/core/inotify_watcher.c src/core/latency_hist.c src/core/reconcile.c src/core/tree_walk.c src/core/watch_map.c src/common/hash_utils.c src/utils/logger.c $BLAKE3_OBJS -I$BLAKE3_DIR $(pkg-config --cflags --libs libmongoc-1.0) -lpthread
@@ -14,6 +14,8 @@ typedef enum {
     CMD_UPLOAD,
     CMD_DOWNLOAD,
     CMD_LIST,
+    CMD_SUBSCRIBE, // держит соединение и получает push-уведомления
+    CMD_STAT,      // пакетная проверка существования и метаданных
     CMD_UNKNOWN
 } CommandType;
 
@@ -29,9 +31,14 @@ typedef enum {
     RESP_PERMISSION_DENIED,
     RESP_ERROR,
     RESP_INVALID_OFFSET,
-    RESP_UNKNOWN_COMMAND = 4
+    RESP_UNKNOWN_COMMAND = 4,
+    RESP_NOT_MODIFIED = 6 // у клиента уже актуальное содержимое (If-None-Match)
 } ResponseStatus;
 
+// RequestHeader.flags
+#define REQ_FLAG_PUBLIC        0x01
+#define REQ_FLAG_IF_NONE_MATCH 0x02 // download: file_hash — хеш локальной копии клиента
+
 // Заголовок запроса от клиента к серверу
 typedef struct {
     CommandType command;
@@ -42,7 +49,7 @@ typedef struct {
 
     uint8_t flags; // bit 0 = public
 
-    uint8_t file_hash[BLAKE3_HASH_LEN]; // для download/list
+    uint8_t file_hash[BLAKE3_HASH_LEN]; // upload: хеш данных; download: см. REQ_FLAG_IF_NONE_MATCH
     char recipient[FINGERPRINT_LEN]; // для upload
 } RequestHeader;
 
@@ -53,6 +60,51 @@ typedef struct {
 } ResponseHeader;
 
 
+// CMD_STAT: после RequestHeader (filesize = число элементов) клиент
+// отправляет массив StatQuery, сервер отвечает ResponseHeader
+// (filesize = число элементов) и массивом StatEntry в том же порядке.
+#define STAT_MAX_BATCH 1024
+
+typedef struct {
+    uint8_t by_hash; // 1 = искать по file_hash, 0 = по filename
+    char filename[FILENAME_MAX_LEN];
+    uint8_t file_hash[BLAKE3_HASH_LEN];
+} StatQuery;
+
+// Права вызывающего на файл (StatEntry.permission)
+#define STAT_PERM_OWNER     0x01
+#define STAT_PERM_RECIPIENT 0x02
+#define STAT_PERM_PUBLIC    0x04
+
+typedef struct {
+    uint8_t exists;
+    uint8_t permission;
+    long long size;
+    int64_t uploaded_at; // unix-время в миллисекундах
+    uint8_t file_hash[BLAKE3_HASH_LEN]; // BLAKE3 открытого текста
+} StatEntry;
+
+// Типы push-уведомлений (CMD_SUBSCRIBE). Подписка длится до следующего
+// запроса клиента: сервер отвечает на него только после NOTIFY_END, а до
+// него могут прийти ещё уведомления и keepalive.
+typedef enum {
+    NOTIFY_FILE_UPLOADED,
+    NOTIFY_KEEPALIVE,
+    NOTIFY_RESYNC, // очередь подписчика переполнилась, клиенту нужен один LIST
+    NOTIFY_END     // конец потока, дальше ResponseHeader следующего запроса
+} NotifyType;
+
+// Уведомление от сервера подписчику
+typedef struct {
+    NotifyType type;
+    char filename[FILENAME_MAX_LEN];
+    long long filesize;
+    int64_t uploaded_at; // unix-время в миллисекундах
+    uint8_t flags; // bit 0 = public
+    char owner[FINGERPRINT_LEN];
+} NotifyMessage;
+
+
 // Объявления функциц
 
 int send_all(int sockfd, const void *buffer, size_t len);
@@ -25,6 +25,7 @@ gcc -c client.c -o client.o -Iinclude -Ideps/blake3 -Wall -Wextra $(pkg-config -
 gcc -c ../db/mongo_ops.c -o mongo_ops.o -Iinclude -Ideps/blake3 -Wall -Wextra $(pkg-config --cflags libmongoc-1.0)
 gcc -c ../utils/utils.c -o utils.o -Iinclude -Ideps/blake3 -Wall -Wextra
 gcc -c ../crypto/aes_gcm.c -o aes_gcm.o -Iinclude -Ideps/blake3 -Wall -Wextra
+gcc -c client_proto.c -o client_proto.o -Wall -Wextra
 
 BLAKE3_DIR=../../deps/blake3
 # Компилируем BLAKE3 без AVX512
@@ -36,7 +37,7 @@ gcc -c $BLAKE3_DIR/blake3_sse41.c -o blake3_sse41.o -I$BLAKE3_DIR -Wall -Wextra
 gcc -c $BLAKE3_DIR/blake3_avx2.c -o blake3_avx2.o -I$BLAKE3_DIR -Wall -Wextra -mavx2
 
 # НЕ компилируем blake3_avx512.c
-gcc -o client client.o mongo_ops.o utils.o aes_gcm.o \
+gcc -o client client.o client_proto.o mongo_ops.o utils.o aes_gcm.o \
     blake3.o blake3_dispatch.o blake3_portable.o \
     blake3_sse2.o blake3_sse41.o blake3_avx2.o blake3_avx512.o \
     $(pkg-config --libs libmongoc-1.0) -lssl -lcrypto -lpthread
\ No newline at end of file
@@ -8,8 +8,10 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <linux/limits.h>
 
 #include "../../include/protocol.h"
+#include "client_proto.h"
 
 #define BLAKE3_IMPLEMENTATION
 
@@ -58,21 +60,6 @@ static SSL_CTX *init_client_ssl_ctx(void) {
     return ctx;
 }
 
-/*
- * Reliable SSL write: ensures all bytes are sent.
- */
-static int ssl_send_all(SSL *ssl, const void *buf, size_t len) {
-    size_t sent = 0;
-    while (sent < len) {
-        int n = SSL_write(ssl, (const char *)buf + sent, len - sent);
-        if (n <= 0) {
-            return -1;
-        }
-        sent += n;
-    }
-    return 0;
-}
-
 /*
 * ANSCI anim
 */
@@ -118,21 +105,6 @@ static void show_progress(long long sent, long long total) {
 }
 
 
-/*
- * Reliable SSL read: ensures all expected bytes are received.
- */
-static int ssl_recv_all(SSL *ssl, void *buf, size_t len) {
-    size_t received = 0;
-    while (received < len) {
-        int n = SSL_read(ssl, (char *)buf + received, len - received);
-        if (n <= 0) {
-            return -1;
-        }
-        received += n;
-    }
-    return 0;
-}
-
 /*
  * Upload a file to the server over mTLS.
  * Uses the secure SSL channel for all communication.
@@ -187,13 +159,13 @@ static int upload_file_ssl(SSL *ssl, const char *local_filepath, const char *rem
     memcpy(header.file_hash, file_hash, BLAKE3_HASH_LEN);
 
     printf("Uploading '%s' (%lld bytes) as '%s'...\n", local_filepath, filesize, remote_filename);
-    if (ssl_send_all(ssl, &header, sizeof(RequestHeader)) == -1) {
+    if (proto_send_all(ssl, &header, sizeof(RequestHeader)) == -1) {
         fclose(fp);
         return -1;
     }
 
     /* Wait for server readiness confirmation */
-    if (ssl_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
+    if (proto_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
         fclose(fp);
         return -1;
     }
@@ -210,7 +182,7 @@ static int upload_file_ssl(SSL *ssl, const char *local_filepath, const char *rem
     long long total_sent = 0;
     ssize_t bytes_read;
     while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, fp)) > 0) {
-        if (ssl_send_all(ssl, buffer, bytes_read) == -1) {
+        if (proto_send_all(ssl, buffer, bytes_read) == -1) {
             fprintf(stderr, "Failed to send file data.\n");
             fclose(fp);
             return -1;
@@ -234,7 +206,7 @@ static int upload_file_ssl(SSL *ssl, const char *local_filepath, const char *rem
     printf("File data sent. Total: %lld bytes.\n", total_sent);
 
     /* Receive final upload status */
-    if (ssl_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
+    if (proto_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
         fclose(fp);
         return -1;
     }
@@ -328,12 +300,12 @@ static int download_file_ssl(SSL *ssl, const char *remote_filename, const char *
     header.filesize = 0;
 
     printf("Requesting download of '%s' to '%s'...\n", remote_filename, local_filepath);
-    if (ssl_send_all(ssl, &header, sizeof(RequestHeader)) == -1) {
+    if (proto_send_all(ssl, &header, sizeof(RequestHeader)) == -1) {
         return -1;
     }
 
     /* Receive file metadata */
-    if (ssl_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
+    if (proto_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
         return -1;
     }
 
@@ -393,6 +365,78 @@ static int download_file_ssl(SSL *ssl, const char *remote_filename, const char *
     return 0;
 }
 
+/*
+ * Download only if the server copy differs from the local file.
+ * Sends the local BLAKE3 hash with REQ_FLAG_IF_NONE_MATCH; the server
+ * answers RESP_NOT_MODIFIED without reading the file when they match.
+ */
+static int sync_file_ssl(SSL *ssl, const char *remote_filename, const char *local_filepath) {
+    char buffer[BUFFER_SIZE];
+    RequestHeader header;
+    ResponseHeader response;
+
+    memset(&header, 0, sizeof(header));
+    header.command = CMD_DOWNLOAD;
+    strncpy(header.filename, remote_filename, FILENAME_MAX_LEN - 1);
+
+    if (access(local_filepath, F_OK) == 0) {
+        if (compute_file_blake3(local_filepath, header.file_hash) != 0) {
+            fprintf(stderr, "error: could not compute hash for %s\n", local_filepath);
+            return -1;
+        }
+        header.flags |= REQ_FLAG_IF_NONE_MATCH;
+    }
+
+    if (proto_send_all(ssl, &header, sizeof(RequestHeader)) == -1 ||
+        proto_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
+        return -1;
+    }
+
+    if (response.status == RESP_NOT_MODIFIED) {
+        printf("'%s' is up to date (%lld bytes).\n", local_filepath, response.filesize);
+        return 0;
+    }
+
+    if (response.status != RESP_SUCCESS) {
+        fprintf(stderr, "Server rejected download request: Status %d\n", response.status);
+        return -1;
+    }
+
+    /* Write next to the target and rename, so a failed sync keeps the old copy */
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.part", local_filepath);
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        perror("fopen");
+        return -1;
+    }
+
+    long long total_received = 0;
+    while (total_received < response.filesize) {
+        size_t bytes_to_read = (response.filesize - total_received < BUFFER_SIZE) ?
+                               (size_t)(response.filesize - total_received) : BUFFER_SIZE;
+        int bytes_received = SSL_read(ssl, buffer, bytes_to_read);
+        if (bytes_received <= 0 ||
+            fwrite(buffer, 1, bytes_received, fp) != (size_t)bytes_received) {
+            fprintf(stderr, "Sync of '%s' interrupted.\n", remote_filename);
+            fclose(fp);
+            unlink(tmp_path);
+            return -1;
+        }
+        total_received += bytes_received;
+    }
+
+    if (fclose(fp) != 0 || rename(tmp_path, local_filepath) != 0) {
+        perror("sync");
+        unlink(tmp_path);
+        return -1;
+    }
+
+    printf("Updated '%s' (%lld bytes).\n", local_filepath, total_received);
+    return 0;
+}
+
 void display_progress(float progress) {
 //progress должна быть в диапазоне от 0.0 до 1.0
     if (progress < 0.0) progress = 0.0;
@@ -426,12 +470,12 @@ static int list_files_ssl(SSL *ssl) {
     header.filesize = 0;
 
     printf("Requesting file list from server...\n");
-    if (ssl_send_all(ssl, &header, sizeof(RequestHeader)) == -1) {
+    if (proto_send_all(ssl, &header, sizeof(RequestHeader)) == -1) {
         return -1;
     }
 
     /* Receive list metadata */
-    if (ssl_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
+    if (proto_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
         return -1;
     }
 
@@ -468,6 +512,138 @@ static int list_files_ssl(SSL *ssl) {
     return 0;
 }
 
+static int parse_hex_hash(const char *hex, uint8_t out[BLAKE3_HASH_LEN]) {
+    if (strlen(hex) != BLAKE3_HASH_LEN * 2) return -1;
+    for (int i = 0; i < BLAKE3_HASH_LEN; i++) {
+        unsigned int byte;
+        if (sscanf(hex + i * 2, "%2x", &byte) != 1) return -1;
+        out[i] = (uint8_t)byte;
+    }
+    return 0;
+}
+
+/*
+ * Batched existence/metadata check. Arguments that are 64 hex characters
+ * are looked up by BLAKE3 content hash, everything else by filename.
+ */
+static int stat_files_ssl(SSL *ssl, char **names, int count) {
+    RequestHeader header;
+    ResponseHeader response;
+
+    if (count <= 0 || count > STAT_MAX_BATCH) {
+        fprintf(stderr, "stat accepts 1..%d names\n", STAT_MAX_BATCH);
+        return -1;
+    }
+
+    StatQuery *queries = calloc(count, sizeof(StatQuery));
+    StatEntry *entries = calloc(count, sizeof(StatEntry));
+    if (!queries || !entries) {
+        free(queries);
+        free(entries);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (parse_hex_hash(names[i], queries[i].file_hash) == 0) {
+            queries[i].by_hash = 1;
+        } else {
+            strncpy(queries[i].filename, names[i], FILENAME_MAX_LEN - 1);
+        }
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.command = CMD_STAT;
+    header.filesize = count;
+
+    int rc = -1;
+    if (proto_send_all(ssl, &header, sizeof(RequestHeader)) == -1 ||
+        proto_send_all(ssl, queries, count * sizeof(StatQuery)) == -1 ||
+        proto_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
+        goto out;
+    }
+
+    if (response.status != RESP_SUCCESS || response.filesize != count) {
+        fprintf(stderr, "Server rejected stat request: Status %d\n", response.status);
+        goto out;
+    }
+
+    if (proto_recv_all(ssl, entries, count * sizeof(StatEntry)) == -1) {
+        goto out;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!entries[i].exists) {
+            printf("%-40s  missing\n", names[i]);
+            continue;
+        }
+        printf("%-40s  %12lld bytes  uploaded_at=%lld  perm=%s%s%s  blake3=",
+               names[i], entries[i].size, (long long)entries[i].uploaded_at,
+               (entries[i].permission & STAT_PERM_OWNER) ? "o" : "-",
+               (entries[i].permission & STAT_PERM_RECIPIENT) ? "r" : "-",
+               (entries[i].permission & STAT_PERM_PUBLIC) ? "p" : "-");
+        for (int j = 0; j < BLAKE3_HASH_LEN; j++) printf("%02x", entries[i].file_hash[j]);
+        printf("\n");
+    }
+    rc = 0;
+
+out:
+    free(queries);
+    free(entries);
+    return rc;
+}
+
+/*
+ * Subscribe to server-push notifications instead of polling LIST.
+ * Blocks until the connection is closed (Ctrl-C to stop).
+ */
+static int subscribe_ssl(SSL *ssl) {
+    RequestHeader header;
+    ResponseHeader response;
+    NotifyMessage note;
+
+    memset(&header, 0, sizeof(header));
+    header.command = CMD_SUBSCRIBE;
+
+    if (proto_send_all(ssl, &header, sizeof(RequestHeader)) == -1) {
+        return -1;
+    }
+
+    if (proto_recv_all(ssl, &response, sizeof(ResponseHeader)) == -1) {
+        return -1;
+    }
+
+    if (response.status != RESP_SUCCESS) {
+        fprintf(stderr, "Server rejected subscribe request: Status %d\n", response.status);
+        return -1;
+    }
+
+    printf("Subscribed. Waiting for new files...\n");
+
+    while (proto_recv_all(ssl, &note, sizeof(NotifyMessage)) == 0) {
+        switch (note.type) {
+            case NOTIFY_FILE_UPLOADED:
+                note.filename[FILENAME_MAX_LEN - 1] = '\0';
+                note.owner[FINGERPRINT_LEN - 1] = '\0';
+                printf("[new] %s (%lld bytes, %s) from %.16s...\n",
+                       note.filename, note.filesize,
+                       (note.flags & 0x01) ? "public" : "private", note.owner);
+                fflush(stdout);
+                break;
+            case NOTIFY_RESYNC:
+                printf("[resync] notifications were dropped, run 'list' to catch up\n");
+                fflush(stdout);
+                break;
+            case NOTIFY_END:
+                return 0;
+            case NOTIFY_KEEPALIVE:
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     struct sockaddr_in serv_addr;
     char *server_ip = "127.0.0.1";
@@ -478,7 +654,10 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Commands:\n");
         fprintf(stderr, "  %s upload <local_filepath> <remote_filename>\n", argv[0]);
         fprintf(stderr, "  %s download <remote_filename> <local_filepath>\n", argv[0]);
+        fprintf(stderr, "  %s sync <remote_filename> <local_filepath>\n", argv[0]);
         fprintf(stderr, "  %s list\n", argv[0]);
+        fprintf(stderr, "  %s subscribe\n", argv[0]);
+        fprintf(stderr, "  %s stat <remote_filename|blake3_hex>...\n", argv[0]);
         fprintf(stderr, "Optional: --ip <ip> --port <port>\n");
         return EXIT_FAILURE;
     }
@@ -554,8 +733,21 @@ int main(int argc, char *argv[]) {
         } else {
             result = download_file_ssl(ssl, argv[2], argv[3]) ? EXIT_FAILURE : EXIT_SUCCESS;
         }
+    } else if (strcmp(cmd_str, "sync") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "Usage: %s sync <remote_filename> <local_filepath>\n", argv[0]);
+        } else {
+            result = sync_file_ssl(ssl, argv[2], argv[3]) ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
     } else if (strcmp(cmd_str, "list") == 0) {
         result = list_files_ssl(ssl) ? EXIT_FAILURE : EXIT_SUCCESS;
+    } else if (strcmp(cmd_str, "stat") == 0) {
+        /* Names stop at the first option flag */
+        int count = 0;
+        while (2 + count < argc && strncmp(argv[2 + count], "--", 2) != 0) count++;
+        result = stat_files_ssl(ssl, &argv[2], count) ? EXIT_FAILURE : EXIT_SUCCESS;
+    } else if (strcmp(cmd_str, "subscribe") == 0) {
+        result = subscribe_ssl(ssl) ? EXIT_FAILURE : EXIT_SUCCESS;
     } else {
         fprintf(stderr, "Unknown command: %s\n", cmd_str);
     }
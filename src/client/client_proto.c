@@ -0,0 +1,120 @@
+#include <string.h>
+
+#include "client_proto.h"
+
+int proto_send_all(SSL *ssl, const void *buf, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        int n = SSL_write(ssl, (const char *)buf + sent, len - sent);
+        if (n <= 0) {
+            return -1;
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+int proto_recv_all(SSL *ssl, void *buf, size_t len) {
+    size_t received = 0;
+    while (received < len) {
+        int n = SSL_read(ssl, (char *)buf + received, len - received);
+        if (n <= 0) {
+            return -1;
+        }
+        received += n;
+    }
+    return 0;
+}
+
+/* Reads the body of a response in BUFFER_SIZE pieces */
+static int recv_body(SSL *ssl, long long len, proto_sink_fn sink, void *ctx) {
+    uint8_t buffer[BUFFER_SIZE];
+    long long received = 0;
+    while (received < len) {
+        size_t want = (len - received < BUFFER_SIZE) ? (size_t)(len - received) : BUFFER_SIZE;
+        int n = SSL_read(ssl, buffer, want);
+        if (n <= 0) {
+            return -1;
+        }
+        if (sink && sink(ctx, buffer, (size_t)n) != 0) {
+            return -1;
+        }
+        received += n;
+    }
+    return 0;
+}
+
+int proto_upload(SSL *ssl, const char *remote_filename, const uint8_t *data, size_t len,
+                 const uint8_t hash[BLAKE3_HASH_LEN], const char *recipient, int *status) {
+    RequestHeader header;
+    ResponseHeader response;
+
+    memset(&header, 0, sizeof(header));
+    header.command = CMD_UPLOAD;
+    strncpy(header.filename, remote_filename, FILENAME_MAX_LEN - 1);
+    header.filesize = (long long)len;
+    memcpy(header.file_hash, hash, BLAKE3_HASH_LEN);
+    if (recipient) {
+        strncpy(header.recipient, recipient, FINGERPRINT_LEN - 1);
+    }
+
+    /* The server confirms before the body and reports the result after it */
+    if (proto_send_all(ssl, &header, sizeof(header)) == -1 ||
+        proto_recv_all(ssl, &response, sizeof(response)) == -1) {
+        return -1;
+    }
+    *status = response.status;
+    if (response.status != RESP_SUCCESS) {
+        return 1;
+    }
+
+    if (proto_send_all(ssl, data, len) == -1 ||
+        proto_recv_all(ssl, &response, sizeof(response)) == -1) {
+        return -1;
+    }
+    *status = response.status;
+    return response.status == RESP_SUCCESS ? 0 : 1;
+}
+
+int proto_download(SSL *ssl, const char *remote_filename, proto_sink_fn sink, void *ctx,
+                   long long *size, int *status) {
+    RequestHeader header;
+    ResponseHeader response;
+
+    memset(&header, 0, sizeof(header));
+    header.command = CMD_DOWNLOAD;
+    strncpy(header.filename, remote_filename, FILENAME_MAX_LEN - 1);
+
+    if (proto_send_all(ssl, &header, sizeof(header)) == -1 ||
+        proto_recv_all(ssl, &response, sizeof(response)) == -1) {
+        return -1;
+    }
+    *status = response.status;
+    *size = response.filesize;
+    if (response.status == RESP_NOT_MODIFIED) {
+        return 0;
+    }
+    if (response.status != RESP_SUCCESS) {
+        return 1;
+    }
+    return recv_body(ssl, response.filesize, sink, ctx);
+}
+
+int proto_list(SSL *ssl, long long *bytes, int *status) {
+    RequestHeader header;
+    ResponseHeader response;
+
+    memset(&header, 0, sizeof(header));
+    header.command = CMD_LIST;
+
+    if (proto_send_all(ssl, &header, sizeof(header)) == -1 ||
+        proto_recv_all(ssl, &response, sizeof(response)) == -1) {
+        return -1;
+    }
+    *status = response.status;
+    *bytes = response.filesize;
+    if (response.status != RESP_SUCCESS) {
+        return 1;
+    }
+    return response.filesize > 0 ? recv_body(ssl, response.filesize, NULL, NULL) : 0;
+}
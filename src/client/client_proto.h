@@ -0,0 +1,39 @@
+#ifndef CLIENT_PROTO_H
+#define CLIENT_PROTO_H
+
+#include <openssl/ssl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../include/protocol.h"
+
+/*
+ * Wire-level requests shared by the interactive client and the load
+ * generator. Nothing here prints or touches local files: payloads come
+ * from memory and downloads go to a caller-supplied sink.
+ *
+ * Return values: 0 - the server answered RESP_SUCCESS (or RESP_NOT_MODIFIED
+ * for a conditional download), 1 - the server answered with another status
+ * (stored in *status), -1 - the connection failed and must be dropped.
+ */
+
+/* Reliable SSL write/read: all bytes or -1 */
+int proto_send_all(SSL *ssl, const void *buf, size_t len);
+int proto_recv_all(SSL *ssl, void *buf, size_t len);
+
+/* Upload len bytes whose BLAKE3 hash is already known; recipient may be NULL */
+int proto_upload(SSL *ssl, const char *remote_filename, const uint8_t *data, size_t len,
+                 const uint8_t hash[BLAKE3_HASH_LEN], const char *recipient, int *status);
+
+/*
+ * Download remote_filename, passing the body to sink in BUFFER_SIZE pieces
+ * (sink may be NULL to discard it). *size receives the reported size.
+ */
+typedef int (*proto_sink_fn)(void *ctx, const uint8_t *data, size_t len);
+int proto_download(SSL *ssl, const char *remote_filename, proto_sink_fn sink, void *ctx,
+                   long long *size, int *status);
+
+/* LIST; the listing is read and discarded, *bytes receives its length */
+int proto_list(SSL *ssl, long long *bytes, int *status);
+
+#endif // CLIENT_PROTO_H
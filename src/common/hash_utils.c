@@ -1,26 +1,58 @@
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "blake3.h"
 
 #include "hash_utils.h"
 
-int compute_file_blake3(const char *filepath, uint8_t out_hash[HASH_SIZE]) {
+// Крупный блок: BLAKE3 распараллеливает SIMD по чанкам внутри одного update
+#define HASH_READ_BUF (1024 * 1024)
 
+void compute_buffer_blake3(const uint8_t *data, size_t len, uint8_t out_hash[HASH_SIZE]) {
     blake3_hasher hasher;
-
     blake3_hasher_init(&hasher);
     blake3_hasher_update(&hasher, data, len);
-
     blake3_hasher_finalize(&hasher, out_hash, HASH_SIZE);
-
 }
 
-// todo: compute_file_blake3(...)
+int compute_fd_blake3(int fd, uint8_t out_hash[HASH_SIZE], uint64_t *bytes) {
+    uint8_t *buf = malloc(HASH_READ_BUF);
+    if (!buf) return -1;
 
-int compute_file_blake3(const char *filepath, uint8_t out_hash[HASH_SIZE]) {
-    FILE *fp = fopen(filepath, "rb");
+    blake3_hasher hasher;
+    blake3_hasher_init(&hasher);
 
-    if (!fp) return -1;
+    uint64_t total = 0;
+    int rc = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf, HASH_READ_BUF);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            rc = -1;
+            break;
+        }
+        blake3_hasher_update(&hasher, buf, (size_t)n);
+        total += (uint64_t)n;
+    }
+
+    if (rc == 0) {
+        blake3_hasher_finalize(&hasher, out_hash, HASH_SIZE);
+        if (bytes) *bytes = total;
+    }
+
+    free(buf);
+    return rc;
+}
 
-}
\ No newline at end of file
+int compute_file_blake3(const char *filepath, uint8_t out_hash[HASH_SIZE]) {
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+
+    int rc = compute_fd_blake3(fd, out_hash, NULL);
+    close(fd);
+    return rc;
+}
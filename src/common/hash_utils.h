@@ -1,7 +1,7 @@
 #ifndef HASH_UTILS_H
 #define HASH_UTILS_H
 
-#include <cstddef>
+#include <stddef.h>
 #include <stdint.h>
 
 #define HASH_SIZE 32
@@ -9,7 +9,11 @@
 // Вычисляет BLAKE3-хеш файла по пути
 int compute_file_blake3(const char *filepath, uint8_t out_hash[HASH_SIZE]);
 
+// Вычисляет BLAKE3-хеш содержимого открытого файла от текущей позиции до конца.
+// bytes (может быть NULL) — сколько байт прочитано.
+int compute_fd_blake3(int fd, uint8_t out_hash[HASH_SIZE], uint64_t *bytes);
+
 // Вычисляет BLAKE3-хеш буфера в памяти
 void compute_buffer_blake3(const uint8_t *data, size_t len, uint8_t out_hash[HASH_SIZE]);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,599 @@
+// core/checkpoint.c
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "tree_walk.h"
+
+#define CHECKPOINT_MAGIC   0x31504358u // "XCP1"
+#define CHECKPOINT_VERSION 1
+
+#define MIN_SLOTS 1024
+#define MIN_HEAP  (64 * 1024)
+
+enum {
+    SLOT_EMPTY = 0,
+    SLOT_FILE,
+    SLOT_DIR,
+    SLOT_DELETED
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slot_count;   // степень двойки
+    uint64_t heap_size;
+    uint64_t heap_used;    // подсказка: при загрузке пересчитывается по слотам
+    uint64_t seq;
+    uint64_t reserved[3];
+} cp_header_t;
+
+typedef struct {
+    uint64_t path_hash;
+    uint64_t ino;          // 0 — неизвестен (записи, заполненные сверкой)
+    int64_t size;
+    int64_t mtime_ns;
+    uint64_t seq;
+    uint64_t path_off;     // смещение строки в куче
+    uint32_t path_len;
+    uint32_t state;
+} cp_slot_t;
+
+struct checkpoint {
+    pthread_mutex_t lock;
+
+    char *path;
+    int fd;
+    void *map;
+    size_t map_size;
+
+    cp_header_t *hdr;
+    cp_slot_t *slots;
+    char *heap;
+
+    size_t files;
+    size_t dirs;
+    size_t tombstones;
+    size_t heap_live;      // байт живых строк, для размера при перестройке
+
+    size_t sync_batch;
+    size_t dirty;
+    uint64_t syncs;
+    uint64_t invalid;
+
+    // mtime каталогов, перечитанных сверкой, до checkpoint_commit_dirs()
+    file_state_set_t pending_dirs;
+};
+
+static uint64_t hash_path(const char *path, size_t len) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)path[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static int64_t mtime_ns_of(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000ll + st->st_mtim.tv_nsec;
+}
+
+static size_t layout_size(uint64_t slot_count, uint64_t heap_size) {
+    return sizeof(cp_header_t) + slot_count * sizeof(cp_slot_t) + heap_size;
+}
+
+static void attach(checkpoint_t *cp, void *map, size_t size, int fd) {
+    cp->map = map;
+    cp->map_size = size;
+    cp->fd = fd;
+    cp->hdr = map;
+    cp->slots = (cp_slot_t *)((char *)map + sizeof(cp_header_t));
+    cp->heap = (char *)(cp->slots + cp->hdr->slot_count);
+}
+
+// Создаёт пустой файл нужного размера и отображает его (нули — пустые слоты)
+static void *create_mapped(const char *path, uint64_t slot_count, uint64_t heap_size,
+                           int *out_fd, size_t *out_size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) return NULL;
+
+    size_t size = layout_size(slot_count, heap_size);
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    cp_header_t *hdr = map;
+    hdr->magic = CHECKPOINT_MAGIC;
+    hdr->version = CHECKPOINT_VERSION;
+    hdr->slot_count = slot_count;
+    hdr->heap_size = heap_size;
+    hdr->heap_used = 0;
+
+    *out_fd = fd;
+    *out_size = size;
+    return map;
+}
+
+static const char *slot_path(const checkpoint_t *cp, const cp_slot_t *s) {
+    return cp->heap + s->path_off;
+}
+
+static bool slot_live(const cp_slot_t *s) {
+    return s->state == SLOT_FILE || s->state == SLOT_DIR;
+}
+
+// Индекс живого слота для пути или -1
+static ssize_t find(const checkpoint_t *cp, const char *path, size_t len, uint64_t h) {
+    size_t mask = cp->hdr->slot_count - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        const cp_slot_t *s = &cp->slots[i];
+        if (s->state == SLOT_EMPTY) return -1;
+        if (slot_live(s) && s->path_hash == h && s->path_len == len &&
+            memcmp(slot_path(cp, s), path, len) == 0) {
+            return (ssize_t)i;
+        }
+    }
+}
+
+// Вставка без проверок места: путь дописывается в кучу, слот — первый свободный
+static cp_slot_t *insert(checkpoint_t *cp, const char *path, size_t len, uint64_t h) {
+    size_t mask = cp->hdr->slot_count - 1;
+    size_t i = h & mask;
+    while (slot_live(&cp->slots[i])) i = (i + 1) & mask;
+
+    cp_slot_t *s = &cp->slots[i];
+    if (s->state == SLOT_DELETED) cp->tombstones--;
+
+    memcpy(cp->heap + cp->hdr->heap_used, path, len);
+    cp->heap[cp->hdr->heap_used + len] = '\0';
+    s->path_off = cp->hdr->heap_used;
+    s->path_len = (uint32_t)len;
+    s->path_hash = h;
+    cp->hdr->heap_used += len + 1;
+    cp->heap_live += len + 1;
+    return s;
+}
+
+/**
+ * Перестраивает файл под extra_bytes новых путей: новый файл рядом,
+ * живые записи переносятся, затем rename поверх старого. Уплотняет кучу
+ * и убирает надгробия.
+ */
+static bool rebuild(checkpoint_t *cp, size_t extra_bytes) {
+    size_t live = cp->files + cp->dirs;
+    uint64_t slot_count = MIN_SLOTS;
+    while ((live + 1) * 2 > slot_count) slot_count *= 2;
+    uint64_t heap_size = MIN_HEAP;
+    while (heap_size < (cp->heap_live + extra_bytes) * 2) heap_size *= 2;
+
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", cp->path) >= (int)sizeof(tmp)) return false;
+
+    int fd;
+    size_t size;
+    void *map = create_mapped(tmp, slot_count, heap_size, &fd, &size);
+    if (!map) return false;
+
+    checkpoint_t next = { .files = cp->files, .dirs = cp->dirs };
+    attach(&next, map, size, fd);
+    next.hdr->seq = cp->hdr->seq;
+
+    for (size_t i = 0; i < cp->hdr->slot_count; i++) {
+        const cp_slot_t *old = &cp->slots[i];
+        if (!slot_live(old)) continue;
+        cp_slot_t *s = insert(&next, slot_path(cp, old), old->path_len, old->path_hash);
+        s->ino = old->ino;
+        s->size = old->size;
+        s->mtime_ns = old->mtime_ns;
+        s->seq = old->seq;
+        s->state = old->state;
+    }
+
+    if (msync(map, size, MS_SYNC) != 0 || rename(tmp, cp->path) != 0) {
+        munmap(map, size);
+        close(fd);
+        unlink(tmp);
+        return false;
+    }
+
+    munmap(cp->map, cp->map_size);
+    close(cp->fd);
+    attach(cp, map, size, fd);
+    cp->tombstones = 0;
+    cp->heap_live = next.heap_live;
+    cp->dirty = 0;
+    return true;
+}
+
+static void maybe_sync_locked(checkpoint_t *cp) {
+    if (++cp->dirty < cp->sync_batch) return;
+    if (msync(cp->map, cp->map_size, MS_SYNC) == 0) cp->syncs++;
+    cp->dirty = 0;
+}
+
+static bool put_locked(checkpoint_t *cp, const char *path, uint32_t state, uint64_t ino,
+                       int64_t size, int64_t mtime_ns) {
+    size_t len = strlen(path);
+    uint64_t h = hash_path(path, len);
+
+    ssize_t idx = find(cp, path, len, h);
+    cp_slot_t *s;
+    if (idx >= 0) {
+        s = &cp->slots[idx];
+        if (s->state == SLOT_FILE) cp->files--;
+        else cp->dirs--;
+    } else {
+        // Заполнение до 3/4 с учётом надгробий и место в куче
+        size_t used = cp->files + cp->dirs + cp->tombstones + 1;
+        if (used * 4 > cp->hdr->slot_count * 3 ||
+            cp->hdr->heap_used + len + 1 > cp->hdr->heap_size) {
+            if (!rebuild(cp, len + 1)) return false;
+        }
+        s = insert(cp, path, len, h);
+    }
+
+    s->ino = ino;
+    s->size = size;
+    s->mtime_ns = mtime_ns;
+    s->seq = ++cp->hdr->seq;
+    s->state = state;
+    if (state == SLOT_FILE) cp->files++;
+    else cp->dirs++;
+
+    maybe_sync_locked(cp);
+    return true;
+}
+
+static void remove_slot_locked(checkpoint_t *cp, cp_slot_t *s) {
+    if (s->state == SLOT_FILE) cp->files--;
+    else cp->dirs--;
+    cp->heap_live -= s->path_len + 1;
+    s->state = SLOT_DELETED;
+    cp->tombstones++;
+}
+
+// Проверяет загруженный файл и пересчитывает счётчики. Заголовок мог
+// остаться несброшенным, поэтому конец кучи берётся по самим слотам.
+static void load(checkpoint_t *cp) {
+    uint64_t heap_end = 0;
+    for (size_t i = 0; i < cp->hdr->slot_count; i++) {
+        cp_slot_t *s = &cp->slots[i];
+        if (s->state == SLOT_EMPTY) continue;
+        if (s->state == SLOT_DELETED) {
+            cp->tombstones++;
+            continue;
+        }
+
+        bool ok = slot_live(s) &&
+                  s->path_off < cp->hdr->heap_size &&
+                  s->path_len < cp->hdr->heap_size - s->path_off &&
+                  cp->heap[s->path_off + s->path_len] == '\0' &&
+                  strlen(slot_path(cp, s)) == s->path_len &&
+                  hash_path(slot_path(cp, s), s->path_len) == s->path_hash;
+        if (!ok) {
+            // Запись оборвана на полпути: слот уже не найти по пути
+            s->state = SLOT_DELETED;
+            cp->tombstones++;
+            cp->invalid++;
+            continue;
+        }
+
+        if (s->state == SLOT_FILE) cp->files++;
+        else cp->dirs++;
+        cp->heap_live += s->path_len + 1;
+        if (s->path_off + s->path_len + 1 > heap_end) heap_end = s->path_off + s->path_len + 1;
+    }
+    if (cp->hdr->heap_used < heap_end) cp->hdr->heap_used = heap_end;
+}
+
+static bool open_existing(checkpoint_t *cp) {
+    int fd = open(cp->path, O_RDWR | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    struct stat st;
+    cp_header_t hdr;
+    if (fstat(fd, &st) != 0 || pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        hdr.magic != CHECKPOINT_MAGIC || hdr.version != CHECKPOINT_VERSION ||
+        hdr.slot_count < MIN_SLOTS || (hdr.slot_count & (hdr.slot_count - 1)) != 0 ||
+        hdr.heap_used > hdr.heap_size ||
+        (uint64_t)st.st_size != layout_size(hdr.slot_count, hdr.heap_size)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    attach(cp, map, (size_t)st.st_size, fd);
+    load(cp);
+    return true;
+}
+
+checkpoint_t *checkpoint_open(const char *path, size_t sync_batch, int *err) {
+    checkpoint_t *cp = calloc(1, sizeof(checkpoint_t));
+    if (!cp || !(cp->path = strdup(path))) {
+        free(cp);
+        if (err) *err = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&cp->lock, NULL);
+    cp->fd = -1;
+    cp->sync_batch = sync_batch ? sync_batch : 1;
+
+    if (!open_existing(cp)) {
+        int fd;
+        size_t size;
+        void *map = create_mapped(path, MIN_SLOTS, MIN_HEAP, &fd, &size);
+        if (!map) {
+            if (err) *err = errno;
+            pthread_mutex_destroy(&cp->lock);
+            free(cp->path);
+            free(cp);
+            return NULL;
+        }
+        attach(cp, map, size, fd);
+    }
+    return cp;
+}
+
+void checkpoint_close(checkpoint_t *cp) {
+    if (!cp) return;
+    checkpoint_sync(cp);
+    munmap(cp->map, cp->map_size);
+    close(cp->fd);
+    file_state_set_free(&cp->pending_dirs);
+    pthread_mutex_destroy(&cp->lock);
+    free(cp->path);
+    free(cp);
+}
+
+bool checkpoint_usable(checkpoint_t *cp) {
+    pthread_mutex_lock(&cp->lock);
+    bool usable = cp->invalid == 0 && cp->dirs > 0;
+    pthread_mutex_unlock(&cp->lock);
+    return usable;
+}
+
+void checkpoint_reset(checkpoint_t *cp) {
+    pthread_mutex_lock(&cp->lock);
+    memset(cp->slots, 0, cp->hdr->slot_count * sizeof(cp_slot_t));
+    cp->hdr->heap_used = 0;
+    cp->files = cp->dirs = cp->tombstones = cp->heap_live = 0;
+    cp->invalid = 0;
+    file_state_set_free(&cp->pending_dirs);
+    maybe_sync_locked(cp);
+    pthread_mutex_unlock(&cp->lock);
+}
+
+bool checkpoint_put_file(checkpoint_t *cp, const char *path, uint64_t ino,
+                         int64_t size, int64_t mtime_ns) {
+    pthread_mutex_lock(&cp->lock);
+    bool ok = put_locked(cp, path, SLOT_FILE, ino, size, mtime_ns);
+    pthread_mutex_unlock(&cp->lock);
+    return ok;
+}
+
+bool checkpoint_put_dir(checkpoint_t *cp, const char *path, int64_t mtime_ns) {
+    pthread_mutex_lock(&cp->lock);
+    bool ok = put_locked(cp, path, SLOT_DIR, 0, 0, mtime_ns);
+    pthread_mutex_unlock(&cp->lock);
+    return ok;
+}
+
+void checkpoint_remove(checkpoint_t *cp, const char *path) {
+    size_t len = strlen(path);
+    uint64_t h = hash_path(path, len);
+
+    pthread_mutex_lock(&cp->lock);
+    ssize_t idx = find(cp, path, len, h);
+    if (idx >= 0) {
+        remove_slot_locked(cp, &cp->slots[idx]);
+        cp->hdr->seq++;
+        maybe_sync_locked(cp);
+    }
+    pthread_mutex_unlock(&cp->lock);
+}
+
+size_t checkpoint_collect_prefix(checkpoint_t *cp, const char *dir, file_state_set_t *out) {
+    size_t len = strlen(dir);
+    size_t n = 0;
+
+    pthread_mutex_lock(&cp->lock);
+    for (size_t i = 0; i < cp->hdr->slot_count; i++) {
+        const cp_slot_t *s = &cp->slots[i];
+        if (s->state != SLOT_FILE || s->path_len <= len) continue;
+
+        const char *path = slot_path(cp, s);
+        if (path[len] != '/' || memcmp(path, dir, len) != 0) continue;
+        if (file_state_set_add(out, path, s->size, s->mtime_ns)) n++;
+    }
+    pthread_mutex_unlock(&cp->lock);
+    return n;
+}
+
+// --- каталоги дерева ---
+
+typedef struct {
+    file_state_set_t *per_worker;
+} dirs_ctx_t;
+
+static bool dirs_on_dir(void *ctx, unsigned worker, const char *path, int dirfd) {
+    dirs_ctx_t *dc = ctx;
+    struct stat st;
+    if (fstat(dirfd, &st) == 0) file_state_set_add(&dc->per_worker[worker], path, 0, mtime_ns_of(&st));
+    return true;
+}
+
+int checkpoint_add_dirs(checkpoint_t *cp, const char *root, unsigned nthreads) {
+    if (nthreads == 0) nthreads = 1;
+    file_state_set_t *sets = calloc(nthreads, sizeof(file_state_set_t));
+    if (!sets) return -1;
+
+    dirs_ctx_t ctx = { .per_worker = sets };
+    tree_walk_ops_t ops = { .on_dir = dirs_on_dir };
+    int rc = tree_walk_parallel(root, nthreads, &ops, &ctx, NULL);
+
+    pthread_mutex_lock(&cp->lock);
+    for (unsigned w = 0; w < nthreads; w++) {
+        for (size_t i = 0; i < sets[w].len; i++) {
+            if (!put_locked(cp, sets[w].items[i].path, SLOT_DIR, 0, 0, sets[w].items[i].mtime_ns)) {
+                rc = -1;
+            }
+        }
+        file_state_set_free(&sets[w]);
+    }
+    pthread_mutex_unlock(&cp->lock);
+
+    free(sets);
+    return rc;
+}
+
+// --- сверка при старте ---
+
+// Перечитывает каталог: новые файлы — в created, новые подкаталоги — в очередь
+static void rescan_dir(checkpoint_t *cp, const char *dir, file_state_set_t *queue,
+                       file_state_set_t *created) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+
+    struct stat st;
+    if (fstat(dirfd(d), &st) == 0) {
+        file_state_set_add(&cp->pending_dirs, dir, 0, mtime_ns_of(&st));
+    }
+
+    char path[PATH_MAX];
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+        if (de->d_type != DT_REG && de->d_type != DT_DIR && de->d_type != DT_UNKNOWN) continue;
+
+        int len = snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        if (len < 0 || (size_t)len >= sizeof(path)) continue;
+
+        // Уже известные пути проверяются по своим записям
+        if (find(cp, path, (size_t)len, hash_path(path, (size_t)len)) >= 0) continue;
+
+        if (fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            file_state_set_add(queue, path, 0, 0);
+        } else if (S_ISREG(st.st_mode)) {
+            file_state_set_add(created, path, (int64_t)st.st_size, mtime_ns_of(&st));
+        }
+    }
+    closedir(d);
+}
+
+checkpoint_verify_stats_t checkpoint_verify(checkpoint_t *cp, reconcile_fn fn, void *ctx) {
+    checkpoint_verify_stats_t vs = {0};
+    file_state_set_t modified = {0}, deleted = {0}, created = {0}, queue = {0};
+
+    pthread_mutex_lock(&cp->lock);
+    file_state_set_free(&cp->pending_dirs);
+
+    for (size_t i = 0; i < cp->hdr->slot_count; i++) {
+        cp_slot_t *s = &cp->slots[i];
+        if (!slot_live(s)) continue;
+        vs.entries_checked++;
+
+        const char *path = slot_path(cp, s);
+        struct stat st;
+        bool present = fstatat(AT_FDCWD, path, &st, AT_SYMLINK_NOFOLLOW) == 0;
+
+        if (s->state == SLOT_DIR) {
+            if (!present || !S_ISDIR(st.st_mode)) {
+                // Файлы каталога проверяются своими записями
+                remove_slot_locked(cp, s);
+            } else if (mtime_ns_of(&st) != s->mtime_ns) {
+                file_state_set_add(&queue, path, 0, 0);
+            }
+            continue;
+        }
+
+        if (!present || !S_ISREG(st.st_mode)) {
+            file_state_set_add(&deleted, path, s->size, s->mtime_ns);
+        } else if ((int64_t)st.st_size != s->size || mtime_ns_of(&st) != s->mtime_ns ||
+                   (s->ino != 0 && (uint64_t)st.st_ino != s->ino)) {
+            file_state_set_add(&modified, path, (int64_t)st.st_size, mtime_ns_of(&st));
+        } else {
+            vs.changes.unchanged++;
+        }
+    }
+
+    // Очередь растёт по мере нахождения новых подкаталогов
+    for (size_t i = 0; i < queue.len; i++) {
+        rescan_dir(cp, queue.items[i].path, &queue, &created);
+        vs.dirs_rescanned++;
+    }
+    pthread_mutex_unlock(&cp->lock);
+
+    for (size_t i = 0; i < deleted.len; i++) fn(ctx, RECONCILE_DELETED, &deleted.items[i]);
+    for (size_t i = 0; i < modified.len; i++) fn(ctx, RECONCILE_MODIFIED, &modified.items[i]);
+    for (size_t i = 0; i < created.len; i++) fn(ctx, RECONCILE_CREATED, &created.items[i]);
+    vs.changes.deleted = deleted.len;
+    vs.changes.modified = modified.len;
+    vs.changes.created = created.len;
+
+    file_state_set_free(&deleted);
+    file_state_set_free(&modified);
+    file_state_set_free(&created);
+    file_state_set_free(&queue);
+    return vs;
+}
+
+void checkpoint_commit_dirs(checkpoint_t *cp) {
+    pthread_mutex_lock(&cp->lock);
+    for (size_t i = 0; i < cp->pending_dirs.len; i++) {
+        const file_state_t *d = &cp->pending_dirs.items[i];
+        put_locked(cp, d->path, SLOT_DIR, 0, 0, d->mtime_ns);
+    }
+    file_state_set_free(&cp->pending_dirs);
+    pthread_mutex_unlock(&cp->lock);
+}
+
+bool checkpoint_sync(checkpoint_t *cp) {
+    pthread_mutex_lock(&cp->lock);
+    bool ok = true;
+    if (cp->dirty > 0) {
+        ok = msync(cp->map, cp->map_size, MS_SYNC) == 0;
+        if (ok) {
+            cp->syncs++;
+            cp->dirty = 0;
+        }
+    }
+    pthread_mutex_unlock(&cp->lock);
+    return ok;
+}
+
+checkpoint_stats_t checkpoint_get_stats(checkpoint_t *cp) {
+    pthread_mutex_lock(&cp->lock);
+    checkpoint_stats_t st = {
+        .files = cp->files,
+        .dirs = cp->dirs,
+        .seq = cp->hdr->seq,
+        .invalid = cp->invalid,
+        .syncs = cp->syncs,
+        .file_bytes = cp->map_size,
+    };
+    pthread_mutex_unlock(&cp->lock);
+    return st;
+}
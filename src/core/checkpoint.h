@@ -0,0 +1,88 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "reconcile.h"
+
+// Контрольная точка демона: что уже записано в MongoDB, по путям.
+// Файл отображается в память: заголовок, таблица слотов (хеш пути ->
+// inode, размер, mtime, номер события) с открытой адресацией и куча строк
+// путей. Обновляется на месте после каждой успешной записи, на диск
+// сбрасывается пачками (msync).
+//
+// При перезапуске вместо загрузки состояния из MongoDB и полного обхода
+// дерева достаточно stat по каждой записи: время старта зависит только от
+// размера дерева, не от истории в базе. Каталоги хранятся со своим mtime,
+// чтобы найти новые файлы без обхода неизменённых каталогов.
+// Потокобезопасна.
+
+typedef struct checkpoint checkpoint_t;
+
+typedef struct {
+    uint64_t files;
+    uint64_t dirs;
+    uint64_t seq;            // номер последнего записанного события
+    uint64_t invalid;        // повреждённых слотов при загрузке
+    uint64_t syncs;
+    uint64_t file_bytes;
+} checkpoint_stats_t;
+
+typedef struct {
+    reconcile_stats_t changes;
+    uint64_t entries_checked;
+    uint64_t dirs_rescanned;
+} checkpoint_verify_stats_t;
+
+/**
+ * @brief Открывает или создаёт контрольную точку.
+ *
+ * @param sync_batch после стольких изменений сброс на диск делает тот
+ *                   поток, который их внёс; остальное — checkpoint_sync()
+ * @param err        код errno при неудаче
+ * @return контрольная точка или NULL
+ */
+checkpoint_t *checkpoint_open(const char *path, size_t sync_batch, int *err);
+void checkpoint_close(checkpoint_t *cp);
+
+// true — загружено непустое состояние без повреждений, ему можно доверять
+bool checkpoint_usable(checkpoint_t *cp);
+
+// Очищает все записи (перед заполнением заново после полной сверки)
+void checkpoint_reset(checkpoint_t *cp);
+
+bool checkpoint_put_file(checkpoint_t *cp, const char *path, uint64_t ino,
+                         int64_t size, int64_t mtime_ns);
+bool checkpoint_put_dir(checkpoint_t *cp, const char *path, int64_t mtime_ns);
+void checkpoint_remove(checkpoint_t *cp, const char *path);
+
+// Файлы под каталогом dir (для каталога, ушедшего из дерева): копии
+// записей добавляются в out. Полный проход по таблице.
+size_t checkpoint_collect_prefix(checkpoint_t *cp, const char *dir, file_state_set_t *out);
+
+// Записывает mtime всех каталогов поддерева root
+int checkpoint_add_dirs(checkpoint_t *cp, const char *root, unsigned nthreads);
+
+/**
+ * @brief Сверяет записи с диском через stat.
+ *
+ * Изменённые и исчезнувшие файлы отдаются как MODIFIED/DELETED. Каталоги
+ * с другим mtime перечитываются: файлы, которых нет в контрольной точке, —
+ * CREATED, новые подкаталоги перечитываются целиком. Колбэк вызывается без
+ * удержания блокировки.
+ *
+ * Новые mtime каталогов запоминаются, но применяются только
+ * checkpoint_commit_dirs() — после того как найденные изменения записаны,
+ * иначе сбой между ними потеряет их навсегда.
+ */
+checkpoint_verify_stats_t checkpoint_verify(checkpoint_t *cp, reconcile_fn fn, void *ctx);
+void checkpoint_commit_dirs(checkpoint_t *cp);
+
+// Сбрасывает изменения на диск, если они есть
+bool checkpoint_sync(checkpoint_t *cp);
+
+checkpoint_stats_t checkpoint_get_stats(checkpoint_t *cp);
+
+#endif // CHECKPOINT_H
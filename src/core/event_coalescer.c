@@ -0,0 +1,479 @@
+// core/event_coalescer.c
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "event_coalescer.h"
+
+#define WHEEL_TICK_NS  4000000ull // 4 мс
+#define WHEEL_SLOTS    1024       // охват колеса ~4 с, дальние сроки ждут следующего оборота
+#define COOKIE_RING    128        // ожидающие пары IN_MOVED_FROM
+
+typedef struct pending {
+    char *path;
+    char *old_path;
+    fs_event_kind_t kind;
+    uint64_t first_ns;
+    uint64_t deadline_tick;
+    uint32_t merged;
+
+    struct pending *hnext;          // цепочка хеш-таблицы
+    struct pending *wprev, *wnext;  // список слота колеса
+} pending_t;
+
+typedef struct {
+    uint32_t cookie;
+    char *path;     // NULL — слот свободен
+    uint64_t first_ns;
+    uint64_t deadline_ns;
+} moved_from_t;
+
+struct coalescer {
+    uint64_t quiet_ns;
+    size_t max_pending;
+    coalescer_emit_fn emit;
+    void *ctx;
+
+    pending_t **buckets;
+    size_t n_buckets;   // степень двойки
+    size_t count;
+
+    pending_t *wheel[WHEEL_SLOTS];
+    uint64_t cur_tick;  // все слоты с меньшим тиком уже обработаны
+
+    moved_from_t moves[COOKIE_RING];
+    size_t moves_next;
+
+    coalescer_stats_t stats;
+};
+
+const char *fs_event_kind_name(fs_event_kind_t kind) {
+    switch (kind) {
+        case FS_EVENT_MODIFIED: return "modified";
+        case FS_EVENT_MOVED_TO: return "moved_to";
+        case FS_EVENT_DELETED:  return "deleted";
+        case FS_EVENT_RENAMED:  return "renamed";
+        case FS_EVENT_CREATED:  return "created";
+    }
+    return "unknown";
+}
+
+static uint64_t hash_path(const char *s) {
+    uint64_t h = 1469598103934665603ull;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+coalescer_t *coalescer_new(uint64_t quiet_ns, size_t max_pending,
+                           coalescer_emit_fn emit, void *ctx) {
+    coalescer_t *c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+
+    c->n_buckets = 1024;
+    c->buckets = calloc(c->n_buckets, sizeof(pending_t *));
+    if (!c->buckets) {
+        free(c);
+        return NULL;
+    }
+
+    c->quiet_ns = quiet_ns;
+    c->max_pending = max_pending ? max_pending : SIZE_MAX;
+    c->emit = emit;
+    c->ctx = ctx;
+    return c;
+}
+
+static void free_pending(pending_t *p) {
+    free(p->path);
+    free(p->old_path);
+    free(p);
+}
+
+void coalescer_free(coalescer_t *c) {
+    if (!c) return;
+    for (size_t b = 0; b < c->n_buckets; b++) {
+        pending_t *p = c->buckets[b];
+        while (p) {
+            pending_t *next = p->hnext;
+            free_pending(p);
+            p = next;
+        }
+    }
+    for (size_t i = 0; i < COOKIE_RING; i++) free(c->moves[i].path);
+    free(c->buckets);
+    free(c);
+}
+
+// --- хеш-таблица ---
+
+static pending_t **find_link(coalescer_t *c, const char *path, uint64_t h) {
+    pending_t **pp = &c->buckets[h & (c->n_buckets - 1)];
+    while (*pp && strcmp((*pp)->path, path) != 0) pp = &(*pp)->hnext;
+    return pp;
+}
+
+static void grow_buckets(coalescer_t *c) {
+    size_t n = c->n_buckets * 2;
+    pending_t **nb = calloc(n, sizeof(pending_t *));
+    if (!nb) return; // цепочки просто станут длиннее
+
+    for (size_t b = 0; b < c->n_buckets; b++) {
+        pending_t *p = c->buckets[b];
+        while (p) {
+            pending_t *next = p->hnext;
+            size_t i = hash_path(p->path) & (n - 1);
+            p->hnext = nb[i];
+            nb[i] = p;
+            p = next;
+        }
+    }
+    free(c->buckets);
+    c->buckets = nb;
+    c->n_buckets = n;
+}
+
+static void unlink_hash(coalescer_t *c, pending_t *p) {
+    pending_t **pp = find_link(c, p->path, hash_path(p->path));
+    if (*pp == p) {
+        *pp = p->hnext;
+        c->count--;
+    }
+}
+
+// --- колесо таймеров ---
+
+static void wheel_unlink(coalescer_t *c, pending_t *p) {
+    if (p->wprev) p->wprev->wnext = p->wnext;
+    else c->wheel[p->deadline_tick % WHEEL_SLOTS] = p->wnext;
+    if (p->wnext) p->wnext->wprev = p->wprev;
+    p->wprev = p->wnext = NULL;
+}
+
+static void wheel_insert(coalescer_t *c, pending_t *p, uint64_t now_ns) {
+    uint64_t tick = (now_ns + c->quiet_ns + WHEEL_TICK_NS - 1) / WHEEL_TICK_NS;
+    if (tick < c->cur_tick) tick = c->cur_tick;
+
+    p->deadline_tick = tick;
+    pending_t **slot = &c->wheel[tick % WHEEL_SLOTS];
+    p->wprev = NULL;
+    p->wnext = *slot;
+    if (*slot) (*slot)->wprev = p;
+    *slot = p;
+}
+
+static void emit_now(coalescer_t *c, fs_event_kind_t kind, const char *path,
+                     const char *old_path, uint64_t first_ns, uint32_t merged) {
+    fs_event_t ev = {
+        .kind = kind,
+        .path = path,
+        .old_path = old_path,
+        .first_ns = first_ns,
+        .merged = merged,
+    };
+    c->stats.emitted++;
+    c->emit(c->ctx, &ev);
+}
+
+static void emit_pending(coalescer_t *c, pending_t *p) {
+    emit_now(c, p->kind, p->path, p->old_path, p->first_ns, p->merged);
+}
+
+// Применяет сырое событие к пути. old_path передаётся во владение.
+static void merge_event(coalescer_t *c, const char *path, fs_event_kind_t kind,
+                        char *old_path, uint64_t first_ns, uint64_t now_ns) {
+    uint64_t h = hash_path(path);
+    pending_t **link = find_link(c, path, h);
+    pending_t *p = *link;
+
+    if (!p) {
+        if (c->count >= c->max_pending) {
+            // Переполнение: не копим, отдаём как есть
+            emit_now(c, kind, path, old_path, first_ns, 1);
+            free(old_path);
+            return;
+        }
+
+        p = calloc(1, sizeof(*p));
+        char *copy = p ? strdup(path) : NULL;
+        if (!copy) {
+            free(p);
+            emit_now(c, kind, path, old_path, first_ns, 1);
+            free(old_path);
+            return;
+        }
+
+        p->path = copy;
+        p->kind = kind;
+        p->old_path = old_path;
+        p->first_ns = first_ns;
+        p->merged = 1;
+        p->hnext = *link;
+        *link = p;
+        c->count++;
+        if (c->count > c->n_buckets) grow_buckets(c);
+
+        wheel_insert(c, p, now_ns);
+        return;
+    }
+
+    p->merged++;
+    if (first_ns < p->first_ns) p->first_ns = first_ns;
+
+    switch (kind) {
+        case FS_EVENT_MODIFIED:
+        case FS_EVENT_CREATED:
+            // Запись поверх переименованного/перемещённого файла не меняет
+            // сути итогового события; запись после удаления — файл создан заново
+            if (p->kind == FS_EVENT_DELETED) p->kind = FS_EVENT_MODIFIED;
+            free(old_path);
+            break;
+
+        case FS_EVENT_MOVED_TO:
+        case FS_EVENT_RENAMED:
+            p->kind = kind;
+            free(p->old_path);
+            p->old_path = old_path;
+            break;
+
+        case FS_EVENT_DELETED:
+            if (p->kind == FS_EVENT_RENAMED && p->old_path) {
+                // Переименовали и удалили: исчез исходный путь
+                char *orig = p->old_path;
+                p->old_path = NULL;
+                p->kind = FS_EVENT_DELETED;
+                wheel_unlink(c, p);
+                wheel_insert(c, p, now_ns);
+                merge_event(c, orig, FS_EVENT_DELETED, NULL, first_ns, now_ns);
+                free(orig);
+                free(old_path);
+                return;
+            }
+            p->kind = FS_EVENT_DELETED;
+            free(p->old_path);
+            p->old_path = NULL;
+            free(old_path);
+            break;
+    }
+
+    // Путь снова изменился — окно тишины начинается заново
+    wheel_unlink(c, p);
+    wheel_insert(c, p, now_ns);
+}
+
+void coalescer_modified(coalescer_t *c, const char *path, uint64_t now_ns) {
+    c->stats.raw_events++;
+    merge_event(c, path, FS_EVENT_MODIFIED, NULL, now_ns, now_ns);
+}
+
+void coalescer_deleted(coalescer_t *c, const char *path, uint64_t now_ns) {
+    c->stats.raw_events++;
+    merge_event(c, path, FS_EVENT_DELETED, NULL, now_ns, now_ns);
+}
+
+void coalescer_created(coalescer_t *c, const char *path, uint64_t now_ns) {
+    c->stats.raw_events++;
+    merge_event(c, path, FS_EVENT_CREATED, NULL, now_ns, now_ns);
+}
+
+// Переименование from -> path (from передаётся во владение)
+static void rename_path(coalescer_t *c, char *from, const char *path,
+                        uint64_t first_ns, uint64_t now_ns) {
+    c->stats.renames_paired++;
+
+    // Накопленные изменения исходного пути переезжают вместе с файлом
+    pending_t **link = find_link(c, from, hash_path(from));
+    pending_t *prev = *link;
+    if (prev) {
+        *link = prev->hnext;
+        c->count--;
+        wheel_unlink(c, prev);
+        if (prev->first_ns < first_ns) first_ns = prev->first_ns;
+        if (prev->kind == FS_EVENT_RENAMED && prev->old_path) {
+            // Цепочка a -> b -> c сводится к a -> c
+            free(from);
+            from = prev->old_path;
+            prev->old_path = NULL;
+        }
+        free_pending(prev);
+    }
+
+    if (strcmp(from, path) == 0) {
+        // Переименование в себя — по сути модификация
+        merge_event(c, path, FS_EVENT_MODIFIED, NULL, first_ns, now_ns);
+        free(from);
+        return;
+    }
+
+    merge_event(c, path, FS_EVENT_RENAMED, from, first_ns, now_ns);
+}
+
+void coalescer_moved_from(coalescer_t *c, const char *path, uint32_t cookie, uint64_t now_ns) {
+    c->stats.raw_events++;
+
+    moved_from_t *m = &c->moves[c->moves_next];
+    c->moves_next = (c->moves_next + 1) % COOKIE_RING;
+
+    if (m->path) {
+        // Кольцо заполнено: самая старая пара так и не пришла — файл ушёл из дерева
+        char *old = m->path;
+        m->path = NULL;
+        merge_event(c, old, FS_EVENT_DELETED, NULL, m->first_ns, now_ns);
+        free(old);
+    }
+
+    m->path = strdup(path);
+    if (!m->path) {
+        merge_event(c, path, FS_EVENT_DELETED, NULL, now_ns, now_ns);
+        return;
+    }
+    m->cookie = cookie;
+    m->first_ns = now_ns;
+    m->deadline_ns = now_ns + c->quiet_ns;
+}
+
+void coalescer_moved_to(coalescer_t *c, const char *path, uint32_t cookie, uint64_t now_ns) {
+    c->stats.raw_events++;
+
+    moved_from_t *m = NULL;
+    for (size_t i = 0; cookie != 0 && i < COOKIE_RING; i++) {
+        if (c->moves[i].path && c->moves[i].cookie == cookie) {
+            m = &c->moves[i];
+            break;
+        }
+    }
+
+    if (!m) {
+        // Файл пришёл снаружи дерева
+        merge_event(c, path, FS_EVENT_MOVED_TO, NULL, now_ns, now_ns);
+        return;
+    }
+
+    char *from = m->path;
+    uint64_t first_ns = m->first_ns;
+    m->path = NULL;
+    rename_path(c, from, path, first_ns, now_ns);
+}
+
+void coalescer_renamed(coalescer_t *c, const char *old_path, const char *path, uint64_t now_ns) {
+    c->stats.raw_events++;
+
+    char *from = strdup(old_path);
+    if (!from) {
+        // Без пары: прежний путь удалён, новый появился
+        merge_event(c, old_path, FS_EVENT_DELETED, NULL, now_ns, now_ns);
+        merge_event(c, path, FS_EVENT_MOVED_TO, NULL, now_ns, now_ns);
+        return;
+    }
+    rename_path(c, from, path, now_ns, now_ns);
+}
+
+static void expire_moves(coalescer_t *c, uint64_t now_ns, bool all) {
+    for (size_t i = 0; i < COOKIE_RING; i++) {
+        moved_from_t *m = &c->moves[i];
+        if (!m->path || (!all && m->deadline_ns > now_ns)) continue;
+
+        char *old = m->path;
+        m->path = NULL;
+        if (all) {
+            emit_now(c, FS_EVENT_DELETED, old, NULL, m->first_ns, 1);
+        } else {
+            merge_event(c, old, FS_EVENT_DELETED, NULL, m->first_ns, now_ns);
+        }
+        free(old);
+    }
+}
+
+void coalescer_advance(coalescer_t *c, uint64_t now_ns) {
+    expire_moves(c, now_ns, false);
+
+    uint64_t now_tick = now_ns / WHEEL_TICK_NS;
+    if (now_tick < c->cur_tick) return;
+
+    // После долгого простоя достаточно одного полного оборота
+    uint64_t from = c->cur_tick;
+    if (now_tick - from >= WHEEL_SLOTS) from = now_tick - WHEEL_SLOTS + 1;
+
+    pending_t *expired = NULL;
+
+    for (uint64_t t = from; t <= now_tick; t++) {
+        pending_t *p = c->wheel[t % WHEEL_SLOTS];
+        while (p) {
+            pending_t *next = p->wnext;
+            if (p->deadline_tick <= now_tick) {
+                wheel_unlink(c, p);
+                unlink_hash(c, p);
+                p->wnext = expired;
+                expired = p;
+            }
+            p = next;
+        }
+    }
+    c->cur_tick = now_tick + 1;
+
+    // Выпускаем в порядке сроков: список собран в обратном порядке
+    pending_t *ordered = NULL;
+    while (expired) {
+        pending_t *next = expired->wnext;
+        expired->wnext = ordered;
+        ordered = expired;
+        expired = next;
+    }
+    while (ordered) {
+        pending_t *next = ordered->wnext;
+        emit_pending(c, ordered);
+        free_pending(ordered);
+        ordered = next;
+    }
+}
+
+uint64_t coalescer_next_deadline(const coalescer_t *c) {
+    uint64_t best = 0;
+
+    for (size_t i = 0; i < COOKIE_RING; i++) {
+        if (c->moves[i].path && (best == 0 || c->moves[i].deadline_ns < best)) {
+            best = c->moves[i].deadline_ns;
+        }
+    }
+
+    if (c->count == 0) return best;
+
+    uint64_t wheel_best = 0;
+    for (uint64_t t = c->cur_tick; t < c->cur_tick + WHEEL_SLOTS; t++) {
+        for (const pending_t *p = c->wheel[t % WHEEL_SLOTS]; p; p = p->wnext) {
+            if (p->deadline_tick == t) {
+                wheel_best = t * WHEEL_TICK_NS;
+                break;
+            }
+        }
+        if (wheel_best) break;
+    }
+    // Все сроки дальше одного оборота — проснёмся в конце оборота
+    if (!wheel_best) wheel_best = (c->cur_tick + WHEEL_SLOTS) * WHEEL_TICK_NS;
+
+    return (best == 0 || wheel_best < best) ? wheel_best : best;
+}
+
+void coalescer_flush(coalescer_t *c) {
+    expire_moves(c, 0, true);
+
+    for (size_t s = 0; s < WHEEL_SLOTS; s++) {
+        while (c->wheel[s]) {
+            pending_t *p = c->wheel[s];
+            wheel_unlink(c, p);
+            unlink_hash(c, p);
+            emit_pending(c, p);
+            free_pending(p);
+        }
+    }
+}
+
+size_t coalescer_pending(const coalescer_t *c) {
+    return c->count;
+}
+
+coalescer_stats_t coalescer_get_stats(const coalescer_t *c) {
+    return c->stats;
+}
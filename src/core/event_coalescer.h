@@ -0,0 +1,77 @@
+#ifndef EVENT_COALESCER_H
+#define EVENT_COALESCER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Склейка и подавление дребезга событий файловой системы.
+//
+// Сырые события копятся по пути, пока путь не "затихнет" на quiet-окно,
+// после чего наружу уходит одно итоговое событие. Пара
+// IN_MOVED_FROM/IN_MOVED_TO с общим cookie превращается в одно RENAMED.
+// Сроки хранятся в колесе таймеров: вставка и перенос O(1), а
+// coalescer_next_deadline() позволяет взводить timerfd только когда есть
+// что ждать. Не потокобезопасен — используется из цикла событий.
+
+typedef enum {
+    FS_EVENT_MODIFIED,
+    FS_EVENT_MOVED_TO,
+    FS_EVENT_DELETED,
+    FS_EVENT_RENAMED,
+    FS_EVENT_CREATED  // синтетическое событие сверки: файл появился без нашего ведома
+} fs_event_kind_t;
+
+typedef struct {
+    fs_event_kind_t kind;
+    const char *path;
+    const char *old_path; // только для FS_EVENT_RENAMED
+    uint64_t first_ns;    // время первого сырого события, вошедшего в итоговое
+    uint32_t merged;      // сколько сырых событий склеено в это
+} fs_event_t;
+
+// Строковое имя типа для proc map ("modified", "moved_to", ...)
+const char *fs_event_kind_name(fs_event_kind_t kind);
+
+typedef void (*coalescer_emit_fn)(void *ctx, const fs_event_t *ev);
+
+typedef struct coalescer coalescer_t;
+
+typedef struct {
+    uint64_t raw_events;
+    uint64_t emitted;
+    uint64_t renames_paired;
+} coalescer_stats_t;
+
+/**
+ * @param quiet_ns    окно тишины: событие уходит через quiet_ns после последнего изменения пути
+ * @param max_pending предел накопленных путей; сверх него события уходят сразу
+ * @param emit        колбэк для итоговых событий (вызывается синхронно)
+ */
+coalescer_t *coalescer_new(uint64_t quiet_ns, size_t max_pending,
+                           coalescer_emit_fn emit, void *ctx);
+void coalescer_free(coalescer_t *c);
+
+// IN_CLOSE_WRITE и догоняющие события
+void coalescer_modified(coalescer_t *c, const char *path, uint64_t now_ns);
+void coalescer_deleted(coalescer_t *c, const char *path, uint64_t now_ns);
+void coalescer_created(coalescer_t *c, const char *path, uint64_t now_ns);
+void coalescer_moved_from(coalescer_t *c, const char *path, uint32_t cookie, uint64_t now_ns);
+// cookie == 0 — перемещение без пары (например, догоняющее событие каталога)
+void coalescer_moved_to(coalescer_t *c, const char *path, uint32_t cookie, uint64_t now_ns);
+// Уже сопоставленное переименование (файлы каталога, переименованного целиком)
+void coalescer_renamed(coalescer_t *c, const char *old_path, const char *path, uint64_t now_ns);
+
+// Выпускает события, чьё окно тишины истекло к now_ns
+void coalescer_advance(coalescer_t *c, uint64_t now_ns);
+
+// Ближайший срок (монотонные нс) или 0, если ждать нечего
+uint64_t coalescer_next_deadline(const coalescer_t *c);
+
+// Выпускает всё накопленное немедленно (завершение работы, переполнение)
+void coalescer_flush(coalescer_t *c);
+
+size_t coalescer_pending(const coalescer_t *c);
+coalescer_stats_t coalescer_get_stats(const coalescer_t *c);
+
+#endif // EVENT_COALESCER_H
@@ -0,0 +1,515 @@
+// core/event_pipeline.c
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "event_pipeline.h"
+
+#define MAX_PIPELINE_WORKERS 32
+#define MARK_POLL_NS         1000000 // опрос метки ждущим потоком
+
+typedef struct pipeline_node {
+    pipeline_event_t ev;
+    bool want_hash;
+    uint64_t enqueued_ns;
+    struct pipeline_node *next; // очередь ожидания производителя
+} pipeline_node_t;
+
+typedef struct {
+    // Индексы производителя и потребителя на разных линиях кэша
+    _Alignas(64) _Atomic size_t head;  // пишет только рабочий поток
+    _Alignas(64) _Atomic size_t tail;  // пишет только цикл событий
+    _Alignas(64) pipeline_node_t **ring;
+    size_t mask;
+
+    _Atomic int sleeping;  // поток ждёт в read(efd)
+    _Atomic bool stop;
+    int efd;
+
+    // Не вошедшее в полную очередь: только цикл событий, по порядку
+    pipeline_node_t *spill_head;
+    pipeline_node_t *spill_tail;
+    size_t spill_len;
+    _Atomic bool spill_waiting; // разбудить производителя, когда освободится место
+
+    // Метрики: пишет рабочий поток, читает цикл событий
+    _Atomic uint64_t processed;
+    _Atomic uint64_t busy_ns;
+    _Atomic uint64_t max_wait_ns;
+    _Atomic uint64_t hashed;
+    _Atomic uint64_t cache_hits;
+    _Atomic uint64_t skipped;
+    _Atomic uint64_t failed;
+    _Atomic uint64_t bytes_hashed;
+    size_t high_watermark; // пишет и читает цикл событий
+
+    struct event_pipeline *p;
+    unsigned id;
+    pthread_t thread;
+    bool started;
+} pipeline_worker_t;
+
+// processed потока дошёл до числа узлов, принятых им к моменту метки
+struct pipeline_mark {
+    unsigned nworkers;
+    uint64_t target[];
+};
+
+struct event_pipeline {
+    pipeline_worker_t *workers;
+    unsigned nworkers;
+    size_t hash_backlog;
+    hash_cache_t *cache;
+    pipeline_record_fn record;
+    void *ctx;
+    bool stopped;
+
+    // Счётчики производителя (только цикл событий)
+    uint64_t submitted;
+    uint64_t spilled;
+    size_t spill_pending;
+    int spill_efd;  // читаемо, когда в переполненной очереди освободилось место
+
+    // Принятые, но ещё не записанные события
+    _Atomic size_t inflight;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t hash_path(const char *s) {
+    uint64_t h = 1469598103934665603ull;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static int64_t mtime_ns_of(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+static void atomic_max(_Atomic uint64_t *target, uint64_t v) {
+    uint64_t cur = atomic_load_explicit(target, memory_order_relaxed);
+    while (v > cur && !atomic_compare_exchange_weak_explicit(
+               target, &cur, v, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void free_node(pipeline_node_t *n) {
+    free(n->ev.path);
+    free(n->ev.old_path);
+    free(n);
+}
+
+// Открывает файл, заполняет размер и хеш (из кэша или чтением)
+static uint64_t fill_event(event_pipeline_t *p, pipeline_node_t *n) {
+    pipeline_event_t *ev = &n->ev;
+
+    int fd = open(ev->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC | O_NONBLOCK);
+    if (fd == -1) return 0; // файл уже исчез — событие всё равно уйдёт, exists = false
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return 0;
+    }
+
+    ev->exists = true;
+    ev->ino = (uint64_t)st.st_ino;
+    ev->size = (int64_t)st.st_size;
+    ev->mtime_ns = mtime_ns_of(&st);
+
+    uint64_t bytes = 0;
+    if (p->cache && hash_cache_lookup(p->cache, st.st_dev, st.st_ino,
+                                      ev->size, ev->mtime_ns, ev->hash)) {
+        ev->hashed = true;
+        ev->cache_hit = true;
+    } else if (n->want_hash && compute_fd_blake3(fd, ev->hash, &bytes) == 0) {
+        struct stat after;
+        // Файл дописывают прямо сейчас: хеш не соответствует ни одной
+        // версии, ждём следующего события
+        if (fstat(fd, &after) == 0 && after.st_size == st.st_size &&
+            mtime_ns_of(&after) == ev->mtime_ns) {
+            ev->hashed = true;
+            if (p->cache) {
+                hash_cache_store(p->cache, st.st_dev, st.st_ino,
+                                 ev->size, ev->mtime_ns, ev->hash);
+            }
+        }
+    }
+
+    close(fd);
+    return bytes;
+}
+
+static void process_node(event_pipeline_t *p, pipeline_worker_t *w, pipeline_node_t *n) {
+    uint64_t started = now_ns();
+    atomic_max(&w->max_wait_ns, started - n->enqueued_ns);
+
+    if (n->ev.kind != FS_EVENT_DELETED && !n->ev.rename_source) {
+        uint64_t bytes = fill_event(p, n);
+        atomic_fetch_add_explicit(&w->bytes_hashed, bytes, memory_order_relaxed);
+
+        _Atomic uint64_t *counter;
+        if (n->ev.cache_hit) counter = &w->cache_hits;
+        else if (n->ev.hashed) counter = &w->hashed;
+        else if (!n->want_hash) counter = &w->skipped;
+        else counter = &w->failed;
+        atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+    }
+
+    p->record(p->ctx, w->id, &n->ev);
+
+    atomic_fetch_add_explicit(&w->busy_ns, now_ns() - started, memory_order_relaxed);
+    // release: запись события видна тому, кто дождался метки
+    atomic_fetch_add_explicit(&w->processed, 1, memory_order_release);
+}
+
+static void *worker_main(void *arg) {
+    pipeline_worker_t *w = arg;
+    event_pipeline_t *p = w->p;
+
+    for (;;) {
+        size_t h = atomic_load_explicit(&w->head, memory_order_relaxed);
+        size_t t = atomic_load_explicit(&w->tail, memory_order_acquire);
+
+        if (h == t) {
+            if (atomic_load(&w->stop)) break;
+
+            // Объявляем сон и перепроверяем очередь: производитель либо
+            // увидит sleeping и разбудит, либо мы увидим новый tail
+            atomic_store(&w->sleeping, 1);
+            if (atomic_load(&w->tail) == h && !atomic_load(&w->stop)) {
+                uint64_t counter;
+                while (read(w->efd, &counter, sizeof(counter)) == -1 && errno == EINTR) {
+                }
+            }
+            atomic_store(&w->sleeping, 0);
+            continue;
+        }
+
+        pipeline_node_t *n = w->ring[h & w->mask];
+        atomic_store(&w->head, h + 1);
+
+        // Очередь освободилась наполовину — производитель дольёт ожидающее
+        if (t - (h + 1) <= w->mask / 2 && atomic_load(&w->spill_waiting) &&
+            atomic_exchange(&w->spill_waiting, false)) {
+            uint64_t one = 1;
+            (void)!write(p->spill_efd, &one, sizeof(one));
+        }
+
+        process_node(p, w, n);
+        free_node(n);
+
+        if (atomic_fetch_sub(&p->inflight, 1) == 1) {
+            pthread_mutex_lock(&p->idle_lock);
+            pthread_cond_broadcast(&p->idle_cond);
+            pthread_mutex_unlock(&p->idle_lock);
+        }
+    }
+
+    return NULL;
+}
+
+static void wake(pipeline_worker_t *w) {
+    uint64_t one = 1;
+    (void)!write(w->efd, &one, sizeof(one));
+}
+
+event_pipeline_t *pipeline_new(unsigned nworkers, size_t ring_capacity, size_t hash_backlog,
+                               hash_cache_t *cache, pipeline_record_fn record, void *ctx) {
+    if (nworkers == 0) {
+        // Потоки в основном ждут MongoDB и диск — берём больше, чем ядер
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = ncpu > 0 ? (unsigned)ncpu * 2 : 4;
+        if (nworkers < 4) nworkers = 4;
+    }
+    if (nworkers > MAX_PIPELINE_WORKERS) nworkers = MAX_PIPELINE_WORKERS;
+
+    size_t cap = 16;
+    while (cap < ring_capacity) cap <<= 1;
+
+    event_pipeline_t *p = calloc(1, sizeof(*p));
+    if (!p) return NULL;
+
+    p->workers = aligned_alloc(64, sizeof(pipeline_worker_t) * nworkers);
+    if (!p->workers) {
+        free(p);
+        return NULL;
+    }
+    memset(p->workers, 0, sizeof(pipeline_worker_t) * nworkers);
+
+    p->hash_backlog = hash_backlog;
+    p->cache = cache;
+    p->spill_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (p->spill_efd == -1) {
+        free(p->workers);
+        free(p);
+        return NULL;
+    }
+    p->record = record;
+    p->ctx = ctx;
+    pthread_mutex_init(&p->idle_lock, NULL);
+    pthread_cond_init(&p->idle_cond, NULL);
+
+    for (unsigned i = 0; i < nworkers; i++) {
+        pipeline_worker_t *w = &p->workers[i];
+        w->p = p;
+        w->id = i;
+        w->mask = cap - 1;
+        w->ring = calloc(cap, sizeof(pipeline_node_t *));
+        w->efd = eventfd(0, EFD_CLOEXEC);
+        p->nworkers++;
+
+        if (!w->ring || w->efd == -1 ||
+            pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            pipeline_free(p);
+            return NULL;
+        }
+        w->started = true;
+    }
+
+    return p;
+}
+
+void pipeline_stop(event_pipeline_t *p) {
+    if (p->stopped) return;
+
+    // Ожидающее в очередях производителя тоже принято
+    pipeline_wait_idle(p);
+
+    for (unsigned i = 0; i < p->nworkers; i++) {
+        pipeline_worker_t *w = &p->workers[i];
+        if (!w->started) continue;
+        atomic_store(&w->stop, true);
+        wake(w);
+    }
+    for (unsigned i = 0; i < p->nworkers; i++) {
+        if (p->workers[i].started) pthread_join(p->workers[i].thread, NULL);
+    }
+    p->stopped = true;
+}
+
+void pipeline_free(event_pipeline_t *p) {
+    if (!p) return;
+    pipeline_stop(p);
+
+    for (unsigned i = 0; i < p->nworkers; i++) {
+        pipeline_worker_t *w = &p->workers[i];
+        if (w->efd >= 0) close(w->efd);
+        free(w->ring);
+    }
+
+    pthread_mutex_destroy(&p->idle_lock);
+    pthread_cond_destroy(&p->idle_cond);
+    close(p->spill_efd);
+    free(p->workers);
+    free(p);
+}
+
+static pipeline_node_t *new_node(const fs_event_t *ev, bool rename_source) {
+    pipeline_node_t *n = calloc(1, sizeof(*n));
+    if (!n) return NULL;
+
+    n->ev.kind = ev->kind;
+    n->ev.first_ns = ev->first_ns;
+    n->ev.rename_source = rename_source;
+    n->ev.path = strdup(ev->path);
+    n->ev.old_path = ev->old_path ? strdup(ev->old_path) : NULL;
+    if (!n->ev.path || (ev->old_path && !n->ev.old_path)) {
+        free_node(n);
+        return NULL;
+    }
+    return n;
+}
+
+static pipeline_worker_t *worker_of(event_pipeline_t *p, const pipeline_node_t *n) {
+    // Половина-источник переименования принадлежит old_path
+    const char *key = n->ev.rename_source ? n->ev.old_path : n->ev.path;
+    return &p->workers[hash_path(key) % p->nworkers];
+}
+
+// Кладёт узел в кольцо; false — кольцо полно
+static bool ring_push(event_pipeline_t *p, pipeline_worker_t *w, pipeline_node_t *n,
+                      size_t backlog) {
+    size_t t = atomic_load_explicit(&w->tail, memory_order_relaxed);
+    size_t occupancy = t - atomic_load(&w->head);
+    if (occupancy > w->mask) return false;
+
+    if (occupancy + 1 > w->high_watermark) w->high_watermark = occupancy + 1;
+    // Хвост ожидания тоже очередь: хеш считается, только если догоняем
+    n->want_hash = n->ev.kind != FS_EVENT_DELETED && !n->ev.rename_source &&
+                   occupancy + backlog < p->hash_backlog;
+
+    w->ring[t & w->mask] = n;
+    atomic_store(&w->tail, t + 1);
+    if (atomic_load(&w->sleeping)) wake(w);
+    return true;
+}
+
+// Переносит ожидающее в кольцо, сколько влезет
+static void spill_flush(event_pipeline_t *p, pipeline_worker_t *w) {
+    while (w->spill_head) {
+        pipeline_node_t *n = w->spill_head;
+        // После ring_push узел принадлежит потоку и может быть уже освобождён
+        pipeline_node_t *next = n->next;
+        if (!ring_push(p, w, n, w->spill_len - 1)) {
+            // Просим поток сообщить о месте и перепроверяем: он мог
+            // освободить кольцо раньше, чем увидел флаг
+            atomic_store(&w->spill_waiting, true);
+            if (atomic_load(&w->tail) - atomic_load(&w->head) > w->mask) return;
+            continue;
+        }
+        w->spill_head = next;
+        if (!next) w->spill_tail = NULL;
+        w->spill_len--;
+        p->spill_pending--;
+    }
+}
+
+// Ставит узел в очередь потока его пути. Полное кольцо не ждём: узел
+// встаёт в хвост ожидания, порядок пути сохраняется
+static void enqueue(event_pipeline_t *p, pipeline_node_t *n) {
+    pipeline_worker_t *w = worker_of(p, n);
+
+    n->enqueued_ns = now_ns();
+    atomic_fetch_add(&p->inflight, 1);
+
+    if (!w->spill_head && ring_push(p, w, n, 0)) return;
+
+    if (w->spill_tail) w->spill_tail->next = n;
+    else w->spill_head = n;
+    w->spill_tail = n;
+    w->spill_len++;
+    p->spill_pending++;
+    p->spilled++;
+    spill_flush(p, w);
+}
+
+bool pipeline_submit(event_pipeline_t *p, const fs_event_t *ev) {
+    // Обе половины переименования выделяются заранее: уходят вместе или никак
+    pipeline_node_t *n = new_node(ev, false);
+    pipeline_node_t *src = NULL;
+    if (n && ev->kind == FS_EVENT_RENAMED) {
+        src = new_node(ev, true);
+        if (!src) {
+            free_node(n);
+            n = NULL;
+        }
+    }
+    if (!n) return false;
+
+    p->submitted++;
+    enqueue(p, n);
+    if (src) enqueue(p, src);
+    return true;
+}
+
+int pipeline_spill_fd(const event_pipeline_t *p) {
+    return p->spill_efd;
+}
+
+void pipeline_resume(event_pipeline_t *p) {
+    uint64_t counter;
+    (void)!read(p->spill_efd, &counter, sizeof(counter));
+    if (p->spill_pending == 0) return;
+    for (unsigned i = 0; i < p->nworkers; i++) {
+        if (p->workers[i].spill_head) spill_flush(p, &p->workers[i]);
+    }
+}
+
+pipeline_mark_t *pipeline_mark(event_pipeline_t *p) {
+    pipeline_mark_t *m = malloc(sizeof(*m) + p->nworkers * sizeof(uint64_t));
+    if (!m) return NULL;
+
+    m->nworkers = p->nworkers;
+    for (unsigned i = 0; i < p->nworkers; i++) {
+        // Список ожидания уйдёт в кольцо по порядку, за уже поставленным
+        pipeline_worker_t *w = &p->workers[i];
+        m->target[i] = atomic_load_explicit(&w->tail, memory_order_relaxed) + w->spill_len;
+    }
+    return m;
+}
+
+bool pipeline_mark_reached(event_pipeline_t *p, const pipeline_mark_t *m) {
+    for (unsigned i = 0; i < m->nworkers; i++) {
+        if (atomic_load_explicit(&p->workers[i].processed, memory_order_acquire) < m->target[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void pipeline_wait_mark(event_pipeline_t *p, const pipeline_mark_t *m) {
+    struct timespec pause = { .tv_nsec = MARK_POLL_NS };
+    while (!pipeline_mark_reached(p, m)) nanosleep(&pause, NULL);
+}
+
+void pipeline_wait_idle(event_pipeline_t *p) {
+    // Ожидающее доливаем сами: больше некому
+    while (p->spill_pending > 0) {
+        struct pollfd pfd = { .fd = p->spill_efd, .events = POLLIN };
+        while (poll(&pfd, 1, -1) == -1 && errno == EINTR) {
+        }
+        pipeline_resume(p);
+    }
+
+    pthread_mutex_lock(&p->idle_lock);
+    while (atomic_load(&p->inflight) > 0) pthread_cond_wait(&p->idle_cond, &p->idle_lock);
+    pthread_mutex_unlock(&p->idle_lock);
+}
+
+unsigned pipeline_worker_count(const event_pipeline_t *p) {
+    return p->nworkers;
+}
+
+pipeline_stats_t pipeline_get_stats(event_pipeline_t *p) {
+    pipeline_stats_t total = {
+        .submitted = p->submitted,
+        .spilled = p->spilled,
+        .spill_pending = p->spill_pending,
+    };
+    for (unsigned i = 0; i < p->nworkers; i++) {
+        pipeline_worker_t *w = &p->workers[i];
+        total.hashed += atomic_load_explicit(&w->hashed, memory_order_relaxed);
+        total.cache_hits += atomic_load_explicit(&w->cache_hits, memory_order_relaxed);
+        total.skipped += atomic_load_explicit(&w->skipped, memory_order_relaxed);
+        total.failed += atomic_load_explicit(&w->failed, memory_order_relaxed);
+        total.bytes_hashed += atomic_load_explicit(&w->bytes_hashed, memory_order_relaxed);
+    }
+    return total;
+}
+
+pipeline_worker_stats_t pipeline_get_worker_stats(event_pipeline_t *p, unsigned worker) {
+    pipeline_worker_t *w = &p->workers[worker];
+    size_t t = atomic_load_explicit(&w->tail, memory_order_relaxed);
+    size_t h = atomic_load_explicit(&w->head, memory_order_acquire);
+
+    pipeline_worker_stats_t ws = {
+        .occupancy = t - h,
+        .high_watermark = w->high_watermark,
+        .processed = atomic_load_explicit(&w->processed, memory_order_relaxed),
+        .max_wait_ns = atomic_exchange_explicit(&w->max_wait_ns, 0, memory_order_relaxed),
+        .busy_ns = atomic_load_explicit(&w->busy_ns, memory_order_relaxed),
+    };
+    w->high_watermark = t - h;
+    return ws;
+}
@@ -0,0 +1,123 @@
+#ifndef EVENT_PIPELINE_H
+#define EVENT_PIPELINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/hash_utils.h"
+#include "event_coalescer.h"
+#include "hash_cache.h"
+
+// Конвейер обработки итоговых событий: цикл событий раскладывает их по
+// K рабочим потокам по хешу пути через кольцевые буферы SPSC без
+// блокировок. Поток дополняет событие размером и BLAKE3 содержимого и сам
+// вызывает колбэк записи (MongoDB). События одного пути всегда попадают в
+// один поток и обрабатываются по порядку; несвязанные файлы идут параллельно.
+// Переименование затрагивает два пути и делится на две половины: каждая
+// уходит в поток своего пути.
+//
+// Противодавление: цикл событий никогда не ждёт потоки. Если очередь потока
+// заполнена, событие встаёт в список ожидания этого потока; когда очередь
+// освободится наполовину, pipeline_spill_fd() становится читаемым и
+// pipeline_resume() доливает ожидающее. Когда очередь вместе со списком
+// длиннее hash_backlog, события проходят без хеширования содержимого,
+// чтобы поток быстрее догнал.
+
+typedef struct {
+    fs_event_kind_t kind;
+    char *path;
+    char *old_path;     // только для FS_EVENT_RENAMED
+    uint64_t first_ns;
+    bool rename_source; // половина переименования для old_path (без хеша)
+
+    // Заполняется рабочим потоком
+    bool exists;        // обычный файл на момент обработки
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime_ns;
+    bool hashed;
+    bool cache_hit;
+    uint8_t hash[HASH_SIZE];
+} pipeline_event_t;
+
+// Колбэк записи, вызывается в рабочем потоке worker
+typedef void (*pipeline_record_fn)(void *ctx, unsigned worker, const pipeline_event_t *ev);
+
+typedef struct {
+    uint64_t submitted;
+    uint64_t hashed;       // прочитано и посчитано
+    uint64_t cache_hits;
+    uint64_t skipped;      // длинная очередь и кэш не помог — событие ушло без хеша
+    uint64_t failed;       // файл исчез, не обычный или не прочитан до конца
+    uint64_t bytes_hashed;
+    uint64_t spilled;      // событий, прошедших через список ожидания
+    size_t spill_pending;  // ждут места в очередях сейчас
+} pipeline_stats_t;
+
+// Состояние одного потока для метрик противодавления
+typedef struct {
+    size_t occupancy;       // событий в очереди сейчас
+    size_t high_watermark;  // максимум с прошлого чтения
+    uint64_t processed;
+    uint64_t max_wait_ns;   // максимальное ожидание события в очереди с прошлого чтения
+    uint64_t busy_ns;       // время обработки (хеширование + запись)
+} pipeline_worker_stats_t;
+
+typedef struct event_pipeline event_pipeline_t;
+
+/**
+ * @param nworkers      число потоков (0 — вдвое больше ядер, не меньше 4)
+ * @param ring_capacity ёмкость очереди потока (округляется до степени двойки)
+ * @param hash_backlog  предел заполнения очереди, выше которого хеш не считается
+ * @param cache         кэш хешей (может быть NULL)
+ * @param record        колбэк записи
+ */
+event_pipeline_t *pipeline_new(unsigned nworkers, size_t ring_capacity, size_t hash_backlog,
+                               hash_cache_t *cache, pipeline_record_fn record, void *ctx);
+
+// Останавливает потоки, дождавшись обработки всех принятых событий
+void pipeline_stop(event_pipeline_t *p);
+
+// Освобождает конвейер (вызывает pipeline_stop)
+void pipeline_free(event_pipeline_t *p);
+
+/**
+ * @brief Ставит итоговое событие в очередь потока его пути.
+ *
+ * Вызывается только из одного потока (цикла событий).
+ * @return false только при нехватке памяти
+ */
+bool pipeline_submit(event_pipeline_t *p, const fs_event_t *ev);
+
+// eventfd для epoll цикла событий: место в переполненной очереди освободилось
+int pipeline_spill_fd(const event_pipeline_t *p);
+
+// Доливает ожидающие события в очереди; вызывается по pipeline_spill_fd()
+void pipeline_resume(event_pipeline_t *p);
+
+// Метка «всё принятое к этому моменту»: по ней другой поток ждёт записи
+// уже принятых событий, не дожидаясь простоя конвейера
+typedef struct pipeline_mark pipeline_mark_t;
+
+// Ставится в потоке, который ставит события; освобождается free()
+pipeline_mark_t *pipeline_mark(event_pipeline_t *p);
+
+// true — всё принятое до метки записано. Из любого потока
+bool pipeline_mark_reached(event_pipeline_t *p, const pipeline_mark_t *m);
+
+// Ждёт метку. Не из потока, который ставит события: список ожидания
+// доливает он
+void pipeline_wait_mark(event_pipeline_t *p, const pipeline_mark_t *m);
+
+// Блокируется, пока все принятые события не записаны. Вызывается из
+// потока, который ставит события (сам доливает список ожидания)
+void pipeline_wait_idle(event_pipeline_t *p);
+
+unsigned pipeline_worker_count(const event_pipeline_t *p);
+pipeline_stats_t pipeline_get_stats(event_pipeline_t *p);
+
+// Метрики потока; high_watermark и max_wait_ns сбрасываются при чтении
+pipeline_worker_stats_t pipeline_get_worker_stats(event_pipeline_t *p, unsigned worker);
+
+#endif // EVENT_PIPELINE_H
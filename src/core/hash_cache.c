@@ -0,0 +1,279 @@
+// core/hash_cache.c
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash_cache.h"
+
+#define HASH_CACHE_MAGIC   0x31434858u // "XHC1"
+#define HASH_CACHE_VERSION 1
+
+// Уплотнение на ходу: журнал вдвое длиннее живых записей, но не короче этого
+#define HASH_CACHE_COMPACT_MIN 4096
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+} cache_file_header_t;
+
+// Запись журнала и слот таблицы совпадают: 64 байта
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;      // 0 — слот пуст (inode 0 в Linux не бывает)
+    int64_t size;
+    int64_t mtime_ns;
+    uint8_t hash[HASH_SIZE];
+} cache_record_t;
+
+struct hash_cache {
+    pthread_mutex_t lock;
+
+    cache_record_t *slots;
+    size_t cap;        // степень двойки
+    size_t count;
+    size_t max_entries;
+
+    char *path;
+    int fd;            // -1 — журнал не ведётся
+    uint64_t log_records;
+
+    uint64_t hits;
+    uint64_t misses;
+};
+
+static uint64_t mix_key(uint64_t dev, uint64_t ino) {
+    uint64_t h = ino * 0x9E3779B97F4A7C15ull ^ dev;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return h ^ (h >> 32);
+}
+
+static cache_record_t *find_slot(cache_record_t *slots, size_t cap, uint64_t dev, uint64_t ino) {
+    size_t i = mix_key(dev, ino) & (cap - 1);
+    while (slots[i].ino != 0 && (slots[i].ino != ino || slots[i].dev != dev)) {
+        i = (i + 1) & (cap - 1);
+    }
+    return &slots[i];
+}
+
+static bool grow(hash_cache_t *hc) {
+    size_t ncap = hc->cap * 2;
+    cache_record_t *ns = calloc(ncap, sizeof(cache_record_t));
+    if (!ns) return false;
+
+    for (size_t i = 0; i < hc->cap; i++) {
+        if (hc->slots[i].ino == 0) continue;
+        *find_slot(ns, ncap, hc->slots[i].dev, hc->slots[i].ino) = hc->slots[i];
+    }
+    free(hc->slots);
+    hc->slots = ns;
+    hc->cap = ncap;
+    return true;
+}
+
+// Вставка в таблицу без записи в журнал
+static void table_put(hash_cache_t *hc, const cache_record_t *rec) {
+    if ((hc->count + 1) * 4 > hc->cap * 3 && !grow(hc)) return;
+
+    cache_record_t *slot = find_slot(hc->slots, hc->cap, rec->dev, rec->ino);
+    if (slot->ino == 0) hc->count++;
+    *slot = *rec;
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static const cache_file_header_t g_header = {
+    .magic = HASH_CACHE_MAGIC,
+    .version = HASH_CACHE_VERSION,
+    .record_size = sizeof(cache_record_t),
+};
+
+// Переписывает журнал из таблицы: временный файл + rename
+static void rewrite_log(hash_cache_t *hc) {
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", hc->path) >= (int)sizeof(tmp)) return;
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) return;
+
+    bool ok = write_all(fd, &g_header, sizeof(g_header));
+    for (size_t i = 0; ok && i < hc->cap; i++) {
+        if (hc->slots[i].ino != 0) ok = write_all(fd, &hc->slots[i], sizeof(cache_record_t));
+    }
+
+    if (!ok || fsync(fd) != 0 || rename(tmp, hc->path) != 0) {
+        close(fd);
+        unlink(tmp);
+        return;
+    }
+    close(fd);
+
+    if (hc->fd >= 0) close(hc->fd);
+    hc->fd = open(hc->path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    hc->log_records = hc->count;
+}
+
+static void load_log(hash_cache_t *hc) {
+    int fd = open(hc->path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+
+    cache_file_header_t hdr;
+    if (read(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) ||
+        hdr.magic != HASH_CACHE_MAGIC || hdr.version != HASH_CACHE_VERSION ||
+        hdr.record_size != sizeof(cache_record_t)) {
+        // Чужой или старый формат — начинаем с пустого кэша
+        close(fd);
+        return;
+    }
+
+    cache_record_t batch[256];
+    for (;;) {
+        ssize_t n = read(fd, batch, sizeof(batch));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        // Оборванная последняя запись (сбой во время дозаписи) отбрасывается
+        size_t records = (size_t)n / sizeof(cache_record_t);
+        for (size_t i = 0; i < records; i++) {
+            if (batch[i].ino != 0) table_put(hc, &batch[i]);
+        }
+        hc->log_records += records;
+        if ((size_t)n % sizeof(cache_record_t) != 0) break;
+    }
+    close(fd);
+}
+
+hash_cache_t *hash_cache_open(const char *path, size_t max_entries) {
+    hash_cache_t *hc = calloc(1, sizeof(*hc));
+    if (!hc) return NULL;
+
+    hc->cap = 1024;
+    hc->slots = calloc(hc->cap, sizeof(cache_record_t));
+    hc->max_entries = max_entries ? max_entries : SIZE_MAX;
+    hc->fd = -1;
+    if (!hc->slots) {
+        free(hc);
+        return NULL;
+    }
+    pthread_mutex_init(&hc->lock, NULL);
+
+    if (!path) return hc;
+
+    hc->path = strdup(path);
+    if (!hc->path) return hc;
+
+    load_log(hc);
+
+    if (hc->log_records == 0 || hc->log_records > hc->count * 2) {
+        // Новый журнал или много устаревших записей — уплотняем
+        rewrite_log(hc);
+    } else {
+        hc->fd = open(hc->path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    }
+
+    return hc;
+}
+
+void hash_cache_close(hash_cache_t *hc) {
+    if (!hc) return;
+    if (hc->fd >= 0) {
+        fdatasync(hc->fd);
+        close(hc->fd);
+    }
+    pthread_mutex_destroy(&hc->lock);
+    free(hc->path);
+    free(hc->slots);
+    free(hc);
+}
+
+bool hash_cache_lookup(hash_cache_t *hc, uint64_t dev, uint64_t ino,
+                       int64_t size, int64_t mtime_ns, uint8_t out_hash[HASH_SIZE]) {
+    if (ino == 0) return false;
+
+    pthread_mutex_lock(&hc->lock);
+    const cache_record_t *slot = find_slot(hc->slots, hc->cap, dev, ino);
+    bool hit = slot->ino != 0 && slot->size == size && slot->mtime_ns == mtime_ns;
+    if (hit) {
+        memcpy(out_hash, slot->hash, HASH_SIZE);
+        hc->hits++;
+    } else {
+        hc->misses++;
+    }
+    pthread_mutex_unlock(&hc->lock);
+
+    return hit;
+}
+
+void hash_cache_store(hash_cache_t *hc, uint64_t dev, uint64_t ino,
+                      int64_t size, int64_t mtime_ns, const uint8_t hash[HASH_SIZE]) {
+    if (ino == 0) return;
+
+    cache_record_t rec = {
+        .dev = dev,
+        .ino = ino,
+        .size = size,
+        .mtime_ns = mtime_ns,
+    };
+    memcpy(rec.hash, hash, HASH_SIZE);
+
+    pthread_mutex_lock(&hc->lock);
+
+    // Повторный хеш неизменённого файла: в журнале он уже есть
+    const cache_record_t *cur = find_slot(hc->slots, hc->cap, dev, ino);
+    if (cur->ino != 0 && memcmp(cur, &rec, sizeof(rec)) == 0) {
+        pthread_mutex_unlock(&hc->lock);
+        return;
+    }
+
+    if (hc->count >= hc->max_entries) {
+        // Переполнение: кэш начинается заново, журнал тоже
+        memset(hc->slots, 0, hc->cap * sizeof(cache_record_t));
+        hc->count = 0;
+        if (hc->path) rewrite_log(hc);
+    }
+
+    table_put(hc, &rec);
+    if (hc->fd >= 0 && write_all(hc->fd, &rec, sizeof(rec))) {
+        hc->log_records++;
+        // Долгоживущий демон: без этого журнал растёт до следующего открытия
+        if (hc->log_records >= HASH_CACHE_COMPACT_MIN && hc->log_records > hc->count * 2) {
+            rewrite_log(hc);
+        }
+    }
+
+    pthread_mutex_unlock(&hc->lock);
+}
+
+hash_cache_stats_t hash_cache_get_stats(hash_cache_t *hc) {
+    pthread_mutex_lock(&hc->lock);
+    hash_cache_stats_t st = {
+        .entries = hc->count,
+        .hits = hc->hits,
+        .misses = hc->misses,
+        .log_records = hc->log_records,
+    };
+    pthread_mutex_unlock(&hc->lock);
+    return st;
+}
@@ -0,0 +1,46 @@
+#ifndef HASH_CACHE_H
+#define HASH_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/hash_utils.h"
+
+// Постоянный кэш хешей содержимого: (dev, inode) -> (size, mtime, BLAKE3).
+// Запись считается актуальной, только если size и mtime совпадают с
+// текущими — так после перезапуска неизменённые файлы не перечитываются.
+//
+// На диске — журнал фиксированных записей только на дозапись; при загрузке
+// поздняя запись для того же inode побеждает. Запись, совпадающая с уже
+// известной, в журнал не попадает. Журнал уплотняется, если в нём больше
+// половины устаревших записей: при открытии и на ходу.
+// Потокобезопасен.
+
+typedef struct hash_cache hash_cache_t;
+
+typedef struct {
+    uint64_t entries;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t log_records; // записей в журнале на диске
+} hash_cache_stats_t;
+
+/**
+ * @param path        файл журнала; NULL — кэш только в памяти
+ * @param max_entries предел записей; при переполнении кэш начинается заново
+ * @return кэш или NULL при нехватке памяти (ошибка журнала не фатальна:
+ *         кэш работает в памяти)
+ */
+hash_cache_t *hash_cache_open(const char *path, size_t max_entries);
+void hash_cache_close(hash_cache_t *hc);
+
+bool hash_cache_lookup(hash_cache_t *hc, uint64_t dev, uint64_t ino,
+                       int64_t size, int64_t mtime_ns, uint8_t out_hash[HASH_SIZE]);
+
+void hash_cache_store(hash_cache_t *hc, uint64_t dev, uint64_t ino,
+                      int64_t size, int64_t mtime_ns, const uint8_t hash[HASH_SIZE]);
+
+hash_cache_stats_t hash_cache_get_stats(hash_cache_t *hc);
+
+#endif // HASH_CACHE_H
@@ -0,0 +1,817 @@
+// core/inotify_watcher.c
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "inotify_watcher.h"
+#include "latency_hist.h"
+#include "tree_walk.h"
+#include "watch_map.h"
+
+// IN_CREATE нужен только для каталогов: новые подкаталоги ставятся на наблюдение
+#define INOTIFY_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | \
+                      IN_CREATE | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+#define INOTIFY_BUFFER_SIZE ((sizeof(struct inotify_event) + NAME_MAX + 1) * 128)
+
+// Новые каталоги fanotify видит и так (метка на всю ФС), FAN_CREATE не нужен.
+// FAN_RENAME (ядро 5.17+) даёт старое и новое имя одним событием; на старых
+// ядрах — FAN_MOVED_FROM/FAN_MOVED_TO без пары.
+#define FANOTIFY_BASE_MASK (FAN_CLOSE_WRITE | FAN_DELETE | FAN_ONDIR)
+#define FANOTIFY_BUFFER_SIZE (64 * 1024)
+
+// Каталоги, ушедшие по IN_MOVED_FROM и ждущие своего IN_MOVED_TO
+#define DIR_MOVES_MAX 16
+
+#define FH_CACHE_BUCKETS 4096
+#define FH_CACHE_MAX     65536  // при переполнении кэш сбрасывается целиком
+
+#ifndef FAN_EVENT_INFO_TYPE_OLD_DFID_NAME
+#define FAN_EVENT_INFO_TYPE_OLD_DFID_NAME 10
+#define FAN_EVENT_INFO_TYPE_NEW_DFID_NAME 12
+#endif
+#ifndef FAN_RENAME
+#define FAN_RENAME 0x10000000
+#endif
+
+// Дескриптор каталога (file handle) -> путь
+typedef struct fh_entry {
+    struct fh_entry *next;
+    uint64_t hash;
+    int type;
+    unsigned len;
+    char *path;
+    unsigned char handle[];
+} fh_entry_t;
+
+struct watcher {
+    watcher_backend_t backend;
+    int fd;
+    char *root;
+    size_t root_len;
+
+    watcher_sink_t sink;
+    void *ctx;
+    watcher_stats_t stats;
+
+    // inotify: наблюдаемые каталоги, wd -> путь
+    watch_map_t watches;
+
+    // inotify: ушедшие каталоги без пары (cookie -> прежний путь)
+    struct {
+        uint32_t cookie;
+        char *path;
+    } dir_moves[DIR_MOVES_MAX];
+    size_t n_dir_moves;
+
+    // fanotify
+    int mount_fd;           // для open_by_handle_at
+    uint32_t next_cookie;
+    fh_entry_t **fh_buckets;
+    size_t fh_count;
+};
+
+// Что генерировать для файлов, уже лежащих в новом поддереве
+typedef enum {
+    CATCH_UP_NONE,
+    CATCH_UP_MODIFIED,
+    CATCH_UP_MOVED_TO,
+    CATCH_UP_RENAMED    // каталог переименован внутри дерева: renamed от прежнего пути
+} catch_up_t;
+
+const char *watcher_backend_name(watcher_backend_t backend) {
+    return backend == WATCHER_FANOTIFY ? "fanotify" : "inotify";
+}
+
+bool watcher_parse_backend(const char *name, watcher_backend_t *out) {
+    if (strcmp(name, "inotify") == 0) {
+        *out = WATCHER_INOTIFY;
+        return true;
+    }
+    if (strcmp(name, "fanotify") == 0) {
+        *out = WATCHER_FANOTIFY;
+        return true;
+    }
+    return false;
+}
+
+static bool path_under(const char *path, const char *dir, size_t dir_len) {
+    return strncmp(path, dir, dir_len) == 0 && (path[dir_len] == '\0' || path[dir_len] == '/');
+}
+
+static bool under_root(const watcher_t *w, const char *path) {
+    return path_under(path, w->root, w->root_len);
+}
+
+// ---- Постановка наблюдений и догоняющие события ----
+
+// Результаты одного потока обхода
+typedef struct {
+    int *wds;
+    char **paths;
+    size_t len, cap;
+
+    char **files;   // обычные файлы в новых каталогах (для догоняющих событий)
+    size_t n_files, cap_files;
+
+    uint64_t failed;
+    uint64_t enospc;
+} watch_batch_t;
+
+typedef struct {
+    int inotify_fd;     // -1 — наблюдения не ставим, только собираем файлы
+    bool collect_files;
+    watch_batch_t *per_worker;
+} watch_walk_ctx_t;
+
+static bool push_str(char ***arr, size_t *len, size_t *cap, char *s) {
+    if (*len == *cap) {
+        size_t ncap = *cap ? *cap * 2 : 64;
+        char **grown = realloc(*arr, ncap * sizeof(char *));
+        if (!grown) return false;
+        *arr = grown;
+        *cap = ncap;
+    }
+    (*arr)[(*len)++] = s;
+    return true;
+}
+
+static bool watch_walk_on_dir(void *ctx, unsigned worker, const char *path, int dirfd) {
+    (void)dirfd;
+    watch_walk_ctx_t *wc = ctx;
+    if (wc->inotify_fd < 0) return true;
+
+    watch_batch_t *b = &wc->per_worker[worker];
+
+    int wd = inotify_add_watch(wc->inotify_fd, path, INOTIFY_MASK);
+    if (wd == -1) {
+        if (errno == ENOSPC) b->enospc++;
+        else b->failed++;
+        // Глубже всё равно заходим: вложенные каталоги могут уложиться в лимит
+        return true;
+    }
+
+    if (b->len == b->cap) {
+        size_t ncap = b->cap ? b->cap * 2 : 256;
+        int *wds = realloc(b->wds, ncap * sizeof(int));
+        if (wds) b->wds = wds;
+        char **paths = realloc(b->paths, ncap * sizeof(char *));
+        if (paths) b->paths = paths;
+        if (!wds || !paths) {
+            b->failed++;
+            return true;
+        }
+        b->cap = ncap;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) {
+        b->failed++;
+        return true;
+    }
+    b->wds[b->len] = wd;
+    b->paths[b->len] = copy;
+    b->len++;
+    return true;
+}
+
+static void watch_walk_on_entry(void *ctx, unsigned worker, const char *dir_path, int dirfd,
+                                const char *name, unsigned char d_type) {
+    (void)dirfd;
+    watch_walk_ctx_t *wc = ctx;
+    if (!wc->collect_files || d_type != DT_REG) return;
+
+    watch_batch_t *b = &wc->per_worker[worker];
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", dir_path, name) >= (int)sizeof(path)) return;
+
+    char *copy = strdup(path);
+    if (copy && !push_str(&b->files, &b->n_files, &b->cap_files, copy)) free(copy);
+}
+
+static long read_max_user_watches(void) {
+    FILE *fp = fopen(WATCHER_MAX_USER_WATCHES_FILE, "r");
+    if (!fp) return -1;
+    long max = -1;
+    if (fscanf(fp, "%ld", &max) != 1) max = -1;
+    fclose(fp);
+    return max;
+}
+
+/**
+ * Обходит поддерево root параллельно. Для inotify ставит наблюдение на каждый
+ * каталог; для fanotify только собирает файлы.
+ *
+ * Файлы, уже лежащие в дереве, отдаются получателю событием catch_up: они могли
+ * быть созданы и закрыты между IN_CREATE каталога и установкой наблюдения на
+ * него, или пришли вместе с каталогом, перемещённым извне. Для
+ * CATCH_UP_RENAMED old_root — прежний путь каталога, и каждый файл уходит
+ * парой old_root/<отн. путь> -> root/<отн. путь>.
+ *
+ * @return количество поставленных наблюдений
+ */
+static size_t add_tree(watcher_t *w, const char *root, catch_up_t catch_up,
+                       const char *old_root) {
+    unsigned nthreads = tree_walk_default_threads();
+    watch_batch_t *batches = calloc(nthreads, sizeof(watch_batch_t));
+    if (!batches) return 0;
+
+    watch_walk_ctx_t ctx = {
+        .inotify_fd = w->backend == WATCHER_INOTIFY ? w->fd : -1,
+        .collect_files = catch_up != CATCH_UP_NONE,
+        .per_worker = batches,
+    };
+    tree_walk_ops_t ops = {
+        .on_dir = watch_walk_on_dir,
+        .on_entry = watch_walk_on_entry,
+    };
+
+    watcher_tree_report_t report = { .backend = w->backend, .root = root, .max_watches = -1 };
+    uint64_t started = latency_now_ns();
+    tree_walk_stats_t stats = {0};
+    if (tree_walk_parallel(root, nthreads, &ops, &ctx, &stats) != 0) report.walk_errors++;
+
+    for (unsigned i = 0; i < nthreads; i++) {
+        watch_batch_t *b = &batches[i];
+        for (size_t j = 0; j < b->len; j++) {
+            // Повторный inotify_add_watch на тот же inode возвращает прежний wd —
+            // put просто обновит путь (каталог переместили внутри дерева)
+            if (watch_map_put(&w->watches, b->wds[j], b->paths[j])) report.dirs_added++;
+            free(b->paths[j]);
+        }
+        report.failed += b->failed;
+        report.enospc += b->enospc;
+        free(b->wds);
+        free(b->paths);
+    }
+
+    size_t root_len = strlen(root);
+    for (unsigned i = 0; i < nthreads; i++) {
+        watch_batch_t *b = &batches[i];
+        uint64_t now = latency_now_ns();
+        for (size_t j = 0; j < b->n_files; j++) {
+            char old_path[PATH_MAX];
+            if (catch_up == CATCH_UP_RENAMED &&
+                snprintf(old_path, sizeof(old_path), "%s%s", old_root,
+                         b->files[j] + root_len) < (int)sizeof(old_path)) {
+                w->sink.renamed(w->ctx, old_path, b->files[j], now);
+            } else if (catch_up == CATCH_UP_MOVED_TO || catch_up == CATCH_UP_RENAMED) {
+                w->sink.moved_to(w->ctx, b->files[j], 0, now);
+            } else {
+                w->sink.modified(w->ctx, b->files[j], now);
+            }
+            free(b->files[j]);
+        }
+        report.files_caught_up += b->n_files;
+        free(b->files);
+    }
+    free(batches);
+
+    report.entries = stats.entries;
+    report.walk_errors += stats.errors;
+    report.elapsed_ms = (double)(latency_now_ns() - started) / 1e6;
+    if (w->backend == WATCHER_INOTIFY) {
+        report.watches_in_use = watch_map_count(&w->watches);
+        report.max_watches = read_max_user_watches();
+    }
+    if (w->sink.tree_added) w->sink.tree_added(w->ctx, &report);
+
+    return report.dirs_added;
+}
+
+// ---- inotify ----
+
+static void rm_watch_cb(void *ctx, int wd) {
+    inotify_rm_watch(*(int *)ctx, wd);
+}
+
+// Каталог ушёл по IN_MOVED_FROM: ждём IN_MOVED_TO с тем же cookie
+static void dir_move_push(watcher_t *w, const char *path, uint32_t cookie, uint64_t now) {
+    char *copy = strdup(path);
+    if (!copy) {
+        w->sink.subtree_removed(w->ctx, path, now);
+        return;
+    }
+    if (w->n_dir_moves == DIR_MOVES_MAX) {
+        // Самый старый так и не нашёл пары — ушёл из дерева
+        w->sink.subtree_removed(w->ctx, w->dir_moves[0].path, now);
+        free(w->dir_moves[0].path);
+        memmove(&w->dir_moves[0], &w->dir_moves[1], (DIR_MOVES_MAX - 1) * sizeof(w->dir_moves[0]));
+        w->n_dir_moves--;
+    }
+    w->dir_moves[w->n_dir_moves].cookie = cookie;
+    w->dir_moves[w->n_dir_moves].path = copy;
+    w->n_dir_moves++;
+}
+
+// Прежний путь каталога с этим cookie (передаётся во владение) или NULL
+static char *dir_move_take(watcher_t *w, uint32_t cookie) {
+    for (size_t i = 0; i < w->n_dir_moves; i++) {
+        if (w->dir_moves[i].cookie != cookie) continue;
+        char *path = w->dir_moves[i].path;
+        memmove(&w->dir_moves[i], &w->dir_moves[i + 1],
+                (w->n_dir_moves - i - 1) * sizeof(w->dir_moves[0]));
+        w->n_dir_moves--;
+        return path;
+    }
+    return NULL;
+}
+
+// Ядро ставит IN_MOVED_FROM и IN_MOVED_TO одного rename в очередь подряд,
+// так что к концу вычитанной очереди оставшиеся без пары ушли наружу
+static void dir_moves_expire(watcher_t *w, uint64_t now) {
+    for (size_t i = 0; i < w->n_dir_moves; i++) {
+        w->sink.subtree_removed(w->ctx, w->dir_moves[i].path, now);
+        free(w->dir_moves[i].path);
+    }
+    w->n_dir_moves = 0;
+}
+
+static bool inotify_process(watcher_t *w) {
+    char buffer[INOTIFY_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t len = read(w->fd, buffer, sizeof(buffer));
+
+        if (len == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                // Очередь пуста, возвращаемся в epoll
+                dir_moves_expire(w, latency_now_ns());
+                return true;
+            }
+            return false;
+        }
+
+        // Все события пачки прочитаны в один момент
+        uint64_t read_ns = latency_now_ns();
+
+        for (char *ptr = buffer; ptr < buffer + len;) {
+            struct inotify_event *event = (struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+            w->stats.events++;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                w->stats.overflows++;
+                if (w->sink.overflow) w->sink.overflow(w->ctx);
+                continue;
+            }
+
+            // Каталог удалён или наблюдение снято
+            if (event->mask & IN_IGNORED) {
+                watch_map_remove(&w->watches, event->wd);
+                continue;
+            }
+
+            if (event->len == 0) continue;
+
+            const char *dir = watch_map_get(&w->watches, event->wd);
+            if (!dir) continue;
+
+            char fullpath[PATH_MAX];
+            int res = snprintf(fullpath, sizeof(fullpath), "%s/%s", dir, event->name);
+            if (res < 0 || (size_t)res >= sizeof(fullpath)) {
+                w->stats.dropped++;
+                continue;
+            }
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & IN_CREATE) {
+                    add_tree(w, fullpath, CATCH_UP_MODIFIED, NULL);
+                } else if (event->mask & IN_MOVED_TO) {
+                    // С парой — переименование внутри дерева, файлы уходят
+                    // парами; без пары — каталог пришёл снаружи
+                    char *old_dir = dir_move_take(w, event->cookie);
+                    add_tree(w, fullpath, old_dir ? CATCH_UP_RENAMED : CATCH_UP_MOVED_TO, old_dir);
+                    free(old_dir);
+                } else if (event->mask & IN_MOVED_FROM) {
+                    // Поддерево ушло из-под старого пути; если оно осталось
+                    // в дереве, IN_MOVED_TO поставит наблюдения заново
+                    watch_map_remove_prefix(&w->watches, fullpath, rm_watch_cb, &w->fd);
+                    dir_move_push(w, fullpath, event->cookie, read_ns);
+                }
+                continue;
+            }
+
+            if (event->mask & IN_CLOSE_WRITE) {
+                w->sink.modified(w->ctx, fullpath, read_ns);
+            } else if (event->mask & IN_MOVED_TO) {
+                w->sink.moved_to(w->ctx, fullpath, event->cookie, read_ns);
+            } else if (event->mask & IN_MOVED_FROM) {
+                w->sink.moved_from(w->ctx, fullpath, event->cookie, read_ns);
+            } else if (event->mask & IN_DELETE) {
+                w->sink.deleted(w->ctx, fullpath, read_ns);
+            }
+        }
+    }
+}
+
+static int inotify_open(watcher_t *w) {
+    if (!watch_map_init(&w->watches, 1024)) return ENOMEM;
+
+    w->fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (w->fd == -1) return errno;
+
+    if (add_tree(w, w->root, CATCH_UP_NONE, NULL) == 0) return ENOENT;
+    return 0;
+}
+
+// ---- fanotify ----
+
+static uint64_t fh_hash(int type, const unsigned char *handle, unsigned len) {
+    uint64_t h = 1469598103934665603ull ^ (uint64_t)(unsigned)type;
+    for (unsigned i = 0; i < len; i++) {
+        h ^= handle[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static void fh_cache_clear(watcher_t *w) {
+    for (size_t i = 0; i < FH_CACHE_BUCKETS; i++) {
+        fh_entry_t *e = w->fh_buckets[i];
+        while (e) {
+            fh_entry_t *next = e->next;
+            free(e->path);
+            free(e);
+            e = next;
+        }
+        w->fh_buckets[i] = NULL;
+    }
+    w->fh_count = 0;
+}
+
+// Удаляет из кэша записи, для которых keep() ложно
+static void fh_cache_filter(watcher_t *w, bool (*keep)(const watcher_t *w, const char *path,
+                                                       const char *arg, size_t arg_len),
+                            const char *arg) {
+    size_t arg_len = arg ? strlen(arg) : 0;
+    for (size_t i = 0; i < FH_CACHE_BUCKETS; i++) {
+        fh_entry_t **pp = &w->fh_buckets[i];
+        while (*pp) {
+            fh_entry_t *e = *pp;
+            if (keep(w, e->path, arg, arg_len)) {
+                pp = &e->next;
+                continue;
+            }
+            *pp = e->next;
+            free(e->path);
+            free(e);
+            w->fh_count--;
+        }
+    }
+}
+
+static bool keep_outside_dir(const watcher_t *w, const char *path, const char *dir, size_t len) {
+    (void)w;
+    return !path_under(path, dir, len);
+}
+
+static bool keep_under_root(const watcher_t *w, const char *path, const char *arg, size_t len) {
+    (void)arg;
+    (void)len;
+    return under_root(w, path);
+}
+
+// Каталог dir переименован или удалён: пути его самого и потомков устарели
+static void fh_cache_invalidate(watcher_t *w, const char *dir) {
+    fh_cache_filter(w, keep_outside_dir, dir);
+}
+
+// Каталог пришёл в дерево снаружи: кэшированные пути его потомков указывают
+// за пределы корня. Записи вне корня нужны только чтобы быстро отбрасывать
+// события — их не жалко
+static void fh_cache_drop_outside(watcher_t *w) {
+    fh_cache_filter(w, keep_under_root, NULL);
+}
+
+// Путь каталога по дескриптору или NULL, если каталог уже удалён.
+// Промах — open_by_handle_at + readlink через /proc/self/fd.
+static const char *fh_resolve(watcher_t *w, struct file_handle *fh) {
+    uint64_t h = fh_hash(fh->handle_type, fh->f_handle, fh->handle_bytes);
+    fh_entry_t **bucket = &w->fh_buckets[h & (FH_CACHE_BUCKETS - 1)];
+
+    for (fh_entry_t *e = *bucket; e; e = e->next) {
+        if (e->hash == h && e->type == fh->handle_type && e->len == fh->handle_bytes &&
+            memcmp(e->handle, fh->f_handle, e->len) == 0) {
+            w->stats.handle_cache_hits++;
+            return e->path;
+        }
+    }
+    w->stats.handle_cache_misses++;
+
+    int fd = open_by_handle_at(w->mount_fd, fh, O_PATH | O_CLOEXEC);
+    if (fd == -1) return NULL;
+
+    char link[64];
+    char path[PATH_MAX];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    ssize_t n = readlink(link, path, sizeof(path) - 1);
+    close(fd);
+    if (n <= 0 || n == (ssize_t)sizeof(path) - 1) return NULL;
+    path[n] = '\0';
+
+    // Каталог удалён, но дескриптор ещё открывается
+    static const char deleted[] = " (deleted)";
+    size_t dlen = sizeof(deleted) - 1;
+    if ((size_t)n > dlen && strcmp(path + n - dlen, deleted) == 0) return NULL;
+
+    if (w->fh_count >= FH_CACHE_MAX) fh_cache_clear(w);
+
+    fh_entry_t *e = malloc(sizeof(fh_entry_t) + fh->handle_bytes);
+    if (!e) return NULL;
+    e->path = strdup(path);
+    if (!e->path) {
+        free(e);
+        return NULL;
+    }
+    e->hash = h;
+    e->type = fh->handle_type;
+    e->len = fh->handle_bytes;
+    memcpy(e->handle, fh->f_handle, e->len);
+    e->next = *bucket;
+    *bucket = e;
+    w->fh_count++;
+    return e->path;
+}
+
+// Полный путь из записи DFID_NAME, где бы он ни лежал; false — каталог
+// не найден или путь слишком длинный
+static bool fid_resolve_path(watcher_t *w, const struct fanotify_event_info_fid *fid,
+                             char *out, size_t size) {
+    struct file_handle *fh = (struct file_handle *)fid->handle;
+    const char *name = (const char *)fh->f_handle + fh->handle_bytes;
+
+    const char *dir = fh_resolve(w, fh);
+    if (!dir) {
+        w->stats.dropped++;
+        return false;
+    }
+
+    int res = (strcmp(name, ".") == 0) ? snprintf(out, size, "%s", dir)
+                                       : snprintf(out, size, "%s/%s", dir, name);
+    if (res < 0 || (size_t)res >= size) {
+        w->stats.dropped++;
+        return false;
+    }
+    return true;
+}
+
+// То же, но false и для путей вне корня
+static bool fid_record_path(watcher_t *w, const struct fanotify_event_info_fid *fid,
+                            char *out, size_t size) {
+    if (!fid_resolve_path(w, fid, out, size)) return false;
+    if (!under_root(w, out)) {
+        w->stats.outside_root++;
+        return false;
+    }
+    return true;
+}
+
+// meta — выровненная копия заголовка, event — событие в буфере чтения
+static void fanotify_handle_event(watcher_t *w, const struct fanotify_event_metadata *meta,
+                                  const char *event, uint64_t now) {
+    const struct fanotify_event_info_fid *dfid = NULL, *old_dfid = NULL, *new_dfid = NULL;
+
+    const char *ptr = event + meta->metadata_len;
+    const char *end = event + meta->event_len;
+    while (ptr + sizeof(struct fanotify_event_info_header) <= end) {
+        const struct fanotify_event_info_header *hdr = (const void *)ptr;
+        if (hdr->len == 0 || ptr + hdr->len > end) break;
+
+        switch (hdr->info_type) {
+            case FAN_EVENT_INFO_TYPE_DFID_NAME:     dfid = (const void *)ptr; break;
+            case FAN_EVENT_INFO_TYPE_OLD_DFID_NAME: old_dfid = (const void *)ptr; break;
+            case FAN_EVENT_INFO_TYPE_NEW_DFID_NAME: new_dfid = (const void *)ptr; break;
+            default: break;
+        }
+        ptr += hdr->len;
+    }
+
+    bool is_dir = (meta->mask & FAN_ONDIR) != 0;
+    char path[PATH_MAX];
+    char old_path[PATH_MAX];
+
+    if (meta->mask & FAN_RENAME) {
+        if (!old_dfid || !new_dfid) return;
+
+        if (is_dir) {
+            // Метка на всю ФС: сначала отбрасываем чужие каталоги, и только
+            // потом трогаем кэш — иначе посторонняя активность его вымывает
+            bool have_old = fid_resolve_path(w, old_dfid, old_path, sizeof(old_path));
+            bool have_new = fid_resolve_path(w, new_dfid, path, sizeof(path));
+            bool old_in = have_old && under_root(w, old_path);
+            bool new_in = have_new && under_root(w, path);
+            if (!old_in && !new_in) {
+                w->stats.outside_root++;
+                return;
+            }
+
+            if (old_in) {
+                fh_cache_invalidate(w, old_path);
+            } else if (have_old) {
+                fh_cache_drop_outside(w);
+            } else {
+                // Откуда пришёл каталог, неизвестно
+                fh_cache_clear(w);
+            }
+            // Внутри дерева файлы уходят парами; ушедший наружу каталог
+            // получатель разбирает сам; пришедший снаружи — догоняющие moved_to
+            if (old_in && new_in) {
+                add_tree(w, path, CATCH_UP_RENAMED, old_path);
+            } else if (old_in) {
+                w->sink.subtree_removed(w->ctx, old_path, now);
+            } else {
+                add_tree(w, path, CATCH_UP_MOVED_TO, NULL);
+            }
+            return;
+        }
+
+        bool have_old = fid_record_path(w, old_dfid, old_path, sizeof(old_path));
+        bool have_new = fid_record_path(w, new_dfid, path, sizeof(path));
+
+        uint32_t cookie = 0;
+        if (have_old && have_new) {
+            if (++w->next_cookie == 0) w->next_cookie = 1;
+            cookie = w->next_cookie;
+        }
+        if (have_old) w->sink.moved_from(w->ctx, old_path, cookie, now);
+        if (have_new) w->sink.moved_to(w->ctx, path, cookie, now);
+        return;
+    }
+
+    if (!dfid) return;
+
+    if (is_dir) {
+        if (!fid_record_path(w, dfid, path, sizeof(path))) return;
+
+        if (meta->mask & (FAN_DELETE | FAN_MOVED_FROM)) {
+            fh_cache_invalidate(w, path);
+            // Удалить можно только пустой каталог; ушедший без пары (ядро
+            // без FAN_RENAME) уносит файлы с собой
+            if (meta->mask & FAN_MOVED_FROM) w->sink.subtree_removed(w->ctx, path, now);
+        } else if (meta->mask & FAN_MOVED_TO) {
+            // Без FAN_RENAME источник неизвестен: если снаружи, устарели
+            // записи вне корня; если изнутри — FAN_MOVED_FROM уже их убрал
+            fh_cache_drop_outside(w);
+            add_tree(w, path, CATCH_UP_MOVED_TO, NULL);
+        }
+        return;
+    }
+
+    if (!fid_record_path(w, dfid, path, sizeof(path))) return;
+
+    if (meta->mask & FAN_CLOSE_WRITE) {
+        w->sink.modified(w->ctx, path, now);
+    } else if (meta->mask & FAN_MOVED_TO) {
+        w->sink.moved_to(w->ctx, path, 0, now);
+    } else if (meta->mask & FAN_MOVED_FROM) {
+        w->sink.moved_from(w->ctx, path, 0, now);
+    } else if (meta->mask & FAN_DELETE) {
+        w->sink.deleted(w->ctx, path, now);
+    }
+}
+
+static bool fanotify_process(watcher_t *w) {
+    char buffer[FANOTIFY_BUFFER_SIZE]
+        __attribute__((aligned(__alignof__(struct fanotify_event_metadata))));
+
+    for (;;) {
+        ssize_t len = read(w->fd, buffer, sizeof(buffer));
+
+        if (len == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) return true;
+            return false;
+        }
+
+        uint64_t read_ns = latency_now_ns();
+
+        // Записи с именами выровнены ядром только на 4 байта, а в заголовке
+        // есть 64-битная маска: читаем его копией, не через указатель в буфер
+        for (size_t off = 0; off + FAN_EVENT_METADATA_LEN <= (size_t)len;) {
+            struct fanotify_event_metadata meta;
+            memcpy(&meta, buffer + off, sizeof(meta));
+            if (meta.event_len < FAN_EVENT_METADATA_LEN || off + meta.event_len > (size_t)len) break;
+            if (meta.vers != FANOTIFY_METADATA_VERSION) return false;
+            w->stats.events++;
+
+            // В режиме FID дескриптора нет, но закрываем на всякий случай
+            if (meta.fd >= 0) close(meta.fd);
+
+            if (meta.mask & FAN_Q_OVERFLOW) {
+                w->stats.overflows++;
+                if (w->sink.overflow) w->sink.overflow(w->ctx);
+            } else {
+                fanotify_handle_event(w, &meta, buffer + off, read_ns);
+            }
+            off += meta.event_len;
+        }
+    }
+}
+
+static int fanotify_open(watcher_t *w) {
+    w->fh_buckets = calloc(FH_CACHE_BUCKETS, sizeof(fh_entry_t *));
+    if (!w->fh_buckets) return ENOMEM;
+
+    w->mount_fd = open(w->root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (w->mount_fd == -1) return errno;
+
+    w->fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME,
+                          O_RDONLY | O_LARGEFILE);
+    if (w->fd == -1) return errno;
+
+    if (fanotify_mark(w->fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                      FANOTIFY_BASE_MASK | FAN_RENAME, AT_FDCWD, w->root) == 0) {
+        return 0;
+    }
+    if (errno != EINVAL) return errno;
+
+    if (fanotify_mark(w->fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                      FANOTIFY_BASE_MASK | FAN_MOVED_FROM | FAN_MOVED_TO,
+                      AT_FDCWD, w->root) == -1) {
+        return errno;
+    }
+    return 0;
+}
+
+// ---- Общий интерфейс ----
+
+watcher_t *watcher_open(watcher_backend_t backend, const char *root,
+                        const watcher_sink_t *sink, void *ctx, int *err) {
+    watcher_t *w = calloc(1, sizeof(watcher_t));
+    if (!w) {
+        if (err) *err = ENOMEM;
+        return NULL;
+    }
+    w->backend = backend;
+    w->fd = -1;
+    w->mount_fd = -1;
+    w->sink = *sink;
+    w->ctx = ctx;
+
+    // Корень без завершающего '/': префиксное сравнение путей
+    w->root = strdup(root);
+    if (!w->root) {
+        free(w);
+        if (err) *err = ENOMEM;
+        return NULL;
+    }
+    w->root_len = strlen(w->root);
+    while (w->root_len > 1 && w->root[w->root_len - 1] == '/') w->root[--w->root_len] = '\0';
+
+    int rc = backend == WATCHER_FANOTIFY ? fanotify_open(w) : inotify_open(w);
+    if (rc != 0) {
+        watcher_close(w);
+        if (err) *err = rc;
+        return NULL;
+    }
+    return w;
+}
+
+void watcher_close(watcher_t *w) {
+    if (!w) return;
+    if (w->fd != -1) close(w->fd);
+    if (w->mount_fd != -1) close(w->mount_fd);
+    if (w->backend == WATCHER_INOTIFY) watch_map_destroy(&w->watches);
+    for (size_t i = 0; i < w->n_dir_moves; i++) free(w->dir_moves[i].path);
+    if (w->fh_buckets) {
+        fh_cache_clear(w);
+        free(w->fh_buckets);
+    }
+    free(w->root);
+    free(w);
+}
+
+watcher_backend_t watcher_backend(const watcher_t *w) {
+    return w->backend;
+}
+
+int watcher_fd(const watcher_t *w) {
+    return w->fd;
+}
+
+bool watcher_process(watcher_t *w) {
+    return w->backend == WATCHER_FANOTIFY ? fanotify_process(w) : inotify_process(w);
+}
+
+void watcher_rescan(watcher_t *w) {
+    if (w->backend == WATCHER_INOTIFY) {
+        add_tree(w, w->root, CATCH_UP_NONE, NULL);
+    } else {
+        // Пока события терялись, каталоги могли переехать
+        fh_cache_clear(w);
+    }
+}
+
+watcher_stats_t watcher_get_stats(const watcher_t *w) {
+    return w->stats;
+}
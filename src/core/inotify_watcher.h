@@ -0,0 +1,105 @@
+#ifndef INOTIFY_WATCHER_H
+#define INOTIFY_WATCHER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Наблюдение за деревом каталогов с двумя реализациями:
+//
+//  - inotify: по наблюдению на каждый каталог, рекурсивно, с догоняющими
+//    событиями для файлов в новых каталогах. Ограничено max_user_watches.
+//  - fanotify: одна метка FAN_MARK_FILESYSTEM на всю файловую систему,
+//    события с FAN_REPORT_DFID_NAME (дескриптор каталога + имя). Дескрипторы
+//    переводятся в пути через кэш; события вне корня отбрасываются.
+//    Нужен CAP_SYS_ADMIN.
+//
+// Обе отдают одни и те же сырые события через watcher_sink_t. Модуль не
+// логирует: отчёты о постановке наблюдений уходят в sink->tree_added,
+// счётчики — через watcher_get_stats().
+
+#define WATCHER_MAX_USER_WATCHES_FILE "/proc/sys/fs/inotify/max_user_watches"
+
+typedef enum {
+    WATCHER_INOTIFY,
+    WATCHER_FANOTIFY
+} watcher_backend_t;
+
+typedef struct {
+    watcher_backend_t backend;
+    const char *root;
+    size_t dirs_added;     // новых наблюдений (только inotify)
+    uint64_t failed;       // каталогов, на которые не удалось поставить наблюдение
+    uint64_t enospc;       // из них — по исчерпанию max_user_watches
+    uint64_t entries;      // записей, найденных обходом
+    uint64_t walk_errors;
+    uint64_t files_caught_up;
+    double elapsed_ms;
+    size_t watches_in_use;
+    long max_watches;      // -1 — неизвестно или не применимо
+} watcher_tree_report_t;
+
+// Получатель сырых событий. cookie связывает moved_from и moved_to одного
+// переименования; 0 — пары нет. Все колбэки вызываются из watcher_process()
+// и watcher_rescan(), кроме tree_added и overflow все обязательны.
+typedef struct {
+    void (*modified)(void *ctx, const char *path, uint64_t now_ns);
+    void (*deleted)(void *ctx, const char *path, uint64_t now_ns);
+    void (*moved_from)(void *ctx, const char *path, uint32_t cookie, uint64_t now_ns);
+    void (*moved_to)(void *ctx, const char *path, uint32_t cookie, uint64_t now_ns);
+
+    // Файл каталога, переименованного внутри дерева: пара уже сопоставлена
+    void (*renamed)(void *ctx, const char *old_path, const char *path, uint64_t now_ns);
+
+    // Каталог ушёл из дерева целиком (перемещён наружу). Файлы под ним по
+    // отдельности не сообщаются: их прежние пути знает только получатель
+    void (*subtree_removed)(void *ctx, const char *dir, uint64_t now_ns);
+
+    // Очередь ядра переполнена, события потеряны
+    void (*overflow)(void *ctx);
+
+    // Поставлены наблюдения на поддерево (в том числе при старте)
+    void (*tree_added)(void *ctx, const watcher_tree_report_t *report);
+} watcher_sink_t;
+
+typedef struct {
+    uint64_t events;
+    uint64_t overflows;
+    uint64_t dropped;          // слишком длинный путь или каталог уже удалён
+    uint64_t outside_root;     // fanotify: события файловой системы вне корня
+    uint64_t handle_cache_hits;
+    uint64_t handle_cache_misses;
+} watcher_stats_t;
+
+typedef struct watcher watcher_t;
+
+const char *watcher_backend_name(watcher_backend_t backend);
+
+// "inotify" / "fanotify"; false — неизвестное имя
+bool watcher_parse_backend(const char *name, watcher_backend_t *out);
+
+/**
+ * @brief Начинает наблюдение за деревом root.
+ *
+ * @param err код errno при неудаче (например, EPERM для fanotify без прав)
+ * @return наблюдатель или NULL
+ */
+watcher_t *watcher_open(watcher_backend_t backend, const char *root,
+                        const watcher_sink_t *sink, void *ctx, int *err);
+void watcher_close(watcher_t *w);
+
+watcher_backend_t watcher_backend(const watcher_t *w);
+
+// Дескриптор для epoll: читаем, когда есть события
+int watcher_fd(const watcher_t *w);
+
+// Вычитывает и разбирает все доступные события. false — фатальная ошибка чтения.
+bool watcher_process(watcher_t *w);
+
+// Восстановление после переполнения: inotify заново ставит наблюдения на
+// каталоги, созданные, пока события терялись
+void watcher_rescan(watcher_t *w);
+
+watcher_stats_t watcher_get_stats(const watcher_t *w);
+
+#endif // INOTIFY_WATCHER_H
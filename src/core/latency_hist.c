@@ -0,0 +1,86 @@
+// core/latency_hist.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "latency_hist.h"
+
+#define SUB_COUNT (1u << LATENCY_HIST_SUB_BITS)
+
+static unsigned bucket_index(uint64_t ns) {
+    if (ns < SUB_COUNT) return (unsigned)ns;
+
+    unsigned msb = 63 - (unsigned)__builtin_clzll(ns);
+    unsigned shift = msb - LATENCY_HIST_SUB_BITS;
+    unsigned sub = (unsigned)(ns >> shift) & (SUB_COUNT - 1);
+    unsigned idx = SUB_COUNT + shift * SUB_COUNT + sub;
+
+    return idx < LATENCY_HIST_BUCKETS ? idx : LATENCY_HIST_BUCKETS - 1;
+}
+
+static uint64_t bucket_upper_bound(unsigned idx) {
+    if (idx < SUB_COUNT) return idx;
+
+    unsigned shift = (idx - SUB_COUNT) / SUB_COUNT;
+    unsigned sub = (idx - SUB_COUNT) % SUB_COUNT;
+    return (((uint64_t)(SUB_COUNT + sub + 1)) << shift) - 1;
+}
+
+void latency_hist_reset(latency_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void latency_hist_record(latency_hist_t *h, uint64_t ns) {
+    h->buckets[bucket_index(ns)]++;
+    h->count++;
+    h->sum_ns += ns;
+    if (ns > h->max_ns) h->max_ns = ns;
+}
+
+void latency_hist_merge(latency_hist_t *dst, const latency_hist_t *src) {
+    for (unsigned i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum_ns += src->sum_ns;
+    if (src->max_ns > dst->max_ns) dst->max_ns = src->max_ns;
+}
+
+uint64_t latency_hist_percentile(const latency_hist_t *h, double p) {
+    if (h->count == 0) return 0;
+
+    uint64_t rank = (uint64_t)((p / 100.0) * (double)h->count + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > h->count) rank = h->count;
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = bucket_upper_bound(i);
+            return upper < h->max_ns ? upper : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+int latency_hist_format(const latency_hist_t *h, char *buf, size_t len) {
+    return snprintf(buf, len,
+                    "count=%llu mean=%.3fms p50=%.3fms p90=%.3fms p99=%.3fms p999=%.3fms max=%.3fms",
+                    (unsigned long long)h->count,
+                    h->count ? (double)h->sum_ns / (double)h->count / 1e6 : 0.0,
+                    latency_hist_percentile(h, 50.0) / 1e6,
+                    latency_hist_percentile(h, 90.0) / 1e6,
+                    latency_hist_percentile(h, 99.0) / 1e6,
+                    latency_hist_percentile(h, 99.9) / 1e6,
+                    h->max_ns / 1e6);
+}
+
+uint64_t latency_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
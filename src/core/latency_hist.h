@@ -0,0 +1,44 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Лог-линейная гистограмма задержек: 4 подкорзины на каждую степень
+// двойки, относительная погрешность не хуже 25%. Диапазон — до ~2 часов.
+//
+// Для журнала демона за интервал: обычная структура под замком
+// вызывающего, сбрасывается после каждой сводки и помнит точный максимум.
+// Накопительные гистограммы для Prometheus у сервера — utils/metrics.h;
+// демон реестр метрик не линкует и не экспортирует.
+#define LATENCY_HIST_SUB_BITS 2
+#define LATENCY_HIST_BUCKETS  168
+
+typedef struct {
+    uint64_t buckets[LATENCY_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+} latency_hist_t;
+
+void latency_hist_reset(latency_hist_t *h);
+
+// Добавляет одно измерение в наносекундах
+void latency_hist_record(latency_hist_t *h, uint64_t ns);
+
+// Складывает src в dst (для агрегации по потокам)
+void latency_hist_merge(latency_hist_t *dst, const latency_hist_t *src);
+
+// Верхняя граница корзины, в которую попадает перцентиль p (0..100)
+uint64_t latency_hist_percentile(const latency_hist_t *h, double p);
+
+/**
+ * @brief Форматирует сводку "count=.. p50=.. p90=.. p99=.. p999=.. max=.." в миллисекундах.
+ * @return длина строки как у snprintf
+ */
+int latency_hist_format(const latency_hist_t *h, char *buf, size_t len);
+
+// Монотонное время в наносекундах (те же часы, что metrics_now_ns)
+uint64_t latency_now_ns(void);
+
+#endif // LATENCY_HIST_H
@@ -0,0 +1,178 @@
+// core/reconcile.c
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "reconcile.h"
+
+bool file_state_set_add(file_state_set_t *set, const char *path, int64_t size, int64_t mtime_ns) {
+    if (set->len == set->cap) {
+        size_t ncap = set->cap ? set->cap * 2 : 1024;
+        file_state_t *grown = realloc(set->items, ncap * sizeof(file_state_t));
+        if (!grown) return false;
+        set->items = grown;
+        set->cap = ncap;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) return false;
+
+    set->items[set->len++] = (file_state_t){
+        .path = copy,
+        .size = size,
+        .mtime_ns = mtime_ns,
+    };
+    return true;
+}
+
+static int cmp_state(const void *a, const void *b) {
+    return strcmp(((const file_state_t *)a)->path, ((const file_state_t *)b)->path);
+}
+
+void file_state_set_sort(file_state_set_t *set) {
+    if (set->len < 2) return;
+    qsort(set->items, set->len, sizeof(file_state_t), cmp_state);
+
+    size_t out = 1;
+    for (size_t i = 1; i < set->len; i++) {
+        if (strcmp(set->items[out - 1].path, set->items[i].path) == 0) {
+            free(set->items[i].path);
+            continue;
+        }
+        set->items[out++] = set->items[i];
+    }
+    set->len = out;
+}
+
+void file_state_set_free(file_state_set_t *set) {
+    for (size_t i = 0; i < set->len; i++) free(set->items[i].path);
+    free(set->items);
+    set->items = NULL;
+    set->len = set->cap = 0;
+}
+
+// --- сканирование ---
+
+typedef struct {
+    file_state_set_t *per_worker;
+    uint64_t *failed;
+} scan_ctx_t;
+
+static void scan_on_entry(void *ctx, unsigned worker, const char *dir_path, int dirfd,
+                          const char *name, unsigned char d_type) {
+    scan_ctx_t *sc = ctx;
+
+    // Симлинки, сокеты и прочее в обмене не участвуют
+    if (d_type != DT_REG && d_type != DT_UNKNOWN) return;
+
+    struct stat st;
+    if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        // Файл исчез между getdents и stat — это не ошибка, его просто нет
+        return;
+    }
+    if (!S_ISREG(st.st_mode)) return;
+
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", dir_path, name) >= (int)sizeof(path)) {
+        sc->failed[worker]++;
+        return;
+    }
+
+    int64_t mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    if (!file_state_set_add(&sc->per_worker[worker], path, (int64_t)st.st_size, mtime_ns)) {
+        sc->failed[worker]++;
+    }
+}
+
+int reconcile_scan(const char *root, unsigned nthreads,
+                   file_state_set_t *out, tree_walk_stats_t *stats) {
+    if (nthreads == 0) nthreads = 1;
+
+    file_state_set_t *sets = calloc(nthreads, sizeof(file_state_set_t));
+    uint64_t *failed = calloc(nthreads, sizeof(uint64_t));
+    if (!sets || !failed) {
+        free(sets);
+        free(failed);
+        return -1;
+    }
+
+    scan_ctx_t ctx = { .per_worker = sets, .failed = failed };
+    tree_walk_ops_t ops = { .on_entry = scan_on_entry };
+    tree_walk_stats_t ws = {0};
+
+    int rc = tree_walk_parallel(root, nthreads, &ops, &ctx, &ws);
+
+    // Сливаем снимки потоков в один массив без копирования строк
+    size_t total = 0;
+    for (unsigned w = 0; w < nthreads; w++) {
+        total += sets[w].len;
+        ws.errors += failed[w];
+    }
+
+    memset(out, 0, sizeof(*out));
+    if (rc == 0 && total > 0) {
+        out->items = malloc(total * sizeof(file_state_t));
+        if (!out->items) rc = -1;
+    }
+
+    for (unsigned w = 0; w < nthreads; w++) {
+        if (rc == 0 && sets[w].len > 0) {
+            memcpy(out->items + out->len, sets[w].items, sets[w].len * sizeof(file_state_t));
+            out->len += sets[w].len;
+            free(sets[w].items);
+        } else {
+            file_state_set_free(&sets[w]);
+        }
+    }
+    out->cap = out->len;
+    free(sets);
+    free(failed);
+
+    if (stats) *stats = ws;
+    if (rc != 0) return -1;
+
+    file_state_set_sort(out);
+    return 0;
+}
+
+// --- сравнение ---
+
+reconcile_stats_t reconcile_diff(const file_state_set_t *recorded,
+                                 const file_state_set_t *actual,
+                                 reconcile_fn fn, void *ctx) {
+    reconcile_stats_t rs = {0};
+    size_t i = 0, j = 0;
+
+    while (i < recorded->len || j < actual->len) {
+        int cmp;
+        if (i == recorded->len) cmp = 1;
+        else if (j == actual->len) cmp = -1;
+        else cmp = strcmp(recorded->items[i].path, actual->items[j].path);
+
+        if (cmp < 0) {
+            rs.deleted++;
+            fn(ctx, RECONCILE_DELETED, &recorded->items[i++]);
+        } else if (cmp > 0) {
+            rs.created++;
+            fn(ctx, RECONCILE_CREATED, &actual->items[j++]);
+        } else {
+            const file_state_t *r = &recorded->items[i++];
+            const file_state_t *a = &actual->items[j++];
+            if (r->size != a->size || r->mtime_ns != a->mtime_ns) {
+                rs.modified++;
+                fn(ctx, RECONCILE_MODIFIED, a);
+            } else {
+                rs.unchanged++;
+            }
+        }
+    }
+
+    return rs;
+}
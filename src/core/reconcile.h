@@ -0,0 +1,76 @@
+#ifndef RECONCILE_H
+#define RECONCILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree_walk.h"
+
+// Сверка фактического состояния дерева с записанным в MongoDB.
+// Нужна после переполнения очереди inotify (события потеряны) и при
+// старте демона (изменения, сделанные пока он не работал).
+//
+// Оба снимка — массивы, отсортированные по пути; сравнение — слияние
+// за один проход без хеш-таблиц.
+
+typedef struct {
+    char *path;
+    int64_t size;     // -1 — размер неизвестен (старые документы без state)
+    int64_t mtime_ns;
+} file_state_t;
+
+typedef struct {
+    file_state_t *items;
+    size_t len;
+    size_t cap;
+} file_state_set_t;
+
+typedef enum {
+    RECONCILE_CREATED,
+    RECONCILE_MODIFIED,
+    RECONCILE_DELETED
+} reconcile_change_t;
+
+typedef struct {
+    uint64_t created;
+    uint64_t modified;
+    uint64_t deleted;
+    uint64_t unchanged;
+} reconcile_stats_t;
+
+// Колбэк расхождения; для RECONCILE_DELETED st — записанное состояние
+typedef void (*reconcile_fn)(void *ctx, reconcile_change_t change, const file_state_t *st);
+
+// Добавляет запись (путь копируется)
+bool file_state_set_add(file_state_set_t *set, const char *path, int64_t size, int64_t mtime_ns);
+
+// Сортирует по пути и схлопывает повторы одного пути
+void file_state_set_sort(file_state_set_t *set);
+
+void file_state_set_free(file_state_set_t *set);
+
+/**
+ * @brief Снимок обычных файлов дерева root параллельным обходом.
+ *
+ * Каталоги читаются через getdents64, атрибуты — fstatat относительно
+ * dirfd каталога, так что путь не разбирается ядром заново для каждого файла.
+ *
+ * @param out   результат, уже отсортированный по пути
+ * @param stats статистика обхода (может быть NULL)
+ * @return 0 при успехе, -1 если дерево не удалось обойти
+ */
+int reconcile_scan(const char *root, unsigned nthreads,
+                   file_state_set_t *out, tree_walk_stats_t *stats);
+
+/**
+ * @brief Сравнивает записанное состояние с фактическим.
+ *
+ * Файл есть только в actual — CREATED, только в recorded — DELETED,
+ * в обоих с другим размером или mtime — MODIFIED.
+ */
+reconcile_stats_t reconcile_diff(const file_state_set_t *recorded,
+                                 const file_state_set_t *actual,
+                                 reconcile_fn fn, void *ctx);
+
+#endif // RECONCILE_H
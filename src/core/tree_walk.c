@@ -0,0 +1,270 @@
+// core/tree_walk.c
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "tree_walk.h"
+
+#define GETDENTS_BUF_SIZE (64 * 1024)
+#define MAX_WALK_THREADS  64
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    // Стек каталогов к обходу (LIFO — меньше памяти на широких деревьях)
+    char **stack;
+    size_t stack_len;
+    size_t stack_cap;
+
+    unsigned active; // потоков, обрабатывающих каталог прямо сейчас
+    bool failed;
+
+    const tree_walk_ops_t *ops;
+    void *ctx;
+} walk_state_t;
+
+typedef struct {
+    walk_state_t *state;
+    unsigned id;
+    tree_walk_stats_t stats;
+} walk_worker_t;
+
+static bool push_locked(walk_state_t *st, char *path) {
+    if (st->stack_len == st->stack_cap) {
+        size_t cap = st->stack_cap ? st->stack_cap * 2 : 1024;
+        char **grown = realloc(st->stack, cap * sizeof(char *));
+        if (!grown) return false;
+        st->stack = grown;
+        st->stack_cap = cap;
+    }
+    st->stack[st->stack_len++] = path;
+    return true;
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t dl = strlen(dir), nl = strlen(name);
+    if (dl + 1 + nl + 1 > PATH_MAX) return NULL;
+
+    char *p = malloc(dl + 1 + nl + 1);
+    if (!p) return NULL;
+    memcpy(p, dir, dl);
+    p[dl] = '/';
+    memcpy(p + dl + 1, name, nl + 1);
+    return p;
+}
+
+// Читает один каталог; найденные подкаталоги складывает в children
+static void walk_one(walk_worker_t *w, const char *path, char ***children,
+                     size_t *n_children, size_t *cap_children, char *buf) {
+    walk_state_t *st = w->state;
+
+    int dirfd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dirfd == -1) {
+        w->stats.errors++;
+        return;
+    }
+
+    w->stats.dirs++;
+
+    if (st->ops->on_dir && !st->ops->on_dir(st->ctx, w->id, path, dirfd)) {
+        close(dirfd);
+        return;
+    }
+
+    for (;;) {
+        long n = syscall(SYS_getdents64, dirfd, buf, GETDENTS_BUF_SIZE);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            w->stats.errors++;
+            break;
+        }
+        if (n == 0) break;
+
+        for (long off = 0; off < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+            off += d->d_reclen;
+
+            const char *name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+
+            unsigned char type = d->d_type;
+            if (type == DT_UNKNOWN) {
+                // Некоторые ФС не заполняют d_type
+                struct stat sb;
+                if (fstatat(dirfd, name, &sb, AT_SYMLINK_NOFOLLOW) == 0) {
+                    type = S_ISDIR(sb.st_mode) ? DT_DIR :
+                           S_ISREG(sb.st_mode) ? DT_REG :
+                           S_ISLNK(sb.st_mode) ? DT_LNK : DT_UNKNOWN;
+                }
+            }
+
+            if (type == DT_DIR) {
+                char *child = join_path(path, name);
+                if (!child) {
+                    w->stats.errors++;
+                    continue;
+                }
+                if (*n_children == *cap_children) {
+                    size_t cap = *cap_children ? *cap_children * 2 : 64;
+                    char **grown = realloc(*children, cap * sizeof(char *));
+                    if (!grown) {
+                        free(child);
+                        w->stats.errors++;
+                        continue;
+                    }
+                    *children = grown;
+                    *cap_children = cap;
+                }
+                (*children)[(*n_children)++] = child;
+            } else {
+                w->stats.entries++;
+                if (st->ops->on_entry) {
+                    st->ops->on_entry(st->ctx, w->id, path, dirfd, name, type);
+                }
+            }
+        }
+    }
+
+    close(dirfd);
+}
+
+static void *walk_worker(void *arg) {
+    walk_worker_t *w = arg;
+    walk_state_t *st = w->state;
+
+    char *buf = malloc(GETDENTS_BUF_SIZE);
+    char **children = NULL;
+    size_t n_children = 0, cap_children = 0;
+
+    if (!buf) {
+        pthread_mutex_lock(&st->lock);
+        st->failed = true;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&st->lock);
+    for (;;) {
+        while (st->stack_len == 0 && st->active > 0 && !st->failed) {
+            pthread_cond_wait(&st->cond, &st->lock);
+        }
+        if (st->stack_len == 0 || st->failed) {
+            // Работы нет и никто не может её добавить — обход завершён
+            pthread_cond_broadcast(&st->cond);
+            break;
+        }
+
+        char *path = st->stack[--st->stack_len];
+        st->active++;
+        pthread_mutex_unlock(&st->lock);
+
+        n_children = 0;
+        walk_one(w, path, &children, &n_children, &cap_children, buf);
+        free(path);
+
+        pthread_mutex_lock(&st->lock);
+        st->active--;
+        for (size_t i = 0; i < n_children; i++) {
+            if (!push_locked(st, children[i])) {
+                free(children[i]);
+                w->stats.errors++;
+            }
+        }
+        if (n_children > 0 || st->active == 0) {
+            pthread_cond_broadcast(&st->cond);
+        }
+    }
+    pthread_mutex_unlock(&st->lock);
+
+    free(children);
+    free(buf);
+    return NULL;
+}
+
+int tree_walk_parallel(const char *root, unsigned nthreads,
+                       const tree_walk_ops_t *ops, void *ctx,
+                       tree_walk_stats_t *stats) {
+    if (!root || !ops) return -1;
+    if (nthreads == 0) nthreads = 1;
+    if (nthreads > MAX_WALK_THREADS) nthreads = MAX_WALK_THREADS;
+
+    walk_state_t st = { .ops = ops, .ctx = ctx };
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.cond, NULL);
+
+    char *root_copy = strdup(root);
+    if (!root_copy || !push_locked(&st, root_copy)) {
+        free(root_copy);
+        pthread_mutex_destroy(&st.lock);
+        pthread_cond_destroy(&st.cond);
+        return -1;
+    }
+
+    walk_worker_t workers[MAX_WALK_THREADS];
+    pthread_t tids[MAX_WALK_THREADS];
+    unsigned started = 0;
+
+    for (unsigned i = 0; i < nthreads; i++) {
+        workers[i] = (walk_worker_t){ .state = &st, .id = i };
+        // Первый поток — вызывающий, остальные создаём
+        if (i == 0) continue;
+        if (pthread_create(&tids[i], NULL, walk_worker, &workers[i]) != 0) break;
+        started = i;
+    }
+
+    walk_worker(&workers[0]);
+
+    for (unsigned i = 1; i <= started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    tree_walk_stats_t total = {0};
+    for (unsigned i = 0; i <= started; i++) {
+        total.dirs += workers[i].stats.dirs;
+        total.entries += workers[i].stats.entries;
+        total.errors += workers[i].stats.errors;
+    }
+    if (stats) *stats = total;
+
+    // При сбое в стеке могли остаться необработанные пути
+    for (size_t i = 0; i < st.stack_len; i++) free(st.stack[i]);
+    free(st.stack);
+
+    pthread_mutex_destroy(&st.lock);
+    pthread_cond_destroy(&st.cond);
+
+    return (st.failed || total.dirs == 0) ? -1 : 0;
+}
+
+unsigned tree_walk_default_threads(void) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) ncpu = 1;
+
+    long n = ncpu * 2;
+    if (n < 4) n = 4;
+    if (n > 32) n = 32;
+    return (unsigned)n;
+}
@@ -0,0 +1,42 @@
+#ifndef TREE_WALK_H
+#define TREE_WALK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Параллельный обход дерева каталогов пулом потоков. Каталоги читаются
+// через getdents64 большими блоками, колбэки получают dirfd для *at()-вызовов.
+// Символические ссылки на каталоги не разыменовываются.
+
+typedef struct {
+    // Вызывается для каждого каталога до чтения его содержимого.
+    // Вернуть false, чтобы не заходить в каталог. Может быть NULL.
+    bool (*on_dir)(void *ctx, unsigned worker, const char *path, int dirfd);
+
+    // Вызывается для каждой записи, не являющейся каталогом. Может быть NULL.
+    void (*on_entry)(void *ctx, unsigned worker, const char *dir_path, int dirfd,
+                     const char *name, unsigned char d_type);
+} tree_walk_ops_t;
+
+typedef struct {
+    uint64_t dirs;
+    uint64_t entries;
+    uint64_t errors;
+} tree_walk_stats_t;
+
+/**
+ * @brief Обходит дерево root в nthreads потоках.
+ *
+ * Колбэки вызываются конкурентно; номер потока worker (0..nthreads-1)
+ * позволяет вести данные по потокам без блокировок.
+ *
+ * @return 0 при успехе, -1 если root не удалось открыть или создать потоки
+ */
+int tree_walk_parallel(const char *root, unsigned nthreads,
+                       const tree_walk_ops_t *ops, void *ctx,
+                       tree_walk_stats_t *stats);
+
+// Разумное число потоков для обхода: обход упирается в I/O, поэтому больше ядер
+unsigned tree_walk_default_threads(void);
+
+#endif // TREE_WALK_H
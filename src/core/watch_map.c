@@ -0,0 +1,156 @@
+// core/watch_map.c
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "watch_map.h"
+
+#define SLOT_EMPTY    -1
+#define SLOT_DELETED  -2
+
+static size_t slot_of(const watch_map_t *m, int wd) {
+    // Мультипликативное хеширование: wd выдаются ядром подряд
+    return (size_t)(((uint32_t)wd * 2654435769u)) & (m->cap - 1);
+}
+
+static bool alloc_slots(watch_map_t *m, size_t cap) {
+    m->slots = malloc(cap * sizeof(watch_slot_t));
+    if (!m->slots) return false;
+    for (size_t i = 0; i < cap; i++) {
+        m->slots[i].wd = SLOT_EMPTY;
+        m->slots[i].path = NULL;
+    }
+    m->cap = cap;
+    m->count = 0;
+    m->tombstones = 0;
+    return true;
+}
+
+bool watch_map_init(watch_map_t *m, size_t expected) {
+    size_t cap = 64;
+    while (cap < expected * 2) cap <<= 1;
+    return alloc_slots(m, cap);
+}
+
+void watch_map_destroy(watch_map_t *m) {
+    if (!m->slots) return;
+    for (size_t i = 0; i < m->cap; i++) {
+        if (m->slots[i].wd >= 0) free(m->slots[i].path);
+    }
+    free(m->slots);
+    m->slots = NULL;
+    m->cap = m->count = m->tombstones = 0;
+}
+
+// Вставка без проверки заполненности; владение path передаётся таблице
+static void insert_owned(watch_map_t *m, int wd, char *path) {
+    size_t i = slot_of(m, wd);
+    size_t first_deleted = SIZE_MAX;
+
+    for (;;) {
+        watch_slot_t *s = &m->slots[i];
+        if (s->wd == wd) {
+            free(s->path);
+            s->path = path;
+            return;
+        }
+        if (s->wd == SLOT_DELETED && first_deleted == SIZE_MAX) {
+            first_deleted = i;
+        }
+        if (s->wd == SLOT_EMPTY) {
+            if (first_deleted != SIZE_MAX) {
+                s = &m->slots[first_deleted];
+                m->tombstones--;
+            }
+            s->wd = wd;
+            s->path = path;
+            m->count++;
+            return;
+        }
+        i = (i + 1) & (m->cap - 1);
+    }
+}
+
+static bool rehash(watch_map_t *m, size_t cap) {
+    watch_map_t fresh;
+    if (!alloc_slots(&fresh, cap)) return false;
+
+    for (size_t i = 0; i < m->cap; i++) {
+        if (m->slots[i].wd >= 0) {
+            insert_owned(&fresh, m->slots[i].wd, m->slots[i].path);
+        }
+    }
+    free(m->slots);
+    *m = fresh;
+    return true;
+}
+
+bool watch_map_put(watch_map_t *m, int wd, const char *path) {
+    if (wd < 0 || !path) return false;
+
+    // Держим заполнение (вместе с удалёнными) не выше 70%
+    if ((m->count + m->tombstones + 1) * 10 > m->cap * 7) {
+        size_t cap = (m->count + 1) * 10 > m->cap * 5 ? m->cap * 2 : m->cap;
+        if (!rehash(m, cap)) return false;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) return false;
+    insert_owned(m, wd, copy);
+    return true;
+}
+
+static watch_slot_t *find_slot(const watch_map_t *m, int wd) {
+    if (wd < 0 || !m->slots) return NULL;
+
+    size_t i = slot_of(m, wd);
+    for (size_t probes = 0; probes < m->cap; probes++) {
+        watch_slot_t *s = &m->slots[i];
+        if (s->wd == wd) return s;
+        if (s->wd == SLOT_EMPTY) return NULL;
+        i = (i + 1) & (m->cap - 1);
+    }
+    return NULL;
+}
+
+const char *watch_map_get(const watch_map_t *m, int wd) {
+    watch_slot_t *s = find_slot(m, wd);
+    return s ? s->path : NULL;
+}
+
+bool watch_map_remove(watch_map_t *m, int wd) {
+    watch_slot_t *s = find_slot(m, wd);
+    if (!s) return false;
+
+    free(s->path);
+    s->path = NULL;
+    s->wd = SLOT_DELETED;
+    m->count--;
+    m->tombstones++;
+    return true;
+}
+
+size_t watch_map_remove_prefix(watch_map_t *m, const char *prefix,
+                               void (*cb)(void *ctx, int wd), void *ctx) {
+    size_t plen = strlen(prefix);
+    size_t removed = 0;
+
+    for (size_t i = 0; i < m->cap; i++) {
+        watch_slot_t *s = &m->slots[i];
+        if (s->wd < 0) continue;
+        if (strncmp(s->path, prefix, plen) != 0) continue;
+        if (s->path[plen] != '\0' && s->path[plen] != '/') continue;
+
+        int wd = s->wd;
+        free(s->path);
+        s->path = NULL;
+        s->wd = SLOT_DELETED;
+        m->count--;
+        m->tombstones++;
+        removed++;
+
+        if (cb) cb(ctx, wd);
+    }
+    return removed;
+}
@@ -0,0 +1,47 @@
+#ifndef WATCH_MAP_H
+#define WATCH_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Хеш-таблица watch descriptor -> путь каталога (открытая адресация,
+// линейное пробирование). Поиск O(1) на каждое событие inotify.
+// Не потокобезопасна: используется только из цикла событий.
+
+typedef struct {
+    int wd;     // -1 = пусто, -2 = удалено
+    char *path;
+} watch_slot_t;
+
+typedef struct {
+    watch_slot_t *slots;
+    size_t cap;        // всегда степень двойки
+    size_t count;
+    size_t tombstones;
+} watch_map_t;
+
+bool watch_map_init(watch_map_t *m, size_t expected);
+void watch_map_destroy(watch_map_t *m);
+
+// Добавляет или заменяет путь для wd (путь копируется)
+bool watch_map_put(watch_map_t *m, int wd, const char *path);
+
+// Путь каталога для wd или NULL
+const char *watch_map_get(const watch_map_t *m, int wd);
+
+bool watch_map_remove(watch_map_t *m, int wd);
+
+/**
+ * @brief Удаляет каталог prefix и все вложенные в него записи.
+ *
+ * Для каждого удалённого wd вызывается cb (если задан), например
+ * чтобы снять наблюдение через inotify_rm_watch.
+ *
+ * @return количество удалённых записей
+ */
+size_t watch_map_remove_prefix(watch_map_t *m, const char *prefix,
+                               void (*cb)(void *ctx, int wd), void *ctx);
+
+static inline size_t watch_map_count(const watch_map_t *m) { return m->count; }
+
+#endif // WATCH_MAP_H
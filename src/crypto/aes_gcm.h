@@ -15,6 +15,14 @@ typedef struct {
 
 int crypto_encrypt_aes_gcm(const uint8_t *pt, size_t pt_len, const uint8_t *key, uint8_t *ct, uint8_t *iv, uint8_t *tag);
 
+//* шифрование с готовым 12-байтным IV; возвращает длину шифротекста или -1
+int crypto_encrypt_aes_gcm_iv(const uint8_t *pt, size_t pt_len, const uint8_t *key,
+                              const uint8_t *iv, uint8_t *ct, uint8_t *tag);
+
+//* расшифровка с проверкой 16-байтного тега; -1 — ошибка или тег не сошёлся
+int crypto_decrypt_aes_gcm(const uint8_t *ct, size_t ct_len, const uint8_t *key,
+                           const uint8_t *iv, const uint8_t *tag, uint8_t *pt);
+
 
 
 
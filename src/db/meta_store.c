@@ -0,0 +1,119 @@
+// db/meta_store.c
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meta_store.h"
+
+static const char *const g_op_names[META_OPS] = {
+    [META_OP_INSERT] = "insert",
+    [META_OP_FIND] = "find",
+    [META_OP_LIST] = "list",
+    [META_OP_STAT] = "stat",
+    [META_OP_EVENT] = "event",
+    [META_OP_LOAD] = "load",
+    [META_OP_CLAIM] = "claim",
+};
+
+const char *meta_backend_name(meta_backend_t backend) {
+    return backend == META_BACKEND_MEMORY ? "memory" : "mongo";
+}
+
+bool meta_parse_backend(const char *name, meta_backend_t *out) {
+    if (strcmp(name, "mongo") == 0) {
+        *out = META_BACKEND_MONGO;
+    } else if (strcmp(name, "memory") == 0) {
+        *out = META_BACKEND_MEMORY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parse_u32(const char *s, size_t len, uint32_t *out) {
+    char buf[16];
+    if (len == 0 || len >= sizeof(buf)) return false;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+
+    char *end;
+    errno = 0;
+    unsigned long v = strtoul(buf, &end, 10);
+    if (errno != 0 || *end != '\0' || buf[0] == '-' || v > UINT32_MAX) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+// "insert+event" -> маска операций
+static bool parse_ops(const char *s, size_t len, unsigned *out) {
+    unsigned mask = 0;
+    while (len > 0) {
+        const char *plus = memchr(s, '+', len);
+        size_t n = plus ? (size_t)(plus - s) : len;
+
+        int op = -1;
+        for (int i = 0; i < META_OPS; i++) {
+            if (strlen(g_op_names[i]) == n && memcmp(g_op_names[i], s, n) == 0) op = i;
+        }
+        if (op < 0) return false;
+        mask |= 1u << op;
+
+        if (!plus) break;
+        len -= n + 1;
+        s = plus + 1;
+    }
+    if (!mask) return false;
+    *out = mask;
+    return true;
+}
+
+bool meta_mem_parse_options(const char *spec, meta_mem_options_t *out) {
+    meta_mem_options_t o = {0};
+    const char *p = spec;
+
+    while (*p) {
+        const char *comma = strchr(p, ',');
+        size_t len = comma ? (size_t)(comma - p) : strlen(p);
+        const char *eq = memchr(p, '=', len);
+        if (!eq) return false;
+
+        size_t klen = (size_t)(eq - p);
+        const char *v = eq + 1;
+        size_t vlen = len - klen - 1;
+        bool ok;
+        if (klen == 10 && memcmp(p, "latency_us", klen) == 0) {
+            ok = parse_u32(v, vlen, &o.latency_us);
+        } else if (klen == 9 && memcmp(p, "jitter_us", klen) == 0) {
+            ok = parse_u32(v, vlen, &o.jitter_us);
+        } else if (klen == 10 && memcmp(p, "fail_every", klen) == 0) {
+            ok = parse_u32(v, vlen, &o.fail_every);
+        } else if (klen == 8 && memcmp(p, "fail_ops", klen) == 0) {
+            ok = parse_ops(v, vlen, &o.fail_ops);
+        } else {
+            ok = false;
+        }
+        if (!ok) return false;
+
+        if (!comma) break;
+        p = comma + 1;
+    }
+
+    *out = o;
+    return true;
+}
+
+bool meta_file_visible_to(const meta_file_t *file, const char *viewer) {
+    return file->is_public || strcmp(file->owner, viewer) == 0 ||
+           (file->recipient[0] && strcmp(file->recipient, viewer) == 0);
+}
+
+void meta_set_error(meta_error_t *error, const char *fmt, ...) {
+    if (!error) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(error->message, sizeof(error->message), fmt, ap);
+    va_end(ap);
+}
@@ -0,0 +1,240 @@
+#ifndef META_STORE_H
+#define META_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../include/protocol.h"
+
+// Хранилище метаданных коллекции file_groups. Обработчики сервера и демона
+// работают не с BSON, а с операциями, которые им нужны:
+//
+//  - документы загрузок (filename, владелец, получатель, iv/tag, хеш):
+//    вставка, самая свежая видимая версия по имени, список видимых,
+//    пакетный поиск по именам и хешам ($in) для STAT;
+//  - документы путей (_id = путь): журнал событий proc и последнее
+//    известное состояние state, которое читает сверка демона.
+//
+// Две реализации:
+//  - mongo: libmongoc с пулом клиентов, операции потокобезопасны;
+//  - memory: хеш-таблицы и отсортированные индексы в памяти процесса,
+//    для тестов и бенчмарков без MongoDB. Умеет добавлять задержку и
+//    отказывать в заданных операциях.
+//
+// Модуль не логирует: текст ошибки возвращается в meta_error_t.
+
+#define META_IV_LEN  12
+#define META_TAG_LEN 16
+#define META_ERROR_LEN 256
+#define META_OBJECT_ID_LEN 33 // id объекта хранилища: 32 hex-символа (storage/object_store.h)
+
+typedef enum {
+    META_BACKEND_MONGO,
+    META_BACKEND_MEMORY
+} meta_backend_t;
+
+// Операции хранилища (маска отказов memory-реализации)
+typedef enum {
+    META_OP_INSERT,
+    META_OP_FIND,
+    META_OP_LIST,
+    META_OP_STAT,
+    META_OP_EVENT,
+    META_OP_LOAD,
+    META_OP_CLAIM,
+    META_OPS
+} meta_op_t;
+
+typedef struct {
+    char message[META_ERROR_LEN];
+} meta_error_t;
+
+// Документ загрузки
+typedef struct {
+    char filename[FILENAME_MAX_LEN];
+    char owner[FINGERPRINT_LEN];
+    char recipient[FINGERPRINT_LEN];   // пусто — получателя нет
+    bool is_public;
+    bool encrypted;                    // iv и tag на месте и нужной длины
+    bool hashed;                       // content_hash на месте
+    int64_t size;
+    int64_t uploaded_at;               // unix-время в миллисекундах
+    uint8_t iv[META_IV_LEN];
+    uint8_t tag[META_TAG_LEN];
+    uint8_t content_hash[BLAKE3_HASH_LEN];
+    char object_id[META_OBJECT_ID_LEN]; // пусто — файл в плоском каталоге под filename
+} meta_file_t;
+
+// Последнее известное состояние пути (state)
+typedef struct {
+    bool exists;
+    int64_t size;
+    int64_t mtime_ns;
+    bool hashed;
+    uint8_t hash[BLAKE3_HASH_LEN];
+} meta_state_t;
+
+// Событие журнала proc
+typedef struct {
+    const char *type;           // type_of_changes
+    const char *status;
+    const char *renamed_from;   // NULL — не переименование
+    const meta_state_t *state;  // NULL — state документа не меняется
+} meta_event_t;
+
+// Колбэки выборок; false из meta_state_fn прерывает загрузку с ошибкой
+typedef void (*meta_file_fn)(void *ctx, const meta_file_t *file);
+typedef bool (*meta_state_fn)(void *ctx, const char *path, int64_t size, int64_t mtime_ns);
+
+typedef struct meta_store meta_store_t;
+
+typedef struct {
+    bool (*insert_file)(meta_store_t *s, const meta_file_t *file, meta_error_t *error);
+    int (*find_latest)(meta_store_t *s, const char *filename, const char *viewer,
+                       meta_file_t *out, meta_error_t *error);
+    bool (*list_visible)(meta_store_t *s, const char *viewer, meta_file_fn fn, void *ctx,
+                         meta_error_t *error);
+    bool (*stat_batch)(meta_store_t *s, const char *const *names, size_t n_names,
+                       const uint8_t (*hashes)[BLAKE3_HASH_LEN], size_t n_hashes,
+                       const char *viewer, meta_file_fn fn, void *ctx, meta_error_t *error);
+    bool (*append_event)(meta_store_t *s, const char *path, const meta_event_t *ev,
+                         uint64_t *seq, meta_error_t *error);
+    bool (*load_states)(meta_store_t *s, const char *root, meta_state_fn fn, void *ctx,
+                        meta_error_t *error);
+    int (*claim_legacy)(meta_store_t *s, const char *filename, const char *object_id,
+                        meta_error_t *error);
+    void (*close)(meta_store_t *s);
+} meta_store_ops_t;
+
+// Общая часть реализаций; каждая кладёт её первым полем своей структуры
+struct meta_store {
+    const meta_store_ops_t *ops;
+    meta_backend_t backend;
+};
+
+// Параметры memory-реализации
+typedef struct {
+    uint32_t latency_us;    // задержка каждой операции
+    uint32_t jitter_us;     // плюс равномерно [0, jitter_us)
+    uint32_t fail_every;    // каждая N-я операция из fail_ops завершается ошибкой; 0 — никогда
+    unsigned fail_ops;      // маска (1u << meta_op_t); 0 — все операции
+} meta_mem_options_t;
+
+const char *meta_backend_name(meta_backend_t backend);
+
+// "mongo" / "memory"; false — неизвестное имя
+bool meta_parse_backend(const char *name, meta_backend_t *out);
+
+/**
+ * @brief Разбирает параметры memory-реализации.
+ *
+ * Формат: "latency_us=200,jitter_us=100,fail_every=50,fail_ops=insert+event".
+ * Пропущенные ключи остаются нулевыми.
+ *
+ * @return false — неизвестный ключ или значение
+ */
+bool meta_mem_parse_options(const char *spec, meta_mem_options_t *out);
+
+// Условие видимости для клиента: владелец, получатель или публичный файл
+bool meta_file_visible_to(const meta_file_t *file, const char *viewer);
+
+void meta_set_error(meta_error_t *error, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Подключается к MongoDB: пул клиентов, ping и индексы
+ *        filename / content_hash.
+ *
+ * @param error причина отказа; при успехе — пустая строка или
+ *              предупреждение (индексы не созданы, хранилище работает)
+ * @return хранилище или NULL
+ */
+meta_store_t *meta_store_open_mongo(const char *uri, const char *database,
+                                    const char *collection, meta_error_t *error);
+
+// Пустое хранилище в памяти; options может быть NULL
+meta_store_t *meta_store_open_memory(const meta_mem_options_t *options);
+
+// Событий в журнале proc пути (только memory, для проверок в тестах)
+size_t meta_mem_event_count(meta_store_t *s, const char *path);
+
+static inline void meta_store_close(meta_store_t *s) {
+    if (s) s->ops->close(s);
+}
+
+static inline bool meta_insert_file(meta_store_t *s, const meta_file_t *file,
+                                    meta_error_t *error) {
+    return s->ops->insert_file(s, file, error);
+}
+
+/**
+ * @brief Самая свежая (по uploaded_at) видимая viewer загрузка с этим именем.
+ *
+ * @return 1 — найдена, 0 — нет, -1 — ошибка
+ */
+static inline int meta_find_latest(meta_store_t *s, const char *filename, const char *viewer,
+                                   meta_file_t *out, meta_error_t *error) {
+    return s->ops->find_latest(s, filename, viewer, out, error);
+}
+
+// Все загрузки, видимые viewer, в порядке вставки
+static inline bool meta_list_visible(meta_store_t *s, const char *viewer, meta_file_fn fn,
+                                     void *ctx, meta_error_t *error) {
+    return s->ops->list_visible(s, viewer, fn, ctx, error);
+}
+
+/**
+ * @brief Видимые viewer загрузки, у которых имя из names или хеш из hashes.
+ *
+ * Документы идут от старых к новым, чтобы при заполнении ответа побеждала
+ * самая свежая загрузка. Документ, подходящий и по имени, и по хешу,
+ * приходит один раз.
+ */
+static inline bool meta_stat_batch(meta_store_t *s, const char *const *names, size_t n_names,
+                                   const uint8_t (*hashes)[BLAKE3_HASH_LEN], size_t n_hashes,
+                                   const char *viewer, meta_file_fn fn, void *ctx,
+                                   meta_error_t *error) {
+    return s->ops->stat_batch(s, names, n_names, hashes, n_hashes, viewer, fn, ctx, error);
+}
+
+/**
+ * @brief Дописывает событие в журнал proc документа path (создаёт документ
+ *        при первом событии).
+ *
+ * Номер события выдаётся чтением и записью без транзакции: события одного
+ * пути должен писать один поток.
+ *
+ * @param seq номер записанного события (может быть NULL)
+ */
+static inline bool meta_append_event(meta_store_t *s, const char *path, const meta_event_t *ev,
+                                     uint64_t *seq, meta_error_t *error) {
+    return s->ops->append_event(s, path, ev, seq, error);
+}
+
+/**
+ * @brief Записанное состояние путей под root для сверки.
+ *
+ * Пути без state (записанные до его появления) приходят с size = -1,
+ * удалённые (state.exists = false) не приходят.
+ */
+static inline bool meta_load_states(meta_store_t *s, const char *root, meta_state_fn fn,
+                                    void *ctx, meta_error_t *error) {
+    return s->ops->load_states(s, root, fn, ctx, error);
+}
+
+/**
+ * @brief Привязывает плоский файл filename к объекту object_id.
+ *
+ * В плоском каталоге под одним именем лежит шифротекст последней загрузки,
+ * поэтому object_id получает самый свежий (по uploaded_at) документ с этим
+ * именем и без object_id, среди всех владельцев. Поиск и запись атомарны.
+ *
+ * @return 1 — документ обновлён, 0 — таких документов нет, -1 — ошибка
+ */
+static inline int meta_claim_legacy(meta_store_t *s, const char *filename, const char *object_id,
+                                    meta_error_t *error) {
+    return s->ops->claim_legacy(s, filename, object_id, error);
+}
+
+#endif // META_STORE_H
@@ -0,0 +1,543 @@
+// db/meta_store_mem.c
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "meta_store.h"
+
+// Хранилище метаданных в памяти процесса. Повторяет выборки, которые
+// обработчики делают в MongoDB:
+//
+//  - загрузки лежат в массиве в порядке вставки (список LIST);
+//  - индексы filename и content_hash — открытая адресация, у ключа список
+//    загрузок, отсортированный по uploaded_at (find_latest берёт с конца,
+//    STAT сливает списки);
+//  - документы путей — хеш-таблица плюс отсортированный массив путей для
+//    выборки диапазона "root/" <= путь < "root0", как по индексу _id.
+//
+// Один rwlock на всё хранилище. Колбэки выборок вызываются под ним и не
+// должны обращаться к хранилищу. Задержка выдерживается до захвата.
+
+#define MEM_INITIAL_SLOTS 64
+
+typedef struct {
+    meta_file_t file;
+    uint64_t seq;
+} mem_file_t;
+
+typedef struct {
+    uint64_t hash;      // 0 — слот свободен
+    uint32_t *ids;      // индексы в files по возрастанию (uploaded_at, seq)
+    uint32_t len;
+    uint32_t cap;
+} mem_posting_t;
+
+typedef struct {
+    mem_posting_t *slots;
+    size_t cap;         // степень двойки
+    size_t used;
+    bool by_hash;       // ключ — content_hash, иначе filename
+} mem_index_t;
+
+typedef struct {
+    char *path;
+    uint64_t events;
+    bool has_state;
+    meta_state_t state;
+} mem_doc_t;
+
+typedef struct {
+    uint64_t hash;
+    mem_doc_t *doc;
+} mem_doc_slot_t;
+
+typedef struct {
+    meta_store_t base;
+    meta_mem_options_t options;
+    pthread_rwlock_t lock;
+
+    mem_file_t *files;
+    size_t n_files;
+    size_t files_cap;
+    mem_index_t by_name;
+    mem_index_t by_hash;
+
+    mem_doc_slot_t *docs;
+    size_t docs_cap;
+    size_t n_docs;
+    mem_doc_t **sorted;     // документы по возрастанию пути
+
+    _Atomic uint64_t fault_calls;
+    _Atomic uint64_t jitter_state;
+} mem_store_t;
+
+static const char *const g_op_names[META_OPS] = {
+    "insert", "find", "list", "stat", "event", "load", "claim"
+};
+
+static uint64_t fnv1a(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h | 1;
+}
+
+static uint64_t key_hash(const mem_index_t *idx, const void *key) {
+    if (idx->by_hash) {
+        uint64_t h;
+        memcpy(&h, key, sizeof(h)); // ключ — уже криптографический хеш
+        return h | 1;
+    }
+    return fnv1a(key, strlen(key));
+}
+
+static bool key_equal(const mem_store_t *m, const mem_index_t *idx,
+                      const mem_posting_t *slot, const void *key) {
+    const meta_file_t *f = &m->files[slot->ids[0]].file;
+    return idx->by_hash ? memcmp(f->content_hash, key, BLAKE3_HASH_LEN) == 0
+                        : strcmp(f->filename, key) == 0;
+}
+
+static mem_posting_t *index_find(const mem_store_t *m, const mem_index_t *idx, const void *key) {
+    if (!idx->slots) return NULL;
+    uint64_t h = key_hash(idx, key);
+    for (size_t i = h & (idx->cap - 1);; i = (i + 1) & (idx->cap - 1)) {
+        mem_posting_t *slot = &idx->slots[i];
+        if (!slot->hash) return NULL;
+        if (slot->hash == h && key_equal(m, idx, slot, key)) return slot;
+    }
+}
+
+static bool index_grow(mem_index_t *idx) {
+    size_t cap = idx->cap ? idx->cap * 2 : MEM_INITIAL_SLOTS;
+    mem_posting_t *slots = calloc(cap, sizeof(*slots));
+    if (!slots) return false;
+
+    for (size_t i = 0; i < idx->cap; i++) {
+        mem_posting_t *old = &idx->slots[i];
+        if (!old->hash) continue;
+        size_t j = old->hash & (cap - 1);
+        while (slots[j].hash) j = (j + 1) & (cap - 1);
+        slots[j] = *old;
+    }
+    free(idx->slots);
+    idx->slots = slots;
+    idx->cap = cap;
+    return true;
+}
+
+static bool file_before(const mem_file_t *a, const mem_file_t *b) {
+    return a->file.uploaded_at < b->file.uploaded_at ||
+           (a->file.uploaded_at == b->file.uploaded_at && a->seq < b->seq);
+}
+
+// Готовит вставку ключа: место в таблице и в списке загрузок. После
+// успешной подготовки index_add не выделяет память и не может отказать.
+static bool index_reserve(mem_store_t *m, mem_index_t *idx, const void *key) {
+    mem_posting_t *slot = index_find(m, idx, key);
+    if (!slot) {
+        return (idx->used + 1) * 4 <= idx->cap * 3 || index_grow(idx);
+    }
+    if (slot->len < slot->cap) return true;
+
+    uint32_t cap = slot->cap * 2;
+    uint32_t *ids = realloc(slot->ids, cap * sizeof(*ids));
+    if (!ids) return false;
+    slot->ids = ids;
+    slot->cap = cap;
+    return true;
+}
+
+// Добавляет загрузку id в список ключа, сохраняя порядок по uploaded_at.
+// fresh — массив для нового ключа (освобождается, если ключ уже есть).
+static void index_add(mem_store_t *m, mem_index_t *idx, const void *key, uint32_t id,
+                      uint32_t *fresh) {
+    mem_posting_t *slot = index_find(m, idx, key);
+    if (!slot) {
+        uint64_t h = key_hash(idx, key);
+        size_t i = h & (idx->cap - 1);
+        while (idx->slots[i].hash) i = (i + 1) & (idx->cap - 1);
+        slot = &idx->slots[i];
+        *slot = (mem_posting_t){ .hash = h, .ids = fresh, .cap = 4 };
+        idx->used++;
+        fresh = NULL;
+    }
+    free(fresh);
+
+    // Загрузки почти всегда приходят по времени: сдвиг редко больше нуля
+    uint32_t pos = slot->len;
+    while (pos > 0 && file_before(&m->files[id], &m->files[slot->ids[pos - 1]])) pos--;
+    memmove(&slot->ids[pos + 1], &slot->ids[pos], (slot->len - pos) * sizeof(uint32_t));
+    slot->ids[pos] = id;
+    slot->len++;
+}
+
+static void index_free(mem_index_t *idx) {
+    for (size_t i = 0; i < idx->cap; i++) free(idx->slots[i].ids);
+    free(idx->slots);
+}
+
+static mem_doc_t *doc_find(const mem_store_t *m, const char *path, uint64_t h) {
+    if (!m->docs) return NULL;
+    for (size_t i = h & (m->docs_cap - 1);; i = (i + 1) & (m->docs_cap - 1)) {
+        const mem_doc_slot_t *slot = &m->docs[i];
+        if (!slot->hash) return NULL;
+        if (slot->hash == h && strcmp(slot->doc->path, path) == 0) return slot->doc;
+    }
+}
+
+// Первый документ с путём >= path
+static size_t sorted_lower_bound(const mem_store_t *m, const char *path) {
+    size_t lo = 0, hi = m->n_docs;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(m->sorted[mid]->path, path) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static bool docs_grow(mem_store_t *m) {
+    size_t cap = m->docs_cap ? m->docs_cap * 2 : MEM_INITIAL_SLOTS;
+    mem_doc_slot_t *slots = calloc(cap, sizeof(*slots));
+    mem_doc_t **sorted = realloc(m->sorted, cap * sizeof(*sorted));
+    if (!slots || !sorted) {
+        free(slots);
+        if (sorted) m->sorted = sorted;
+        return false;
+    }
+    m->sorted = sorted;
+
+    for (size_t i = 0; i < m->docs_cap; i++) {
+        if (!m->docs[i].hash) continue;
+        size_t j = m->docs[i].hash & (cap - 1);
+        while (slots[j].hash) j = (j + 1) & (cap - 1);
+        slots[j] = m->docs[i];
+    }
+    free(m->docs);
+    m->docs = slots;
+    m->docs_cap = cap;
+    return true;
+}
+
+// Документ пути, создаётся при первом событии (как create_base_document)
+static mem_doc_t *doc_get_or_create(mem_store_t *m, const char *path) {
+    uint64_t h = fnv1a(path, strlen(path));
+    mem_doc_t *doc = doc_find(m, path, h);
+    if (doc) return doc;
+
+    if ((m->n_docs + 1) * 4 > m->docs_cap * 3 && !docs_grow(m)) return NULL;
+
+    doc = calloc(1, sizeof(*doc));
+    if (!doc || !(doc->path = strdup(path))) {
+        free(doc);
+        return NULL;
+    }
+
+    size_t i = h & (m->docs_cap - 1);
+    while (m->docs[i].hash) i = (i + 1) & (m->docs_cap - 1);
+    m->docs[i] = (mem_doc_slot_t){ .hash = h, .doc = doc };
+
+    size_t pos = sorted_lower_bound(m, path);
+    memmove(&m->sorted[pos + 1], &m->sorted[pos], (m->n_docs - pos) * sizeof(*m->sorted));
+    m->sorted[pos] = doc;
+    m->n_docs++;
+    return doc;
+}
+
+// Задержка и отказы. true — операция должна завершиться ошибкой.
+static bool inject(mem_store_t *m, meta_op_t op, meta_error_t *error) {
+    const meta_mem_options_t *o = &m->options;
+
+    uint64_t delay_us = o->latency_us;
+    if (o->jitter_us) {
+        // splitmix64 на общем счётчике: дёшево и без гонок
+        uint64_t z = atomic_fetch_add_explicit(&m->jitter_state, 0x9e3779b97f4a7c15ULL,
+                                               memory_order_relaxed);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        delay_us += (z ^ (z >> 31)) % o->jitter_us;
+    }
+    if (delay_us) {
+        struct timespec ts = { .tv_sec = (time_t)(delay_us / 1000000),
+                               .tv_nsec = (long)(delay_us % 1000000) * 1000 };
+        while (nanosleep(&ts, &ts) != 0) {}
+    }
+
+    if (!o->fail_every || (o->fail_ops && !(o->fail_ops & (1u << op)))) return false;
+    uint64_t n = atomic_fetch_add_explicit(&m->fault_calls, 1, memory_order_relaxed) + 1;
+    if (n % o->fail_every != 0) return false;
+    meta_set_error(error, "injected %s failure", g_op_names[op]);
+    return true;
+}
+
+static bool mem_insert_file(meta_store_t *s, const meta_file_t *file, meta_error_t *error) {
+    mem_store_t *m = (mem_store_t *)s;
+    if (inject(m, META_OP_INSERT, error)) return false;
+
+    uint32_t *fresh_name = malloc(4 * sizeof(uint32_t));
+    uint32_t *fresh_hash = malloc(4 * sizeof(uint32_t));
+
+    pthread_rwlock_wrlock(&m->lock);
+    bool ok = false;
+    if (!fresh_name || !fresh_hash) goto out;
+    if (m->n_files == m->files_cap) {
+        size_t cap = m->files_cap ? m->files_cap * 2 : MEM_INITIAL_SLOTS;
+        mem_file_t *files = cap <= UINT32_MAX ? realloc(m->files, cap * sizeof(*files)) : NULL;
+        if (!files) goto out;
+        m->files = files;
+        m->files_cap = cap;
+    }
+
+    // Запись готовится на месте, но считается вставленной только после
+    // того, как индексы приняли её без выделения памяти
+    uint32_t id = (uint32_t)m->n_files;
+    m->files[id] = (mem_file_t){ .file = *file, .seq = id };
+    meta_file_t *f = &m->files[id].file;
+    f->filename[FILENAME_MAX_LEN - 1] = '\0';
+    f->owner[FINGERPRINT_LEN - 1] = '\0';
+    f->recipient[FINGERPRINT_LEN - 1] = '\0';
+
+    if (!index_reserve(m, &m->by_name, f->filename) ||
+        (f->hashed && !index_reserve(m, &m->by_hash, f->content_hash))) {
+        goto out;
+    }
+    m->n_files++;
+
+    index_add(m, &m->by_name, f->filename, id, fresh_name);
+    fresh_name = NULL;
+    if (f->hashed) {
+        index_add(m, &m->by_hash, f->content_hash, id, fresh_hash);
+        fresh_hash = NULL;
+    }
+    ok = true;
+
+out:
+    pthread_rwlock_unlock(&m->lock);
+    free(fresh_name);
+    free(fresh_hash);
+    if (!ok) meta_set_error(error, "out of memory");
+    return ok;
+}
+
+static int mem_find_latest(meta_store_t *s, const char *filename, const char *viewer,
+                           meta_file_t *out, meta_error_t *error) {
+    mem_store_t *m = (mem_store_t *)s;
+    if (inject(m, META_OP_FIND, error)) return -1;
+
+    int found = 0;
+    pthread_rwlock_rdlock(&m->lock);
+    const mem_posting_t *slot = index_find(m, &m->by_name, filename);
+    for (uint32_t i = slot ? slot->len : 0; i > 0; i--) {
+        const meta_file_t *f = &m->files[slot->ids[i - 1]].file;
+        if (meta_file_visible_to(f, viewer)) {
+            *out = *f;
+            found = 1;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&m->lock);
+    return found;
+}
+
+static bool mem_list_visible(meta_store_t *s, const char *viewer, meta_file_fn fn, void *ctx,
+                             meta_error_t *error) {
+    mem_store_t *m = (mem_store_t *)s;
+    if (inject(m, META_OP_LIST, error)) return false;
+
+    pthread_rwlock_rdlock(&m->lock);
+    for (size_t i = 0; i < m->n_files; i++) {
+        if (meta_file_visible_to(&m->files[i].file, viewer)) fn(ctx, &m->files[i].file);
+    }
+    pthread_rwlock_unlock(&m->lock);
+    return true;
+}
+
+static int id_cmp(const void *a, const void *b, void *arg) {
+    const mem_file_t *files = arg;
+    const mem_file_t *fa = &files[*(const uint32_t *)a];
+    const mem_file_t *fb = &files[*(const uint32_t *)b];
+    return file_before(fa, fb) ? -1 : file_before(fb, fa) ? 1 : 0;
+}
+
+static bool mem_stat_batch(meta_store_t *s, const char *const *names, size_t n_names,
+                           const uint8_t (*hashes)[BLAKE3_HASH_LEN], size_t n_hashes,
+                           const char *viewer, meta_file_fn fn, void *ctx, meta_error_t *error) {
+    mem_store_t *m = (mem_store_t *)s;
+    if (inject(m, META_OP_STAT, error)) return false;
+
+    pthread_rwlock_rdlock(&m->lock);
+
+    // Совпадения по всем ключам, затем сортировка и удаление повторов:
+    // документ, подходящий по имени и по хешу, отдаётся один раз
+    size_t total = 0;
+    for (size_t i = 0; i < n_names + n_hashes; i++) {
+        const mem_posting_t *slot = i < n_names
+            ? index_find(m, &m->by_name, names[i])
+            : index_find(m, &m->by_hash, hashes[i - n_names]);
+        if (slot) total += slot->len;
+    }
+
+    uint32_t *ids = total ? malloc(total * sizeof(*ids)) : NULL;
+    if (total && !ids) {
+        pthread_rwlock_unlock(&m->lock);
+        meta_set_error(error, "out of memory");
+        return false;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < n_names + n_hashes; i++) {
+        const mem_posting_t *slot = i < n_names
+            ? index_find(m, &m->by_name, names[i])
+            : index_find(m, &m->by_hash, hashes[i - n_names]);
+        if (!slot) continue;
+        memcpy(&ids[n], slot->ids, slot->len * sizeof(*ids));
+        n += slot->len;
+    }
+    qsort_r(ids, n, sizeof(*ids), id_cmp, m->files);
+
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0 && ids[i] == ids[i - 1]) continue;
+        const meta_file_t *f = &m->files[ids[i]].file;
+        if (meta_file_visible_to(f, viewer)) fn(ctx, f);
+    }
+
+    pthread_rwlock_unlock(&m->lock);
+    free(ids);
+    return true;
+}
+
+static bool mem_append_event(meta_store_t *s, const char *path, const meta_event_t *ev,
+                             uint64_t *seq, meta_error_t *error) {
+    mem_store_t *m = (mem_store_t *)s;
+    if (inject(m, META_OP_EVENT, error)) return false;
+
+    pthread_rwlock_wrlock(&m->lock);
+    mem_doc_t *doc = doc_get_or_create(m, path);
+    if (doc) {
+        doc->events++;
+        if (seq) *seq = doc->events;
+        if (ev->state) {
+            doc->state = *ev->state;
+            doc->has_state = true;
+        }
+    }
+    pthread_rwlock_unlock(&m->lock);
+
+    if (!doc) meta_set_error(error, "out of memory");
+    return doc != NULL;
+}
+
+static bool mem_load_states(meta_store_t *s, const char *root, meta_state_fn fn, void *ctx,
+                            meta_error_t *error) {
+    mem_store_t *m = (mem_store_t *)s;
+    if (inject(m, META_OP_LOAD, error)) return false;
+
+    size_t root_len = strlen(root);
+    char *lo = malloc(root_len + 2);
+    if (!lo) {
+        meta_set_error(error, "out of memory");
+        return false;
+    }
+    memcpy(lo, root, root_len);
+    lo[root_len] = '/';
+    lo[root_len + 1] = '\0';
+
+    bool ok = true;
+    pthread_rwlock_rdlock(&m->lock);
+    for (size_t i = sorted_lower_bound(m, lo); i < m->n_docs; i++) {
+        const mem_doc_t *doc = m->sorted[i];
+        if (strncmp(doc->path, lo, root_len + 1) != 0) break;
+        if (doc->has_state && !doc->state.exists) continue;
+
+        int64_t size = doc->has_state ? doc->state.size : -1;
+        int64_t mtime_ns = doc->has_state ? doc->state.mtime_ns : 0;
+        if (!fn(ctx, doc->path, size, mtime_ns)) {
+            meta_set_error(error, "state consumer failed");
+            ok = false;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&m->lock);
+
+    free(lo);
+    return ok;
+}
+
+static int mem_claim_legacy(meta_store_t *s, const char *filename, const char *object_id,
+                            meta_error_t *error) {
+    mem_store_t *m = (mem_store_t *)s;
+    if (inject(m, META_OP_CLAIM, error)) return -1;
+
+    int claimed = 0;
+    pthread_rwlock_wrlock(&m->lock);
+    const mem_posting_t *slot = index_find(m, &m->by_name, filename);
+    for (uint32_t i = slot ? slot->len : 0; i > 0; i--) {
+        meta_file_t *f = &m->files[slot->ids[i - 1]].file;
+        if (!f->object_id[0]) {
+            snprintf(f->object_id, sizeof(f->object_id), "%s", object_id);
+            claimed = 1;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&m->lock);
+    return claimed;
+}
+
+static void mem_close(meta_store_t *s) {
+    mem_store_t *m = (mem_store_t *)s;
+    index_free(&m->by_name);
+    index_free(&m->by_hash);
+    free(m->files);
+    for (size_t i = 0; i < m->n_docs; i++) {
+        free(m->sorted[i]->path);
+        free(m->sorted[i]);
+    }
+    free(m->sorted);
+    free(m->docs);
+    pthread_rwlock_destroy(&m->lock);
+    free(m);
+}
+
+static const meta_store_ops_t g_mem_ops = {
+    .insert_file = mem_insert_file,
+    .find_latest = mem_find_latest,
+    .list_visible = mem_list_visible,
+    .stat_batch = mem_stat_batch,
+    .append_event = mem_append_event,
+    .load_states = mem_load_states,
+    .claim_legacy = mem_claim_legacy,
+    .close = mem_close,
+};
+
+meta_store_t *meta_store_open_memory(const meta_mem_options_t *options) {
+    mem_store_t *m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+    if (pthread_rwlock_init(&m->lock, NULL) != 0) {
+        free(m);
+        return NULL;
+    }
+    m->base = (meta_store_t){ .ops = &g_mem_ops, .backend = META_BACKEND_MEMORY };
+    if (options) m->options = *options;
+    m->by_hash.by_hash = true;
+    return &m->base;
+}
+
+size_t meta_mem_event_count(meta_store_t *s, const char *path) {
+    if (s->backend != META_BACKEND_MEMORY) return 0;
+    mem_store_t *m = (mem_store_t *)s;
+
+    pthread_rwlock_rdlock(&m->lock);
+    const mem_doc_t *doc = doc_find(m, path, fnv1a(path, strlen(path)));
+    size_t n = doc ? doc->events : 0;
+    pthread_rwlock_unlock(&m->lock);
+    return n;
+}
@@ -0,0 +1,639 @@
+// db/meta_store_mongo.c
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <bson/bson.h>
+#include <mongoc/mongoc.h>
+
+#include "meta_store.h"
+
+// Хранилище метаданных в MongoDB. mongoc_client_t не потокобезопасен,
+// поэтому каждая операция берёт клиента из пула: в коллекцию пишут
+// рабочие потоки конвейера демона.
+
+#define DUPLICATE_KEY 11000
+
+typedef struct {
+    meta_store_t base;
+    mongoc_client_pool_t *pool;
+    char *database;
+    char *collection;
+} mongo_store_t;
+
+typedef struct {
+    mongoc_client_t *client;
+    mongoc_collection_t *coll;
+} mongo_lease_t;
+
+static bool lease_begin(mongo_store_t *ms, mongo_lease_t *lease, meta_error_t *error) {
+    lease->client = mongoc_client_pool_pop(ms->pool);
+    lease->coll = mongoc_client_get_collection(lease->client, ms->database, ms->collection);
+    if (!lease->coll) {
+        mongoc_client_pool_push(ms->pool, lease->client);
+        meta_set_error(error, "failed to get collection %s", ms->collection);
+        return false;
+    }
+    return true;
+}
+
+static void lease_end(mongo_store_t *ms, mongo_lease_t *lease) {
+    mongoc_collection_destroy(lease->coll);
+    mongoc_client_pool_push(ms->pool, lease->client);
+}
+
+static int64_t now_ms(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// Условие видимости документа для клиента: владелец, получатель или
+// публичный файл. Дописывает в doc ключ "$or"; общее для DOWNLOAD, LIST
+// и STAT, чтобы они выбирали одни и те же документы.
+static void append_visible_to(bson_t *doc, const char *viewer) {
+    bson_t or_array, cond;
+    BSON_APPEND_ARRAY_BEGIN(doc, "$or", &or_array);
+    BSON_APPEND_DOCUMENT_BEGIN(&or_array, "0", &cond);
+    BSON_APPEND_UTF8(&cond, "owner_fingerprint", viewer);
+    bson_append_document_end(&or_array, &cond);
+    BSON_APPEND_DOCUMENT_BEGIN(&or_array, "1", &cond);
+    BSON_APPEND_UTF8(&cond, "recipient_fingerprint", viewer);
+    bson_append_document_end(&or_array, &cond);
+    BSON_APPEND_DOCUMENT_BEGIN(&or_array, "2", &cond);
+    BSON_APPEND_BOOL(&cond, "public", true);
+    bson_append_document_end(&or_array, &cond);
+    bson_append_array_end(doc, &or_array);
+}
+
+static void copy_utf8(const bson_t *doc, const char *key, char *out, size_t len) {
+    bson_iter_t iter;
+    if (bson_iter_init_find(&iter, doc, key) && BSON_ITER_HOLDS_UTF8(&iter)) {
+        snprintf(out, len, "%s", bson_iter_utf8(&iter, NULL));
+    }
+}
+
+static bool copy_binary(const bson_t *doc, const char *key, uint8_t *out, uint32_t len) {
+    bson_iter_t iter;
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+    if (bson_iter_init_find(&iter, doc, key) && BSON_ITER_HOLDS_BINARY(&iter)) {
+        bson_iter_binary(&iter, NULL, &data_len, &data);
+    }
+    if (!data || data_len != len) return false;
+    memcpy(out, data, len);
+    return true;
+}
+
+// Документ загрузки -> meta_file_t; отсутствующие поля остаются нулевыми
+static void doc_to_file(const bson_t *doc, meta_file_t *f) {
+    bson_iter_t iter;
+    memset(f, 0, sizeof(*f));
+
+    copy_utf8(doc, "filename", f->filename, sizeof(f->filename));
+    copy_utf8(doc, "owner_fingerprint", f->owner, sizeof(f->owner));
+    copy_utf8(doc, "recipient_fingerprint", f->recipient, sizeof(f->recipient));
+    copy_utf8(doc, "object_id", f->object_id, sizeof(f->object_id));
+
+    if (bson_iter_init_find(&iter, doc, "public") && BSON_ITER_HOLDS_BOOL(&iter)) {
+        f->is_public = bson_iter_bool(&iter);
+    }
+    if (bson_iter_init_find(&iter, doc, "size")) {
+        f->size = bson_iter_as_int64(&iter);
+    }
+    if (bson_iter_init_find(&iter, doc, "uploaded_at") && BSON_ITER_HOLDS_DATE_TIME(&iter)) {
+        f->uploaded_at = bson_iter_date_time(&iter);
+    }
+
+    bool has_iv = copy_binary(doc, "iv", f->iv, META_IV_LEN);
+    bool has_tag = copy_binary(doc, "tag", f->tag, META_TAG_LEN);
+    f->encrypted = has_iv && has_tag;
+    f->hashed = copy_binary(doc, "content_hash", f->content_hash, BLAKE3_HASH_LEN);
+}
+
+static bool mongo_insert_file(meta_store_t *s, const meta_file_t *file, meta_error_t *error) {
+    mongo_store_t *ms = (mongo_store_t *)s;
+    mongo_lease_t lease;
+    if (!lease_begin(ms, &lease, error)) return false;
+
+    bson_t *doc = bson_new();
+    BSON_APPEND_UTF8(doc, "filename", file->filename);
+    BSON_APPEND_INT64(doc, "size", file->size);
+    BSON_APPEND_BOOL(doc, "encrypted", file->encrypted);
+    BSON_APPEND_BINARY(doc, "iv", BSON_SUBTYPE_BINARY, file->iv, META_IV_LEN);
+    BSON_APPEND_BINARY(doc, "tag", BSON_SUBTYPE_BINARY, file->tag, META_TAG_LEN);
+    if (file->hashed) {
+        BSON_APPEND_BINARY(doc, "content_hash", BSON_SUBTYPE_BINARY,
+                           file->content_hash, BLAKE3_HASH_LEN);
+    }
+    BSON_APPEND_BOOL(doc, "deleted", false);
+    BSON_APPEND_UTF8(doc, "owner_fingerprint", file->owner);
+    if (file->recipient[0]) {
+        BSON_APPEND_UTF8(doc, "recipient_fingerprint", file->recipient);
+    }
+    BSON_APPEND_BOOL(doc, "public", file->is_public);
+    BSON_APPEND_DATE_TIME(doc, "uploaded_at", file->uploaded_at);
+    if (file->object_id[0]) {
+        BSON_APPEND_UTF8(doc, "object_id", file->object_id);
+    }
+
+    bson_error_t e;
+    bool ok = mongoc_collection_insert_one(lease.coll, doc, NULL, NULL, &e);
+    if (!ok) meta_set_error(error, "%s", e.message);
+
+    bson_destroy(doc);
+    lease_end(ms, &lease);
+    return ok;
+}
+
+static int mongo_find_latest(meta_store_t *s, const char *filename, const char *viewer,
+                             meta_file_t *out, meta_error_t *error) {
+    mongo_store_t *ms = (mongo_store_t *)s;
+    mongo_lease_t lease;
+    if (!lease_begin(ms, &lease, error)) return -1;
+
+    bson_t *query = bson_new();
+    BSON_APPEND_UTF8(query, "filename", filename);
+    BSON_APPEND_BOOL(query, "deleted", false);
+    append_visible_to(query, viewer);
+    bson_t *opts = BCON_NEW("sort", "{", "uploaded_at", BCON_INT32(-1), "}",
+                            "limit", BCON_INT64(1));
+
+    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(lease.coll, query, opts, NULL);
+    const bson_t *doc;
+    int found = 0;
+    bson_error_t e;
+    if (mongoc_cursor_next(cursor, &doc)) {
+        doc_to_file(doc, out);
+        found = 1;
+    } else if (mongoc_cursor_error(cursor, &e)) {
+        meta_set_error(error, "%s", e.message);
+        found = -1;
+    }
+
+    mongoc_cursor_destroy(cursor);
+    bson_destroy(opts);
+    bson_destroy(query);
+    lease_end(ms, &lease);
+    return found;
+}
+
+// Обходит курсор, отдавая документы загрузок в fn
+static bool drain_files(mongoc_cursor_t *cursor, meta_file_fn fn, void *ctx,
+                        meta_error_t *error) {
+    const bson_t *doc;
+    while (mongoc_cursor_next(cursor, &doc)) {
+        meta_file_t file;
+        doc_to_file(doc, &file);
+        fn(ctx, &file);
+    }
+
+    bson_error_t e;
+    if (mongoc_cursor_error(cursor, &e)) {
+        meta_set_error(error, "%s", e.message);
+        return false;
+    }
+    return true;
+}
+
+static bool mongo_list_visible(meta_store_t *s, const char *viewer, meta_file_fn fn, void *ctx,
+                               meta_error_t *error) {
+    mongo_store_t *ms = (mongo_store_t *)s;
+    mongo_lease_t lease;
+    if (!lease_begin(ms, &lease, error)) return false;
+
+    bson_t *query = bson_new();
+    append_visible_to(query, viewer);
+    bson_t *opts = BCON_NEW(
+        "projection", "{",
+            "filename", BCON_INT32(1),
+            "size", BCON_INT32(1),
+            "uploaded_at", BCON_INT32(1),
+            "public", BCON_INT32(1),
+            "owner_fingerprint", BCON_INT32(1),
+            "recipient_fingerprint", BCON_INT32(1),
+        "}"
+    );
+
+    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(lease.coll, query, opts, NULL);
+    bool ok = drain_files(cursor, fn, ctx, error);
+
+    mongoc_cursor_destroy(cursor);
+    bson_destroy(opts);
+    bson_destroy(query);
+    lease_end(ms, &lease);
+    return ok;
+}
+
+static bool mongo_stat_batch(meta_store_t *s, const char *const *names, size_t n_names,
+                             const uint8_t (*hashes)[BLAKE3_HASH_LEN], size_t n_hashes,
+                             const char *viewer, meta_file_fn fn, void *ctx,
+                             meta_error_t *error) {
+    mongo_store_t *ms = (mongo_store_t *)s;
+    mongo_lease_t lease;
+    if (!lease_begin(ms, &lease, error)) return false;
+
+    bson_t *query = bson_new();
+    BSON_APPEND_BOOL(query, "deleted", false);
+
+    bson_t and_array, and_doc, key_array, key_doc, in_doc, in_array;
+    BSON_APPEND_ARRAY_BEGIN(query, "$and", &and_array);
+
+    // 1. Совпадение по имени или по хешу содержимого (индексы, $in)
+    BSON_APPEND_DOCUMENT_BEGIN(&and_array, "0", &and_doc);
+    BSON_APPEND_ARRAY_BEGIN(&and_doc, "$or", &key_array);
+
+    BSON_APPEND_DOCUMENT_BEGIN(&key_array, "0", &key_doc);
+    BSON_APPEND_DOCUMENT_BEGIN(&key_doc, "filename", &in_doc);
+    BSON_APPEND_ARRAY_BEGIN(&in_doc, "$in", &in_array);
+    for (size_t i = 0; i < n_names; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "%zu", i);
+        BSON_APPEND_UTF8(&in_array, key, names[i]);
+    }
+    bson_append_array_end(&in_doc, &in_array);
+    bson_append_document_end(&key_doc, &in_doc);
+    bson_append_document_end(&key_array, &key_doc);
+
+    BSON_APPEND_DOCUMENT_BEGIN(&key_array, "1", &key_doc);
+    BSON_APPEND_DOCUMENT_BEGIN(&key_doc, "content_hash", &in_doc);
+    BSON_APPEND_ARRAY_BEGIN(&in_doc, "$in", &in_array);
+    for (size_t i = 0; i < n_hashes; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "%zu", i);
+        BSON_APPEND_BINARY(&in_array, key, BSON_SUBTYPE_BINARY, hashes[i], BLAKE3_HASH_LEN);
+    }
+    bson_append_array_end(&in_doc, &in_array);
+    bson_append_document_end(&key_doc, &in_doc);
+    bson_append_document_end(&key_array, &key_doc);
+
+    bson_append_array_end(&and_doc, &key_array);
+    bson_append_document_end(&and_array, &and_doc);
+
+    // 2. Только файлы, видимые вызывающему: чужие приватные файлы
+    //    для него не существуют
+    BSON_APPEND_DOCUMENT_BEGIN(&and_array, "1", &and_doc);
+    append_visible_to(&and_doc, viewer);
+    bson_append_document_end(&and_array, &and_doc);
+
+    bson_append_array_end(query, &and_array);
+
+    // Старые версии идут первыми, чтобы победила самая свежая загрузка
+    bson_t *opts = BCON_NEW(
+        "projection", "{",
+            "filename", BCON_INT32(1),
+            "size", BCON_INT32(1),
+            "uploaded_at", BCON_INT32(1),
+            "content_hash", BCON_INT32(1),
+            "public", BCON_INT32(1),
+            "owner_fingerprint", BCON_INT32(1),
+            "recipient_fingerprint", BCON_INT32(1),
+        "}",
+        "sort", "{", "uploaded_at", BCON_INT32(1), "}"
+    );
+
+    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(lease.coll, query, opts, NULL);
+    bool ok = drain_files(cursor, fn, ctx, error);
+
+    mongoc_cursor_destroy(cursor);
+    bson_destroy(opts);
+    bson_destroy(query);
+    lease_end(ms, &lease);
+    return ok;
+}
+
+// Следующий номер события в proc map документа path
+static bool next_proc_key(mongoc_collection_t *coll, const char *path, int64_t *out,
+                          meta_error_t *error) {
+    bson_t *query = BCON_NEW("_id", BCON_UTF8(path));
+    bson_t *opts = BCON_NEW("projection", "{", "proc", BCON_INT32(1), "}");
+    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(coll, query, opts, NULL);
+
+    int64_t max_key = 0;
+    const bson_t *doc;
+    if (mongoc_cursor_next(cursor, &doc)) {
+        bson_iter_t iter;
+        if (bson_iter_init_find(&iter, doc, "proc") &&
+            BSON_ITER_HOLDS_DOCUMENT(&iter)) {
+
+            bson_iter_t child;
+            bson_iter_recurse(&iter, &child);
+
+            while (bson_iter_next(&child)) {
+                const char *key_str = bson_iter_key(&child);
+                char *endptr;
+                errno = 0;
+                long long num = strtoll(key_str, &endptr, 10);
+
+                if (errno == 0 && *endptr == '\0' && num > max_key) {
+                    max_key = num;
+                }
+            }
+        }
+    }
+
+    bson_error_t e;
+    bool ok = !mongoc_cursor_error(cursor, &e);
+    if (!ok) meta_set_error(error, "%s", e.message);
+
+    mongoc_cursor_destroy(cursor);
+    bson_destroy(opts);
+    bson_destroy(query);
+    *out = max_key + 1;
+    return ok;
+}
+
+// Базовый документ пути: имя, расширение и пустой proc map.
+// Уже существующий документ — не ошибка.
+static bool ensure_base_document(mongoc_collection_t *coll, const char *path,
+                                 meta_error_t *error) {
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    const char *dot = strrchr(name, '.');
+    if (dot == name) dot = NULL;
+    int name_len = dot ? (int)(dot - name) : (int)strlen(name);
+
+    bson_t *doc = bson_new();
+    BSON_APPEND_UTF8(doc, "_id", path);
+    bson_append_utf8(doc, "filename", -1, name, name_len);
+    BSON_APPEND_UTF8(doc, "extension", dot ? dot : "");
+
+    bson_t proc;
+    bson_init(&proc);
+    BSON_APPEND_DOCUMENT(doc, "proc", &proc);
+    bson_destroy(&proc);
+
+    bson_error_t e;
+    bool ok = mongoc_collection_insert_one(coll, doc, NULL, NULL, &e) || e.code == DUPLICATE_KEY;
+    if (!ok) meta_set_error(error, "%s", e.message);
+
+    bson_destroy(doc);
+    return ok;
+}
+
+static bool mongo_append_event(meta_store_t *s, const char *path, const meta_event_t *ev,
+                               uint64_t *seq, meta_error_t *error) {
+    mongo_store_t *ms = (mongo_store_t *)s;
+    mongo_lease_t lease;
+    if (!lease_begin(ms, &lease, error)) return false;
+
+    int64_t key;
+    if (!ensure_base_document(lease.coll, path, error) ||
+        !next_proc_key(lease.coll, path, &key, error)) {
+        lease_end(ms, &lease);
+        return false;
+    }
+
+    // Путь для обновления: "proc.<key>"
+    char set_path[64];
+    snprintf(set_path, sizeof(set_path), "proc.%" PRId64, key);
+
+    const meta_state_t *st = ev->state;
+    bson_t event_doc;
+    bson_init(&event_doc);
+    BSON_APPEND_DATE_TIME(&event_doc, "date", now_ms());
+
+    bson_t info_doc;
+    bson_init(&info_doc);
+    BSON_APPEND_UTF8(&info_doc, "type_of_changes", ev->type);
+    BSON_APPEND_UTF8(&info_doc, "status", ev->status);
+    if (ev->renamed_from) {
+        BSON_APPEND_UTF8(&info_doc, "renamed_from", ev->renamed_from);
+    }
+    if (st && st->exists) {
+        BSON_APPEND_INT64(&info_doc, "size", st->size);
+        if (st->hashed) {
+            BSON_APPEND_BINARY(&info_doc, "content_hash", BSON_SUBTYPE_BINARY,
+                               st->hash, BLAKE3_HASH_LEN);
+        }
+    }
+    BSON_APPEND_DOCUMENT(&event_doc, "info", &info_doc);
+
+    bson_t set_doc;
+    bson_init(&set_doc);
+    BSON_APPEND_DOCUMENT(&set_doc, set_path, &event_doc);
+
+    // state — последнее известное состояние файла, по нему сверка находит
+    // изменения, пропущенные мимо наблюдателя
+    bson_t state_doc;
+    bson_init(&state_doc);
+    if (st) {
+        BSON_APPEND_BOOL(&state_doc, "exists", st->exists);
+        if (st->exists) {
+            BSON_APPEND_INT64(&state_doc, "size", st->size);
+            BSON_APPEND_INT64(&state_doc, "mtime_ns", st->mtime_ns);
+            if (st->hashed) {
+                BSON_APPEND_BINARY(&state_doc, "content_hash", BSON_SUBTYPE_BINARY,
+                                   st->hash, BLAKE3_HASH_LEN);
+            }
+        }
+        BSON_APPEND_DOCUMENT(&set_doc, "state", &state_doc);
+    }
+
+    bson_t *update = BCON_NEW("$set", BCON_DOCUMENT(&set_doc));
+    bson_t *query = BCON_NEW("_id", BCON_UTF8(path));
+
+    bson_error_t e;
+    bool ok = mongoc_collection_update_one(lease.coll, query, update, NULL, NULL, &e);
+    if (!ok) meta_set_error(error, "%s", e.message);
+    if (ok && seq) *seq = (uint64_t)key;
+
+    bson_destroy(&state_doc);
+    bson_destroy(&set_doc);
+    bson_destroy(&info_doc);
+    bson_destroy(&event_doc);
+    bson_destroy(update);
+    bson_destroy(query);
+    lease_end(ms, &lease);
+    return ok;
+}
+
+static bool mongo_load_states(meta_store_t *s, const char *root, meta_state_fn fn, void *ctx,
+                              meta_error_t *error) {
+    mongo_store_t *ms = (mongo_store_t *)s;
+    mongo_lease_t lease;
+    if (!lease_begin(ms, &lease, error)) return false;
+
+    // Диапазон по _id вместо $regex: "root/" <= _id < "root0" ('0' следует за '/')
+    char lo[PATH_MAX], hi[PATH_MAX];
+    snprintf(lo, sizeof(lo), "%s/", root);
+    snprintf(hi, sizeof(hi), "%s0", root);
+
+    bson_t *query = BCON_NEW(
+        "_id", "{", "$gte", BCON_UTF8(lo), "$lt", BCON_UTF8(hi), "}",
+        "$or", "[",
+            "{", "state.exists", BCON_BOOL(true), "}",
+            "{", "state", "{", "$exists", BCON_BOOL(false), "}", "}",
+        "]");
+    bson_t *opts = BCON_NEW("projection", "{", "state", BCON_INT32(1), "}");
+
+    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(lease.coll, query, opts, NULL);
+    const bson_t *doc;
+    bool ok = true;
+
+    while (mongoc_cursor_next(cursor, &doc)) {
+        bson_iter_t iter;
+        if (!bson_iter_init_find(&iter, doc, "_id") || !BSON_ITER_HOLDS_UTF8(&iter)) continue;
+        const char *path = bson_iter_utf8(&iter, NULL);
+
+        int64_t size = -1, mtime_ns = 0;
+        bson_iter_t child;
+        if (bson_iter_init_find(&iter, doc, "state") && BSON_ITER_HOLDS_DOCUMENT(&iter) &&
+            bson_iter_recurse(&iter, &child)) {
+            while (bson_iter_next(&child)) {
+                if (strcmp(bson_iter_key(&child), "size") == 0) {
+                    size = bson_iter_as_int64(&child);
+                } else if (strcmp(bson_iter_key(&child), "mtime_ns") == 0) {
+                    mtime_ns = bson_iter_as_int64(&child);
+                }
+            }
+        }
+
+        if (!fn(ctx, path, size, mtime_ns)) {
+            meta_set_error(error, "state consumer failed");
+            ok = false;
+            break;
+        }
+    }
+
+    bson_error_t e;
+    if (ok && mongoc_cursor_error(cursor, &e)) {
+        meta_set_error(error, "%s", e.message);
+        ok = false;
+    }
+
+    mongoc_cursor_destroy(cursor);
+    bson_destroy(opts);
+    bson_destroy(query);
+    lease_end(ms, &lease);
+    return ok;
+}
+
+static int mongo_claim_legacy(meta_store_t *s, const char *filename, const char *object_id,
+                              meta_error_t *error) {
+    mongo_store_t *ms = (mongo_store_t *)s;
+    mongo_lease_t lease;
+    if (!lease_begin(ms, &lease, error)) return -1;
+
+    // У документов путей (proc) тоже есть filename, но нет uploaded_at
+    bson_t *query = BCON_NEW("filename", BCON_UTF8(filename),
+                             "uploaded_at", "{", "$exists", BCON_BOOL(true), "}",
+                             "object_id", "{", "$exists", BCON_BOOL(false), "}");
+    bson_t *sort = BCON_NEW("uploaded_at", BCON_INT32(-1));
+    bson_t *update = BCON_NEW("$set", "{", "object_id", BCON_UTF8(object_id), "}");
+    mongoc_find_and_modify_opts_t *opts = mongoc_find_and_modify_opts_new();
+    mongoc_find_and_modify_opts_set_sort(opts, sort);
+    mongoc_find_and_modify_opts_set_update(opts, update);
+
+    bson_t reply;
+    bson_error_t e;
+    int claimed;
+    if (!mongoc_collection_find_and_modify_with_opts(lease.coll, query, opts, &reply, &e)) {
+        meta_set_error(error, "%s", e.message);
+        claimed = -1;
+    } else {
+        // value — документ до изменения или null, если ничего не нашлось
+        bson_iter_t iter;
+        claimed = bson_iter_init_find(&iter, &reply, "value") &&
+                  BSON_ITER_HOLDS_DOCUMENT(&iter) ? 1 : 0;
+    }
+
+    bson_destroy(&reply);
+    mongoc_find_and_modify_opts_destroy(opts);
+    bson_destroy(update);
+    bson_destroy(sort);
+    bson_destroy(query);
+    lease_end(ms, &lease);
+    return claimed;
+}
+
+static void mongo_close(meta_store_t *s) {
+    mongo_store_t *ms = (mongo_store_t *)s;
+    if (ms->pool) mongoc_client_pool_destroy(ms->pool);
+    free(ms->database);
+    free(ms->collection);
+    free(ms);
+    mongoc_cleanup();
+}
+
+static const meta_store_ops_t g_mongo_ops = {
+    .insert_file = mongo_insert_file,
+    .find_latest = mongo_find_latest,
+    .list_visible = mongo_list_visible,
+    .stat_batch = mongo_stat_batch,
+    .append_event = mongo_append_event,
+    .load_states = mongo_load_states,
+    .claim_legacy = mongo_claim_legacy,
+    .close = mongo_close,
+};
+
+meta_store_t *meta_store_open_mongo(const char *uri, const char *database,
+                                    const char *collection, meta_error_t *error) {
+    mongoc_init();
+
+    mongo_store_t *ms = calloc(1, sizeof(*ms));
+    if (!ms || !(ms->database = strdup(database)) || !(ms->collection = strdup(collection))) {
+        meta_set_error(error, "out of memory");
+        goto fail;
+    }
+    ms->base = (meta_store_t){ .ops = &g_mongo_ops, .backend = META_BACKEND_MONGO };
+
+    bson_error_t e;
+    mongoc_uri_t *parsed = mongoc_uri_new_with_error(uri, &e);
+    if (!parsed) {
+        meta_set_error(error, "invalid URI %s: %s", uri, e.message);
+        goto fail;
+    }
+    ms->pool = mongoc_client_pool_new(parsed);
+    mongoc_uri_destroy(parsed);
+    if (!ms->pool) {
+        meta_set_error(error, "failed to create client pool for %s", uri);
+        goto fail;
+    }
+
+    mongoc_client_t *client = mongoc_client_pool_pop(ms->pool);
+    bson_t *ping = BCON_NEW("ping", BCON_INT32(1));
+    bool ok = mongoc_client_command_simple(client, "admin", ping, NULL, NULL, &e);
+    bson_destroy(ping);
+    if (!ok) {
+        mongoc_client_pool_push(ms->pool, client);
+        meta_set_error(error, "ping failed: %s", e.message);
+        goto fail;
+    }
+
+    // Индексы для DOWNLOAD и STAT ($in по filename / content_hash). Без них
+    // хранилище работает, но STAT превращается в полный просмотр коллекции,
+    // поэтому ошибка здесь не фатальна.
+    bson_t *index_cmd = BCON_NEW(
+        "createIndexes", BCON_UTF8(collection),
+        "indexes", "[",
+            "{", "key", "{", "filename", BCON_INT32(1), "}",
+                 "name", BCON_UTF8("filename_1"), "}",
+            "{", "key", "{", "content_hash", BCON_INT32(1), "}",
+                 "name", BCON_UTF8("content_hash_1"), "}",
+        "]"
+    );
+    meta_set_error(error, "%s", "");
+    if (!mongoc_client_command_simple(client, database, index_cmd, NULL, NULL, &e)) {
+        meta_set_error(error, "failed to create metadata indexes: %s", e.message);
+    }
+    bson_destroy(index_cmd);
+    mongoc_client_pool_push(ms->pool, client);
+
+    return &ms->base;
+
+fail:
+    if (ms) {
+        if (ms->pool) mongoc_client_pool_destroy(ms->pool);
+        free(ms->database);
+        free(ms->collection);
+        free(ms);
+    }
+    mongoc_cleanup();
+    return NULL;
+}
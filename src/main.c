@@ -7,14 +7,28 @@
 #include <unistd.h>
 #include <signal.h>
 #include <sys/stat.h>
-#include <sys/inotify.h>
+#include <dirent.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <limits.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/time.h>
 #include <time.h>
-#include <bson/bson.h>
-#include <mongoc/mongoc.h>
+#include <inttypes.h>
+
+#include "core/event_coalescer.h"
+#include "core/checkpoint.h"
+#include "core/event_pipeline.h"
+#include "core/hash_cache.h"
+#include "core/inotify_watcher.h"
+#include "core/latency_hist.h"
+#include "core/reconcile.h"
+#include "db/meta_store.h"
+#include "utils/logger.h"
 
 // Конфигурация
 #define PID_FILE "/tmp/exchange-daemon.pid"
@@ -24,299 +38,663 @@
 #define DATABASE_NAME "file_exchange"
 #define COLLECTION_NAME "file_groups"
 
-#define EVENT_BUFFER_SIZE (sizeof(struct inotify_event) + NAME_MAX + 1)
-#define MAX_KEY_LENGTH 32
+#define STATS_INTERVAL_SEC 60
+#define LOG_LEVEL_DEFAULT LOG_INFO // переопределяется EXCHANGE_LOG_LEVEL
+
+// Склейка событий: окно тишины (переопределяется EXCHANGE_QUIET_MS)
+#define QUIET_MS_DEFAULT 200
+#define COALESCER_MAX_PENDING 65536
+
+// Хеширование содержимого: кэш переживает перезапуск
+#define HASH_CACHE_FILE "/tmp/exchange-daemon.hashcache"
+#define HASH_CACHE_MAX_ENTRIES (1u << 20)
+
+// Контрольная точка записанного состояния: быстрый перезапуск без MongoDB
+#define CHECKPOINT_FILE "/tmp/exchange-daemon.checkpoint"
+#define CHECKPOINT_SYNC_BATCH 1024
+
+// Конвейер записи: очередь потока и порог, выше которого хеш не считается
+#define PIPELINE_RING_CAPACITY 4096
+#define PIPELINE_HASH_BACKLOG 1024
+
+// Расхождений сверки за один проход цикла событий
+#define RECONCILE_EMIT_SLICE 4096
+
+// Источник событий: inotify или fanotify (переопределяется EXCHANGE_WATCH_BACKEND)
+#define WATCH_BACKEND_DEFAULT WATCHER_INOTIFY
+
+// Хранилище метаданных (переопределяется EXCHANGE_META_BACKEND)
+#define META_BACKEND_DEFAULT META_BACKEND_MONGO
 
 // Глобальные переменные
 static volatile sig_atomic_t g_shutdown = 0;
-static mongoc_client_t *g_mongo_client = NULL;
-static FILE *g_log_file = NULL;
+static meta_store_t *g_meta = NULL;
 
-// Уровни логирования
-typedef enum {
-    LOG_DEBUG,
-    LOG_INFO,
-    LOG_WARNING,
-    LOG_ERROR
-} log_level_t;
+// Задержка от первого сырого события до фиксации в MongoDB (включает окно тишины)
+static latency_hist_t g_commit_latency;
+static pthread_mutex_t g_commit_latency_lock = PTHREAD_MUTEX_INITIALIZER;
 
-// Логирование
-static void logger(log_level_t level, const char *format, ...) {
-    if (!g_log_file) return;
-    
-    const char *level_str[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
-    char timestamp[20];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", tm_info);
-    
-    fprintf(g_log_file, "[%s] [%s] ", timestamp, level_str[level]);
-    
-    va_list args;
-    va_start(args, format);
-    vfprintf(g_log_file, format, args);
-    va_end(args);
+// Склейка событий по пути и таймер её ближайшего срока
+static coalescer_t *g_coalescer = NULL;
+static int g_debounce_fd = -1;
+static uint64_t g_debounce_armed_ns = 0;
+
+// Конвейер записи и кэш хешей
+static hash_cache_t *g_hash_cache = NULL;
+static event_pipeline_t *g_pipeline = NULL;
+
+// Что уже записано в MongoDB (NULL — контрольная точка недоступна)
+static checkpoint_t *g_checkpoint = NULL;
+
+// Сверка с диском запрошена (переполнение очереди событий ядра)
+static bool g_reconcile_requested = false;
+
+// Наблюдение за деревом
+static watcher_t *g_watcher = NULL;
+
+// Добавление события в proc map (renamed_from — прежний путь для переименования или NULL).
+// Вместе с событием обновляется state — последнее известное состояние файла,
+// по нему сверка находит изменения, пропущенные мимо inotify.
+// facts — размер, mtime и хеш содержимого; NULL — файла нет.
+static bool append_proc_event(const char *file_id, const char *change_type, const char *status,
+                              const char *renamed_from, const pipeline_event_t *facts) {
+    meta_state_t state = { .exists = facts != NULL };
+    if (facts) {
+        state.size = facts->size;
+        state.mtime_ns = facts->mtime_ns;
+        state.hashed = facts->hashed;
+        if (facts->hashed) memcpy(state.hash, facts->hash, sizeof(state.hash));
+    }
+    meta_event_t ev = {
+        .type = change_type,
+        .status = status,
+        .renamed_from = renamed_from,
+        .state = &state,
+    };
+    
+    // Номера событий выдаются чтением и записью без транзакции: безопасно,
+    // потому что события одного пути обрабатывает один поток конвейера
+    // (переименование пишет прежний путь отдельной половиной в его потоке)
+    uint64_t seq = 0;
+    meta_error_t err = {{0}};
+    if (!meta_append_event(g_meta, file_id, &ev, &seq, &err)) {
+        logger(LOG_ERROR, "Failed to append proc event for %s: %s", file_id, err.message);
+        return false;
+    }
     
-    fprintf(g_log_file, "\n");
-    fflush(g_log_file);
+    logger(LOG_INFO, "Added event %" PRIu64 " to %s: %s - %s", seq, file_id, change_type, status);
+    return true;
 }
 
-// Получение расширения файла
-static char* get_file_extension(const char *full_path) {
-    if (!full_path) return NULL;
+// Обработчик создания/модификации файла
+static bool handle_file_event(const pipeline_event_t *job, const char *event_type) {
+    const char *fullpath = job->path;
+    if (!job->exists) {
+        logger(LOG_DEBUG, "Skipping non-regular file: %s", fullpath);
+        return false;
+    }
     
-    const char *filename = strrchr(full_path, '/');
-    if (!filename) filename = full_path;
-    else filename++;
+    logger(LOG_INFO, "File %s: %s (%lld bytes%s)", event_type, fullpath, (long long)job->size,
+           job->hashed ? "" : ", not hashed");
     
-    const char *dot = strrchr(filename, '.');
-    if (!dot || dot == filename) {
-        return strdup("");
+    if (!append_proc_event(fullpath, event_type, "success", NULL, job)) {
+        logger(LOG_ERROR, "Failed to log %s event for: %s", event_type, fullpath);
+        return false;
     }
-    
-    return strdup(dot);
+    return true;
 }
 
-// Получение имени файла без расширения
-static char* get_filename_without_extension(const char* full_filename) {
-    const char *filename = strrchr(full_filename, '/');
-    if (!filename) filename = full_filename;
-    else filename++;
-    
-    const char *dot = strrchr(filename, '.');
-    size_t name_len = dot ? (size_t)(dot - filename) : strlen(filename);
+// Обработчик удаления файла
+static bool handle_file_deleted(const char *fullpath) {
+    logger(LOG_INFO, "File deleted: %s", fullpath);
     
-    char *result = malloc(name_len + 1);
-    if (!result) {
-        logger(LOG_ERROR, "Memory allocation failed in get_filename_without_extension");
-        return NULL;
+    if (!append_proc_event(fullpath, "deleted", "n/a", NULL, NULL)) {
+        logger(LOG_ERROR, "Failed to log deletion event for: %s", fullpath);
+        return false;
     }
-    
-    strncpy(result, filename, name_len);
-    result[name_len] = '\0';
-    return result;
+    return true;
 }
 
-// Получение следующего ключа для proc map
-static char* get_next_proc_key(const char *file_id) {
-    mongoc_collection_t *coll = mongoc_client_get_collection(
-        g_mongo_client, DATABASE_NAME, COLLECTION_NAME);
-    if (!coll) {
-        logger(LOG_ERROR, "Failed to get collection for file: %s", file_id);
-        return NULL;
+// Обработчик переименования внутри дерева: одна пара MOVED_FROM/MOVED_TO.
+// Прежний путь отмечает handle_rename_source в потоке своего пути.
+static bool handle_file_renamed(const pipeline_event_t *job) {
+    const char *fullpath = job->path;
+    const char *old_path = job->old_path;
+    if (!job->exists) {
+        logger(LOG_DEBUG, "Skipping non-regular file: %s", fullpath);
+        return false;
     }
     
-    bson_t *query = BCON_NEW("_id", BCON_UTF8(file_id));
-    bson_t *projection = BCON_NEW("proc", BCON_INT32(1));
-    bson_error_t error;
-    
-    char *next_key = NULL;
-    const bson_t *doc;
-    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
-        coll, query, NULL, NULL);
+    logger(LOG_INFO, "File renamed: %s -> %s", old_path, fullpath);
     
-    int64_t max_key = 0;
+    if (!append_proc_event(fullpath, "renamed", "success", old_path, job)) {
+        logger(LOG_ERROR, "Failed to log rename event for: %s", fullpath);
+        return false;
+    }
+    return true;
+}
+
+// Половина переименования для прежнего пути: его больше не существует
+static bool handle_rename_source(const pipeline_event_t *job) {
+    if (!append_proc_event(job->old_path, "deleted", "renamed", NULL, NULL)) {
+        logger(LOG_ERROR, "Failed to log rename source for: %s", job->old_path);
+        return false;
+    }
+    return true;
+}
+
+// Событие с размером и хешем, готовое к записи: единственное место записи в proc map.
+// Вызывается в рабочих потоках конвейера.
+static void record_fs_event(void *ctx, unsigned worker, const pipeline_event_t *job) {
+    (void)ctx;
+    (void)worker;
+    
+    bool committed = false;
+    
+    switch (job->kind) {
+        case FS_EVENT_MODIFIED:
+        case FS_EVENT_MOVED_TO:
+        case FS_EVENT_CREATED:
+            committed = handle_file_event(job, fs_event_kind_name(job->kind));
+            break;
+        case FS_EVENT_DELETED:
+            committed = handle_file_deleted(job->path);
+            break;
+        case FS_EVENT_RENAMED:
+            committed = job->rename_source ? handle_rename_source(job)
+                                           : handle_file_renamed(job);
+            break;
+    }
     
-    if (mongoc_cursor_next(cursor, &doc)) {
-        bson_iter_t iter;
-        if (bson_iter_init_find(&iter, doc, "proc") && 
-            BSON_ITER_HOLDS_DOCUMENT(&iter)) {
-            
-            bson_iter_t child;
-            bson_iter_recurse(&iter, &child);
-            
-            while (bson_iter_next(&child)) {
-                const char *key_str = bson_iter_key(&child);
-                char *endptr;
-                long num = strtol(key_str, &endptr, 10);
-                
-                if (errno == 0 && *endptr == '\0' && num > 0 && num > max_key) {
-                    max_key = num;
-                }
-            }
+    if (committed && g_checkpoint) {
+        // Записано — отмечаем в контрольной точке, пачка сбросится на диск сама
+        if (job->kind == FS_EVENT_DELETED) {
+            checkpoint_remove(g_checkpoint, job->path);
+        } else if (job->rename_source) {
+            checkpoint_remove(g_checkpoint, job->old_path);
+        } else {
+            checkpoint_put_file(g_checkpoint, job->path, job->ino, job->size, job->mtime_ns);
         }
-    } else {
-        logger(LOG_DEBUG, "No existing document found for: %s, starting from key 1", file_id);
     }
     
-    if (mongoc_cursor_error(cursor, &error)) {
-        logger(LOG_ERROR, "Cursor error for file %s: %s", file_id, error.message);
+    // Задержку считаем по событию, а не по половинам переименования
+    if (committed && !job->rename_source) {
+        uint64_t elapsed = latency_now_ns() - job->first_ns;
+        pthread_mutex_lock(&g_commit_latency_lock);
+        latency_hist_record(&g_commit_latency, elapsed);
+        pthread_mutex_unlock(&g_commit_latency_lock);
     }
+}
+
+// Итоговое событие после склейки уходит в конвейер записи
+static void dispatch_fs_event(void *ctx, const fs_event_t *ev) {
+    (void)ctx;
     
-    mongoc_cursor_destroy(cursor);
-    bson_destroy(query);
-    bson_destroy(projection);
-    mongoc_collection_destroy(coll);
-    
-    next_key = malloc(MAX_KEY_LENGTH);
-    if (!next_key) {
-        logger(LOG_ERROR, "Memory allocation failed for next_key");
-        return NULL;
+    if (ev->merged > 1) {
+        logger(LOG_DEBUG, "Coalesced %u events into %s: %s",
+               ev->merged, fs_event_kind_name(ev->kind), ev->path);
     }
     
-    snprintf(next_key, MAX_KEY_LENGTH, "%" PRId64, max_key + 1);
-    logger(LOG_DEBUG, "Next proc key for %s: %s", file_id, next_key);
-    return next_key;
+    if (pipeline_submit(g_pipeline, ev)) return;
+    
+    // Нет памяти на очередь — фиксируем без хеша прямо здесь
+    logger(LOG_WARNING, "Hash queue allocation failed, recording without hash: %s", ev->path);
+    pipeline_event_t job = {
+        .kind = ev->kind,
+        .path = (char *)ev->path,
+        .old_path = (char *)ev->old_path,
+        .first_ns = ev->first_ns,
+    };
+    struct stat st;
+    if (ev->kind != FS_EVENT_DELETED && lstat(ev->path, &st) == 0 && S_ISREG(st.st_mode)) {
+        job.exists = true;
+        job.ino = (uint64_t)st.st_ino;
+        job.size = (int64_t)st.st_size;
+        job.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    }
+    // Порядок по пути сохраняем: сначала дописываем то, что уже в очереди
+    pipeline_wait_idle(g_pipeline);
+    record_fs_event(NULL, 0, &job);
+    if (ev->kind == FS_EVENT_RENAMED) {
+        job.rename_source = true;
+        record_fs_event(NULL, 0, &job);
+    }
 }
 
-// Создание базового документа файла
-static bool create_base_document(const char *fullpath) {
-    mongoc_collection_t *coll = mongoc_client_get_collection(
-        g_mongo_client, DATABASE_NAME, COLLECTION_NAME);
-    if (!coll) {
-        logger(LOG_ERROR, "Failed to get collection for base document: %s", fullpath);
-        return false;
+// Взводит одноразовый таймер на ближайший срок склейки или снимает его
+static void arm_debounce_timer(void) {
+    uint64_t deadline = coalescer_next_deadline(g_coalescer);
+    if (deadline == g_debounce_armed_ns) return;
+    
+    struct itimerspec its = {0};
+    if (deadline) {
+        its.it_value.tv_sec = (time_t)(deadline / 1000000000ull);
+        its.it_value.tv_nsec = (long)(deadline % 1000000000ull);
     }
-    
-    char *filename = get_filename_without_extension(fullpath);
-    char *extension = get_file_extension(fullpath);
-    
-    if (!filename || !extension) {
-        logger(LOG_ERROR, "Failed to parse filename/extension for: %s", fullpath);
-        free(filename);
-        free(extension);
-        mongoc_collection_destroy(coll);
-        return false;
+    if (timerfd_settime(g_debounce_fd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+        logger(LOG_ERROR, "timerfd_settime failed for debounce timer: %s", strerror(errno));
+        return;
     }
-    
-    bson_t *doc = bson_new();
-    BSON_APPEND_UTF8(doc, "_id", fullpath);
-    BSON_APPEND_UTF8(doc, "filename", filename);
-    BSON_APPEND_UTF8(doc, "extension", extension);
-    
-    // Инициализируем пустой proc map
-    bson_t proc;
-    bson_init(&proc);
-    BSON_APPEND_DOCUMENT(doc, "proc", &proc);
-    bson_destroy(&proc);
-    
-    bson_error_t error;
-    bool success = mongoc_collection_insert_one(coll, doc, NULL, NULL, &error);
-    
-    if (!success) {
-        // Если документ уже существует, это не ошибка
-        if (error.code != 11000) { // Duplicate key error
-            logger(LOG_ERROR, "Failed to create base document for %s: %s", fullpath, error.message);
-        } else {
-            logger(LOG_DEBUG, "Base document already exists for: %s", fullpath);
-            success = true; // Документ уже существует, продолжаем
-        }
-    } else {
-        logger(LOG_INFO, "Created base document for: %s", fullpath);
+    g_debounce_armed_ns = deadline;
+}
+
+// Приёмник событий наблюдателя: в MongoDB пишет только dispatch_fs_event,
+// когда путь затихнет
+static void sink_modified(void *ctx, const char *path, uint64_t now_ns) {
+    coalescer_modified(ctx, path, now_ns);
+}
+
+static void sink_deleted(void *ctx, const char *path, uint64_t now_ns) {
+    coalescer_deleted(ctx, path, now_ns);
+}
+
+static void sink_moved_from(void *ctx, const char *path, uint32_t cookie, uint64_t now_ns) {
+    coalescer_moved_from(ctx, path, cookie, now_ns);
+}
+
+static void sink_moved_to(void *ctx, const char *path, uint32_t cookie, uint64_t now_ns) {
+    coalescer_moved_to(ctx, path, cookie, now_ns);
+}
+
+static void sink_renamed(void *ctx, const char *old_path, const char *path, uint64_t now_ns) {
+    coalescer_renamed(ctx, old_path, path, now_ns);
+}
+
+// Каталог перемещён за пределы дерева: удаляем всё, что под ним записано
+static void sink_subtree_removed(void *ctx, const char *dir, uint64_t now_ns) {
+    if (!g_checkpoint) {
+        // Без контрольной точки записанное под каталогом знает только MongoDB
+        logger(LOG_WARNING, "Directory left the tree: %s; scheduling reconciliation", dir);
+        g_reconcile_requested = true;
+        return;
     }
     
-    bson_destroy(doc);
-    free(filename);
-    free(extension);
-    mongoc_collection_destroy(coll);
-    
-    return success;
+    file_state_set_t gone = {0};
+    size_t n = checkpoint_collect_prefix(g_checkpoint, dir, &gone);
+    for (size_t i = 0; i < gone.len; i++) {
+        coalescer_deleted(ctx, gone.items[i].path, now_ns);
+    }
+    file_state_set_free(&gone);
+    logger(LOG_INFO, "Directory left the tree: %s (%zu files deleted)", dir, n);
 }
 
-// Добавление события в proc map
-static bool append_proc_event(const char *file_id, const char *change_type, const char *status) {
-    // Сначала убедимся, что базовый документ существует
-    if (!create_base_document(file_id)) {
-        logger(LOG_ERROR, "Failed to ensure base document for: %s", file_id);
-        return false;
+static void sink_overflow(void *ctx) {
+    (void)ctx;
+    // События потеряны — после разбора пачки сверимся с диском
+    logger(LOG_WARNING, "Event queue overflow, events were lost; scheduling reconciliation");
+    g_reconcile_requested = true;
+}
+
+static void sink_tree_added(void *ctx, const watcher_tree_report_t *r) {
+    (void)ctx;
+    if (r->backend == WATCHER_FANOTIFY) {
+        // fanotify: наблюдения не ставятся, только догоняющие события
+        logger(LOG_INFO, "Caught up %s: %llu files in %.1f ms (%llu entries, %llu walk errors)",
+               r->root, (unsigned long long)r->files_caught_up, r->elapsed_ms,
+               (unsigned long long)r->entries, (unsigned long long)r->walk_errors);
+        return;
     }
     
-    mongoc_collection_t *coll = mongoc_client_get_collection(
-        g_mongo_client, DATABASE_NAME, COLLECTION_NAME);
-    if (!coll) {
-        logger(LOG_ERROR, "Failed to get collection for event: %s", file_id);
+    logger(LOG_INFO, "Watching %s: +%zu dirs in %.1f ms (%llu entries, %llu walk errors); "
+           "inotify watches in use %zu of %ld (%.1f%%)",
+           r->root, r->dirs_added, r->elapsed_ms,
+           (unsigned long long)r->entries, (unsigned long long)r->walk_errors,
+           r->watches_in_use, r->max_watches,
+           r->max_watches > 0 ? 100.0 * (double)r->watches_in_use / (double)r->max_watches : 0.0);
+    
+    if (r->enospc > 0) {
+        logger(LOG_ERROR, "inotify watch budget exhausted: %llu directories are not watched, "
+               "raise %s", (unsigned long long)r->enospc, WATCHER_MAX_USER_WATCHES_FILE);
+    } else if (r->max_watches > 0 && r->watches_in_use * 10 > (size_t)r->max_watches * 9) {
+        logger(LOG_WARNING, "inotify watch budget above 90%%, consider raising %s",
+               WATCHER_MAX_USER_WATCHES_FILE);
+    }
+    if (r->failed > 0) {
+        logger(LOG_WARNING, "Failed to watch %llu directories under %s",
+               (unsigned long long)r->failed, r->root);
+    }
+}
+
+static const watcher_sink_t g_watch_sink = {
+    .modified = sink_modified,
+    .deleted = sink_deleted,
+    .moved_from = sink_moved_from,
+    .moved_to = sink_moved_to,
+    .renamed = sink_renamed,
+    .subtree_removed = sink_subtree_removed,
+    .overflow = sink_overflow,
+    .tree_added = sink_tree_added,
+};
+
+static bool add_recorded_state(void *ctx, const char *path, int64_t size, int64_t mtime_ns) {
+    if (!file_state_set_add(ctx, path, size, mtime_ns)) {
+        logger(LOG_ERROR, "Memory allocation failed while loading recorded state");
         return false;
     }
-    
-    char *next_key = get_next_proc_key(file_id);
-    if (!next_key) {
-        logger(LOG_ERROR, "Failed to get next proc key for: %s", file_id);
-        mongoc_collection_destroy(coll);
+    return true;
+}
+
+// Загружает из хранилища метаданных записанное состояние файлов под root.
+// Документы без state (записанные до его появления) попадают с size = -1,
+// и сверка один раз дозапишет их состояние.
+static bool load_recorded_state(const char *root, file_state_set_t *out) {
+    meta_error_t error;
+    if (!meta_load_states(g_meta, root, add_recorded_state, out, &error)) {
+        logger(LOG_ERROR, "Failed to load recorded state: %s", error.message);
         return false;
     }
     
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    int64_t now_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
-    
-    // Формируем путь для обновления: "proc.<next_key>"
-    char set_path[64];
-    snprintf(set_path, sizeof(set_path), "proc.%s", next_key);
-    
-    // Создаем документ события
-    bson_t event_doc;
-    bson_init(&event_doc);
-    BSON_APPEND_DATE_TIME(&event_doc, "date", now_ms);
+    file_state_set_sort(out);
+    return true;
+}
+
+static void reconcile_emit(void *ctx, reconcile_change_t change, const file_state_t *st) {
+    uint64_t now = *(uint64_t *)ctx;
+    switch (change) {
+        case RECONCILE_CREATED:  coalescer_created(g_coalescer, st->path, now); break;
+        case RECONCILE_MODIFIED: coalescer_modified(g_coalescer, st->path, now); break;
+        case RECONCILE_DELETED:  coalescer_deleted(g_coalescer, st->path, now); break;
+    }
+}
+
+// Заполняет контрольную точку файлами, чьё записанное состояние совпало
+// с диском; расхождения попадут в неё, когда будут записаны.
+// Оба набора отсортированы по пути.
+static void seed_checkpoint(const file_state_set_t *recorded, const file_state_set_t *actual) {
+    size_t i = 0, j = 0;
+    while (i < recorded->len && j < actual->len) {
+        int c = strcmp(recorded->items[i].path, actual->items[j].path);
+        if (c < 0) {
+            i++;
+        } else if (c > 0) {
+            j++;
+        } else {
+            const file_state_t *r = &recorded->items[i++];
+            const file_state_t *a = &actual->items[j++];
+            if (r->size == a->size && r->mtime_ns == a->mtime_ns) {
+                checkpoint_put_file(g_checkpoint, a->path, 0, a->size, a->mtime_ns);
+            }
+        }
+    }
+    checkpoint_add_dirs(g_checkpoint, EXCHANGE_DIR, tree_walk_default_threads());
+    checkpoint_sync(g_checkpoint);
+}
+
+// Расхождение, найденное сверкой; st указывает в снимки задания
+typedef struct {
+    reconcile_change_t change;
+    const file_state_t *st;
+} reconcile_change_entry_t;
+
+// Сверка в фоновом потоке: загрузка из MongoDB, обход и сравнение идут
+// мимо цикла событий, он только выдаёт найденное порциями
+typedef struct {
+    pthread_t thread;
+    bool running;          // поток работает или ещё не присоединён
+    bool emitting;         // расхождения выдаются в склейку
+    int done_fd;           // eventfd: поток закончил
+    
+    const char *reason;
+    bool seed;
+    pipeline_mark_t *mark; // записанное до старта сверки
+    
+    bool ok;
+    file_state_set_t recorded;
+    file_state_set_t actual;
+    reconcile_change_entry_t *changes;
+    size_t nchanges;
+    size_t cap;
+    size_t next;           // следующее к выдаче
+    reconcile_stats_t rs;
+    tree_walk_stats_t ws;
+    uint64_t started, loaded, scanned, diffed;
+} reconcile_job_t;
+
+static reconcile_job_t g_reconcile = { .done_fd = -1 };
+
+static void reconcile_collect(void *ctx, reconcile_change_t change, const file_state_t *st) {
+    reconcile_job_t *job = ctx;
+    if (!job->ok) return;
+    
+    if (job->nchanges == job->cap) {
+        size_t cap = job->cap ? job->cap * 2 : 1024;
+        reconcile_change_entry_t *grown = realloc(job->changes, cap * sizeof(*grown));
+        if (!grown) {
+            job->ok = false;
+            return;
+        }
+        job->changes = grown;
+        job->cap = cap;
+    }
+    job->changes[job->nchanges++] = (reconcile_change_entry_t){ change, st };
+}
+
+static void *reconcile_thread(void *arg) {
+    reconcile_job_t *job = arg;
     
-    bson_t info_doc;
-    bson_init(&info_doc);
-    BSON_APPEND_UTF8(&info_doc, "type_of_changes", change_type);
-    BSON_APPEND_UTF8(&info_doc, "status", status);
-    BSON_APPEND_DOCUMENT(&event_doc, "info", &info_doc);
+    // Записанное состояние не должно отставать от принятых событий
+    pipeline_wait_mark(g_pipeline, job->mark);
     
-    // Формируем операцию обновления
-    bson_t *update = BCON_NEW("$set", "{", set_path, BCON_DOCUMENT(&event_doc), "}");
-    bson_t *query = BCON_NEW("_id", BCON_UTF8(file_id));
+    job->ok = load_recorded_state(EXCHANGE_DIR, &job->recorded);
+    job->loaded = latency_now_ns();
     
-    bson_error_t error;
-    bool success = mongoc_collection_update_one(
-        coll, query, update, NULL, NULL, &error);
+    if (job->ok && reconcile_scan(EXCHANGE_DIR, tree_walk_default_threads(),
+                                  &job->actual, &job->ws) != 0) {
+        logger(LOG_ERROR, "Reconciliation scan of %s failed", EXCHANGE_DIR);
+        job->ok = false;
+    }
+    job->scanned = latency_now_ns();
     
-    if (!success) {
-        logger(LOG_ERROR, "Failed to append proc event for %s: %s", file_id, error.message);
-    } else {
-        logger(LOG_INFO, "Added event %s to %s: %s - %s", 
-               next_key, file_id, change_type, status);
+    if (job->ok) {
+        job->rs = reconcile_diff(&job->recorded, &job->actual, reconcile_collect, job);
+        if (!job->ok) logger(LOG_ERROR, "Memory allocation failed while collecting reconciliation changes");
     }
+    job->diffed = latency_now_ns();
     
-    // Очистка
-    bson_destroy(&info_doc);
-    bson_destroy(&event_doc);
-    bson_destroy(update);
-    bson_destroy(query);
-    free(next_key);
-    mongoc_collection_destroy(coll);
+    if (job->ok && job->seed && g_checkpoint) seed_checkpoint(&job->recorded, &job->actual);
     
-    return success;
+    uint64_t one = 1;
+    (void)!write(job->done_fd, &one, sizeof(one));
+    return NULL;
 }
 
-// Проверка, является ли путь обычным файлом
-static bool is_regular_file(const char *path) {
-    struct stat st;
-    if (stat(path, &st) != 0) {
-        logger(LOG_WARNING, "Failed to stat file: %s, error: %s", path, strerror(errno));
-        return false;
-    }
-    return S_ISREG(st.st_mode);
+static void reconcile_job_clear(reconcile_job_t *job) {
+    file_state_set_free(&job->recorded);
+    file_state_set_free(&job->actual);
+    free(job->changes);
+    free(job->mark);
+    job->changes = NULL;
+    job->nchanges = job->cap = job->next = 0;
+    job->mark = NULL;
+    job->emitting = false;
 }
 
-// Обработчик создания/модификации файла
-static void handle_file_event(const char *fullpath, const char *event_type) {
-    if (!is_regular_file(fullpath)) {
-        logger(LOG_DEBUG, "Skipping non-regular file: %s", fullpath);
+/**
+ * Сверка дерева с MongoDB: параллельный снимок диска против записанного
+ * state. Расхождения уходят синтетическими событиями через склейку,
+ * так что совпадения с живыми событиями ядра не пишутся дважды.
+ *
+ * Работа идёт в фоновом потоке; итог забирает finish_reconciliation()
+ * по done_fd. Пока сверка идёт, повторный запрос откладывается.
+ * С seed контрольная точка заполняется заново по результату сверки.
+ */
+static void start_reconciliation(const char *reason, bool seed) {
+    reconcile_job_t *job = &g_reconcile;
+    if (job->running || job->emitting) {
+        g_reconcile_requested = true;
         return;
     }
     
-    logger(LOG_INFO, "File %s: %s", event_type, fullpath);
-    
-    if (!append_proc_event(fullpath, event_type, "success")) {
-        logger(LOG_ERROR, "Failed to log %s event for: %s", event_type, fullpath);
+    // Накопленное фиксируем сразу, иначе записанное состояние отстаёт от диска
+    coalescer_flush(g_coalescer);
+    
+    // Сброс до старта: живые события, записанные во время сверки, и её
+    // расхождения уже попадут в новую контрольную точку. Пригодной она
+    // станет, только когда seed_checkpoint добавит каталоги
+    if (seed && g_checkpoint) checkpoint_reset(g_checkpoint);
+    
+    job->reason = reason;
+    job->seed = seed;
+    job->started = latency_now_ns();
+    job->mark = pipeline_mark(g_pipeline);
+    if (!job->mark || pthread_create(&job->thread, NULL, reconcile_thread, job) != 0) {
+        logger(LOG_ERROR, "Failed to start reconciliation (%s)", reason);
+        reconcile_job_clear(job);
+        return;
     }
+    job->running = true;
 }
 
-// Обработчик удаления файла
-static void handle_file_deleted(const char *fullpath) {
-    logger(LOG_INFO, "File deleted: %s", fullpath);
-    
-    if (!append_proc_event(fullpath, "deleted", "n/a")) {
-        logger(LOG_ERROR, "Failed to log deletion event for: %s", fullpath);
+// Поток сверки закончил: присоединяем и начинаем выдачу расхождений
+static void finish_reconciliation(void) {
+    reconcile_job_t *job = &g_reconcile;
+    uint64_t counter;
+    (void)!read(job->done_fd, &counter, sizeof(counter));
+    if (!job->running) return;
+    
+    pthread_join(job->thread, NULL);
+    job->running = false;
+    
+    if (!job->ok) {
+        reconcile_job_clear(job);
+        return;
+    }
+    job->emitting = true;
+}
+
+// Выдаёт в склейку очередную порцию расхождений; последняя завершает сверку
+static void emit_reconciliation_slice(void) {
+    reconcile_job_t *job = &g_reconcile;
+    uint64_t now = latency_now_ns();
+    size_t end = job->next + RECONCILE_EMIT_SLICE;
+    if (end > job->nchanges) end = job->nchanges;
+    
+    for (; job->next < end; job->next++) {
+        reconcile_emit(&now, job->changes[job->next].change, job->changes[job->next].st);
     }
+    if (job->next < job->nchanges) return;
+    
+    logger(LOG_INFO, "Reconciliation (%s): %zu files on disk, %zu recorded; "
+           "%llu created, %llu modified, %llu deleted, %llu unchanged; "
+           "load %.1f ms, scan %.1f ms (%llu dirs, %llu errors), diff %.1f ms, total %.1f ms",
+           job->reason, job->actual.len, job->recorded.len,
+           (unsigned long long)job->rs.created, (unsigned long long)job->rs.modified,
+           (unsigned long long)job->rs.deleted, (unsigned long long)job->rs.unchanged,
+           (double)(job->loaded - job->started) / 1e6,
+           (double)(job->scanned - job->loaded) / 1e6,
+           (unsigned long long)job->ws.dirs, (unsigned long long)job->ws.errors,
+           (double)(job->diffed - job->scanned) / 1e6,
+           (double)(latency_now_ns() - job->started) / 1e6);
+    
+    reconcile_job_clear(job);
 }
 
-// Обработчик сигналов
-static void signal_handler(int sig) {
-    logger(LOG_INFO, "Received signal %d, shutting down", sig);
-    g_shutdown = 1;
+// Завершение работы: ждём поток сверки, невыданное отбрасываем —
+// следующий старт сверится заново
+static void abandon_reconciliation(void) {
+    reconcile_job_t *job = &g_reconcile;
+    if (job->running) {
+        // Поток может ждать метку конвейера: доливаем список ожидания сами
+        pipeline_wait_idle(g_pipeline);
+        pthread_join(job->thread, NULL);
+        job->running = false;
+    }
+    if (job->emitting) {
+        logger(LOG_WARNING, "Shutting down with %zu reconciliation changes not yet recorded",
+               job->nchanges - job->next);
+    }
+    reconcile_job_clear(job);
+}
+
+/**
+ * Быстрый перезапуск: stat по записям контрольной точки вместо загрузки
+ * состояния из MongoDB. Перечитываются только каталоги с изменённым mtime.
+ */
+static void run_checkpoint_verification(void) {
+    uint64_t started = latency_now_ns();
+    
+    checkpoint_verify_stats_t vs = checkpoint_verify(g_checkpoint, reconcile_emit, &started);
+    
+    // mtime каталогов отмечаем, только когда найденное в них записано
+    coalescer_flush(g_coalescer);
+    pipeline_wait_idle(g_pipeline);
+    checkpoint_commit_dirs(g_checkpoint);
+    checkpoint_sync(g_checkpoint);
+    
+    checkpoint_stats_t cs = checkpoint_get_stats(g_checkpoint);
+    logger(LOG_INFO, "Checkpoint restart: %llu entries checked, %llu dirs rescanned; "
+           "%llu created, %llu modified, %llu deleted, %llu unchanged; "
+           "%llu files, %llu dirs, %.1f MiB; total %.1f ms",
+           (unsigned long long)vs.entries_checked, (unsigned long long)vs.dirs_rescanned,
+           (unsigned long long)vs.changes.created, (unsigned long long)vs.changes.modified,
+           (unsigned long long)vs.changes.deleted, (unsigned long long)vs.changes.unchanged,
+           (unsigned long long)cs.files, (unsigned long long)cs.dirs,
+           (double)cs.file_bytes / (1024.0 * 1024.0),
+           (double)(latency_now_ns() - started) / 1e6);
+}
+
+// Периодическая работа по таймеру: сводка задержек и склейки за интервал
+static void run_periodic_tasks(void) {
+    static coalescer_stats_t last;
+    coalescer_stats_t cs = coalescer_get_stats(g_coalescer);
+    uint64_t raw = cs.raw_events - last.raw_events;
+    uint64_t emitted = cs.emitted - last.emitted;
+    
+    if (raw > 0) {
+        logger(LOG_INFO, "Coalescer (last %ds): %llu raw events -> %llu writes (%.1fx), "
+               "%llu renames paired, %zu pending",
+               STATS_INTERVAL_SEC, (unsigned long long)raw, (unsigned long long)emitted,
+               emitted ? (double)raw / (double)emitted : 0.0,
+               (unsigned long long)(cs.renames_paired - last.renames_paired),
+               coalescer_pending(g_coalescer));
+    }
+    last = cs;
+    
+    static pipeline_stats_t last_pipe;
+    pipeline_stats_t ps = pipeline_get_stats(g_pipeline);
+    if (ps.submitted > last_pipe.submitted) {
+        logger(LOG_INFO, "Pipeline (last %ds): %llu events, %llu hashed (%.1f MiB), "
+               "%llu cache hits, %llu skipped (backlog), %llu failed; "
+               "%llu queued behind full workers, %zu waiting",
+               STATS_INTERVAL_SEC,
+               (unsigned long long)(ps.submitted - last_pipe.submitted),
+               (unsigned long long)(ps.hashed - last_pipe.hashed),
+               (double)(ps.bytes_hashed - last_pipe.bytes_hashed) / (1024.0 * 1024.0),
+               (unsigned long long)(ps.cache_hits - last_pipe.cache_hits),
+               (unsigned long long)(ps.skipped - last_pipe.skipped),
+               (unsigned long long)(ps.failed - last_pipe.failed),
+               (unsigned long long)(ps.spilled - last_pipe.spilled),
+               ps.spill_pending);
+        
+        // Противодавление по потокам: заполнение очереди и отставание
+        for (unsigned w = 0; w < pipeline_worker_count(g_pipeline); w++) {
+            pipeline_worker_stats_t ws = pipeline_get_worker_stats(g_pipeline, w);
+            logger(LOG_INFO, "  worker %u: queue %zu/%d (peak %zu), %llu processed, "
+                   "max queue wait %.1f ms, busy %.1f s",
+                   w, ws.occupancy, PIPELINE_RING_CAPACITY, ws.high_watermark,
+                   (unsigned long long)ws.processed, (double)ws.max_wait_ns / 1e6,
+                   (double)ws.busy_ns / 1e9);
+        }
+    }
+    last_pipe = ps;
+    
+    // Остаток пачки контрольной точки — на диск
+    if (g_checkpoint && !checkpoint_sync(g_checkpoint)) {
+        logger(LOG_WARNING, "Failed to sync checkpoint: %s", strerror(errno));
+    }
+    
+    // Снимок под замком, форматирование без него
+    latency_hist_t snapshot;
+    pthread_mutex_lock(&g_commit_latency_lock);
+    snapshot = g_commit_latency;
+    latency_hist_reset(&g_commit_latency);
+    pthread_mutex_unlock(&g_commit_latency_lock);
+    
+    if (snapshot.count == 0) return;
+    
+    char summary[256];
+    latency_hist_format(&snapshot, summary, sizeof(summary));
+    logger(LOG_INFO, "Event-to-commit latency (last %ds): %s", STATS_INTERVAL_SEC, summary);
 }
 
 // Проверка на уже запущенный демон
@@ -350,27 +728,41 @@ static bool write_pid_file(void) {
     return true;
 }
 
-// Инициализация MongoDB
-static bool init_mongodb(void) {
-    mongoc_init();
-    
-    g_mongo_client = mongoc_client_new(MONGODB_URI);
-    if (!g_mongo_client) {
-        logger(LOG_ERROR, "Failed to connect to MongoDB at %s", MONGODB_URI);
-        return false;
+// Хранилище метаданных: MongoDB или память (EXCHANGE_META_BACKEND).
+// Пул клиентов mongo-реализации нужен рабочим потокам конвейера.
+static bool init_metadata(void) {
+    meta_backend_t backend = META_BACKEND_DEFAULT;
+    const char *env = getenv("EXCHANGE_META_BACKEND");
+    if (env && *env && !meta_parse_backend(env, &backend)) {
+        logger(LOG_WARNING, "Invalid EXCHANGE_META_BACKEND=%s, using %s",
+               env, meta_backend_name(backend));
     }
     
-    // Проверяем подключение
-    bson_error_t error;
-    bool ping_success = mongoc_client_command_simple(
-        g_mongo_client, "admin", BCON_NEW("ping", BCON_INT32(1)), NULL, NULL, &error);
+    if (backend == META_BACKEND_MEMORY) {
+        meta_mem_options_t options = {0};
+        const char *spec = getenv("EXCHANGE_META_MEMORY");
+        if (spec && *spec && !meta_mem_parse_options(spec, &options)) {
+            logger(LOG_WARNING, "Invalid EXCHANGE_META_MEMORY=%s, ignoring", spec);
+            options = (meta_mem_options_t){0};
+        }
+        g_meta = meta_store_open_memory(&options);
+        if (!g_meta) {
+            logger(LOG_ERROR, "Failed to create in-memory metadata store");
+            return false;
+        }
+        logger(LOG_WARNING, "Metadata kept in memory: recorded events are lost on restart");
+        return true;
+    }
     
-    if (!ping_success) {
-        logger(LOG_ERROR, "MongoDB ping failed: %s", error.message);
-        mongoc_client_destroy(g_mongo_client);
-        g_mongo_client = NULL;
+    meta_error_t error;
+    g_meta = meta_store_open_mongo(MONGODB_URI, DATABASE_NAME, COLLECTION_NAME, &error);
+    if (!g_meta) {
+        logger(LOG_ERROR, "Failed to connect to MongoDB: %s", error.message);
         return false;
     }
+    if (error.message[0]) {
+        logger(LOG_WARNING, "MongoDB: %s", error.message);
+    }
     
     logger(LOG_INFO, "Successfully connected to MongoDB");
     return true;
@@ -380,50 +772,112 @@ static bool init_mongodb(void) {
 static void cleanup_resources(void) {
     logger(LOG_INFO, "Cleaning up resources");
     
-    if (g_mongo_client) {
-        mongoc_client_destroy(g_mongo_client);
-        g_mongo_client = NULL;
-    }
-    
-    mongoc_cleanup();
+    meta_store_close(g_meta);
+    g_meta = NULL;
     
-    if (g_log_file && g_log_file != stdout && g_log_file != stderr) {
-        fclose(g_log_file);
-        g_log_file = NULL;
-    }
+    // Последним: до него ещё пишут в журнал
+    log_shutdown();
     
     unlink(PID_FILE);
 }
 
 // Инициализация логирования
 static bool init_logging(void) {
-    g_log_file = fopen(LOG_FILE, "a");
-    if (!g_log_file) {
-        // Fallback to stderr
-        g_log_file = stderr;
-        fprintf(stderr, "Failed to open log file, using stderr\n");
+    log_level_t level = LOG_LEVEL_DEFAULT;
+    const char *env = getenv("EXCHANGE_LOG_LEVEL");
+    bool bad_level = env && *env && !log_parse_level(env, &level);
+    
+    // Недоступный файл — журнал уходит в stderr
+    if (!log_init(LOG_FILE, level)) {
+        fprintf(stderr, "Failed to start logger\n");
+        return false;
     }
+    if (bad_level) logger(LOG_WARNING, "Invalid EXCHANGE_LOG_LEVEL=%s, using info", env);
     
     logger(LOG_INFO, "Daemon started with PID %d", (int)getpid());
     return true;
 }
 
-// Настройка обработчиков сигналов
-static bool setup_signal_handlers(void) {
-    struct sigaction sa = {0};
-    sa.sa_handler = signal_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART;
+// Настройка сигналов: SIGINT/SIGTERM блокируются и читаются через signalfd
+static int setup_signal_fd(void) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1) {
+        logger(LOG_ERROR, "Failed to block signals: %s", strerror(errno));
+        return -1;
+    }
     
-    if (sigaction(SIGINT, &sa, NULL) == -1 ||
-        sigaction(SIGTERM, &sa, NULL) == -1) {
-        logger(LOG_ERROR, "Failed to setup signal handlers: %s", strerror(errno));
-        return false;
+    int sfd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (sfd == -1) {
+        logger(LOG_ERROR, "signalfd failed: %s", strerror(errno));
+        return -1;
     }
     
     // Игнорируем SIGPIPE
     signal(SIGPIPE, SIG_IGN);
     
+    return sfd;
+}
+
+// Периодический таймер для фоновых задач
+static int setup_timer_fd(void) {
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (tfd == -1) {
+        logger(LOG_ERROR, "timerfd_create failed: %s", strerror(errno));
+        return -1;
+    }
+    
+    struct itimerspec its = {
+        .it_interval = { .tv_sec = STATS_INTERVAL_SEC },
+        .it_value = { .tv_sec = STATS_INTERVAL_SEC },
+    };
+    if (timerfd_settime(tfd, 0, &its, NULL) == -1) {
+        logger(LOG_ERROR, "timerfd_settime failed: %s", strerror(errno));
+        close(tfd);
+        return -1;
+    }
+    
+    return tfd;
+}
+
+// Окно тишины из окружения, по умолчанию QUIET_MS_DEFAULT
+static uint64_t read_quiet_window_ns(void) {
+    long quiet_ms = QUIET_MS_DEFAULT;
+    const char *env = getenv("EXCHANGE_QUIET_MS");
+    if (env && *env) {
+        char *end;
+        errno = 0;
+        long v = strtol(env, &end, 10);
+        if (errno == 0 && *end == '\0' && v >= 0 && v <= 60000) {
+            quiet_ms = v;
+        } else {
+            logger(LOG_WARNING, "Invalid EXCHANGE_QUIET_MS=%s, using %d ms", env, QUIET_MS_DEFAULT);
+        }
+    }
+    logger(LOG_INFO, "Event quiet window: %ld ms", quiet_ms);
+    return (uint64_t)quiet_ms * 1000000ull;
+}
+
+// Источник событий из окружения, по умолчанию WATCH_BACKEND_DEFAULT
+static watcher_backend_t read_watch_backend(void) {
+    watcher_backend_t backend = WATCH_BACKEND_DEFAULT;
+    const char *env = getenv("EXCHANGE_WATCH_BACKEND");
+    if (env && *env && !watcher_parse_backend(env, &backend)) {
+        logger(LOG_WARNING, "Invalid EXCHANGE_WATCH_BACKEND=%s, using %s",
+               env, watcher_backend_name(WATCH_BACKEND_DEFAULT));
+    }
+    return backend;
+}
+
+static bool epoll_watch(int epfd, int fd) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        logger(LOG_ERROR, "epoll_ctl failed for fd %d: %s", fd, strerror(errno));
+        return false;
+    }
     return true;
 }
 
@@ -448,96 +902,186 @@ int main(void) {
     
     // Запись PID файла
     if (!write_pid_file()) {
+        log_shutdown();
         return EXIT_FAILURE;
     }
     
-    // Инициализация MongoDB
-    if (!init_mongodb()) {
+    // Инициализация хранилища метаданных
+    if (!init_metadata()) {
         cleanup_resources();
         return EXIT_FAILURE;
     }
     
     // Настройка обработчиков сигналов
-    if (!setup_signal_handlers()) {
+    int signal_fd = setup_signal_fd();
+    if (signal_fd == -1) {
         cleanup_resources();
         return EXIT_FAILURE;
     }
     
-    // Инициализация inotify
-    int inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
-    if (inotify_fd == -1) {
-        logger(LOG_ERROR, "inotify_init1 failed: %s", strerror(errno));
+    g_hash_cache = hash_cache_open(HASH_CACHE_FILE, HASH_CACHE_MAX_ENTRIES);
+    
+    // Без контрольной точки демон работает, но каждый старт сверяется с MongoDB
+    int cp_err = 0;
+    g_checkpoint = checkpoint_open(CHECKPOINT_FILE, CHECKPOINT_SYNC_BATCH, &cp_err);
+    if (!g_checkpoint) {
+        logger(LOG_WARNING, "Failed to open checkpoint %s: %s", CHECKPOINT_FILE, strerror(cp_err));
+    }
+    
+    g_pipeline = g_hash_cache ? pipeline_new(0, PIPELINE_RING_CAPACITY, PIPELINE_HASH_BACKLOG,
+                                             g_hash_cache, record_fs_event, NULL) : NULL;
+    g_coalescer = coalescer_new(read_quiet_window_ns(), COALESCER_MAX_PENDING,
+                                dispatch_fs_event, NULL);
+    if (!g_coalescer || !g_pipeline) {
+        logger(LOG_ERROR, "Failed to create event pipeline");
+        coalescer_free(g_coalescer);
+        pipeline_free(g_pipeline);
+        hash_cache_close(g_hash_cache);
+        checkpoint_close(g_checkpoint);
+        close(signal_fd);
         cleanup_resources();
         return EXIT_FAILURE;
     }
     
-    // Добавление наблюдения за директорией
-    int wd = inotify_add_watch(inotify_fd, EXCHANGE_DIR,
-                              IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM);
-    if (wd == -1) {
-        logger(LOG_ERROR, "inotify_add_watch failed for %s: %s", 
-               EXCHANGE_DIR, strerror(errno));
-        close(inotify_fd);
+    // Наблюдение за деревом: рекурсивный inotify или fanotify на всю ФС
+    watcher_backend_t backend = read_watch_backend();
+    int watch_err = 0;
+    g_watcher = watcher_open(backend, EXCHANGE_DIR, &g_watch_sink, g_coalescer, &watch_err);
+    if (!g_watcher) {
+        logger(LOG_ERROR, "Failed to watch directory tree %s with %s: %s%s",
+               EXCHANGE_DIR, watcher_backend_name(backend), strerror(watch_err),
+               (backend == WATCHER_FANOTIFY && watch_err == EPERM) ?
+                   " (fanotify requires CAP_SYS_ADMIN)" : "");
+        coalescer_free(g_coalescer);
+        pipeline_free(g_pipeline);
+        hash_cache_close(g_hash_cache);
+        checkpoint_close(g_checkpoint);
+        close(signal_fd);
         cleanup_resources();
         return EXIT_FAILURE;
     }
     
-    logger(LOG_INFO, "Started watching directory: %s", EXCHANGE_DIR);
+    hash_cache_stats_t hcs = hash_cache_get_stats(g_hash_cache);
+    logger(LOG_INFO, "Started watching directory tree: %s via %s (hash cache: %llu entries, "
+           "%u pipeline workers)", EXCHANGE_DIR, watcher_backend_name(backend),
+           (unsigned long long)hcs.entries, pipeline_worker_count(g_pipeline));
+    
+    // Изменения, сделанные пока демон не работал. Наблюдения уже стоят,
+    // поэтому всё, что случится во время сверки, придёт и через них.
+    // Полная сверка идёт в фоне, уже под циклом событий.
+    bool startup_reconcile = !g_checkpoint || !checkpoint_usable(g_checkpoint);
+    if (!startup_reconcile) run_checkpoint_verification();
+    
+    int timer_fd = setup_timer_fd();
+    g_debounce_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    g_reconcile.done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (timer_fd == -1 || g_debounce_fd == -1 || g_reconcile.done_fd == -1 || epoll_fd == -1 ||
+        !epoll_watch(epoll_fd, watcher_fd(g_watcher)) ||
+        !epoll_watch(epoll_fd, signal_fd) ||
+        !epoll_watch(epoll_fd, timer_fd) ||
+        !epoll_watch(epoll_fd, g_debounce_fd) ||
+        !epoll_watch(epoll_fd, pipeline_spill_fd(g_pipeline)) ||
+        !epoll_watch(epoll_fd, g_reconcile.done_fd)) {
+        logger(LOG_ERROR, "Failed to set up event loop: %s", strerror(errno));
+        if (epoll_fd >= 0) close(epoll_fd);
+        if (g_reconcile.done_fd >= 0) close(g_reconcile.done_fd);
+        if (g_debounce_fd >= 0) close(g_debounce_fd);
+        if (timer_fd >= 0) close(timer_fd);
+        close(signal_fd);
+        watcher_close(g_watcher);
+        coalescer_free(g_coalescer);
+        pipeline_free(g_pipeline);
+        hash_cache_close(g_hash_cache);
+        checkpoint_close(g_checkpoint);
+        cleanup_resources();
+        return EXIT_FAILURE;
+    }
     
-    // Основной цикл
-    char buffer[EVENT_BUFFER_SIZE * 128] __attribute__((aligned(__alignof__(struct inotify_event))));
+    latency_hist_reset(&g_commit_latency);
+    if (startup_reconcile) start_reconciliation("startup", true);
     
+    // Основной цикл: блокируемся в epoll без таймаута, пробуждения
+    // только по событиям файловой системы, сигналам и таймерам.
+    // Таймер склейки взведён, лишь пока есть накопленные события;
+    // пока сверка выдаёт расхождения, epoll только опрашивается.
     while (!g_shutdown) {
-        ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+        arm_debounce_timer();
         
-        if (len == -1) {
-            if (errno == EINTR) {
-                continue;
-            } else if (errno == EAGAIN) {
-                usleep(100000); // 100ms
-                continue;
-            } else {
-                logger(LOG_ERROR, "inotify read error: %s", strerror(errno));
-                break;
-            }
+        struct epoll_event events[8];
+        int n = epoll_wait(epoll_fd, events, 8, g_reconcile.emitting ? 0 : -1);
+        
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            logger(LOG_ERROR, "epoll_wait failed: %s", strerror(errno));
+            break;
         }
         
-        // Обработка событий inotify
-        for (char *ptr = buffer; ptr < buffer + len;) {
-            struct inotify_event *event = (struct inotify_event *)ptr;
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
             
-            if (event->len > 0) {
-                char fullpath[PATH_MAX];
-                int res = snprintf(fullpath, sizeof(fullpath), "%s/%s", 
-                                  EXCHANGE_DIR, event->name);
-                
-                if (res < 0 || (size_t)res >= sizeof(fullpath)) {
-                    logger(LOG_ERROR, "Path too long: %s/%s", EXCHANGE_DIR, event->name);
-                    ptr += sizeof(struct inotify_event) + event->len;
-                    continue;
+            if (fd == watcher_fd(g_watcher)) {
+                if (!watcher_process(g_watcher)) {
+                    logger(LOG_ERROR, "%s read error: %s",
+                           watcher_backend_name(backend), strerror(errno));
+                    g_shutdown = 1;
                 }
-                
-                if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
-                    handle_file_event(fullpath, 
-                                     (event->mask & IN_MOVED_TO) ? "moved_to" : "modified");
-                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
-                    handle_file_deleted(fullpath);
+            } else if (fd == signal_fd) {
+                struct signalfd_siginfo si;
+                while (read(signal_fd, &si, sizeof(si)) == sizeof(si)) {
+                    logger(LOG_INFO, "Received signal %d, shutting down", (int)si.ssi_signo);
+                    g_shutdown = 1;
                 }
+            } else if (fd == timer_fd) {
+                uint64_t expirations;
+                if (read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                    run_periodic_tasks();
+                }
+            } else if (fd == g_debounce_fd) {
+                uint64_t expirations;
+                if (read(g_debounce_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                    g_debounce_armed_ns = 0;
+                }
+                coalescer_advance(g_coalescer, latency_now_ns());
+            } else if (fd == pipeline_spill_fd(g_pipeline)) {
+                // Потоки освободили место: доливаем события, не вошедшие в очередь
+                pipeline_resume(g_pipeline);
+            } else if (fd == g_reconcile.done_fd) {
+                finish_reconciliation();
             }
-            
-            ptr += sizeof(struct inotify_event) + event->len;
+        }
+        
+        // Порция расхождений между ожиданиями epoll: события ядра не копятся
+        if (g_reconcile.emitting) emit_reconciliation_slice();
+        
+        if (g_reconcile_requested && !g_reconcile.running && !g_reconcile.emitting) {
+            g_reconcile_requested = false;
+            // Каталоги, созданные за время переполнения, тоже не под наблюдением
+            watcher_rescan(g_watcher);
+            start_reconciliation("event queue overflow", false);
         }
     }
     
+    // Накопленное не теряем: фиксируем всё до выхода
+    abandon_reconciliation();
+    coalescer_flush(g_coalescer);
+    pipeline_stop(g_pipeline);
+    run_periodic_tasks();
+    coalescer_free(g_coalescer);
+    pipeline_free(g_pipeline);
+    hash_cache_close(g_hash_cache);
+    checkpoint_close(g_checkpoint);
+    close(epoll_fd);
+    close(g_reconcile.done_fd);
+    close(g_debounce_fd);
+    close(timer_fd);
+    close(signal_fd);
+    
     // Завершение работы
     logger(LOG_INFO, "Shutting down daemon");
     
-    if (inotify_fd >= 0) {
-        if (wd >= 0) {
-            inotify_rm_watch(inotify_fd, wd);
-        }
-        close(inotify_fd);
-    }
+    // Закрытие fd снимает все наблюдения разом
+    watcher_close(g_watcher);
     
     cleanup_resources();
     return EXIT_SUCCESS;
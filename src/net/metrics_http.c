@@ -0,0 +1,174 @@
+// net/metrics_http.c
+// Минимальный HTTP/1.0 сервер для одного пути: ответ формирует
+// metrics_render(), разбор запроса — только строка запроса.
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "metrics_http.h"
+#include "../utils/metrics.h"
+
+#define METRICS_REQUEST_MAX 2048
+#define METRICS_IO_TIMEOUT_MS 1000 // медленный клиент не задерживает следующий сбор
+
+static struct {
+    int listen_fd;
+    int stop_fd;
+    uint16_t port;
+    pthread_t thread;
+    bool running;
+} g_http = { .listen_fd = -1, .stop_fd = -1 };
+
+static bool send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Читает заголовки до пустой строки; false — клиент ушёл или тянет время
+static bool read_request(int fd, char *buf, size_t cap) {
+    size_t len = 0;
+    while (len + 1 < cap) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, METRICS_IO_TIMEOUT_MS);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return false;
+
+        ssize_t n = recv(fd, buf + len, cap - 1 - len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        len += (size_t)n;
+        buf[len] = '\0';
+        if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n")) return true;
+    }
+    // Длинные заголовки не нужны: строки запроса достаточно
+    return true;
+}
+
+static void serve(int fd) {
+    char req[METRICS_REQUEST_MAX];
+    if (!read_request(fd, req, sizeof(req))) return;
+
+    char head[256];
+    if (strncmp(req, "GET /metrics ", 13) != 0 && strncmp(req, "GET /metrics?", 13) != 0) {
+        const char *body = "not found\n";
+        int n = snprintf(head, sizeof(head),
+                         "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n"
+                         "Content-Length: %zu\r\nConnection: close\r\n\r\n", strlen(body));
+        if (send_all(fd, head, (size_t)n)) send_all(fd, body, strlen(body));
+        return;
+    }
+
+    size_t len = 0;
+    char *body = metrics_render(&len);
+    if (!body) {
+        const char *err = "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n";
+        send_all(fd, err, strlen(err));
+        return;
+    }
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", len);
+    if (send_all(fd, head, (size_t)n)) send_all(fd, body, len);
+    free(body);
+}
+
+static void *http_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        struct pollfd fds[2] = {
+            { .fd = g_http.listen_fd, .events = POLLIN },
+            { .fd = g_http.stop_fd, .events = POLLIN },
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN) break;
+
+        int fd = accept4(g_http.listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+        struct timeval tv = { .tv_sec = METRICS_IO_TIMEOUT_MS / 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        serve(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+bool metrics_http_start(uint16_t port, int *err) {
+    if (g_http.running) return true;
+
+    g_http.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    g_http.stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (g_http.listen_fd < 0 || g_http.stop_fd < 0) goto fail;
+
+    int opt = 1;
+    setsockopt(g_http.listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(g_http.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(g_http.listen_fd, 8) != 0 ||
+        getsockname(g_http.listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        goto fail;
+    }
+    g_http.port = ntohs(addr.sin_port);
+
+    int rc = pthread_create(&g_http.thread, NULL, http_thread, NULL);
+    if (rc != 0) {
+        errno = rc;
+        goto fail;
+    }
+    g_http.running = true;
+    return true;
+
+fail:
+    if (err) *err = errno;
+    if (g_http.listen_fd >= 0) close(g_http.listen_fd);
+    if (g_http.stop_fd >= 0) close(g_http.stop_fd);
+    g_http.listen_fd = g_http.stop_fd = -1;
+    g_http.port = 0;
+    return false;
+}
+
+uint16_t metrics_http_port(void) {
+    return g_http.running ? g_http.port : 0;
+}
+
+void metrics_http_stop(void) {
+    if (!g_http.running) return;
+
+    uint64_t one = 1;
+    (void)!write(g_http.stop_fd, &one, sizeof(one));
+    pthread_join(g_http.thread, NULL);
+
+    close(g_http.listen_fd);
+    close(g_http.stop_fd);
+    g_http.listen_fd = g_http.stop_fd = -1;
+    g_http.port = 0;
+    g_http.running = false;
+}
@@ -0,0 +1,26 @@
+#ifndef METRICS_HTTP_H
+#define METRICS_HTTP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Точка сбора метрик для Prometheus: GET /metrics по обычному HTTP,
+// только на 127.0.0.1. Один фоновый поток, соединения обслуживаются по
+// очереди и закрываются после ответа — сборщик ходит раз в несколько секунд.
+
+/**
+ * @brief Начинает слушать 127.0.0.1:port.
+ *
+ * @param port порт; 0 — любой свободный (см. metrics_http_port)
+ * @param err  код errno при неудаче
+ * @return false, если порт занят или поток не создан
+ */
+bool metrics_http_start(uint16_t port, int *err);
+
+// Фактический порт или 0, если точка не запущена
+uint16_t metrics_http_port(void);
+
+// Останавливает поток и закрывает сокет
+void metrics_http_stop(void);
+
+#endif // METRICS_HTTP_H
@@ -0,0 +1,186 @@
+// net/notify_bus.c
+// Внутрипроцессная шина push-уведомлений для CMD_SUBSCRIBE.
+// Источник событий — путь загрузки в server.c, потребители — потоки
+// клиентов, удерживающие соединение открытым.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "notify_bus.h"
+
+#define NOTIFY_BUCKETS 64
+
+struct notify_subscriber {
+    char fingerprint[FINGERPRINT_LEN];
+    int efd;
+
+    pthread_mutex_t lock;
+    NotifyMessage queue[NOTIFY_QUEUE_CAP];
+    size_t head;
+    size_t count;
+    bool overflowed;
+
+    struct notify_subscriber *next;
+};
+
+// Подписчики разложены по корзинам по отпечатку, чтобы адресное
+// уведомление не обходило весь список.
+static notify_subscriber_t *g_buckets[NOTIFY_BUCKETS];
+static size_t g_subscriber_count = 0;
+static pthread_rwlock_t g_bus_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static unsigned bucket_of(const char *fingerprint) {
+    // FNV-1a по первым символам отпечатка — он уже равномерно распределён
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 16 && fingerprint[i]; i++) {
+        h ^= (uint8_t)fingerprint[i];
+        h *= 16777619u;
+    }
+    return h % NOTIFY_BUCKETS;
+}
+
+notify_subscriber_t *notify_bus_subscribe(const char *fingerprint) {
+    if (!fingerprint) return NULL;
+
+    notify_subscriber_t *sub = calloc(1, sizeof(*sub));
+    if (!sub) return NULL;
+
+    sub->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (sub->efd == -1) {
+        free(sub);
+        return NULL;
+    }
+
+    strncpy(sub->fingerprint, fingerprint, FINGERPRINT_LEN - 1);
+    pthread_mutex_init(&sub->lock, NULL);
+
+    unsigned b = bucket_of(sub->fingerprint);
+
+    pthread_rwlock_wrlock(&g_bus_lock);
+    sub->next = g_buckets[b];
+    g_buckets[b] = sub;
+    g_subscriber_count++;
+    pthread_rwlock_unlock(&g_bus_lock);
+
+    return sub;
+}
+
+void notify_bus_unsubscribe(notify_subscriber_t *sub) {
+    if (!sub) return;
+
+    unsigned b = bucket_of(sub->fingerprint);
+
+    // После снятия write-lock ни один publish больше не видит подписчика
+    pthread_rwlock_wrlock(&g_bus_lock);
+    for (notify_subscriber_t **pp = &g_buckets[b]; *pp; pp = &(*pp)->next) {
+        if (*pp == sub) {
+            *pp = sub->next;
+            g_subscriber_count--;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&g_bus_lock);
+
+    close(sub->efd);
+    pthread_mutex_destroy(&sub->lock);
+    free(sub);
+}
+
+int notify_subscriber_fd(const notify_subscriber_t *sub) {
+    return sub ? sub->efd : -1;
+}
+
+size_t notify_subscriber_drain(notify_subscriber_t *sub, NotifyMessage *out,
+                               size_t max, bool *overflowed) {
+    uint64_t counter;
+    // Сбрасываем счётчик eventfd до чтения очереди: событие, пришедшее
+    // после этого, снова разбудит poll().
+    while (read(sub->efd, &counter, sizeof(counter)) == -1 && errno == EINTR) {
+    }
+
+    pthread_mutex_lock(&sub->lock);
+
+    size_t n = sub->count < max ? sub->count : max;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = sub->queue[(sub->head + i) % NOTIFY_QUEUE_CAP];
+    }
+    sub->head = (sub->head + n) % NOTIFY_QUEUE_CAP;
+    sub->count -= n;
+
+    if (overflowed) *overflowed = sub->overflowed;
+    sub->overflowed = false;
+
+    bool more = sub->count > 0;
+    pthread_mutex_unlock(&sub->lock);
+
+    if (more) {
+        uint64_t one = 1;
+        (void)!write(sub->efd, &one, sizeof(one));
+    }
+
+    return n;
+}
+
+static bool enqueue(notify_subscriber_t *sub, const NotifyMessage *msg) {
+    pthread_mutex_lock(&sub->lock);
+
+    bool queued = false;
+    if (sub->count < NOTIFY_QUEUE_CAP) {
+        sub->queue[(sub->head + sub->count) % NOTIFY_QUEUE_CAP] = *msg;
+        sub->count++;
+        queued = true;
+    } else {
+        sub->overflowed = true;
+    }
+
+    pthread_mutex_unlock(&sub->lock);
+
+    uint64_t one = 1;
+    (void)!write(sub->efd, &one, sizeof(one));
+    return queued;
+}
+
+size_t notify_bus_publish(const NotifyMessage *msg, const char *recipient) {
+    if (!msg) return 0;
+
+    bool is_public = msg->flags & 0x01;
+    size_t delivered = 0;
+
+    pthread_rwlock_rdlock(&g_bus_lock);
+
+    if (g_subscriber_count == 0) {
+        pthread_rwlock_unlock(&g_bus_lock);
+        return 0;
+    }
+
+    if (is_public) {
+        for (unsigned b = 0; b < NOTIFY_BUCKETS; b++) {
+            for (notify_subscriber_t *sub = g_buckets[b]; sub; sub = sub->next) {
+                if (enqueue(sub, msg)) delivered++;
+            }
+        }
+    } else if (recipient && recipient[0] != '\0') {
+        for (notify_subscriber_t *sub = g_buckets[bucket_of(recipient)]; sub; sub = sub->next) {
+            if (strcmp(sub->fingerprint, recipient) == 0 && enqueue(sub, msg)) {
+                delivered++;
+            }
+        }
+    }
+
+    pthread_rwlock_unlock(&g_bus_lock);
+    return delivered;
+}
+
+size_t notify_bus_subscriber_count(void) {
+    pthread_rwlock_rdlock(&g_bus_lock);
+    size_t n = g_subscriber_count;
+    pthread_rwlock_unlock(&g_bus_lock);
+    return n;
+}
@@ -0,0 +1,58 @@
+#ifndef NOTIFY_BUS_H
+#define NOTIFY_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../include/protocol.h"
+
+// Ёмкость очереди одного подписчика. При переполнении старые
+// уведомления не теряются молча: подписчик получает NOTIFY_RESYNC.
+#define NOTIFY_QUEUE_CAP 256
+
+typedef struct notify_subscriber notify_subscriber_t;
+
+/**
+ * @brief Регистрирует подписчика на шине уведомлений.
+ *
+ * Подписчик получает события загрузки, где он указан получателем,
+ * и все публичные загрузки.
+ *
+ * @param fingerprint SHA-256 отпечаток клиентского сертификата (64 hex).
+ * @return подписчик или NULL при ошибке. Освобождать через notify_bus_unsubscribe().
+ */
+notify_subscriber_t *notify_bus_subscribe(const char *fingerprint);
+
+// Снимает подписку и освобождает ресурсы подписчика
+void notify_bus_unsubscribe(notify_subscriber_t *sub);
+
+// eventfd подписчика: становится читаемым, когда в очереди есть уведомления
+int notify_subscriber_fd(const notify_subscriber_t *sub);
+
+/**
+ * @brief Забирает накопленные уведомления из очереди подписчика.
+ *
+ * @param out        буфер для уведомлений
+ * @param max        ёмкость буфера
+ * @param overflowed выставляется в true, если с прошлого вызова часть событий потеряна
+ * @return количество скопированных уведомлений
+ */
+size_t notify_subscriber_drain(notify_subscriber_t *sub, NotifyMessage *out,
+                               size_t max, bool *overflowed);
+
+/**
+ * @brief Рассылает уведомление подходящим подписчикам.
+ *
+ * Не блокируется на медленных подписчиках: запись в очередь O(1),
+ * при переполнении выставляется флаг resync.
+ *
+ * @param msg       уведомление (поле flags bit 0 = public)
+ * @param recipient отпечаток получателя или пустая строка
+ * @return количество подписчиков, получивших уведомление
+ */
+size_t notify_bus_publish(const NotifyMessage *msg, const char *recipient);
+
+// Текущее количество подписчиков
+size_t notify_bus_subscriber_count(void);
+
+#endif // NOTIFY_BUS_H
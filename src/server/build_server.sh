@@ -19,9 +19,23 @@ set -e
 
 # Общие объекты (без SIMD)
 gcc -c server.c -o server.o -Iinclude -Ideps/blake3 -Wall -Wextra $(pkg-config --cflags libmongoc-1.0)
-gcc -c ../db/mongo_ops_server.c -o mongo_ops_server.o -Iinclude -Ideps/blake3 -Wall -Wextra $(pkg-config --cflags libmongoc-1.0)
+gcc -c ../db/meta_store.c -o meta_store.o -Wall -Wextra
+gcc -c ../db/meta_store_mem.c -o meta_store_mem.o -Wall -Wextra
+gcc -c ../db/meta_store_mongo.c -o meta_store_mongo.o -Wall -Wextra $(pkg-config --cflags libmongoc-1.0)
+gcc -c ../storage/object_store.c -o object_store.o -Wall -Wextra
+gcc -c ../storage/pack_store.c -o pack_store.o -Wall -Wextra
+gcc -c ../storage/sync_group.c -o sync_group.o -Wall -Wextra
+gcc -c ../storage/buffer_pool.c -o buffer_pool.o -Wall -Wextra
+gcc -c ../storage/chunk_cache.c -o chunk_cache.o -Wall -Wextra
+gcc -c ../storage/flight_group.c -o flight_group.o -Wall -Wextra
+gcc -c ../storage/layout_migrate.c -o layout_migrate.o -Wall -Wextra
 gcc -c ../utils/utils.c -o utils.o -Iinclude -Ideps/blake3 -Wall -Wextra
 gcc -c ../crypto/aes_gcm.c -o aes_gcm.o -Iinclude -Ideps/blake3 -Wall -Wextra
+gcc -c ../net/notify_bus.c -o notify_bus.o -Iinclude -Wall -Wextra
+gcc -c ../utils/logger.c -o logger.o -Wall -Wextra
+gcc -c ../utils/metrics.c -o metrics.o -Wall -Wextra
+gcc -c ../utils/request_trace.c -o request_trace.o -Wall -Wextra
+gcc -c ../net/metrics_http.c -o metrics_http.o -Wall -Wextra
 
 BLAKE3_DIR=../../deps/blake3
 # Компилируем BLAKE3 без AVX512
@@ -33,7 +47,13 @@ gcc -c $BLAKE3_DIR/blake3_sse41.c -o blake3_sse41.o -I$BLAKE3_DIR -Wall -Wextra
 gcc -c $BLAKE3_DIR/blake3_avx2.c -o blake3_avx2.o -I$BLAKE3_DIR -Wall -Wextra -mavx2
 
 # НЕ компилируем blake3_avx512.c
-gcc -o server server.o mongo_ops_server.o utils.o aes_gcm.o \
+gcc -o server server.o meta_store.o meta_store_mem.o meta_store_mongo.o object_store.o pack_store.o sync_group.o buffer_pool.o \
+    chunk_cache.o flight_group.o utils.o aes_gcm.o notify_bus.o logger.o metrics.o metrics_http.o request_trace.o \
     blake3.o blake3_dispatch.o blake3_portable.o \
     blake3_sse2.o blake3_sse41.o blake3_avx2.o blake3_avx512.o \
-    $(pkg-config --libs libmongoc-1.0) -lssl -lcrypto -lpthread
\ No newline at end of file
+    $(pkg-config --libs libmongoc-1.0) -lssl -lcrypto -lpthread
+
+# Перенос плоского каталога хранилища в веер xx/yy
+gcc -o migrate-storage migrate_storage.c layout_migrate.o object_store.o pack_store.o sync_group.o buffer_pool.o \
+    meta_store.o meta_store_mem.o meta_store_mongo.o -Wall -Wextra \
+    $(pkg-config --libs libmongoc-1.0) -lpthread
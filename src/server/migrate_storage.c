@@ -0,0 +1,93 @@
+// server/migrate_storage.c
+// Перенос плоского каталога хранилища в раскладку root/xx/yy/<id>
+// (storage/layout_migrate.h). Сервер можно не останавливать: скачивания
+// читают плоское имя, пока документ не получил object_id.
+//
+//   migrate-storage [--root DIR] [--uri URI] [--batch N] [--grace-ms MS] [--dry-run]
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../db/meta_store.h"
+#include "../storage/layout_migrate.h"
+#include "../storage/object_store.h"
+
+// Те же значения, что в server.c
+#define STORAGE_DIR "../../filetrade"
+#define MONGODB_URI "mongodb://localhost:27017"
+#define DATABASE_NAME "file_exchange"
+#define COLLECTION_NAME "file_groups"
+
+static void print_error(const char *name, const char *message, void *ctx) {
+    (void)ctx;
+    fprintf(stderr, "%s: %s\n", name, message);
+}
+
+int main(int argc, char **argv) {
+    const char *root = STORAGE_DIR;
+    const char *uri = MONGODB_URI;
+    layout_migrate_options_t opts;
+    layout_migrate_options_default(&opts);
+    opts.on_error = print_error;
+
+    for (int i = 1; i < argc; i++) {
+        const char *k = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(k, "--dry-run") == 0) {
+            opts.dry_run = true;
+            continue;
+        }
+        if (!v) {
+            fprintf(stderr, "%s needs a value\n", k);
+            return EXIT_FAILURE;
+        }
+        i++;
+        if (strcmp(k, "--root") == 0) root = v;
+        else if (strcmp(k, "--uri") == 0) uri = v;
+        else if (strcmp(k, "--batch") == 0) opts.batch = strtoul(v, NULL, 10);
+        else if (strcmp(k, "--grace-ms") == 0) opts.grace_ms = (unsigned)strtoul(v, NULL, 10);
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return EXIT_FAILURE;
+        }
+    }
+    if (opts.batch == 0) {
+        fprintf(stderr, "--batch must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    // Сегментами владеет сервер; мелкие объекты в плоской раскладке не
+    // лежали, переносятся только файлы
+    object_store_options_t store_opts;
+    object_store_options_default(&store_opts);
+    store_opts.no_pack = true;
+    int err = 0;
+    object_store_t *store = object_store_open(root, &store_opts, &err);
+    if (!store) {
+        fprintf(stderr, "%s: %s\n", root, strerror(err));
+        return EXIT_FAILURE;
+    }
+
+    meta_error_t error;
+    meta_store_t *meta = meta_store_open_mongo(uri, DATABASE_NAME, COLLECTION_NAME, &error);
+    if (!meta) {
+        fprintf(stderr, "metadata: %s\n", error.message);
+        object_store_close(store);
+        return EXIT_FAILURE;
+    }
+
+    layout_migrate_report_t report;
+    bool ok = layout_migrate(store, meta, &opts, &report, &err);
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", root, strerror(err));
+    } else {
+        printf("%s%zu scanned, %zu migrated, %zu already linked, %zu orphaned, %zu failed\n",
+               opts.dry_run ? "dry run: " : "", report.scanned, report.migrated,
+               report.already_linked, report.orphaned, report.failed);
+    }
+
+    meta_store_close(meta);
+    object_store_close(store);
+    return ok && report.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
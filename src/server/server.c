@@ -23,6 +23,7 @@
 #include <openssl/sha.h>
 #include <openssl/evp.h>
 #include <openssl/rand.h> 
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <arpa/inet.h>
@@ -31,46 +32,58 @@
 #include <sys/socket.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <poll.h>
 #include <unistd.h>
 #include <time.h>
-#include <mongoc/mongoc.h>
-#include <bson/bson.h>
 #include <openssl/ssl.h>
 
 #define BLAKE3_IMPLEMENTATION
 #include "blake3.h"
 
 // Подмодули
-#include "../db/mongo_ops_server.h"
 #include "../../include/protocol.h"
+#include "../db/meta_store.h"
 #include "../crypto/aes_gcm.h"
+#include "../net/metrics_http.h"
+#include "../net/notify_bus.h"
+#include "../storage/chunk_cache.h"
+#include "../storage/flight_group.h"
+#include "../storage/object_store.h"
+#include "../utils/logger.h"
+#include "../utils/metrics.h"
+#include "../utils/request_trace.h"
 
 // Конфигурация
 #define PORT 5151
 #define BUFFER_SIZE 4096
-#define MAX_KEY_LENGTH 32
 #define LOG_FILE "/tmp/file-server.log"
 #define MONGODB_URI "mongodb://localhost:27017"
 #define DATABASE_NAME "file_exchange"
 #define COLLECTION_NAME "file_groups"
+#define META_BACKEND_DEFAULT META_BACKEND_MONGO // переопределяется EXCHANGE_META_BACKEND
+#ifndef STORAGE_DIR // стенд bench_handlers подставляет временный каталог
 #define STORAGE_DIR "../../filetrade"
-
-// Hello world 
-// Уровни логирования
-typedef enum {
-    LOG_DEBUG,
-    LOG_INFO,
-    LOG_WARNING,
-    LOG_ERROR
-} log_level_t;
+#endif
+#define NOTIFY_KEEPALIVE_MS 30000
+#define SHUTDOWN_DRAIN_MS 2000 // сколько ждём потоков клиентов при остановке
+#define ACCEPT_RETRY_MS 100 // пауза после ошибки poll/accept, чтобы не крутиться вхолостую
+#define LOG_LEVEL_DEFAULT LOG_INFO // переопределяется EXCHANGE_LOG_LEVEL
+#define METRICS_PORT 9151 // только 127.0.0.1; переопределяется EXCHANGE_METRICS_PORT, 0 — выключить
+#define SLOW_REQUEST_MS 1000 // порог журнала медленных запросов; EXCHANGE_SLOW_REQUEST_MS, 0 — выключить
+#define SLOW_LOG_INTERVAL_MS 1000 // не больше одной строки о медленном запросе за интервал
 
 // Глобальные переменные
-static volatile sig_atomic_t g_shutdown = 0;
-mongoc_client_t *g_mongo_client = NULL;
-mongoc_collection_t *g_collection = NULL;
+static volatile sig_atomic_t g_shutdown = 0;   // номер сигнала остановки
+static int g_shutdown_fd = -1;                  // eventfd: читаем при остановке
+static meta_store_t *g_meta = NULL;         // метаданные: MongoDB или память
+static object_store_t *g_objects = NULL;     // зашифрованные файлы в STORAGE_DIR
+static chunk_cache_t *g_chunks = NULL;       // расшифрованные куски популярных файлов, NULL — выключен
+static flight_group_t *g_flights = NULL;     // одновременные скачивания одного объекта
+static flight_group_t *g_uploads = NULL;     // одновременные загрузки одного содержимого (BLAKE3)
 static SSL_CTX *g_ssl_ctx = NULL;
-static FILE *g_log_file = NULL;
 
 // Контекст шифрования
 typedef struct {
@@ -80,258 +93,155 @@ typedef struct {
 
 static file_crypto_ctx_t g_file_crypto = {0};
 
+// Метрики сервера (регистрируются в init_metrics)
+typedef enum {
+    MONGO_OP_INSERT,
+    MONGO_OP_FIND,
+    MONGO_OP_LIST,
+    MONGO_OP_STAT,
+    MONGO_OP_PROC_EVENT,
+    MONGO_OP_COUNT
+} mongo_op_t;
+
+typedef enum {
+    CRYPTO_OP_BLAKE3,
+    CRYPTO_OP_ENCRYPT,
+    CRYPTO_OP_DECRYPT,
+    CRYPTO_OP_COUNT
+} crypto_op_t;
+
+static struct {
+    metric_id_t connections;
+    metric_id_t active_connections;
+    metric_id_t handshake_failures;
+    metric_id_t missing_client_cert;
+    metric_id_t bytes_in;
+    metric_id_t bytes_out;
+    metric_id_t requests[CMD_UNKNOWN + 1];
+    metric_id_t request_duration[CMD_UNKNOWN + 1];
+    metric_id_t upload_size;
+    metric_id_t mongo_duration[MONGO_OP_COUNT];
+    metric_id_t mongo_errors[MONGO_OP_COUNT];
+    metric_id_t crypto_duration[CRYPTO_OP_COUNT];
+    metric_id_t crypto_bytes[CRYPTO_OP_COUNT];
+    metric_id_t phase_duration[CMD_UNKNOWN + 1][TRACE_PHASES]; // -1 — фаза не бывает у команды
+    metric_id_t slow_requests;
+    metric_id_t chunk_cache_hits;
+    metric_id_t chunk_cache_misses;
+    metric_id_t download_coalesced;
+    metric_id_t upload_coalesced;
+} g_metrics;
+
+static uint64_t g_slow_request_ns;
+static trace_sampler_t g_slow_sampler;
+
+static void observe_since(metric_id_t histogram, uint64_t started) {
+    metrics_observe(histogram, metrics_now_ns() - started);
+}
+
 // Информация о клиенте
-typedef struct {
+typedef struct client_info {
     int client_socket;
     struct sockaddr_in client_addr;
     SSL *ssl;
     char fingerprint[65];
+    struct client_info *prev, *next; // список g_clients
 } client_info_t;
 
-// Логирование
-static void logger(log_level_t level, const char *format, ...) {
-    if (!g_log_file) return;
-    
-    const char *level_str[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
-    char timestamp[20];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", tm_info);
-    
-    fprintf(g_log_file, "[%s] [%s] ", timestamp, level_str[level]);
-    
-    va_list args;
-    va_start(args, format);
-    vfprintf(g_log_file, format, args);
-    va_end(args);
-    
-    fprintf(g_log_file, "\n");
-    fflush(g_log_file);
+// Потоки клиентов отсоединены; при остановке их будят shutdown() сокетов и
+// ждут, пока последний не выйдет, — только потом закрываются хранилища,
+// на которых они могут стоять (sync_group_wait, pack_store_put)
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t idle;  // count стал 0
+    client_info_t *head;
+    size_t count;
+} g_clients = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0 };
+
+static void client_register(client_info_t *info) {
+    pthread_mutex_lock(&g_clients.lock);
+    info->prev = NULL;
+    info->next = g_clients.head;
+    if (g_clients.head) g_clients.head->prev = info;
+    g_clients.head = info;
+    g_clients.count++;
+    pthread_mutex_unlock(&g_clients.lock);
 }
 
-// Получение расширения файла
-static char* get_file_extension(const char *full_path) {
-    if (!full_path) return NULL;
-    
-    const char *filename = strrchr(full_path, '/');
-    if (!filename) filename = full_path;
-    else filename++;
-    
-    const char *dot = strrchr(filename, '.');
-    if (!dot || dot == filename) {
-        return strdup("");
-    }
-    
-    return strdup(dot);
+// Снимает клиента с учёта и закрывает сокет; close под блокировкой, чтобы
+// drain_clients не сделал shutdown() чужому дескриптору с тем же номером
+static void client_done(client_info_t *info) {
+    pthread_mutex_lock(&g_clients.lock);
+    if (info->prev) info->prev->next = info->next;
+    else g_clients.head = info->next;
+    if (info->next) info->next->prev = info->prev;
+    close(info->client_socket);
+    if (--g_clients.count == 0) pthread_cond_broadcast(&g_clients.idle);
+    pthread_mutex_unlock(&g_clients.lock);
+    free(info);
 }
 
-// Получение имени файла без расширения
-static char* get_filename_without_extension(const char* full_filename) {
-    const char *filename = strrchr(full_filename, '/');
-    if (!filename) filename = full_filename;
-    else filename++;
-    
-    const char *dot = strrchr(filename, '.');
-    size_t name_len = dot ? (size_t)(dot - filename) : strlen(filename);
-    
-    char *result = malloc(name_len + 1);
-    if (!result) {
-        logger(LOG_ERROR, "Memory allocation failed in get_filename_without_extension");
-        return NULL;
-    }
-    
-    strncpy(result, filename, name_len);
-    result[name_len] = '\0';
-    return result;
+static size_t clients_active(void) {
+    pthread_mutex_lock(&g_clients.lock);
+    size_t n = g_clients.count;
+    pthread_mutex_unlock(&g_clients.lock);
+    return n;
+}
+
+// Будит все соединения (чтение и запись вернут ошибку) и ждёт выхода
+// потоков не дольше SHUTDOWN_DRAIN_MS; возвращает, сколько осталось
+static size_t drain_clients(void) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SHUTDOWN_DRAIN_MS / 1000;
+    deadline.tv_nsec += (long)(SHUTDOWN_DRAIN_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    
+    pthread_mutex_lock(&g_clients.lock);
+    for (client_info_t *c = g_clients.head; c; c = c->next) {
+        shutdown(c->client_socket, SHUT_RDWR);
+    }
+    while (g_clients.count > 0) {
+        if (pthread_cond_timedwait(&g_clients.idle, &g_clients.lock, &deadline) == ETIMEDOUT) break;
+    }
+    size_t left = g_clients.count;
+    pthread_mutex_unlock(&g_clients.lock);
+    return left;
 }
 
 // Вычисление хеша BLAKE3
 static void compute_buffer_blake3(const uint8_t *data, size_t len, uint8_t out_hash[BLAKE3_HASH_LEN]) {
+    uint64_t started = metrics_now_ns();
     blake3_hasher hasher;
     blake3_hasher_init(&hasher);
     blake3_hasher_update(&hasher, data, len);
     blake3_hasher_finalize(&hasher, out_hash, BLAKE3_HASH_LEN);
-}
-
-// Получение следующего ключа для proc map
-static char* get_next_proc_key(const char *file_id) {
-    mongoc_collection_t *coll = mongoc_client_get_collection(
-        g_mongo_client, DATABASE_NAME, COLLECTION_NAME);
-    if (!coll) {
-        logger(LOG_ERROR, "Failed to get collection for file: %s", file_id);
-        return NULL;
-    }
-    
-    bson_t *query = BCON_NEW("_id", BCON_UTF8(file_id));
-    bson_t *projection = BCON_NEW("proc", BCON_INT32(1));
-    bson_error_t error;
-    
-    char *next_key = NULL;
-    const bson_t *doc;
-    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
-        coll, query, NULL, NULL);
-    
-    int64_t max_key = 0;
-    
-    if (mongoc_cursor_next(cursor, &doc)) {
-        bson_iter_t iter;
-        if (bson_iter_init_find(&iter, doc, "proc") && 
-            BSON_ITER_HOLDS_DOCUMENT(&iter)) {
-            
-            bson_iter_t child;
-            bson_iter_recurse(&iter, &child);
-            
-            while (bson_iter_next(&child)) {
-                const char *key_str = bson_iter_key(&child);
-                char *endptr;
-                long num = strtol(key_str, &endptr, 10);
-                
-                if (errno == 0 && *endptr == '\0' && num > 0 && num > max_key) {
-                    max_key = num;
-                }
-            }
-        }
-    } else {
-        logger(LOG_DEBUG, "No existing document found for: %s, starting from key 1", file_id);
-    }
-    
-    if (mongoc_cursor_error(cursor, &error)) {
-        logger(LOG_ERROR, "Cursor error for file %s: %s", file_id, error.message);
-    }
-    
-    mongoc_cursor_destroy(cursor);
-    bson_destroy(query);
-    bson_destroy(projection);
-    mongoc_collection_destroy(coll);
-    
-    next_key = malloc(MAX_KEY_LENGTH);
-    if (!next_key) {
-        logger(LOG_ERROR, "Memory allocation failed for next_key");
-        return NULL;
-    }
-    
-    snprintf(next_key, MAX_KEY_LENGTH, "%" PRId64, max_key + 1);
-    return next_key;
-}
-
-// Создание базового документа файла
-static bool create_base_document(const char *fullpath) {
-    mongoc_collection_t *coll = mongoc_client_get_collection(
-        g_mongo_client, DATABASE_NAME, COLLECTION_NAME);
-    if (!coll) {
-        logger(LOG_ERROR, "Failed to get collection for base document: %s", fullpath);
-        return false;
-    }
-    
-    char *filename = get_filename_without_extension(fullpath);
-    char *extension = get_file_extension(fullpath);
-    
-    if (!filename || !extension) {
-        logger(LOG_ERROR, "Failed to parse filename/extension for: %s", fullpath);
-        free(filename);
-        free(extension);
-        mongoc_collection_destroy(coll);
-        return false;
-    }
-    
-    bson_t *doc = bson_new();
-    BSON_APPEND_UTF8(doc, "_id", fullpath);
-    BSON_APPEND_UTF8(doc, "filename", filename);
-    BSON_APPEND_UTF8(doc, "extension", extension);
-    
-    // Инициализируем пустой proc map
-    bson_t proc;
-    bson_init(&proc);
-    BSON_APPEND_DOCUMENT(doc, "proc", &proc);
-    bson_destroy(&proc);
-    
-    bson_error_t error;
-    bool success = mongoc_collection_insert_one(coll, doc, NULL, NULL, &error);
-    
-    if (!success) {
-        // Если документ уже существует, это не ошибка
-        if (error.code != 11000) {
-            logger(LOG_ERROR, "Failed to create base document for %s: %s", fullpath, error.message);
-        } else {
-            logger(LOG_DEBUG, "Base document already exists for: %s", fullpath);
-            success = true;
-        }
-    } else {
-        logger(LOG_INFO, "Created base document for: %s", fullpath);
-    }
-    
-    bson_destroy(doc);
-    free(filename);
-    free(extension);
-    mongoc_collection_destroy(coll);
-    
-    return success;
+    observe_since(g_metrics.crypto_duration[CRYPTO_OP_BLAKE3], started);
+    metrics_add(g_metrics.crypto_bytes[CRYPTO_OP_BLAKE3], len);
 }
 
 // Добавление события в proc map
 static bool append_proc_event(const char *file_id, const char *change_type, const char *status) {
-    // Сначала убедимся, что базовый документ существует
-    if (!create_base_document(file_id)) {
-        logger(LOG_ERROR, "Failed to ensure base document for: %s", file_id);
-        return false;
-    }
+    uint64_t started = metrics_now_ns();
+    meta_event_t ev = { .type = change_type, .status = status };
+    meta_error_t error;
+    uint64_t seq = 0;
     
-    mongoc_collection_t *coll = mongoc_client_get_collection(
-        g_mongo_client, DATABASE_NAME, COLLECTION_NAME);
-    if (!coll) {
-        logger(LOG_ERROR, "Failed to get collection for event: %s", file_id);
-        return false;
-    }
-    
-    char *next_key = get_next_proc_key(file_id);
-    if (!next_key) {
-        logger(LOG_ERROR, "Failed to get next proc key for: %s", file_id);
-        mongoc_collection_destroy(coll);
-        return false;
-    }
-    
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    int64_t now_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
-    
-    // Формируем путь для обновления: "proc.<next_key>"
-    char set_path[64];
-    snprintf(set_path, sizeof(set_path), "proc.%s", next_key);
-    
-    // Создаем документ события
-    bson_t event_doc;
-    bson_init(&event_doc);
-    BSON_APPEND_DATE_TIME(&event_doc, "date", now_ms);
-    
-    bson_t info_doc;
-    bson_init(&info_doc);
-    BSON_APPEND_UTF8(&info_doc, "type_of_changes", change_type);
-    BSON_APPEND_UTF8(&info_doc, "status", status);
-    BSON_APPEND_DOCUMENT(&event_doc, "info", &info_doc);
-    
-    // Формируем операцию обновления
-    bson_t *update = BCON_NEW("$set", "{", set_path, BCON_DOCUMENT(&event_doc), "}");
-    bson_t *query = BCON_NEW("_id", BCON_UTF8(file_id));
-    
-    bson_error_t error;
-    bool success = mongoc_collection_update_one(
-        coll, query, update, NULL, NULL, &error);
+    // Три обращения к MongoDB: документ, ключ proc и само обновление
+    bool success = meta_append_event(g_meta, file_id, &ev, &seq, &error);
+    observe_since(g_metrics.mongo_duration[MONGO_OP_PROC_EVENT], started);
     
     if (!success) {
         logger(LOG_ERROR, "Failed to append proc event for %s: %s", file_id, error.message);
+        metrics_inc(g_metrics.mongo_errors[MONGO_OP_PROC_EVENT]);
     } else {
-        logger(LOG_INFO, "Added event %s to %s: %s - %s", 
-               next_key, file_id, change_type, status);
+        logger(LOG_INFO, "Added event %" PRIu64 " to %s: %s - %s", 
+               seq, file_id, change_type, status);
     }
     
-    // Очистка
-    bson_destroy(&info_doc);
-    bson_destroy(&event_doc);
-    bson_destroy(update);
-    bson_destroy(query);
-    free(next_key);
-    mongoc_collection_destroy(coll);
-    
     return success;
 }
 
@@ -345,6 +255,7 @@ static int ssl_send_all(SSL *ssl, const void *buf, size_t len) {
             return -1;
         }
         sent += n;
+        metrics_add(g_metrics.bytes_out, (uint64_t)n);
     }
     
     return 0;
@@ -359,6 +270,7 @@ static int ssl_recv_all(SSL *ssl, void *buffer, size_t len) {
         bytes = SSL_read(ssl, (char*)buffer + total, len - total);
         if (bytes <= 0) return -1;
         total += bytes;
+        metrics_add(g_metrics.bytes_in, (uint64_t)bytes);
     }
     
     return total;
@@ -368,42 +280,13 @@ static int ssl_recv_all(SSL *ssl, void *buffer, size_t len) {
 static int enhanced_aes_gcm_encrypt(const uint8_t *plaintext, int plaintext_len,
                                    const uint8_t *key, const uint8_t *iv,
                                    uint8_t *ciphertext, uint8_t *tag) {
-    EVP_CIPHER_CTX *ctx;
-    int len;
-    int ciphertext_len;
-    
-    if (!(ctx = EVP_CIPHER_CTX_new())) {
-        return -1;
-    }
-    
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
-    }
-    
-    if (EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
-    }
-    
-    if (EVP_EncryptUpdate(ctx, ciphertext, &len, plaintext, plaintext_len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
-    }
-    ciphertext_len = len;
-    
-    if (EVP_EncryptFinal_ex(ctx, ciphertext + len, &len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
-    }
-    ciphertext_len += len;
-    
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
-    }
+    uint64_t started = metrics_now_ns();
+    int ciphertext_len = crypto_encrypt_aes_gcm_iv(plaintext, (size_t)plaintext_len,
+                                                   key, iv, ciphertext, tag);
+    if (ciphertext_len < 0) return -1;
     
-    EVP_CIPHER_CTX_free(ctx);
+    observe_since(g_metrics.crypto_duration[CRYPTO_OP_ENCRYPT], started);
+    metrics_add(g_metrics.crypto_bytes[CRYPTO_OP_ENCRYPT], (uint64_t)plaintext_len);
     return ciphertext_len;
 }
 
@@ -411,47 +294,71 @@ static int enhanced_aes_gcm_encrypt(const uint8_t *plaintext, int plaintext_len,
 static int enhanced_aes_gcm_decrypt(const uint8_t *ciphertext, int ciphertext_len,
                                    const uint8_t *key, const uint8_t *iv,
                                    const uint8_t *tag, uint8_t *plaintext) {
-    EVP_CIPHER_CTX *ctx;
-    int len;
-    int plaintext_len;
+    uint64_t started = metrics_now_ns();
+    int plaintext_len = crypto_decrypt_aes_gcm(ciphertext, (size_t)ciphertext_len,
+                                               key, iv, tag, plaintext);
+    if (plaintext_len < 0) return -1;
     
-    if (!(ctx = EVP_CIPHER_CTX_new())) {
-        return -1;
-    }
-    
-    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
+    observe_since(g_metrics.crypto_duration[CRYPTO_OP_DECRYPT], started);
+    metrics_add(g_metrics.crypto_bytes[CRYPTO_OP_DECRYPT], (uint64_t)ciphertext_len);
+    return plaintext_len;
+}
+
+// Зашифрованный объект загрузки; одновременные загрузки одного
+// содержимого разделяют его (g_uploads)
+typedef struct {
+    char object_id[OBJECT_ID_LEN];
+    uint8_t iv[12];
+    uint8_t tag[16];
+} stored_object_t;
+
+// Шифрование и запись объекта под новым id; false — причина в журнале
+static bool store_encrypted(const uint8_t *plaintext, long long size, const char *filename,
+                            stored_object_t *out, request_trace_t *trace) {
+    // Шифрование AES-256-GCM
+    uint8_t *ciphertext = malloc(size + 16);
+    if (!ciphertext) {
+        logger(LOG_ERROR, "Memory allocation failed for ciphertext");
+        return false;
     }
     
-    if (EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
+    // Генерация случайного IV
+    if (RAND_bytes(out->iv, sizeof(out->iv)) != 1) {
+        logger(LOG_ERROR, "Failed to generate IV for: %s", filename);
+        free(ciphertext);
+        return false;
     }
     
-    if (EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext, ciphertext_len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
-    }
-    plaintext_len = len;
+    int ct_len = enhanced_aes_gcm_encrypt(plaintext, size, 
+                                         g_file_crypto.key, out->iv, 
+                                         ciphertext, out->tag);
+    trace_phase(trace, TRACE_ENCRYPT);
     
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16, (void*)tag) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
+    if (ct_len < 0) {
+        logger(LOG_ERROR, "Encryption failed for: %s", filename);
+        free(ciphertext);
+        return false;
     }
     
-    if (EVP_DecryptFinal_ex(ctx, plaintext + len, &len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return -1;
+    // Сохранение зашифрованного файла под новым id: загрузки с одним
+    // именем больше не затирают друг друга
+    int store_err = 0;
+    bool stored = object_id_generate(out->object_id);
+    if (!stored) {
+        logger(LOG_ERROR, "Failed to generate object id for: %s", filename);
+    } else if (!(stored = object_store_put(g_objects, out->object_id, ciphertext, (size_t)ct_len,
+                                           &store_err))) {
+        logger(LOG_ERROR, "Failed to store object %s for %s: %s",
+               out->object_id, filename, strerror(store_err));
     }
-    plaintext_len += len;
-    
-    EVP_CIPHER_CTX_free(ctx);
-    return plaintext_len;
+    free(ciphertext);
+    trace_phase(trace, TRACE_WRITE);
+    return stored;
 }
 
 // Обработка команды UPLOAD
-void handle_upload_request(SSL *ssl, RequestHeader *req, const char *client_fingerprint) {
+void handle_upload_request(SSL *ssl, RequestHeader *req, const char *client_fingerprint,
+                           request_trace_t *trace) {
     if (!g_file_crypto.initialized) {
         logger(LOG_ERROR, "Crypto context not initialized");
         ResponseHeader resp = { .status = RESP_ERROR };
@@ -482,14 +389,12 @@ void handle_upload_request(SSL *ssl, RequestHeader *req, const char *client_fing
         }
     }
     
-    char filepath[PATH_MAX];
-    snprintf(filepath, sizeof(filepath), "%s/%s", STORAGE_DIR, req->filename);
-    
     ResponseHeader resp = { .status = RESP_SUCCESS };
     if (ssl_send_all(ssl, &resp, sizeof(resp)) != 0) {
         logger(LOG_ERROR, "Failed to send success response for upload");
         return;
     }
+    trace_phase(trace, TRACE_SEND);
     
     // Получение файла
     uint8_t *plaintext = malloc(req->filesize);
@@ -515,10 +420,14 @@ void handle_upload_request(SSL *ssl, RequestHeader *req, const char *client_fing
         ptr += to_read;
         remaining -= to_read;
     }
+    metrics_observe(g_metrics.upload_size, (uint64_t)req->filesize);
+    trace->bytes = (uint64_t)req->filesize;
+    trace_phase(trace, TRACE_RECV);
     
     // Проверка целостности BLAKE3
     uint8_t computed_hash[BLAKE3_HASH_LEN];
     compute_buffer_blake3(plaintext, req->filesize, computed_hash);
+    trace_phase(trace, TRACE_HASH);
     
     if (memcmp(computed_hash, req->file_hash, BLAKE3_HASH_LEN) != 0) {
         logger(LOG_ERROR, "Integrity check failed for: %s", req->filename);
@@ -528,359 +437,716 @@ void handle_upload_request(SSL *ssl, RequestHeader *req, const char *client_fing
         return;
     }
     
-    // Шифрование AES-256-GCM
-    uint8_t *ciphertext = malloc(req->filesize + 16);
-    uint8_t iv[12];
-    uint8_t tag[16];
-    
-    // Генерация случайного IV
-    if (RAND_bytes(iv, sizeof(iv)) != 1) {
-        logger(LOG_ERROR, "Failed to generate IV for: %s", req->filename);
-        free(plaintext);
-        free(ciphertext);
-        resp.status = RESP_ERROR;
-        ssl_send_all(ssl, &resp, sizeof(resp));
-        return;
+    // Одновременные загрузки одного содержимого (флот раскатывает один
+    // артефакт): шифрует и пишет только ведущий, остальные после его
+    // коммита вставляют свой документ на тот же объект. Тело каждый
+    // принимает и проверяет сам — хеша без содержимого недостаточно.
+    stored_object_t obj;
+    flight_t *flight = NULL;
+    bool leader = true, shared = false;
+    if (g_uploads) {
+        flight = flight_join(g_uploads, (const char *)computed_hash, &leader);
+    }
+    if (!leader) {
+        size_t len;
+        int status;
+        const stored_object_t *done = (const stored_object_t *)flight_wait(g_uploads, flight, &len, &status);
+        if (done) {
+            obj = *done;
+            shared = true;
+            metrics_inc(g_metrics.upload_coalesced);
+        }
+        flight_release(g_uploads, flight); // ведущий не справился — своя полная загрузка
+        flight = NULL;
+        trace_phase(trace, TRACE_WRITE);
     }
     
-    int ct_len = enhanced_aes_gcm_encrypt(plaintext, req->filesize, 
-                                         g_file_crypto.key, iv, 
-                                         ciphertext, tag);
-    
+    bool stored = shared || store_encrypted(plaintext, req->filesize, req->filename, &obj, trace);
     free(plaintext);
     
-    if (ct_len < 0) {
-        logger(LOG_ERROR, "Encryption failed for: %s", req->filename);
-        free(ciphertext);
-        resp.status = RESP_ERROR;
-        ssl_send_all(ssl, &resp, sizeof(resp));
-        return;
-    }
-    
-    // Сохранение зашифрованного файла
-    FILE *fp = fopen(filepath, "wb");
-    if (!fp) {
-        logger(LOG_ERROR, "Failed to open file for writing: %s", filepath);
-        free(ciphertext);
+    if (!stored) {
+        if (flight) {
+            flight_finish(g_uploads, flight, NULL, 0, RESP_ERROR);
+            flight_release(g_uploads, flight);
+        }
         resp.status = RESP_ERROR;
         ssl_send_all(ssl, &resp, sizeof(resp));
         return;
     }
     
-    size_t written = fwrite(ciphertext, 1, ct_len, fp);
-    fclose(fp);
-    free(ciphertext);
-    
-    if (written != (size_t)ct_len) {
-        logger(LOG_ERROR, "Failed to write complete file: %s", filepath);
-        resp.status = RESP_ERROR;
-        ssl_send_all(ssl, &resp, sizeof(resp));
-        return;
-    }
-
+    char filepath[PATH_MAX];
+    object_store_path(g_objects, obj.object_id, filepath, sizeof(filepath));
+    
+    // Сохранение метаданных
+    bool is_public = req->recipient[0] == '\0';
+    meta_file_t meta = {
+        .is_public = is_public,
+        .encrypted = true,
+        .hashed = true,
+        .size = req->filesize,
+    };
+    snprintf(meta.object_id, sizeof(meta.object_id), "%s", obj.object_id);
+    snprintf(meta.filename, sizeof(meta.filename), "%s", req->filename);
+    snprintf(meta.owner, sizeof(meta.owner), "%s", client_fingerprint);
+    snprintf(meta.recipient, sizeof(meta.recipient), "%s", req->recipient);
+    memcpy(meta.iv, obj.iv, sizeof(meta.iv));
+    memcpy(meta.tag, obj.tag, sizeof(meta.tag));
+    memcpy(meta.content_hash, computed_hash, BLAKE3_HASH_LEN);
 
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t uploaded_at = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    meta.uploaded_at = uploaded_at;
     
-    // Сохранение метаданных в MongoDB
-    bson_t *doc = bson_new();
-    BSON_APPEND_UTF8(doc, "filename", req->filename);
-    BSON_APPEND_INT64(doc, "size", req->filesize);
-    BSON_APPEND_BOOL(doc, "encrypted", true);
-    BSON_APPEND_BINARY(doc, "iv", BSON_SUBTYPE_BINARY, iv, sizeof(iv));
-    BSON_APPEND_BINARY(doc, "tag", BSON_SUBTYPE_BINARY, tag, sizeof(tag));
-    BSON_APPEND_BOOL(doc, "deleted", false);
-    BSON_APPEND_UTF8(doc, "owner_fingerprint", client_fingerprint);
-    
-    bson_error_t error;
-    bool success = mongoc_collection_insert_one(g_collection, doc, NULL, NULL, &error);
+    meta_error_t error;
+    uint64_t insert_started = metrics_now_ns();
+    bool success = meta_insert_file(g_meta, &meta, &error);
+    observe_since(g_metrics.mongo_duration[MONGO_OP_INSERT], insert_started);
+    trace_phase(trace, TRACE_MONGO);
     
-    bson_destroy(doc);
-
-    if(req->recipient[0] != '\0') {
-        BSON_APPEND_UTF8(doc, "recipient_fingerprint", req->recipient);
-        BSON_APPEND_BOOL(doc, "public", false);
-    } else {
-        BSON_APPEND_BOOL(doc, "public", true);
+    if (flight) {
+        stored_object_t *published = success ? malloc(sizeof(*published)) : NULL;
+        if (published) *published = obj;
+        flight_finish(g_uploads, flight, published, sizeof(obj), RESP_ERROR);
+        flight_release(g_uploads, flight);
     }
     
-    BSON_APPEND_DATE_TIME(doc, "uploaded_at", bson_get_monotonic_time() / 1000);
-    
     if (!success) {
         logger(LOG_ERROR, "MongoDB insert failed for %s: %s", req->filename, error.message);
+        metrics_inc(g_metrics.mongo_errors[MONGO_OP_INSERT]);
+        if (!shared) { // без документа объект недостижим; общий держит документ ведущего
+            int store_err = 0;
+            object_store_remove(g_objects, obj.object_id, &store_err);
+        }
         resp.status = RESP_ERROR;
     } else {
-        logger(LOG_INFO, "File uploaded successfully: %s", req->filename);
+        logger(LOG_INFO, "File uploaded successfully%s: %s", shared ? " (coalesced)" : "", req->filename);
         resp.status = RESP_SUCCESS;
+
+        // Уведомляем подписчиков вместо того, чтобы они опрашивали LIST
+        NotifyMessage note = {
+            .type = NOTIFY_FILE_UPLOADED,
+            .filesize = req->filesize,
+            .uploaded_at = uploaded_at,
+            .flags = is_public ? 0x01 : 0x00,
+        };
+        strncpy(note.filename, req->filename, FILENAME_MAX_LEN - 1);
+        strncpy(note.owner, client_fingerprint, FINGERPRINT_LEN - 1);
+        size_t delivered = notify_bus_publish(&note, req->recipient);
+        if (delivered > 0) {
+            logger(LOG_DEBUG, "Upload of %s pushed to %zu subscribers", req->filename, delivered);
+        }
         
         // Добавляем событие в proc map
         if (!append_proc_event(filepath, "upload", "success")) {
             logger(LOG_WARNING, "Failed to add proc event for: %s", filepath);
         }
+        trace_phase(trace, TRACE_MONGO);
     }
     
     ssl_send_all(ssl, &resp, sizeof(resp));
+    trace_phase(trace, TRACE_SEND);
 }
 
-// Обработка команды LIST
-void handle_list_request(SSL *ssl, const char *client_fingerprint) {
-    bson_t *query = bson_new();
-    bson_t *opts = BCON_NEW(
-        "projection", "{",
-            "filename", BCON_INT32(1),
-            "size", BCON_INT32(1),
-            "uploaded_at", BCON_INT32(1),
-            "public", BCON_INT32(1),
-            "owner_fingerprint", BCON_INT32(1),
-        "}"
-    );
-    
-    // Показываем публичные файлы и файлы пользователя
-    bson_t *or_query = bson_new();
-        // Показываем:
-    // - файлы, загруженные мной (owner)
-    // - файлы, где я — получатель
-    // - публичные файлы (если будут)
-    bson_t *or_array = bson_new();
-
-    // 1. Я — владелец
-    bson_t owner_doc;
-    bson_init(&owner_doc);
-    BSON_APPEND_UTF8(&owner_doc, "owner_fingerprint", client_fingerprint);
-    BSON_APPEND_ARRAY_BEGIN(or_array, "$or", &owner_doc);
-    bson_append_document_end(or_array, &owner_doc);
+// Строка JSON в кавычках
+static void json_write_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', out);
+            fputc(*p, out);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
 
-    // 2. Я — получатель
-    bson_t recipient_doc;
-    bson_init(&recipient_doc);
-    BSON_APPEND_UTF8(&recipient_doc, "recipient_fingerprint", client_fingerprint);
-    BSON_APPEND_ARRAY_BEGIN(or_array, "$or", &recipient_doc);
-    bson_append_document_end(or_array, &recipient_doc);
+// Накопитель ответа LIST: JSON-массив в том же виде, что давал
+// bson_as_canonical_extended_json для проекции документа
+typedef struct {
+    FILE *out;
+    size_t count;
+} list_builder_t;
 
-    // 3. Публичные (опционально)
-    bson_t public_doc;
-    bson_init(&public_doc);
-    BSON_APPEND_BOOL(&public_doc, "public", true);
-    BSON_APPEND_ARRAY_BEGIN(or_array, "$or", &public_doc);
-    bson_append_document_end(or_array, &public_doc);
+static void list_append(void *ctx, const meta_file_t *file) {
+    list_builder_t *list = ctx;
+    fputs(list->count++ ? ", { \"filename\" : " : "{ \"filename\" : ", list->out);
+    json_write_string(list->out, file->filename);
+    fprintf(list->out,
+            ", \"size\" : { \"$numberLong\" : \"%" PRId64 "\" }"
+            ", \"uploaded_at\" : { \"$date\" : { \"$numberLong\" : \"%" PRId64 "\" } }"
+            ", \"public\" : %s, \"owner_fingerprint\" : ",
+            file->size, file->uploaded_at, file->is_public ? "true" : "false");
+    json_write_string(list->out, file->owner);
+    fputs(" }", list->out);
+}
 
-    bson_append_document(query, "$or", -1, or_array);
-    bson_destroy(or_array);
+// Обработка команды LIST
+// Показываем:
+// - файлы, загруженные мной (owner)
+// - файлы, где я — получатель
+// - публичные файлы
+void handle_list_request(SSL *ssl, const char *client_fingerprint) {
+    char *full_list = NULL;
+    size_t total_len = 0;
+    list_builder_t list = { .out = open_memstream(&full_list, &total_len) };
+    if (!list.out) {
+        logger(LOG_ERROR, "Memory allocation failed for file list");
+        ResponseHeader resp = { .status = RESP_ERROR };
+        ssl_send_all(ssl, &resp, sizeof(resp));
+        return;
+    }
     
-    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
-        g_collection, or_query, opts, NULL);
+    fputc('[', list.out);
+    meta_error_t error;
+    uint64_t find_started = metrics_now_ns();
+    bool ok = meta_list_visible(g_meta, client_fingerprint, list_append, &list, &error);
+    observe_since(g_metrics.mongo_duration[MONGO_OP_LIST], find_started);
+    if (!ok) {
+        logger(LOG_ERROR, "Cursor error in list request: %s", error.message);
+        metrics_inc(g_metrics.mongo_errors[MONGO_OP_LIST]);
+    }
+    fputc(']', list.out);
     
-    bson_error_t error;
-    const bson_t *doc;
-    char *json_str;
-    size_t total_len = 0;
-    char *full_list = NULL;
+    // Как и раньше, ошибка курсора не отменяет уже собранную часть списка
+    ResponseHeader resp = { .status = RESP_SUCCESS };
+    if (fclose(list.out) != 0) {
+        resp.status = RESP_ERROR;
+        total_len = 0;
+    }
+    resp.filesize = (long long)total_len;
+    ssl_send_all(ssl, &resp, sizeof(resp));
     
-    while (mongoc_cursor_next(cursor, &doc)) {
-        json_str = bson_as_canonical_extended_json(doc, NULL);
-        if (!json_str) continue;
-        
-        size_t len = strlen(json_str);
-        
-        if (total_len == 0) {
-            full_list = malloc(len + 3);
-            if (!full_list) {
-                bson_free(json_str);
-                continue;
-            }
-            strcpy(full_list, "[");
-            total_len = 1;
-        } else {
-            char *new_list = realloc(full_list, total_len + len + 2);
-            if (!new_list) {
-                bson_free(json_str);
-                continue;
-            }
-            full_list = new_list;
-            full_list[total_len++] = ',';
+    if (total_len > 0) {
+        ssl_send_all(ssl, full_list, total_len);
+    }
+    free(full_list);
+    
+    logger(LOG_INFO, "Sent file list to client");
+}
+
+// Чтение и расшифровка объекта целиком: открытый текст из malloc или
+// NULL со статусом ответа в *status
+static uint8_t *load_plaintext(const meta_file_t *meta, const char *filename, const char *filepath,
+                               size_t *len, int *status, request_trace_t *trace) {
+    size_t ct_size = 0;
+    int read_err = 0;
+    uint8_t *ciphertext = meta->object_id[0]
+        ? object_store_read(g_objects, meta->object_id, &ct_size, &read_err)
+        : object_store_read_flat(g_objects, filename, &ct_size, &read_err);
+    trace_phase(trace, TRACE_READ);
+    
+    if (!ciphertext) {
+        if (read_err != ENOENT) {
+            logger(LOG_ERROR, "Failed to read %s: %s", filepath, strerror(read_err));
         }
-        
-        memcpy(full_list + total_len, json_str, len);
-        total_len += len;
-        bson_free(json_str);
+        *status = read_err == ENOENT ? RESP_FILE_NOT_FOUND : RESP_ERROR;
+        return NULL;
     }
     
-    if (mongoc_cursor_error(cursor, &error)) {
-        logger(LOG_ERROR, "Cursor error in list request: %s", error.message);
+    // IV и тег из метаданных
+    if (!meta->encrypted) {
+        free(ciphertext);
+        *status = RESP_ERROR;
+        return NULL;
     }
     
-    if (total_len > 0) {
-        full_list[total_len++] = ']';
-        full_list[total_len] = '\0';
-    } else {
-        full_list = strdup("[]");
-        total_len = strlen(full_list);
+    uint8_t *plaintext = malloc(ct_size);
+    if (!plaintext) {
+        free(ciphertext);
+        *status = RESP_ERROR;
+        return NULL;
     }
     
-    ResponseHeader resp = { .status = RESP_SUCCESS, .filesize = total_len };
-    ssl_send_all(ssl, &resp, sizeof(resp));
+    int pt_len = enhanced_aes_gcm_decrypt(ciphertext, (int)ct_size,
+                                         g_file_crypto.key, meta->iv,
+                                         meta->tag, plaintext);
+    free(ciphertext);
+    trace_phase(trace, TRACE_DECRYPT);
     
-    if (full_list) {
-        ssl_send_all(ssl, full_list, total_len);
-        free(full_list);
+    if (pt_len < 0) {
+        free(plaintext);
+        *status = RESP_ERROR;
+        return NULL;
+    }
+    *len = (size_t)pt_len;
+    *status = RESP_SUCCESS;
+    return plaintext;
+}
+
+// Выдача из кэша расшифрованных кусков: все куски от offset до конца
+// должны быть в кэше, иначе -1 и обычный путь через диск и расшифровку.
+// Возвращает число отправленных байт или -2, если клиент отключился.
+static long long send_from_chunk_cache(SSL *ssl, const RequestHeader *req, const meta_file_t *meta,
+                                       request_trace_t *trace) {
+    if (!g_chunks || !meta->object_id[0] || meta->size <= 0) return -1;
+    if (req->offset < 0 || req->offset > meta->size) return -1; // ответит обычный путь
+    
+    long long chunk = (long long)chunk_cache_chunk_size(g_chunks);
+    uint32_t first = (uint32_t)(req->offset / chunk);
+    uint32_t total = (uint32_t)((meta->size + chunk - 1) / chunk);
+    uint32_t count = total - first;
+    if (count == 0) return -1;
+    
+    const chunk_ref_t **refs = malloc(count * sizeof(*refs));
+    if (!refs) return -1;
+    uint32_t got = 0;
+    while (got < count && (refs[got] = chunk_cache_get(g_chunks, meta->object_id, first + got))) got++;
+    if (got < count) {
+        for (uint32_t i = 0; i < got; i++) chunk_cache_release(refs[i]);
+        free(refs);
+        metrics_inc(g_metrics.chunk_cache_misses);
+        return -1;
     }
+    metrics_inc(g_metrics.chunk_cache_hits);
+    trace_phase(trace, TRACE_READ);
     
-    mongoc_cursor_destroy(cursor);
-    bson_destroy(query);
-    bson_destroy(opts);
-    bson_destroy(or_query);
+    ResponseHeader resp = { .status = RESP_SUCCESS, .filesize = meta->size };
+    bool ok = ssl_send_all(ssl, &resp, sizeof(resp)) == 0;
     
-    logger(LOG_INFO, "Sent file list to client");
+    // После первой неудачной отправки только отпускаем куски
+    size_t skip = (size_t)(req->offset % chunk);
+    for (uint32_t i = 0; i < count; i++) {
+        size_t len;
+        const uint8_t *data = chunk_ref_data(refs[i], &len);
+        if (ok && len > skip) ok = ssl_send_all(ssl, data + skip, len - skip) == 0;
+        skip = 0;
+        chunk_cache_release(refs[i]);
+    }
+    free(refs);
+    trace_phase(trace, TRACE_SEND);
+    if (!ok) return -2;
+    
+    long long sent = meta->size - req->offset;
+    trace->bytes = (uint64_t)sent;
+    return sent;
+}
+
+// Кладёт проверенный тегом GCM открытый текст в кэш кусками
+static void fill_chunk_cache(const meta_file_t *meta, const uint8_t *plaintext, size_t len) {
+    if (!g_chunks || !meta->object_id[0]) return;
+    size_t chunk = chunk_cache_chunk_size(g_chunks);
+    for (size_t off = 0; off < len; off += chunk) {
+        size_t n = len - off < chunk ? len - off : chunk;
+        if (!chunk_cache_put(g_chunks, meta->object_id, (uint32_t)(off / chunk), plaintext + off, n)) break;
+    }
 }
 
 // Обработка команды DOWNLOAD
-void handle_download_request(SSL *ssl, RequestHeader *req, const char *client_fingerprint) {
+void handle_download_request(SSL *ssl, RequestHeader *req, const char *client_fingerprint,
+                             request_trace_t *trace) {
     if (strstr(req->filename, "..") || strchr(req->filename, '/')) {
         ResponseHeader resp = { .status = RESP_PERMISSION_DENIED };
         ssl_send_all(ssl, &resp, sizeof(resp));
         return;
     }
     
-    bson_t *query = bson_new();
-    BSON_APPEND_UTF8(query, "filename", req->filename);
-    BSON_APPEND_BOOL(query, "deleted", false);
+    // Самая свежая видимая загрузка с этим именем — тот же документ,
+    // который вернёт STAT; по нему же сверяется If-None-Match
+    meta_file_t meta;
+    meta_error_t error;
+    uint64_t find_started = metrics_now_ns();
+    int found = meta_find_latest(g_meta, req->filename, client_fingerprint, &meta, &error);
+    observe_since(g_metrics.mongo_duration[MONGO_OP_FIND], find_started);
+    trace_phase(trace, TRACE_MONGO);
     
-    bson_error_t error;
-    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(g_collection, query, NULL, NULL);
+    if (found < 0) {
+        logger(LOG_ERROR, "Cursor error in download request: %s", error.message);
+        metrics_inc(g_metrics.mongo_errors[MONGO_OP_FIND]);
+    }
+    if (found <= 0) {
+        ResponseHeader resp = { .status = RESP_FILE_NOT_FOUND };
+        ssl_send_all(ssl, &resp, sizeof(resp));
+        return;
+    }
     
-    const bson_t *doc;
-    bool found = mongoc_cursor_next(cursor, &doc);
+    // Проверка прав доступа: владелец, получатель или публичный файл
+    if (!meta_file_visible_to(&meta, client_fingerprint)) {
+        ResponseHeader resp = { .status = RESP_PERMISSION_DENIED };
+        ssl_send_all(ssl, &resp, sizeof(resp));
+        return;
+    }
     
-    if (!found) {
-        ResponseHeader resp = { .status = RESP_FILE_NOT_FOUND };
+    // If-None-Match: содержимое не изменилось — диск и расшифровку не трогаем
+    if ((req->flags & REQ_FLAG_IF_NONE_MATCH) && meta.hashed &&
+        memcmp(meta.content_hash, req->file_hash, BLAKE3_HASH_LEN) == 0) {
+        ResponseHeader resp = { .status = RESP_NOT_MODIFIED, .filesize = meta.size };
         ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+        logger(LOG_INFO, "Download of '%s' skipped: client copy is current", req->filename);
+        return;
     }
     
-    // Проверка прав доступа
-    bson_iter_t iter;
-    const char *owner_fp = NULL;
-    bool is_public = false;
+    // Популярный файл: ни диска, ни расшифровки
+    char filepath[PATH_MAX];
+    long long cached = send_from_chunk_cache(ssl, req, &meta, trace);
+    if (cached == -2) {
+        logger(LOG_WARNING, "Client disconnected during cached download of '%s'", req->filename);
+        return;
+    }
+    if (cached >= 0) {
+        object_store_path(g_objects, meta.object_id, filepath, sizeof(filepath));
+        if (!append_proc_event(filepath, "download", "success")) {
+            logger(LOG_WARNING, "Failed to add proc event for download: %s", filepath);
+        }
+        trace_phase(trace, TRACE_MONGO);
+        logger(LOG_INFO, "Sent %lld cached bytes of '%s' to client", cached, req->filename);
+        return;
+    }
     
-    if (bson_iter_init_find(&iter, doc, "owner_fingerprint") && BSON_ITER_HOLDS_UTF8(&iter)) {
-        owner_fp = bson_iter_utf8(&iter, NULL);
+    // Документы до переноса раскладки (layout_migrate) без object_id:
+    // файл ещё лежит в плоском каталоге под своим именем
+    if (meta.object_id[0]) {
+        object_store_path(g_objects, meta.object_id, filepath, sizeof(filepath));
+    } else {
+        snprintf(filepath, sizeof(filepath), "%s/%s", object_store_root(g_objects), req->filename);
     }
     
-    if (bson_iter_init_find(&iter, doc, "public") && BSON_ITER_HOLDS_BOOL(&iter)) {
-        is_public = bson_iter_bool(&iter);
+    // Одновременные загрузки объекта читают и расшифровывают его один раз:
+    // ведущий публикует открытый текст, остальные отправляют тот же буфер
+    flight_t *flight = NULL;
+    bool leader = true;
+    if (g_flights && meta.object_id[0]) {
+        flight = flight_join(g_flights, meta.object_id, &leader);
     }
     
-    if (!is_public && (!owner_fp || strcmp(owner_fp, client_fingerprint) != 0)) {
-        ResponseHeader resp = { .status = RESP_PERMISSION_DENIED };
+    const uint8_t *plaintext;
+    size_t pt_len = 0;
+    int status = RESP_SUCCESS;
+    uint8_t *loaded = NULL;
+    if (leader) {
+        loaded = load_plaintext(&meta, req->filename, filepath, &pt_len, &status, trace);
+        plaintext = loaded;
+        if (flight) flight_finish(g_flights, flight, loaded, pt_len, status);
+    } else {
+        metrics_inc(g_metrics.download_coalesced);
+        plaintext = flight_wait(g_flights, flight, &pt_len, &status);
+        trace_phase(trace, TRACE_READ);
+    }
+    
+    if (plaintext && (req->offset < 0 || req->offset > (long long)pt_len)) {
+        status = RESP_INVALID_OFFSET;
+    }
+    if (!plaintext || status != RESP_SUCCESS) {
+        if (flight) flight_release(g_flights, flight);
+        else free(loaded);
+        ResponseHeader resp = { .status = status };
         ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+        return;
     }
     
-    char filepath[PATH_MAX];
-    snprintf(filepath, sizeof(filepath), "%s/%s", STORAGE_DIR, req->filename);
+    // Отправка файла
+    ResponseHeader resp = { .status = RESP_SUCCESS, .filesize = (long long)pt_len };
+    ssl_send_all(ssl, &resp, sizeof(resp));
     
-    struct stat st;
-    if (stat(filepath, &st) != 0) {
-        ResponseHeader resp = { .status = RESP_FILE_NOT_FOUND };
-        ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+    long long bytes_to_send = (long long)pt_len - req->offset;
+    if (bytes_to_send > 0) {
+        ssl_send_all(ssl, plaintext + req->offset, bytes_to_send);
     }
+    trace->bytes = (uint64_t)bytes_to_send;
+    trace_phase(trace, TRACE_SEND);
     
-    long long filesize = st.st_size;
+    if (leader) fill_chunk_cache(&meta, plaintext, pt_len);
+    if (flight) flight_release(g_flights, flight);
+    else free(loaded);
     
-    if (req->offset < 0 || req->offset > filesize) {
-        ResponseHeader resp = { .status = RESP_INVALID_OFFSET };
-        ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+    // Добавляем событие в proc map
+    if (!append_proc_event(filepath, "download", "success")) {
+        logger(LOG_WARNING, "Failed to add proc event for download: %s", filepath);
     }
+    trace_phase(trace, TRACE_MONGO);
     
-    FILE *fp = fopen(filepath, "rb");
-    if (!fp) {
-        ResponseHeader resp = { .status = RESP_ERROR };
-        ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+    logger(LOG_INFO, "Sent %lld bytes of '%s' to client", bytes_to_send, req->filename);
+}
+
+// Сравнение индексов StatQuery для сортировки (qsort_r, arg = массив запросов)
+static int stat_cmp_name(const void *a, const void *b, void *arg) {
+    const StatQuery *queries = arg;
+    return strcmp(queries[*(const uint32_t *)a].filename,
+                  queries[*(const uint32_t *)b].filename);
+}
+
+static int stat_cmp_hash(const void *a, const void *b, void *arg) {
+    const StatQuery *queries = arg;
+    return memcmp(queries[*(const uint32_t *)a].file_hash,
+                  queries[*(const uint32_t *)b].file_hash, BLAKE3_HASH_LEN);
+}
+
+// Заполняет все записи батча, совпадающие с документом по ключу.
+// idx отсортирован по ключу, поэтому совпадения лежат подряд.
+static void stat_fill_matches(const StatQuery *queries, StatEntry *entries,
+                              const uint32_t *idx, size_t n, bool by_hash,
+                              const char *filename, const uint8_t *hash,
+                              const StatEntry *found) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const StatQuery *q = &queries[idx[mid]];
+        int c = by_hash ? memcmp(q->file_hash, hash, BLAKE3_HASH_LEN)
+                        : strcmp(q->filename, filename);
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    
+    for (size_t i = lo; i < n; i++) {
+        const StatQuery *q = &queries[idx[i]];
+        int c = by_hash ? memcmp(q->file_hash, hash, BLAKE3_HASH_LEN)
+                        : strcmp(q->filename, filename);
+        if (c != 0) break;
+        entries[idx[i]] = *found;
     }
+}
+
+// Документы ответа STAT приходят от старых к новым: каждый перезаписывает
+// совпавшие записи батча, так что остаётся самая свежая загрузка
+typedef struct {
+    const StatQuery *queries;
+    StatEntry *entries;
+    const uint32_t *name_idx;
+    size_t n_names;
+    const uint32_t *hash_idx;
+    size_t n_hashes;
+    const char *client_fingerprint;
+} stat_batch_t;
+
+static void stat_apply(void *ctx, const meta_file_t *file) {
+    const stat_batch_t *b = ctx;
+    StatEntry found = { .exists = 1, .size = file->size, .uploaded_at = file->uploaded_at };
     
-    // Чтение и расшифровка файла
-    uint8_t *ciphertext = malloc(filesize);
-    if (!ciphertext) {
-        fclose(fp);
-        ResponseHeader resp = { .status = RESP_ERROR };
-        ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+    if (file->hashed) {
+        memcpy(found.file_hash, file->content_hash, BLAKE3_HASH_LEN);
+    }
+    if (strcmp(file->owner, b->client_fingerprint) == 0) {
+        found.permission |= STAT_PERM_OWNER;
+    }
+    if (file->recipient[0] && strcmp(file->recipient, b->client_fingerprint) == 0) {
+        found.permission |= STAT_PERM_RECIPIENT;
+    }
+    if (file->is_public) {
+        found.permission |= STAT_PERM_PUBLIC;
     }
     
-    if (fread(ciphertext, 1, filesize, fp) != (size_t)filesize) {
-        fclose(fp);
-        free(ciphertext);
-        ResponseHeader resp = { .status = RESP_ERROR };
+    stat_fill_matches(b->queries, b->entries, b->name_idx, b->n_names, false,
+                      file->filename, NULL, &found);
+    if (file->hashed) {
+        stat_fill_matches(b->queries, b->entries, b->hash_idx, b->n_hashes, true,
+                          NULL, file->content_hash, &found);
+    }
+}
+
+// Обработка команды STAT
+// Отвечает на пакет запросов одним запросом к хранилищу метаданных по
+// индексам filename / content_hash ($in), не трогая файлы на диске.
+// Возвращает -1, если поток запросов рассинхронизирован.
+static int handle_stat_request(SSL *ssl, RequestHeader *req, const char *client_fingerprint) {
+    if (req->filesize <= 0 || req->filesize > STAT_MAX_BATCH) {
+        // Клиент уже отправил тело батча, дочитать его безопасно нельзя
+        logger(LOG_WARNING, "Invalid stat batch size: %lld", req->filesize);
+        ResponseHeader resp = { .status = RESP_FAILURE };
         ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+        return req->filesize == 0 ? 0 : -1;
     }
-    fclose(fp);
     
-    // Получение IV и тега из MongoDB
-    const uint8_t *iv = NULL;
-    const uint8_t *tag = NULL;
-    uint32_t iv_len = 0, tag_len = 0;
+    int rc = 0;
+    size_t n = (size_t)req->filesize;
+    StatQuery *queries = malloc(n * sizeof(StatQuery));
+    StatEntry *entries = calloc(n, sizeof(StatEntry));
+    uint32_t *name_idx = malloc(n * sizeof(uint32_t));
+    uint32_t *hash_idx = malloc(n * sizeof(uint32_t));
+    const char **names = malloc(n * sizeof(*names));
+    uint8_t (*hashes)[BLAKE3_HASH_LEN] = malloc(n * sizeof(*hashes));
     
-    if (bson_iter_init_find(&iter, doc, "iv") && BSON_ITER_HOLDS_BINARY(&iter)) {
-        bson_iter_binary(&iter, NULL, &iv_len, &iv);
+    if (!queries || !entries || !name_idx || !hash_idx || !names || !hashes) {
+        logger(LOG_ERROR, "Memory allocation failed for stat batch of %zu", n);
+        rc = -1;
+        goto cleanup_buffers;
     }
     
-    if (bson_iter_init_find(&iter, doc, "tag") && BSON_ITER_HOLDS_BINARY(&iter)) {
-        bson_iter_binary(&iter, NULL, &tag_len, &tag);
+    if (ssl_recv_all(ssl, queries, n * sizeof(StatQuery)) != (int)(n * sizeof(StatQuery))) {
+        logger(LOG_ERROR, "Failed to receive stat batch");
+        rc = -1;
+        goto cleanup_buffers;
     }
     
-    if (!iv || !tag || iv_len != 12 || tag_len != 16) {
-        free(ciphertext);
-        ResponseHeader resp = { .status = RESP_ERROR };
-        ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+    size_t n_names = 0, n_hashes = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (queries[i].by_hash) {
+            memcpy(hashes[n_hashes], queries[i].file_hash, BLAKE3_HASH_LEN);
+            hash_idx[n_hashes++] = (uint32_t)i;
+        } else {
+            queries[i].filename[FILENAME_MAX_LEN - 1] = '\0';
+            names[n_names] = queries[i].filename;
+            name_idx[n_names++] = (uint32_t)i;
+        }
     }
     
-    // Расшифровка
-    uint8_t *plaintext = malloc(filesize);
-    if (!plaintext) {
-        free(ciphertext);
-        ResponseHeader resp = { .status = RESP_ERROR };
-        ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+    qsort_r(name_idx, n_names, sizeof(uint32_t), stat_cmp_name, queries);
+    qsort_r(hash_idx, n_hashes, sizeof(uint32_t), stat_cmp_hash, queries);
+    
+    stat_batch_t batch = {
+        .queries = queries,
+        .entries = entries,
+        .name_idx = name_idx,
+        .n_names = n_names,
+        .hash_idx = hash_idx,
+        .n_hashes = n_hashes,
+        .client_fingerprint = client_fingerprint,
+    };
+    meta_error_t error;
+    uint64_t find_started = metrics_now_ns();
+    bool ok = meta_stat_batch(g_meta, names, n_names, (const uint8_t (*)[BLAKE3_HASH_LEN])hashes,
+                              n_hashes, client_fingerprint, stat_apply, &batch, &error);
+    observe_since(g_metrics.mongo_duration[MONGO_OP_STAT], find_started);
+    
+    ResponseHeader resp = { .status = RESP_SUCCESS, .filesize = (long long)n };
+    if (!ok) {
+        logger(LOG_ERROR, "Cursor error in stat request: %s", error.message);
+        metrics_inc(g_metrics.mongo_errors[MONGO_OP_STAT]);
+        resp.status = RESP_ERROR;
+        resp.filesize = 0;
     }
     
-    int pt_len = enhanced_aes_gcm_decrypt(ciphertext, filesize, 
-                                         g_file_crypto.key, iv, 
-                                         tag, plaintext);
-    free(ciphertext);
+    if (ssl_send_all(ssl, &resp, sizeof(resp)) == 0 && resp.status == RESP_SUCCESS) {
+        ssl_send_all(ssl, entries, n * sizeof(StatEntry));
+    }
     
-    if (pt_len < 0) {
-        free(plaintext);
+    logger(LOG_INFO, "Answered stat batch of %zu (%zu by name, %zu by hash)", n, n_names, n_hashes);
+    
+cleanup_buffers:
+    free(queries);
+    free(entries);
+    free(name_idx);
+    free(hash_idx);
+    free(names);
+    free(hashes);
+    return rc;
+}
+
+// Обработка команды SUBSCRIBE
+// Держит соединение открытым и пересылает уведомления из шины. Подписка
+// завершается, когда клиент присылает следующий запрос или закрывает
+// соединение. Возвращает -1, если соединение больше непригодно.
+static int handle_subscribe_request(SSL *ssl, int client_fd, const char *client_fingerprint) {
+    notify_subscriber_t *sub = notify_bus_subscribe(client_fingerprint);
+    if (!sub) {
+        logger(LOG_ERROR, "Failed to register subscriber: %s", client_fingerprint);
         ResponseHeader resp = { .status = RESP_ERROR };
         ssl_send_all(ssl, &resp, sizeof(resp));
-        goto cleanup;
+        return 0;
     }
     
-    // Отправка файла
-    ResponseHeader resp = { .status = RESP_SUCCESS, .filesize = pt_len };
-    ssl_send_all(ssl, &resp, sizeof(resp));
+    ResponseHeader resp = { .status = RESP_SUCCESS };
+    if (ssl_send_all(ssl, &resp, sizeof(resp)) != 0) {
+        notify_bus_unsubscribe(sub);
+        return -1;
+    }
     
-    long long bytes_to_send = pt_len - req->offset;
-    if (bytes_to_send < 0) bytes_to_send = 0;
+    logger(LOG_INFO, "Client subscribed: %s (subscribers: %zu)",
+           client_fingerprint, notify_bus_subscriber_count());
     
-    if (bytes_to_send > 0) {
-        ssl_send_all(ssl, plaintext + req->offset, bytes_to_send);
+    NotifyMessage batch[32];
+    int rc = 0;
+    
+    while (!g_shutdown) {
+        // Данные, уже расшифрованные OpenSSL, poll() не увидит
+        if (SSL_pending(ssl) > 0) break;
+        
+        struct pollfd fds[3] = {
+            { .fd = client_fd, .events = POLLIN },
+            { .fd = notify_subscriber_fd(sub), .events = POLLIN },
+            { .fd = g_shutdown_fd, .events = POLLIN },
+        };
+        
+        int ready = poll(fds, 3, NOTIFY_KEEPALIVE_MS);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            logger(LOG_ERROR, "poll failed for subscriber %s: %s", client_fingerprint, strerror(errno));
+            rc = -1;
+            break;
+        }
+        
+        // Сервер останавливается: не ждём keepalive, закрываем соединение
+        if (fds[2].revents & POLLIN) {
+            rc = -1;
+            break;
+        }
+        
+        if (ready == 0) {
+            NotifyMessage keepalive = { .type = NOTIFY_KEEPALIVE };
+            if (ssl_send_all(ssl, &keepalive, sizeof(keepalive)) != 0) {
+                rc = -1;
+                break;
+            }
+            continue;
+        }
+        
+        if (fds[1].revents & POLLIN) {
+            bool overflowed = false;
+            size_t n;
+            
+            while ((n = notify_subscriber_drain(sub, batch, sizeof(batch) / sizeof(batch[0]), &overflowed)) > 0 ||
+                   overflowed) {
+                if (overflowed) {
+                    NotifyMessage resync = { .type = NOTIFY_RESYNC };
+                    if (ssl_send_all(ssl, &resync, sizeof(resync)) != 0) {
+                        rc = -1;
+                        break;
+                    }
+                    logger(LOG_WARNING, "Subscriber %s lagged behind, resync requested", client_fingerprint);
+                    overflowed = false;
+                }
+                if (n > 0 && ssl_send_all(ssl, batch, n * sizeof(batch[0])) != 0) {
+                    rc = -1;
+                    break;
+                }
+                if (n < sizeof(batch) / sizeof(batch[0])) break;
+            }
+            if (rc != 0) break;
+        }
+        
+        // Клиент прислал следующий запрос или закрыл соединение
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) break;
     }
     
-    free(plaintext);
+    // Ответ на следующий запрос не должен смешаться с уведомлениями:
+    // сначала закрываем поток. Отставшие в очереди события теряются
+    if (rc == 0 && !g_shutdown) {
+        NotifyMessage end = { .type = NOTIFY_END };
+        if (ssl_send_all(ssl, &end, sizeof(end)) != 0) rc = -1;
+    }
     
-    // Добавляем событие в proc map
-    if (!append_proc_event(filepath, "download", "success")) {
-        logger(LOG_WARNING, "Failed to add proc event for download: %s", filepath);
+    notify_bus_unsubscribe(sub);
+    logger(LOG_INFO, "Client unsubscribed: %s", client_fingerprint);
+    return rc;
+}
+
+// Гистограммы фаз и журнал медленных запросов (не чаще SLOW_LOG_INTERVAL_MS)
+static void finish_request(request_trace_t *trace, const RequestHeader *req,
+                           const char *client_fingerprint) {
+    uint64_t total = trace_end(trace);
+    metrics_observe(g_metrics.request_duration[trace->command], total);
+    for (int i = 0; i < TRACE_PHASES; i++) {
+        if (trace_has_phase(trace, (trace_phase_t)i)) {
+            metrics_observe(g_metrics.phase_duration[trace->command][i], trace->phase_ns[i]);
+        }
     }
     
-    logger(LOG_INFO, "Sent %lld bytes of '%s' to client", bytes_to_send, req->filename);
+    if (g_slow_request_ns == 0 || total < g_slow_request_ns) return;
+    metrics_inc(g_metrics.slow_requests);
     
-cleanup:
-    if (cursor) mongoc_cursor_destroy(cursor);
-    if (query) bson_destroy(query);
+    uint64_t suppressed;
+    if (!trace_sample(&g_slow_sampler, trace->mark_ns,
+                      SLOW_LOG_INTERVAL_MS * 1000000ull, &suppressed)) {
+        return;
+    }
+    char phases[256];
+    trace_format(trace, phases, sizeof(phases));
+    logger(LOG_WARNING, "Slow request: command %d '%s' from %.16s, %llu bytes, %.1f ms: %s"
+           " (%llu more slow requests not logged)",
+           req->command, req->filename, client_fingerprint, (unsigned long long)trace->bytes,
+           (double)total / 1e6, phases, (unsigned long long)suppressed);
 }
 
 // Обработка клиентского соединения
@@ -888,12 +1154,15 @@ void *handle_client(void *arg) {
     client_info_t *info = (client_info_t *)arg;
     int client_fd = info->client_socket;
     
+    metrics_inc(g_metrics.connections);
+    metrics_gauge_add(g_metrics.active_connections, 1);
+    
     // Создаем SSL объект
     SSL *ssl = SSL_new(g_ssl_ctx);
     if (!ssl) {
         logger(LOG_ERROR, "Failed to create SSL object");
-        close(client_fd);
-        free(info);
+        client_done(info);
+        metrics_gauge_add(g_metrics.active_connections, -1);
         return NULL;
     }
     
@@ -904,8 +1173,9 @@ void *handle_client(void *arg) {
         logger(LOG_ERROR, "SSL handshake failed");
         ERR_print_errors_fp(stderr);
         SSL_free(ssl);
-        close(client_fd);
-        free(info);
+        client_done(info);
+        metrics_inc(g_metrics.handshake_failures);
+        metrics_gauge_add(g_metrics.active_connections, -1);
         return NULL;
     }
     
@@ -914,8 +1184,9 @@ void *handle_client(void *arg) {
     if (!client_cert) {
         logger(LOG_ERROR, "No client certificate provided");
         SSL_free(ssl);
-        close(client_fd);
-        free(info);
+        client_done(info);
+        metrics_inc(g_metrics.missing_client_cert);
+        metrics_gauge_add(g_metrics.active_connections, -1);
         return NULL;
     }
     
@@ -940,11 +1211,17 @@ void *handle_client(void *arg) {
     RequestHeader req;
     while (SSL_read(ssl, &req, sizeof(RequestHeader)) == sizeof(RequestHeader)) {
         logger(LOG_DEBUG, "Received command: %d for file: %s", req.command, req.filename);
+        metrics_add(g_metrics.bytes_in, sizeof(RequestHeader));
+        
+        int command = (int)req.command >= 0 && req.command < CMD_UNKNOWN ? (int)req.command : CMD_UNKNOWN;
+        request_trace_t trace;
+        trace_begin(&trace, command);
+        metrics_inc(g_metrics.requests[command]);
         
         switch(req.command) {
             case CMD_UPLOAD:
                 logger(LOG_INFO, "Upload request for: %s (size: %lld)", req.filename, req.filesize);
-                handle_upload_request(ssl, &req, client_fingerprint);
+                handle_upload_request(ssl, &req, client_fingerprint, &trace);
                 break;
                 
             case CMD_LIST:
@@ -953,25 +1230,42 @@ void *handle_client(void *arg) {
                 break;
                 
             case CMD_DOWNLOAD:
-                logger(LOG_INFO, "Download request for: %s (offset: %lld)", req.filename, req.offset);
-                handle_download_request(ssl, &req, client_fingerprint);
+                logger(LOG_INFO, "Download request for: %s (offset: %lld)", req.filename, (long long)req.offset);
+                handle_download_request(ssl, &req, client_fingerprint, &trace);
                 break;
                 
+            case CMD_STAT:
+                logger(LOG_INFO, "Stat request (%lld entries)", req.filesize);
+                if (handle_stat_request(ssl, &req, client_fingerprint) != 0) {
+                    finish_request(&trace, &req, client_fingerprint);
+                    goto disconnect;
+                }
+                break;
+                
+            case CMD_SUBSCRIBE:
+                // Подписка живёт до следующего запроса: её длительность не время ответа
+                logger(LOG_INFO, "Subscribe request");
+                if (handle_subscribe_request(ssl, client_fd, client_fingerprint) != 0) {
+                    goto disconnect;
+                }
+                continue;
+                
             default:
                 logger(LOG_WARNING, "Unknown command: %d", req.command);
                 ResponseHeader resp = { .status = RESP_UNKNOWN_COMMAND };
                 ssl_send_all(ssl, &resp, sizeof(resp));
                 break;
         }
+        finish_request(&trace, &req, client_fingerprint);
     }
     
+disconnect:
     // Завершение соединения
     SSL_shutdown(ssl);
     SSL_free(ssl);
-    close(client_fd);
-    free(info);
-    
+    metrics_gauge_add(g_metrics.active_connections, -1);
     logger(LOG_INFO, "Client disconnected: %s", client_fingerprint);
+    client_done(info); // последним: после него сервер может закрыть всё
     return NULL;
 }
 
@@ -1021,34 +1315,42 @@ static bool init_ssl(void) {
     return true;
 }
 
-// Инициализация MongoDB
-static bool init_mongodb(void) {
-    mongoc_init();
-    
-    g_mongo_client = mongoc_client_new(MONGODB_URI);
-    if (!g_mongo_client) {
-        logger(LOG_ERROR, "Failed to connect to MongoDB");
-        return false;
+// Инициализация хранилища метаданных (EXCHANGE_META_BACKEND: mongo или
+// memory). memory — для бенчмарков и тестов без MongoDB: метаданные живут
+// до остановки сервера, задержку и отказы задаёт EXCHANGE_META_MEMORY.
+static bool init_metadata(void) {
+    meta_backend_t backend = META_BACKEND_DEFAULT;
+    const char *env = getenv("EXCHANGE_META_BACKEND");
+    if (env && *env && !meta_parse_backend(env, &backend)) {
+        logger(LOG_WARNING, "Invalid EXCHANGE_META_BACKEND=%s, using %s",
+               env, meta_backend_name(backend));
+    }
+    
+    if (backend == META_BACKEND_MEMORY) {
+        meta_mem_options_t options = {0};
+        const char *spec = getenv("EXCHANGE_META_MEMORY");
+        if (spec && *spec && !meta_mem_parse_options(spec, &options)) {
+            logger(LOG_WARNING, "Invalid EXCHANGE_META_MEMORY=%s, ignoring", spec);
+            options = (meta_mem_options_t){0};
+        }
+        g_meta = meta_store_open_memory(&options);
+        if (!g_meta) {
+            logger(LOG_ERROR, "Failed to create in-memory metadata store");
+            return false;
+        }
+        logger(LOG_WARNING, "Metadata kept in memory: uploads are lost on restart");
+        return true;
     }
     
-    // Проверка подключения
-    bson_error_t error;
-    bool ping_success = mongoc_client_command_simple(
-        g_mongo_client, "admin", BCON_NEW("ping", BCON_INT32(1)), NULL, NULL, &error);
-    
-    if (!ping_success) {
-        logger(LOG_ERROR, "MongoDB ping failed: %s", error.message);
-        mongoc_client_destroy(g_mongo_client);
-        g_mongo_client = NULL;
+    meta_error_t error;
+    g_meta = meta_store_open_mongo(MONGODB_URI, DATABASE_NAME, COLLECTION_NAME, &error);
+    if (!g_meta) {
+        logger(LOG_ERROR, "Failed to connect to MongoDB: %s", error.message);
         return false;
     }
-    
-    g_collection = mongoc_client_get_collection(g_mongo_client, DATABASE_NAME, COLLECTION_NAME);
-    if (!g_collection) {
-        logger(LOG_ERROR, "Failed to get collection");
-        mongoc_client_destroy(g_mongo_client);
-        g_mongo_client = NULL;
-        return false;
+    // Без индексов сервер работает, но STAT превращается в полный просмотр коллекции
+    if (error.message[0]) {
+        logger(LOG_WARNING, "MongoDB: %s", error.message);
     }
     
     logger(LOG_INFO, "MongoDB initialization completed successfully");
@@ -1069,70 +1371,280 @@ static bool init_cryptography(void) {
 
 // Инициализация логирования
 static bool init_logging(void) {
-    g_log_file = fopen(LOG_FILE, "a");
-    if (!g_log_file) {
-        g_log_file = stderr;
-        fprintf(stderr, "Failed to open log file, using stderr\n");
+    log_level_t level = LOG_LEVEL_DEFAULT;
+    const char *env = getenv("EXCHANGE_LOG_LEVEL");
+    bool bad_level = env && *env && !log_parse_level(env, &level);
+    
+    // Недоступный файл — журнал уходит в stderr
+    if (!log_init(LOG_FILE, level)) {
+        fprintf(stderr, "Failed to start logger\n");
+        return false;
     }
+    if (bad_level) logger(LOG_WARNING, "Invalid EXCHANGE_LOG_LEVEL=%s, using info", env);
     
     logger(LOG_INFO, "File server starting up");
     return true;
 }
 
-// Создание директории для файлов
+// Регистрация метрик и точка сбора на 127.0.0.1 (EXCHANGE_METRICS_PORT, 0 — выключить)
+static void init_metrics(void) {
+    static const char *const commands[CMD_UNKNOWN + 1] = {
+        [CMD_UPLOAD] = "upload", [CMD_DOWNLOAD] = "download", [CMD_LIST] = "list",
+        [CMD_SUBSCRIBE] = "subscribe", [CMD_STAT] = "stat", [CMD_UNKNOWN] = "unknown",
+    };
+    static const char *const mongo_ops[MONGO_OP_COUNT] = {
+        [MONGO_OP_INSERT] = "insert", [MONGO_OP_FIND] = "find", [MONGO_OP_LIST] = "list",
+        [MONGO_OP_STAT] = "stat", [MONGO_OP_PROC_EVENT] = "proc_event",
+    };
+    static const char *const crypto_ops[CRYPTO_OP_COUNT] = {
+        [CRYPTO_OP_BLAKE3] = "blake3", [CRYPTO_OP_ENCRYPT] = "encrypt", [CRYPTO_OP_DECRYPT] = "decrypt",
+    };
+    char labels[64];
+    
+    g_metrics.connections = metrics_counter("exchange_connections_total", NULL,
+                                            "Accepted client connections");
+    g_metrics.active_connections = metrics_gauge("exchange_connections_active", NULL,
+                                                 "Client connections being served");
+    g_metrics.handshake_failures = metrics_counter("exchange_handshake_failures_total", "reason=\"tls\"",
+                                                   "Connections dropped before the first request");
+    g_metrics.missing_client_cert = metrics_counter("exchange_handshake_failures_total", "reason=\"no_cert\"",
+                                                    "Connections dropped before the first request");
+    g_metrics.bytes_in = metrics_counter("exchange_received_bytes_total", NULL,
+                                         "Plaintext bytes read from clients");
+    g_metrics.bytes_out = metrics_counter("exchange_sent_bytes_total", NULL,
+                                          "Plaintext bytes written to clients");
+    for (int i = 0; i <= CMD_UNKNOWN; i++) {
+        snprintf(labels, sizeof(labels), "command=\"%s\"", commands[i]);
+        g_metrics.requests[i] = metrics_counter("exchange_requests_total", labels,
+                                                "Requests by command");
+        g_metrics.request_duration[i] = metrics_histogram("exchange_request_duration_seconds", labels,
+                                                          "Time from request header to response, subscribe excluded",
+                                                          METRICS_UNIT_NANOSECONDS);
+    }
+    g_metrics.upload_size = metrics_histogram("exchange_upload_size_bytes", NULL,
+                                              "Declared size of received uploads", METRICS_UNIT_BYTES);
+    for (int i = 0; i < MONGO_OP_COUNT; i++) {
+        snprintf(labels, sizeof(labels), "op=\"%s\"", mongo_ops[i]);
+        g_metrics.mongo_duration[i] = metrics_histogram("exchange_mongo_duration_seconds", labels,
+                                                        "MongoDB round trips by operation",
+                                                        METRICS_UNIT_NANOSECONDS);
+        g_metrics.mongo_errors[i] = metrics_counter("exchange_mongo_errors_total", labels,
+                                                    "Failed MongoDB operations");
+    }
+    for (int i = 0; i < CRYPTO_OP_COUNT; i++) {
+        snprintf(labels, sizeof(labels), "op=\"%s\"", crypto_ops[i]);
+        g_metrics.crypto_duration[i] = metrics_histogram("exchange_crypto_duration_seconds", labels,
+                                                         "Hashing and AES-GCM time per buffer",
+                                                         METRICS_UNIT_NANOSECONDS);
+        g_metrics.crypto_bytes[i] = metrics_counter("exchange_crypto_bytes_total", labels,
+                                                    "Bytes hashed, encrypted or decrypted");
+    }
+    
+    // Фазы есть только у команд, которые их проходят
+    static const trace_phase_t upload_phases[] = {
+        TRACE_RECV, TRACE_HASH, TRACE_ENCRYPT, TRACE_WRITE, TRACE_MONGO, TRACE_SEND,
+    };
+    static const trace_phase_t download_phases[] = {
+        TRACE_MONGO, TRACE_READ, TRACE_DECRYPT, TRACE_SEND,
+    };
+    for (int c = 0; c <= CMD_UNKNOWN; c++) {
+        for (int i = 0; i < TRACE_PHASES; i++) g_metrics.phase_duration[c][i] = -1;
+    }
+    for (size_t i = 0; i < sizeof(upload_phases) / sizeof(upload_phases[0]); i++) {
+        snprintf(labels, sizeof(labels), "command=\"upload\",phase=\"%s\"",
+                 trace_phase_name(upload_phases[i]));
+        g_metrics.phase_duration[CMD_UPLOAD][upload_phases[i]] =
+            metrics_histogram("exchange_request_phase_seconds", labels,
+                              "Request time by phase", METRICS_UNIT_NANOSECONDS);
+    }
+    for (size_t i = 0; i < sizeof(download_phases) / sizeof(download_phases[0]); i++) {
+        snprintf(labels, sizeof(labels), "command=\"download\",phase=\"%s\"",
+                 trace_phase_name(download_phases[i]));
+        g_metrics.phase_duration[CMD_DOWNLOAD][download_phases[i]] =
+            metrics_histogram("exchange_request_phase_seconds", labels,
+                              "Request time by phase", METRICS_UNIT_NANOSECONDS);
+    }
+    g_metrics.slow_requests = metrics_counter("exchange_slow_requests_total", NULL,
+                                              "Requests slower than EXCHANGE_SLOW_REQUEST_MS");
+    g_metrics.chunk_cache_hits = metrics_counter("exchange_chunk_cache_downloads_total", "result=\"hit\"",
+                                                 "Downloads by decrypted chunk cache outcome");
+    g_metrics.chunk_cache_misses = metrics_counter("exchange_chunk_cache_downloads_total", "result=\"miss\"",
+                                                   "Downloads by decrypted chunk cache outcome");
+    g_metrics.download_coalesced = metrics_counter("exchange_download_coalesced_total", NULL,
+                                                   "Downloads served by another request's read and decrypt");
+    g_metrics.upload_coalesced = metrics_counter("exchange_upload_coalesced_total", NULL,
+                                                 "Uploads stored as a document on a concurrent upload's object");
+    
+    long slow_ms = SLOW_REQUEST_MS;
+    const char *slow_env = getenv("EXCHANGE_SLOW_REQUEST_MS");
+    if (slow_env && *slow_env) {
+        char *end;
+        errno = 0;
+        long v = strtol(slow_env, &end, 10);
+        if (errno == 0 && *end == '\0' && v >= 0) {
+            slow_ms = v;
+        } else {
+            logger(LOG_WARNING, "Invalid EXCHANGE_SLOW_REQUEST_MS=%s, using %d ms",
+                   slow_env, SLOW_REQUEST_MS);
+        }
+    }
+    g_slow_request_ns = (uint64_t)slow_ms * 1000000ull;
+    
+    long port = METRICS_PORT;
+    const char *env = getenv("EXCHANGE_METRICS_PORT");
+    if (env && *env) {
+        char *end;
+        errno = 0;
+        long v = strtol(env, &end, 10);
+        if (errno == 0 && *end == '\0' && v >= 0 && v <= 65535) {
+            port = v;
+        } else {
+            logger(LOG_WARNING, "Invalid EXCHANGE_METRICS_PORT=%s, using %d", env, METRICS_PORT);
+        }
+    }
+    if (port == 0) {
+        logger(LOG_INFO, "Metrics endpoint disabled");
+        return;
+    }
+    
+    // Без метрик сервер работает: занятый порт — не повод не стартовать
+    int err = 0;
+    if (!metrics_http_start((uint16_t)port, &err)) {
+        logger(LOG_WARNING, "Metrics endpoint on 127.0.0.1:%ld unavailable: %s", port, strerror(err));
+        return;
+    }
+    logger(LOG_INFO, "Metrics on http://127.0.0.1:%u/metrics", metrics_http_port());
+}
+
+// Создание директории для файлов (параметры упаковки — EXCHANGE_STORAGE)
 static bool create_storage_dir(void) {
-    if (mkdir(STORAGE_DIR, 0755) != 0 && errno != EEXIST) {
-        logger(LOG_ERROR, "Failed to create storage directory: %s", strerror(errno));
+    object_store_options_t options;
+    object_store_options_default(&options);
+    const char *spec = getenv("EXCHANGE_STORAGE");
+    if (spec && *spec && !object_store_parse_options(spec, &options)) {
+        logger(LOG_WARNING, "Invalid EXCHANGE_STORAGE=%s, using defaults", spec);
+        object_store_options_default(&options);
+    }
+    
+    int err = 0;
+    g_objects = object_store_open(STORAGE_DIR, &options, &err);
+    if (!g_objects) {
+        logger(LOG_ERROR, "Failed to create storage directory: %s", strerror(err));
         return false;
     }
     
-    logger(LOG_INFO, "Storage directory ready: %s", STORAGE_DIR);
+    pack_stats_t pack;
+    pack_store_stats(object_store_pack(g_objects), &pack);
+    logger(LOG_INFO, "Storage directory ready: %s (%zu packed objects in %zu segments, "
+           "%" PRIu64 " dead bytes)", STORAGE_DIR, pack.objects, pack.segments, pack.dead_bytes);
     return true;
 }
 
+// Кэш расшифрованных кусков (EXCHANGE_CHUNK_CACHE, budget=0 — выключить)
+static void init_chunk_cache(void) {
+    chunk_cache_options_t options;
+    chunk_cache_options_default(&options);
+    const char *spec = getenv("EXCHANGE_CHUNK_CACHE");
+    if (spec && *spec && !chunk_cache_parse_options(spec, &options)) {
+        logger(LOG_WARNING, "Invalid EXCHANGE_CHUNK_CACHE=%s, using defaults", spec);
+        chunk_cache_options_default(&options);
+    }
+    if (options.budget == 0) return;
+    
+    g_chunks = chunk_cache_create(&options);
+    if (!g_chunks) {
+        logger(LOG_WARNING, "Failed to allocate chunk cache, downloads will not be cached");
+        return;
+    }
+    logger(LOG_INFO, "Chunk cache: %zu bytes in %u shards, %zu-byte chunks",
+           options.budget, options.shards, options.chunk);
+}
+
 // Очистка ресурсов
 static void cleanup_resources(void) {
     logger(LOG_INFO, "Cleaning up resources");
     
+    metrics_http_stop();
+    
+    // Оставшиеся после drain_clients потоки ещё пользуются контекстом TLS,
+    // метаданными и хранилищем: их не трогаем, процесс всё равно выходит
+    if (clients_active() > 0) {
+        log_shutdown();
+        return;
+    }
+    
     if (g_ssl_ctx) {
         SSL_CTX_free(g_ssl_ctx);
         g_ssl_ctx = NULL;
     }
     
-    if (g_collection) {
-        mongoc_collection_destroy(g_collection);
-        g_collection = NULL;
+    meta_store_close(g_meta);
+    g_meta = NULL;
+    
+    // Выданные куски держат только потоки клиентов, а их уже дождались
+    if (g_chunks) {
+        chunk_cache_stats_t st;
+        chunk_cache_stats(g_chunks, &st);
+        logger(LOG_INFO, "Chunk cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " evictions",
+               st.hits, st.misses, st.evictions);
+        chunk_cache_destroy(g_chunks);
+        g_chunks = NULL;
+    }
+    
+    if (g_flights) {
+        flight_stats_t st;
+        flight_group_stats(g_flights, &st);
+        logger(LOG_INFO, "Download coalescing: %" PRIu64 " reads shared by %" PRIu64 " more requests",
+               st.leaders, st.followers);
+        if (!flight_group_destroy(g_flights)) {
+            logger(LOG_WARNING, "Download flights still referenced at shutdown");
+        }
+        g_flights = NULL;
     }
     
-    if (g_mongo_client) {
-        mongoc_client_destroy(g_mongo_client);
-        g_mongo_client = NULL;
+    if (g_uploads) {
+        flight_stats_t st;
+        flight_group_stats(g_uploads, &st);
+        logger(LOG_INFO, "Upload coalescing: %" PRIu64 " objects shared by %" PRIu64 " more uploads",
+               st.leaders, st.followers);
+        if (!flight_group_destroy(g_uploads)) {
+            logger(LOG_WARNING, "Upload flights still referenced at shutdown");
+        }
+        g_uploads = NULL;
     }
     
-    mongoc_cleanup();
+    object_store_close(g_objects);
+    g_objects = NULL;
     
     if (g_file_crypto.initialized) {
         explicit_bzero(g_file_crypto.key, sizeof(g_file_crypto.key));
         g_file_crypto.initialized = 0;
     }
     
-    if (g_log_file && g_log_file != stderr) {
-        fclose(g_log_file);
-        g_log_file = NULL;
-    }
+    log_shutdown();
     
     EVP_cleanup();
     ERR_free_strings();
 }
 
 // Обработчик сигналов
+// Только async-signal-safe вызовы: журнал пишется уже из основного цикла
 static void signal_handler(int sig) {
-    logger(LOG_INFO, "Received signal %d, shutting down", sig);
-    g_shutdown = 1;
+    g_shutdown = sig;
+    uint64_t one = 1;
+    ssize_t n = write(g_shutdown_fd, &one, sizeof(one));
+    (void)n;
 }
 
 // Настройка обработчиков сигналов
 static bool setup_signal_handlers(void) {
+    // Счётчик никто не вычитывает: fd остаётся читаемым для всех потоков
+    g_shutdown_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (g_shutdown_fd < 0) {
+        logger(LOG_ERROR, "Failed to create shutdown eventfd: %s", strerror(errno));
+        return false;
+    }
+    
     struct sigaction sa = {0};
     sa.sa_handler = signal_handler;
     sigemptyset(&sa.sa_mask);
@@ -1159,12 +1671,14 @@ int main() {
         return EXIT_FAILURE;
     }
     
+    init_metrics();
+    
     if (!init_ssl()) {
         cleanup_resources();
         return EXIT_FAILURE;
     }
     
-    if (!init_mongodb()) {
+    if (!init_metadata()) {
         cleanup_resources();
         return EXIT_FAILURE;
     }
@@ -1178,6 +1692,11 @@ int main() {
         cleanup_resources();
         return EXIT_FAILURE;
     }
+    init_chunk_cache();
+    g_flights = flight_group_create();
+    if (!g_flights) logger(LOG_WARNING, "Failed to allocate download coalescing, reading per request");
+    g_uploads = flight_group_create();
+    if (!g_uploads) logger(LOG_WARNING, "Failed to allocate upload coalescing, storing per request");
     
     // Создание сокета
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
@@ -1221,13 +1740,29 @@ int main() {
     
     // Основной цикл
     while (!g_shutdown) {
+        // accept() с SA_RESTART не прерывается сигналом, поэтому ждём в poll()
+        struct pollfd fds[2] = {
+            { .fd = server_fd, .events = POLLIN },
+            { .fd = g_shutdown_fd, .events = POLLIN },
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno != EINTR) {
+                logger(LOG_ERROR, "poll failed on listening socket: %s", strerror(errno));
+                usleep(ACCEPT_RETRY_MS * 1000);
+            }
+            continue;
+        }
+        if (fds[1].revents & POLLIN) break;
+        
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
         
         int client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
         if (client_fd == -1) {
+            // EMFILE/ENOBUFS: сокет остаётся читаемым, и poll сразу вернётся снова
             if (errno != EINTR) {
                 logger(LOG_ERROR, "Accept failed: %s", strerror(errno));
+                usleep(ACCEPT_RETRY_MS * 1000);
             }
             continue;
         }
@@ -1244,11 +1779,11 @@ int main() {
         info->ssl = NULL;
         memset(info->fingerprint, 0, sizeof(info->fingerprint));
         
+        client_register(info);
         pthread_t tid;
         if (pthread_create(&tid, NULL, handle_client, info) != 0) {
             logger(LOG_ERROR, "Failed to create client thread");
-            free(info);
-            close(client_fd);
+            client_done(info);
             continue;
         }
         
@@ -1256,8 +1791,15 @@ int main() {
     }
     
     // Завершение работы
-    logger(LOG_INFO, "Server shutting down");
+    logger(LOG_INFO, "Received signal %d, server shutting down", (int)g_shutdown);
     close(server_fd);
+    
+    // Подписчики видят g_shutdown_fd и отключаются сами, остальных будит
+    // shutdown() сокета; запросы, стоящие на диске, дописываются
+    size_t left = drain_clients();
+    if (left > 0) {
+        logger(LOG_WARNING, "%zu client threads still running at shutdown, storage left open", left);
+    }
     cleanup_resources();
     
     return EXIT_SUCCESS;
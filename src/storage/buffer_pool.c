@@ -0,0 +1,62 @@
+// storage/buffer_pool.c
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "buffer_pool.h"
+
+struct buffer_pool {
+    size_t size;
+    size_t max_free;
+    pthread_mutex_t lock;
+    size_t n_free;
+    void **free;
+};
+
+buffer_pool_t *buffer_pool_create(size_t size, size_t max_free) {
+    buffer_pool_t *pool = calloc(1, sizeof(*pool));
+    if (!pool) return NULL;
+    pool->size = (size + BUFFER_POOL_ALIGN - 1) & ~(size_t)(BUFFER_POOL_ALIGN - 1);
+    pool->max_free = max_free;
+    pool->free = calloc(max_free ? max_free : 1, sizeof(*pool->free));
+    if (!pool->free) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+void buffer_pool_destroy(buffer_pool_t *pool) {
+    if (!pool) return;
+    for (size_t i = 0; i < pool->n_free; i++) free(pool->free[i]);
+    free(pool->free);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+size_t buffer_pool_size(const buffer_pool_t *pool) {
+    return pool->size;
+}
+
+void *buffer_pool_get(buffer_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    void *buf = pool->n_free ? pool->free[--pool->n_free] : NULL;
+    pthread_mutex_unlock(&pool->lock);
+    if (buf) return buf;
+
+    if (posix_memalign(&buf, BUFFER_POOL_ALIGN, pool->size) != 0) return NULL;
+    return buf;
+}
+
+void buffer_pool_put(buffer_pool_t *pool, void *buf) {
+    if (!buf) return;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->n_free < pool->max_free) {
+        pool->free[pool->n_free++] = buf;
+        buf = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    free(buf);
+}
@@ -0,0 +1,26 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+// Пул буферов, выровненных по странице, для записи с O_DIRECT: буфер
+// берётся на время одной загрузки и возвращается, свободных держится не
+// больше max_free. Потокобезопасен.
+
+#define BUFFER_POOL_ALIGN 4096
+
+typedef struct buffer_pool buffer_pool_t;
+
+// size округляется вверх до BUFFER_POOL_ALIGN
+buffer_pool_t *buffer_pool_create(size_t size, size_t max_free);
+
+void buffer_pool_destroy(buffer_pool_t *pool);
+
+size_t buffer_pool_size(const buffer_pool_t *pool);
+
+// NULL — нет памяти
+void *buffer_pool_get(buffer_pool_t *pool);
+
+void buffer_pool_put(buffer_pool_t *pool, void *buf);
+
+#endif // BUFFER_POOL_H
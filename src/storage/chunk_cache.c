@@ -0,0 +1,328 @@
+// storage/chunk_cache.c
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chunk_cache.h"
+
+#define CHUNK_BUCKETS_MIN 16
+#define CHUNK_BUCKETS_MAX (1u << 20)
+#define CHUNK_ENTRY_MIN 4096 // ожидаемый наименьший кусок для размера таблицы
+
+struct chunk_entry {
+    struct chunk_entry *next;              // цепочка корзины
+    struct chunk_entry *prev_ring, *next_ring; // кольцо CLOCK
+    atomic_uint refs;                      // кэш и выданные ссылки
+    atomic_bool referenced;                // бит CLOCK
+    uint64_t hash;
+    uint32_t index;
+    char key[CHUNK_CACHE_KEY_LEN];
+    size_t len;
+    uint8_t data[];
+};
+
+typedef struct {
+    pthread_rwlock_t lock;
+    struct chunk_entry **buckets;
+    size_t mask;
+    struct chunk_entry *hand; // стрелка CLOCK; NULL — шард пуст
+    size_t bytes;
+    size_t budget;
+    size_t chunks;
+} chunk_shard_t;
+
+struct chunk_cache {
+    size_t chunk;
+    unsigned n_shards;
+    chunk_shard_t *shards;
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+    atomic_uint_fast64_t evictions;
+};
+
+void chunk_cache_options_default(chunk_cache_options_t *out) {
+    out->budget = CHUNK_CACHE_BUDGET_DEFAULT;
+    out->shards = CHUNK_CACHE_SHARDS_DEFAULT;
+    out->chunk = CHUNK_CACHE_CHUNK_DEFAULT;
+}
+
+static bool parse_size(const char *v, size_t len, uint64_t *out) {
+    uint64_t x = 0;
+    size_t i = 0;
+    for (; i < len && v[i] >= '0' && v[i] <= '9'; i++) {
+        if (x > (UINT64_MAX - 9) / 10) return false;
+        x = x * 10 + (uint64_t)(v[i] - '0');
+    }
+    if (i == 0) return false;
+    if (i < len) {
+        unsigned shift;
+        switch (v[i]) {
+            case 'K': case 'k': shift = 10; break;
+            case 'M': case 'm': shift = 20; break;
+            case 'G': case 'g': shift = 30; break;
+            default: return false;
+        }
+        if (i + 1 != len || x > (UINT64_MAX >> shift)) return false;
+        x <<= shift;
+    }
+    *out = x;
+    return true;
+}
+
+bool chunk_cache_parse_options(const char *spec, chunk_cache_options_t *out) {
+    chunk_cache_options_t o;
+    chunk_cache_options_default(&o);
+    const char *p = spec;
+
+    while (*p) {
+        const char *comma = strchr(p, ',');
+        size_t len = comma ? (size_t)(comma - p) : strlen(p);
+        const char *eq = memchr(p, '=', len);
+        if (!eq) return false;
+
+        size_t klen = (size_t)(eq - p);
+        const char *v = eq + 1;
+        size_t vlen = len - klen - 1;
+        uint64_t x;
+        if (!parse_size(v, vlen, &x)) return false;
+        if (klen == 6 && memcmp(p, "budget", klen) == 0 && x <= SIZE_MAX / 2) {
+            o.budget = (size_t)x;
+        } else if (klen == 6 && memcmp(p, "shards", klen) == 0 && x > 0 && x <= 1024) {
+            o.shards = (unsigned)x;
+        } else if (klen == 5 && memcmp(p, "chunk", klen) == 0 && x >= 4096 && x <= UINT32_MAX) {
+            o.chunk = (size_t)x;
+        } else {
+            return false;
+        }
+
+        if (!comma) break;
+        p = comma + 1;
+    }
+
+    *out = o;
+    return true;
+}
+
+chunk_cache_t *chunk_cache_create(const chunk_cache_options_t *options) {
+    if (options->budget == 0 || options->shards == 0 || options->chunk == 0) return NULL;
+
+    chunk_cache_t *c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->chunk = options->chunk;
+    c->n_shards = options->shards;
+    c->shards = calloc(c->n_shards, sizeof(*c->shards));
+    if (!c->shards) {
+        free(c);
+        return NULL;
+    }
+
+    size_t budget = options->budget / c->n_shards;
+    size_t buckets = CHUNK_BUCKETS_MIN;
+    while (buckets < CHUNK_BUCKETS_MAX && buckets * CHUNK_ENTRY_MIN < budget) buckets <<= 1;
+
+    for (unsigned i = 0; i < c->n_shards; i++) {
+        chunk_shard_t *sh = &c->shards[i];
+        sh->budget = budget;
+        sh->mask = buckets - 1;
+        sh->buckets = calloc(buckets, sizeof(*sh->buckets));
+        if (!sh->buckets) {
+            c->n_shards = i;
+            chunk_cache_destroy(c);
+            return NULL;
+        }
+        pthread_rwlock_init(&sh->lock, NULL);
+    }
+    return c;
+}
+
+static void entry_unref(struct chunk_entry *e) {
+    if (atomic_fetch_sub(&e->refs, 1) == 1) free(e);
+}
+
+void chunk_cache_destroy(chunk_cache_t *c) {
+    if (!c) return;
+    for (unsigned i = 0; i < c->n_shards; i++) {
+        chunk_shard_t *sh = &c->shards[i];
+        for (size_t b = 0; b <= sh->mask; b++) {
+            struct chunk_entry *e = sh->buckets[b];
+            while (e) {
+                struct chunk_entry *next = e->next;
+                entry_unref(e);
+                e = next;
+            }
+        }
+        free(sh->buckets);
+        pthread_rwlock_destroy(&sh->lock);
+    }
+    free(c->shards);
+    free(c);
+}
+
+size_t chunk_cache_chunk_size(const chunk_cache_t *c) {
+    return c->chunk;
+}
+
+// FNV-1a по ключу и номеру куска с перемешиванием старших бит: старшие
+// выбирают шард, младшие — корзину
+static uint64_t chunk_hash(const char *key, uint32_t index) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < CHUNK_CACHE_KEY_LEN; i++) {
+        h ^= (uint8_t)key[i];
+        h *= 0x100000001b3ull;
+    }
+    h ^= index;
+    h *= 0x100000001b3ull;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+static chunk_shard_t *shard_of(chunk_cache_t *c, uint64_t hash) {
+    return &c->shards[(hash >> 40) % c->n_shards];
+}
+
+static struct chunk_entry **find_slot(chunk_shard_t *sh, uint64_t hash, const char *key,
+                                      uint32_t index) {
+    struct chunk_entry **slot = &sh->buckets[hash & sh->mask];
+    while (*slot) {
+        struct chunk_entry *e = *slot;
+        if (e->hash == hash && e->index == index &&
+            memcmp(e->key, key, CHUNK_CACHE_KEY_LEN) == 0) {
+            break;
+        }
+        slot = &e->next;
+    }
+    return slot;
+}
+
+const chunk_ref_t *chunk_cache_get(chunk_cache_t *c, const char *key, uint32_t index) {
+    uint64_t hash = chunk_hash(key, index);
+    chunk_shard_t *sh = shard_of(c, hash);
+
+    pthread_rwlock_rdlock(&sh->lock);
+    struct chunk_entry *e = *find_slot(sh, hash, key, index);
+    if (e) {
+        atomic_store_explicit(&e->referenced, true, memory_order_relaxed);
+        atomic_fetch_add(&e->refs, 1);
+    }
+    pthread_rwlock_unlock(&sh->lock);
+
+    atomic_fetch_add_explicit(e ? &c->hits : &c->misses, 1, memory_order_relaxed);
+    return e;
+}
+
+const uint8_t *chunk_ref_data(const chunk_ref_t *ref, size_t *len) {
+    *len = ref->len;
+    return ref->data;
+}
+
+void chunk_cache_release(const chunk_ref_t *ref) {
+    if (ref) entry_unref((struct chunk_entry *)ref);
+}
+
+// Вынимает кусок из корзины (slot указывает на него) и из кольца; под
+// блокировкой записи
+static void shard_remove(chunk_shard_t *sh, struct chunk_entry **slot) {
+    struct chunk_entry *e = *slot;
+    *slot = e->next;
+    if (e->next_ring == e) {
+        sh->hand = NULL;
+    } else {
+        e->prev_ring->next_ring = e->next_ring;
+        e->next_ring->prev_ring = e->prev_ring;
+        if (sh->hand == e) sh->hand = e->next_ring;
+    }
+    sh->bytes -= e->len;
+    sh->chunks--;
+    entry_unref(e);
+}
+
+// Обход стрелки: кусок с битом обращения получает второй шанс
+static void shard_evict_one(chunk_cache_t *c, chunk_shard_t *sh) {
+    for (;;) {
+        struct chunk_entry *e = sh->hand;
+        if (atomic_exchange_explicit(&e->referenced, false, memory_order_relaxed)) {
+            sh->hand = e->next_ring;
+            continue;
+        }
+        shard_remove(sh, find_slot(sh, e->hash, e->key, e->index));
+        atomic_fetch_add_explicit(&c->evictions, 1, memory_order_relaxed);
+        return;
+    }
+}
+
+bool chunk_cache_put(chunk_cache_t *c, const char *key, uint32_t index,
+                     const void *data, size_t len) {
+    uint64_t hash = chunk_hash(key, index);
+    chunk_shard_t *sh = shard_of(c, hash);
+    if (len > sh->budget) return false;
+
+    // Копия — до блокировки: под ней только вставка и вытеснение
+    struct chunk_entry *e = malloc(sizeof(*e) + len);
+    if (!e) return false;
+    atomic_init(&e->refs, 1);
+    atomic_init(&e->referenced, false);
+    e->hash = hash;
+    e->index = index;
+    memcpy(e->key, key, CHUNK_CACHE_KEY_LEN);
+    e->len = len;
+    memcpy(e->data, data, len);
+
+    pthread_rwlock_wrlock(&sh->lock);
+    struct chunk_entry **slot = find_slot(sh, hash, key, index);
+    if (*slot) {
+        pthread_rwlock_unlock(&sh->lock);
+        free(e);
+        return true;
+    }
+    while (sh->hand && sh->bytes + len > sh->budget) {
+        shard_evict_one(c, sh);
+        slot = find_slot(sh, hash, key, index); // вытеснение могло сдвинуть цепочку
+    }
+
+    e->next = NULL;
+    *slot = e;
+    // Новый кусок — прямо перед стрелкой: она дойдёт до него последним
+    if (!sh->hand) {
+        e->prev_ring = e->next_ring = e;
+        sh->hand = e;
+    } else {
+        e->next_ring = sh->hand;
+        e->prev_ring = sh->hand->prev_ring;
+        e->prev_ring->next_ring = e;
+        sh->hand->prev_ring = e;
+    }
+    sh->bytes += len;
+    sh->chunks++;
+    pthread_rwlock_unlock(&sh->lock);
+    return true;
+}
+
+void chunk_cache_invalidate(chunk_cache_t *c, const char *key, uint32_t chunks) {
+    for (uint32_t i = 0; i < chunks; i++) {
+        uint64_t hash = chunk_hash(key, i);
+        chunk_shard_t *sh = shard_of(c, hash);
+        pthread_rwlock_wrlock(&sh->lock);
+        struct chunk_entry **slot = find_slot(sh, hash, key, i);
+        if (*slot) shard_remove(sh, slot);
+        pthread_rwlock_unlock(&sh->lock);
+    }
+}
+
+void chunk_cache_stats(chunk_cache_t *c, chunk_cache_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->hits = atomic_load(&c->hits);
+    out->misses = atomic_load(&c->misses);
+    out->evictions = atomic_load(&c->evictions);
+    for (unsigned i = 0; i < c->n_shards; i++) {
+        chunk_shard_t *sh = &c->shards[i];
+        pthread_rwlock_rdlock(&sh->lock);
+        out->bytes += sh->bytes;
+        out->chunks += sh->chunks;
+        pthread_rwlock_unlock(&sh->lock);
+    }
+}
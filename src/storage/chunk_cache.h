@@ -0,0 +1,93 @@
+#ifndef CHUNK_CACHE_H
+#define CHUNK_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Кэш расшифрованного содержимого популярных файлов: куски по chunk байт
+// с ключом (id объекта, номер куска). Повторная выдача такого файла не
+// трогает ни диск, ни AES-GCM.
+//
+// Кэш разбит на шарды со своим rwlock и своей долей бюджета; вытеснение —
+// CLOCK: попадание только ставит бит обращения (под read-блокировкой,
+// читатели друг другу не мешают), стрелка при нехватке места снимает биты
+// и выселяет кусок без бита. Бюджет в байтах жёсткий: кусок, не влезающий
+// в шард, не кэшируется.
+//
+// Объекты неизменяемы: повторная загрузка того же имени получает новый id
+// (storage/object_store.h), поэтому старые куски просто перестают
+// запрашиваться и уходят первыми. chunk_cache_invalidate — для объектов,
+// которые удаляются.
+//
+// Выданный кусок живёт, пока его не отпустят, даже если его уже вытеснили.
+
+#define CHUNK_CACHE_KEY_LEN 32 // hex id объекта без '\0'
+
+#define CHUNK_CACHE_BUDGET_DEFAULT (64 * 1024 * 1024)
+#define CHUNK_CACHE_SHARDS_DEFAULT 16
+#define CHUNK_CACHE_CHUNK_DEFAULT (256 * 1024)
+
+typedef struct chunk_cache chunk_cache_t;
+typedef struct chunk_entry chunk_ref_t;
+
+typedef struct {
+    size_t budget;   // байт на весь кэш, 0 — кэш выключен
+    unsigned shards;
+    size_t chunk;    // размер куска; последний кусок объекта короче
+} chunk_cache_options_t;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t bytes;
+    size_t chunks;
+} chunk_cache_stats_t;
+
+void chunk_cache_options_default(chunk_cache_options_t *out);
+
+/**
+ * @brief Разбирает параметры кэша поверх значений по умолчанию.
+ *
+ * Формат: "budget=64M,shards=16,chunk=256K"; суффиксы K, M, G.
+ *
+ * @return false — неизвестный ключ или значение
+ */
+bool chunk_cache_parse_options(const char *spec, chunk_cache_options_t *out);
+
+// NULL — нет памяти или budget = 0
+chunk_cache_t *chunk_cache_create(const chunk_cache_options_t *options);
+
+// Выданные куски должны быть отпущены до вызова
+void chunk_cache_destroy(chunk_cache_t *c);
+
+size_t chunk_cache_chunk_size(const chunk_cache_t *c);
+
+/**
+ * @brief Ищет кусок; попадание отмечает его для CLOCK.
+ *
+ * @return кусок (отпустить chunk_cache_release) или NULL — промах
+ */
+const chunk_ref_t *chunk_cache_get(chunk_cache_t *c, const char *key, uint32_t index);
+
+const uint8_t *chunk_ref_data(const chunk_ref_t *ref, size_t *len);
+
+void chunk_cache_release(const chunk_ref_t *ref);
+
+/**
+ * @brief Копирует кусок в кэш, вытесняя старые при нехватке бюджета.
+ *
+ * Уже закэшированный кусок не заменяется: содержимое объекта не меняется.
+ *
+ * @return false — кусок больше доли шарда или нет памяти
+ */
+bool chunk_cache_put(chunk_cache_t *c, const char *key, uint32_t index,
+                     const void *data, size_t len);
+
+// Убирает куски 0..chunks-1 объекта
+void chunk_cache_invalidate(chunk_cache_t *c, const char *key, uint32_t chunks);
+
+void chunk_cache_stats(chunk_cache_t *c, chunk_cache_stats_t *out);
+
+#endif // CHUNK_CACHE_H
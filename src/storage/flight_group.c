@@ -0,0 +1,134 @@
+// storage/flight_group.c
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flight_group.h"
+
+// Одновременных полётов не больше числа потоков обработки, так что
+// таблица небольшая и под одним мьютексом; ждущие спят на своём condvar
+#define FLIGHT_BUCKETS 256
+
+struct flight {
+    struct flight *next;
+    char key[FLIGHT_KEY_LEN];
+    unsigned refs;     // под g->lock
+    bool done;         // под g->lock
+    pthread_cond_t cond;
+    uint8_t *data;
+    size_t len;
+    int status;
+};
+
+struct flight_group {
+    pthread_mutex_t lock;
+    struct flight *buckets[FLIGHT_BUCKETS];
+    size_t live; // полётов с неотпущенными ссылками
+    uint64_t leaders;
+    uint64_t followers;
+};
+
+flight_group_t *flight_group_create(void) {
+    flight_group_t *g = calloc(1, sizeof(*g));
+    if (!g) return NULL;
+    pthread_mutex_init(&g->lock, NULL);
+    return g;
+}
+
+bool flight_group_destroy(flight_group_t *g) {
+    if (!g) return true;
+    pthread_mutex_lock(&g->lock);
+    size_t live = g->live;
+    pthread_mutex_unlock(&g->lock);
+    if (live > 0) return false;
+
+    pthread_mutex_destroy(&g->lock);
+    free(g);
+    return true;
+}
+
+static size_t bucket_of(const char *key) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < FLIGHT_KEY_LEN; i++) {
+        h ^= (uint8_t)key[i];
+        h *= 16777619u;
+    }
+    return h % FLIGHT_BUCKETS;
+}
+
+flight_t *flight_join(flight_group_t *g, const char *key, bool *leader) {
+    size_t b = bucket_of(key);
+
+    pthread_mutex_lock(&g->lock);
+    for (struct flight *f = g->buckets[b]; f; f = f->next) {
+        if (memcmp(f->key, key, FLIGHT_KEY_LEN) == 0) {
+            f->refs++;
+            g->followers++;
+            pthread_mutex_unlock(&g->lock);
+            *leader = false;
+            return f;
+        }
+    }
+
+    struct flight *f = calloc(1, sizeof(*f));
+    if (!f) {
+        pthread_mutex_unlock(&g->lock);
+        return NULL;
+    }
+    memcpy(f->key, key, FLIGHT_KEY_LEN);
+    f->refs = 1;
+    pthread_cond_init(&f->cond, NULL);
+    f->next = g->buckets[b];
+    g->buckets[b] = f;
+    g->live++;
+    g->leaders++;
+    pthread_mutex_unlock(&g->lock);
+
+    *leader = true;
+    return f;
+}
+
+void flight_finish(flight_group_t *g, flight_t *f, void *data, size_t len, int status) {
+    pthread_mutex_lock(&g->lock);
+    struct flight **slot = &g->buckets[bucket_of(f->key)];
+    while (*slot != f) slot = &(*slot)->next;
+    *slot = f->next;
+
+    f->data = data;
+    f->len = len;
+    f->status = status;
+    f->done = true;
+    pthread_cond_broadcast(&f->cond);
+    pthread_mutex_unlock(&g->lock);
+}
+
+const uint8_t *flight_wait(flight_group_t *g, flight_t *f, size_t *len, int *status) {
+    pthread_mutex_lock(&g->lock);
+    while (!f->done) pthread_cond_wait(&f->cond, &g->lock);
+    pthread_mutex_unlock(&g->lock);
+
+    *len = f->len;
+    *status = f->status;
+    return f->data;
+}
+
+void flight_release(flight_group_t *g, flight_t *f) {
+    pthread_mutex_lock(&g->lock);
+    bool last = --f->refs == 0;
+    if (last) g->live--;
+    pthread_mutex_unlock(&g->lock);
+    if (!last) return;
+
+    pthread_cond_destroy(&f->cond);
+    free(f->data);
+    free(f);
+}
+
+void flight_group_stats(flight_group_t *g, flight_stats_t *out) {
+    pthread_mutex_lock(&g->lock);
+    out->leaders = g->leaders;
+    out->followers = g->followers;
+    pthread_mutex_unlock(&g->lock);
+}
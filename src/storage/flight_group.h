@@ -0,0 +1,60 @@
+#ifndef FLIGHT_GROUP_H
+#define FLIGHT_GROUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Схлопывание одновременных запросов с одним ключом (singleflight): первый
+// становится ведущим и делает работу, остальные, пришедшие до её
+// завершения, ждут и получают тот же результат. Буфер результата общий и
+// только для чтения (скачивания отправляют его каждый со своей позиции);
+// освобождается он с последней ссылкой.
+//
+// Завершённый полёт убирается из таблицы: следующий запрос начинает новый
+// (или попадает в кэш кусков, storage/chunk_cache.h).
+
+#define FLIGHT_KEY_LEN 32 // hex id объекта или BLAKE3 содержимого
+
+typedef struct flight_group flight_group_t;
+typedef struct flight flight_t;
+
+typedef struct {
+    uint64_t leaders;   // полётов начато
+    uint64_t followers; // запросов присоединилось к чужому
+} flight_stats_t;
+
+flight_group_t *flight_group_create(void);
+
+// Все полёты должны быть отпущены до вызова: ждущий ещё спит на мьютексе
+// группы. Если нет — группа не освобождается и возвращается false
+bool flight_group_destroy(flight_group_t *g);
+
+/**
+ * @brief Присоединяет к полёту по ключу или начинает новый.
+ *
+ * @param leader true — вызывающий ведущий и обязан вызвать flight_finish
+ * @return полёт (отпустить flight_release) или NULL — нет памяти
+ */
+flight_t *flight_join(flight_group_t *g, const char *key, bool *leader);
+
+/**
+ * @brief Публикует результат ведущего и будит ждущих.
+ *
+ * @param data буфер из malloc, переходит во владение полёта; NULL — ошибка
+ * @param status код ошибки для ждущих (для сервера — статус ответа)
+ */
+void flight_finish(flight_group_t *g, flight_t *f, void *data, size_t len, int status);
+
+/**
+ * @brief Ждёт результата ведущего.
+ *
+ * @return буфер (действителен до flight_release) или NULL, причина в *status
+ */
+const uint8_t *flight_wait(flight_group_t *g, flight_t *f, size_t *len, int *status);
+
+void flight_release(flight_group_t *g, flight_t *f);
+
+void flight_group_stats(flight_group_t *g, flight_stats_t *out);
+
+#endif // FLIGHT_GROUP_H
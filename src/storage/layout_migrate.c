@@ -0,0 +1,146 @@
+// storage/layout_migrate.c
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "layout_migrate.h"
+
+void layout_migrate_options_default(layout_migrate_options_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->batch = LAYOUT_MIGRATE_BATCH_DEFAULT;
+    opts->grace_ms = LAYOUT_MIGRATE_GRACE_MS_DEFAULT;
+}
+
+typedef struct {
+    object_store_t *store;
+    const layout_migrate_options_t *opts;
+    layout_migrate_report_t *report;
+    char **pending;     // привязанные плоские имена, ждущие удаления
+    size_t n_pending;
+} migrate_ctx_t;
+
+static void report_error(migrate_ctx_t *c, const char *name, const char *message) {
+    c->report->failed++;
+    if (c->opts->on_error) c->opts->on_error(name, message, c->opts->ctx);
+}
+
+static void sleep_ms(unsigned ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+// Пауза, затем удаление плоских имён пачки
+static void flush_pending(migrate_ctx_t *c) {
+    if (c->n_pending == 0) return;
+    sleep_ms(c->opts->grace_ms);
+    for (size_t i = 0; i < c->n_pending; i++) {
+        int err = 0;
+        if (!object_store_unlink_flat(c->store, c->pending[i], &err)) {
+            report_error(c, c->pending[i], strerror(err));
+        }
+        free(c->pending[i]);
+    }
+    c->n_pending = 0;
+}
+
+static void migrate_one(migrate_ctx_t *c, meta_store_t *meta, const char *name) {
+    char id[OBJECT_ID_LEN];
+    if (!object_id_generate(id)) {
+        report_error(c, name, "getrandom failed");
+        return;
+    }
+
+    int err = 0;
+    if (!object_store_link_flat(c->store, name, id, &err)) {
+        if (err != ENOENT) report_error(c, name, strerror(err)); // ENOENT — удалили под нами
+        return;
+    }
+
+    meta_error_t merr = { 0 };
+    int rc = meta_claim_legacy(meta, name, id, &merr);
+    if (rc != 1) {
+        // Документа нет или запись не удалась: ссылка никому не нужна
+        object_store_remove(c->store, id, &err);
+        if (rc == 0) c->report->orphaned++;
+        else report_error(c, name, merr.message);
+        return;
+    }
+
+    char *copy = strdup(name);
+    if (!copy) {
+        // Объект уже привязан; плоское имя останется до следующего запуска
+        report_error(c, name, strerror(ENOMEM));
+        return;
+    }
+    c->report->migrated++;
+    c->pending[c->n_pending++] = copy;
+    if (c->n_pending == c->opts->batch) flush_pending(c);
+}
+
+bool layout_migrate(object_store_t *store, meta_store_t *meta,
+                    const layout_migrate_options_t *opts, layout_migrate_report_t *report,
+                    int *err) {
+    memset(report, 0, sizeof(*report));
+
+    // Отдельный дескриптор: closedir закроет его, а не корень хранилища
+    int dir_fd = dup(object_store_root_fd(store));
+    if (dir_fd < 0) {
+        *err = errno;
+        return false;
+    }
+    DIR *dir = fdopendir(dir_fd);
+    if (!dir) {
+        *err = errno;
+        close(dir_fd);
+        return false;
+    }
+    rewinddir(dir);
+
+    migrate_ctx_t c = { .store = store, .opts = opts, .report = report };
+    size_t batch = opts->batch ? opts->batch : 1;
+    c.pending = calloc(batch, sizeof(*c.pending));
+    if (!c.pending) {
+        *err = ENOMEM;
+        closedir(dir);
+        return false;
+    }
+    layout_migrate_options_t fixed = *opts;
+    fixed.batch = batch;
+    c.opts = &fixed;
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+
+        struct stat st;
+        if (fstatat(object_store_root_fd(store), de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            if (errno != ENOENT) report_error(&c, de->d_name, strerror(errno));
+            continue;
+        }
+        // Каталоги веера и всё, что не обычный файл, не трогаем
+        if (!S_ISREG(st.st_mode)) continue;
+
+        report->scanned++;
+        if (st.st_nlink > 1) {
+            // Ссылка в веере уже есть (прерванный запуск): второе имя места не
+            // занимает, а удалять его, не зная, успел ли claim, небезопасно
+            report->already_linked++;
+            continue;
+        }
+        if (opts->dry_run) continue;
+        migrate_one(&c, meta, de->d_name);
+    }
+
+    flush_pending(&c);
+    free(c.pending);
+    closedir(dir);
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef LAYOUT_MIGRATE_H
+#define LAYOUT_MIGRATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../db/meta_store.h"
+#include "object_store.h"
+
+// Перенос плоской раскладки (root/<filename>) в веер root/xx/yy/<id> без
+// остановки сервера. Для каждого файла:
+//  1. жёсткая ссылка root/xx/yy/<id> — данные не копируются;
+//  2. meta_claim_legacy записывает id в документ: с этого момента сервер
+//     читает объект по id;
+//  3. после паузы grace_ms (скачивания, успевшие прочитать старый документ,
+//     дочитывают плоское имя) плоское имя удаляется.
+// Повторный запуск продолжает с места остановки. Файл со второй ссылкой
+// (st_nlink > 1) пропускается: запуск прервали после шага 1, и claim мог
+// не случиться; лишнее имя жёсткой ссылки места не занимает.
+// Файлы без документа в метаданных не трогаются (orphaned).
+
+typedef struct {
+    size_t batch;       // плоских имён между паузами
+    unsigned grace_ms;  // пауза перед удалением плоских имён
+    bool dry_run;       // только посчитать
+    // Вызывается на каждую ошибку по файлу; перенос продолжается
+    void (*on_error)(const char *name, const char *message, void *ctx);
+    void *ctx;
+} layout_migrate_options_t;
+
+typedef struct {
+    size_t scanned;
+    size_t migrated;
+    size_t already_linked;
+    size_t orphaned;
+    size_t failed;
+} layout_migrate_report_t;
+
+#define LAYOUT_MIGRATE_BATCH_DEFAULT 256
+#define LAYOUT_MIGRATE_GRACE_MS_DEFAULT 5000
+
+void layout_migrate_options_default(layout_migrate_options_t *opts);
+
+/**
+ * @brief Переносит все плоские файлы корня хранилища.
+ *
+ * @return false — корень не удалось прочитать (причина в *err); ошибки по
+ *         отдельным файлам только считаются в report->failed
+ */
+bool layout_migrate(object_store_t *store, meta_store_t *meta,
+                    const layout_migrate_options_t *opts, layout_migrate_report_t *report,
+                    int *err);
+
+#endif // LAYOUT_MIGRATE_H
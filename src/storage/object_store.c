@@ -0,0 +1,550 @@
+// storage/object_store.c
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer_pool.h"
+#include "object_store.h"
+
+// "xx/yy/" + id
+#define REL_PATH_LEN (6 + OBJECT_ID_LEN)
+#define PACK_DIR "pack"
+
+struct object_store {
+    int root_fd;
+    char *root;
+    size_t pack_max;
+    pack_store_t *pack; // NULL — открыто с no_pack
+    sync_group_t *sync; // NULL — без сброса на диск (no_sync)
+    size_t direct_min;  // 0 — без O_DIRECT
+    buffer_pool_t *buffers;
+};
+
+void object_store_options_default(object_store_options_t *out) {
+    out->pack_max = OBJECT_PACK_MAX_DEFAULT;
+    out->segment_max = OBJECT_SEGMENT_MAX_DEFAULT;
+    out->compact_pct = OBJECT_COMPACT_PCT_DEFAULT;
+    out->no_pack = false;
+    out->no_sync = false;
+    out->sync_delay_us = 0;
+    out->syncfs_min = 0;
+    out->direct_min = OBJECT_DIRECT_MIN_DEFAULT;
+}
+
+static bool parse_size(const char *v, size_t len, uint64_t *out) {
+    uint64_t x = 0;
+    size_t i = 0;
+    for (; i < len && v[i] >= '0' && v[i] <= '9'; i++) {
+        if (x > (UINT64_MAX - 9) / 10) return false;
+        x = x * 10 + (uint64_t)(v[i] - '0');
+    }
+    if (i == 0) return false;
+    if (i < len) {
+        unsigned shift;
+        switch (v[i]) {
+            case 'K': case 'k': shift = 10; break;
+            case 'M': case 'm': shift = 20; break;
+            case 'G': case 'g': shift = 30; break;
+            default: return false;
+        }
+        if (i + 1 != len || x > (UINT64_MAX >> shift)) return false;
+        x <<= shift;
+    }
+    *out = x;
+    return true;
+}
+
+bool object_store_parse_options(const char *spec, object_store_options_t *out) {
+    object_store_options_t o;
+    object_store_options_default(&o);
+    const char *p = spec;
+
+    while (*p) {
+        const char *comma = strchr(p, ',');
+        size_t len = comma ? (size_t)(comma - p) : strlen(p);
+        const char *eq = memchr(p, '=', len);
+        if (!eq) return false;
+
+        size_t klen = (size_t)(eq - p);
+        const char *v = eq + 1;
+        size_t vlen = len - klen - 1;
+        uint64_t x;
+        if (!parse_size(v, vlen, &x)) return false;
+        if (klen == 8 && memcmp(p, "pack_max", klen) == 0 && x <= UINT32_MAX / 2) {
+            o.pack_max = (size_t)x;
+        } else if (klen == 11 && memcmp(p, "segment_max", klen) == 0 && x > 0) {
+            o.segment_max = x;
+        } else if (klen == 11 && memcmp(p, "compact_pct", klen) == 0 && x <= 100) {
+            o.compact_pct = (unsigned)x;
+        } else if (klen == 4 && memcmp(p, "sync", klen) == 0 && x <= 1) {
+            o.no_sync = x == 0;
+        } else if (klen == 13 && memcmp(p, "sync_delay_us", klen) == 0 && x <= 1000000) {
+            o.sync_delay_us = (unsigned)x;
+        } else if (klen == 10 && memcmp(p, "syncfs_min", klen) == 0) {
+            o.syncfs_min = (size_t)x;
+        } else if (klen == 10 && memcmp(p, "direct_min", klen) == 0) {
+            o.direct_min = (size_t)x;
+        } else {
+            return false;
+        }
+
+        if (!comma) break;
+        p = comma + 1;
+    }
+
+    *out = o;
+    return true;
+}
+
+static bool open_pack(object_store_t *s, const object_store_options_t *o, int *err) {
+    if (mkdirat(s->root_fd, PACK_DIR, 0755) != 0 && errno != EEXIST) {
+        *err = errno;
+        return false;
+    }
+    int fd = openat(s->root_fd, PACK_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        *err = errno;
+        return false;
+    }
+    pack_options_t po = { .segment_max = o->segment_max, .compact_pct = o->compact_pct,
+                          .background = true, .sync = s->sync };
+    s->pack = pack_store_open(fd, &po, err);
+    close(fd);
+    return s->pack != NULL;
+}
+
+object_store_t *object_store_open(const char *root, const object_store_options_t *options,
+                                  int *err) {
+    object_store_options_t defaults;
+    if (!options) {
+        object_store_options_default(&defaults);
+        options = &defaults;
+    }
+    if (mkdir(root, 0755) != 0 && errno != EEXIST) {
+        *err = errno;
+        return NULL;
+    }
+
+    object_store_t *s = calloc(1, sizeof(*s));
+    if (!s) {
+        *err = ENOMEM;
+        return NULL;
+    }
+    s->pack_max = options->no_pack ? 0 : options->pack_max;
+    s->direct_min = options->direct_min;
+    if (s->direct_min) {
+        s->buffers = buffer_pool_create(OBJECT_DIRECT_CHUNK, OBJECT_DIRECT_BUFFERS);
+        if (!s->buffers) {
+            *err = ENOMEM;
+            free(s);
+            return NULL;
+        }
+    }
+    s->root = strdup(root);
+    s->root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (!s->root || s->root_fd < 0) {
+        *err = s->root ? errno : ENOMEM;
+        object_store_close(s);
+        return NULL;
+    }
+    if (!options->no_sync) {
+        sync_group_options_t so = { .delay_us = options->sync_delay_us,
+                                    .syncfs_min = options->syncfs_min };
+        s->sync = sync_group_start(s->root_fd, &so, err);
+        if (!s->sync) {
+            object_store_close(s);
+            return NULL;
+        }
+    }
+    // Сегменты открываются и при pack_max=0: упакованное раньше должно читаться
+    if (!options->no_pack && !open_pack(s, options, err)) {
+        object_store_close(s);
+        return NULL;
+    }
+    return s;
+}
+
+void object_store_close(object_store_t *s) {
+    if (!s) return;
+    if (s->pack) pack_store_close(s->pack);
+    sync_group_stop(s->sync);
+    buffer_pool_destroy(s->buffers);
+    if (s->root_fd >= 0) close(s->root_fd);
+    free(s->root);
+    free(s);
+}
+
+pack_store_t *object_store_pack(object_store_t *s) {
+    return s->pack;
+}
+
+const char *object_store_root(const object_store_t *s) {
+    return s->root;
+}
+
+int object_store_root_fd(const object_store_t *s) {
+    return s->root_fd;
+}
+
+bool object_id_generate(char out[OBJECT_ID_LEN]) {
+    static const char hex[] = "0123456789abcdef";
+    uint8_t raw[(OBJECT_ID_LEN - 1) / 2];
+    size_t got = 0;
+    while (got < sizeof(raw)) {
+        ssize_t n = getrandom(raw + got, sizeof(raw) - got, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        got += (size_t)n;
+    }
+    for (size_t i = 0; i < sizeof(raw); i++) {
+        out[2 * i] = hex[raw[i] >> 4];
+        out[2 * i + 1] = hex[raw[i] & 0x0f];
+    }
+    out[OBJECT_ID_LEN - 1] = '\0';
+    return true;
+}
+
+bool object_id_valid(const char *id) {
+    size_t i = 0;
+    for (; id[i]; i++) {
+        if (i >= OBJECT_ID_LEN - 1) return false;
+        if (!((id[i] >= '0' && id[i] <= '9') || (id[i] >= 'a' && id[i] <= 'f'))) return false;
+    }
+    return i == OBJECT_ID_LEN - 1;
+}
+
+// Имя в плоской раскладке: без '/', не "." и не ".."
+static bool flat_name_valid(const char *name) {
+    return name[0] && !strchr(name, '/') && strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+}
+
+// 32 hex-символа в 16 байт ключа сегментов; id уже проверен
+static void id_bytes(const char *id, uint8_t out[PACK_ID_LEN]) {
+    for (int i = 0; i < PACK_ID_LEN; i++) {
+        char hi = id[2 * i], lo = id[2 * i + 1];
+        out[i] = (uint8_t)(((hi <= '9' ? hi - '0' : hi - 'a' + 10) << 4) |
+                           (lo <= '9' ? lo - '0' : lo - 'a' + 10));
+    }
+}
+
+// "xx/yy/<id>" относительно корня
+static bool rel_path(const char *id, char out[REL_PATH_LEN]) {
+    if (!object_id_valid(id)) return false;
+    snprintf(out, REL_PATH_LEN, "%.2s/%.2s/%s", id, id + 2, id);
+    return true;
+}
+
+bool object_store_path(const object_store_t *s, const char *id, char *out, size_t len) {
+    char rel[REL_PATH_LEN];
+    if (!rel_path(id, rel)) return false;
+    int n = snprintf(out, len, "%s/%s", s->root, rel);
+    return n > 0 && (size_t)n < len;
+}
+
+// fsync каталога rel ("" — корень)
+static bool sync_dir(object_store_t *s, const char *rel, int *err) {
+    int fd = rel[0] ? openat(s->root_fd, rel, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : s->root_fd;
+    if (fd < 0 || fsync(fd) != 0) {
+        *err = errno;
+        if (fd >= 0 && fd != s->root_fd) close(fd);
+        return false;
+    }
+    if (fd != s->root_fd) close(fd);
+    return true;
+}
+
+// Каталоги xx и xx/yy; уже существующие — не ошибка. Запись о новом
+// каталоге сразу сбрасывается в родителя: за жизнь хранилища их 65792
+static bool make_fanout(object_store_t *s, const char *rel, int *err) {
+    char dir[6], parent[3] = "";
+    for (size_t n = 2; n <= 5; n += 3) {
+        memcpy(dir, rel, n);
+        dir[n] = '\0';
+        if (mkdirat(s->root_fd, dir, 0755) != 0) {
+            if (errno != EEXIST) {
+                *err = errno;
+                return false;
+            }
+        } else if (s->sync && !sync_dir(s, parent, err)) {
+            return false;
+        }
+        memcpy(parent, rel, 2);
+    }
+    return true;
+}
+
+// Каталог xx/yy объекта
+static int open_fanout(object_store_t *s, const char *rel, int *err) {
+    char dir[6];
+    memcpy(dir, rel, 5);
+    dir[5] = '\0';
+    int fd = openat(s->root_fd, dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        if (!make_fanout(s, rel, err)) return -1;
+        fd = openat(s->root_fd, dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (fd < 0) *err = errno;
+    return fd;
+}
+
+// Даёт открытому файлу имя name; EEXIST — такой объект уже есть
+static bool publish(int fd, int dir_fd, const char *tmp_name, const char *name, int *err) {
+    int rc;
+    if (tmp_name) {
+        rc = linkat(dir_fd, tmp_name, dir_fd, name, 0);
+    } else {
+        // AT_EMPTY_PATH требует CAP_DAC_READ_SEARCH; без неё — через /proc
+        rc = linkat(fd, "", dir_fd, name, AT_EMPTY_PATH);
+        if (rc != 0 && errno != EEXIST) {
+            char proc[32];
+            snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+            rc = linkat(AT_FDCWD, proc, dir_fd, name, AT_SYMLINK_FOLLOW);
+        }
+    }
+    if (rc != 0) {
+        *err = errno;
+        return false;
+    }
+    return true;
+}
+
+static bool pwrite_all(int fd, const uint8_t *data, size_t len, off_t off, int *err) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            *err = errno;
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return true;
+}
+
+static bool set_direct(int fd, bool on) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) return false;
+    flags = on ? flags | O_DIRECT : flags & ~O_DIRECT;
+    return fcntl(fd, F_SETFL, flags) == 0;
+}
+
+// Крупный объект: место выделяется сразу одним fallocate (меньше
+// фрагментация, ENOSPC до передачи), выровненная часть идёт мимо кеша
+// страниц через буфер пула, хвост короче страницы — обычной записью.
+// Без поддержки O_DIRECT (tmpfs и т.п.) — обычная запись целиком.
+static bool write_large(object_store_t *s, int fd, const uint8_t *data, size_t len, int *err) {
+    if (fallocate(fd, 0, 0, (off_t)len) != 0 && errno != EOPNOTSUPP && errno != ENOSYS) {
+        *err = errno;
+        return false;
+    }
+
+    size_t aligned = len & ~(size_t)(BUFFER_POOL_ALIGN - 1);
+    size_t off = 0;
+    uint8_t *buf = aligned ? buffer_pool_get(s->buffers) : NULL;
+    if (buf && set_direct(fd, true)) {
+        size_t chunk = buffer_pool_size(s->buffers);
+        while (off < aligned) {
+            size_t n = aligned - off < chunk ? aligned - off : chunk;
+            memcpy(buf, data + off, n);
+            ssize_t w;
+            do {
+                w = pwrite(fd, buf, n, (off_t)off);
+            } while (w < 0 && errno == EINTR);
+            if (w < 0 && errno == EINVAL && off == 0) break; // выравнивание не то — без O_DIRECT
+            if (w < 0) {
+                *err = errno;
+                buffer_pool_put(s->buffers, buf);
+                return false;
+            }
+            // Короткая запись с O_DIRECT оставляет невыровненный остаток:
+            // он уходит в обычную запись ниже
+            off += (size_t)w;
+            if ((size_t)w < n) break;
+        }
+        set_direct(fd, false);
+    }
+    buffer_pool_put(s->buffers, buf);
+    return pwrite_all(fd, data + off, len - off, (off_t)off, err);
+}
+
+bool object_store_put(object_store_t *s, const char *id, const void *data, size_t len, int *err) {
+    char rel[REL_PATH_LEN];
+    if (!rel_path(id, rel)) {
+        *err = EINVAL;
+        return false;
+    }
+
+    // pack_max=0 — пачки только читаются (при no_pack их нет вовсе),
+    // пустой объект тоже пишется файлом
+    if (s->pack && s->pack_max && len <= s->pack_max) {
+        uint8_t key[PACK_ID_LEN];
+        id_bytes(id, key);
+        return pack_store_put(s->pack, key, data, len, err);
+    }
+
+    int dir_fd = open_fanout(s, rel, err);
+    if (dir_fd < 0) return false;
+    const char *name = rel + 6;
+
+    // Безымянный файл появляется в каталоге только целиком (linkat);
+    // без поддержки O_TMPFILE — временное имя, которое читатели не ищут
+    char tmp_name[8 + OBJECT_ID_LEN];
+    bool named_tmp = false;
+    int fd = openat(dir_fd, ".", O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+    if (fd < 0 && (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL)) {
+        snprintf(tmp_name, sizeof(tmp_name), ".tmp.%s", name);
+        fd = openat(dir_fd, tmp_name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        named_tmp = true;
+    }
+    if (fd < 0) {
+        *err = errno;
+        close(dir_fd);
+        return false;
+    }
+
+    bool large = s->direct_min && len >= s->direct_min;
+    bool ok = (large ? write_large(s, fd, data, len, err) : pwrite_all(fd, data, len, 0, err)) &&
+              publish(fd, dir_fd, named_tmp ? tmp_name : NULL, name, err);
+    if (named_tmp) unlinkat(dir_fd, tmp_name, 0);
+
+    // Объект уже виден, но документ о нём появится только после сброса:
+    // после сбоя недописанный файл никто не найдёт
+    if (ok && s->sync && !sync_group_wait(s->sync, fd, dir_fd, err)) {
+        unlinkat(dir_fd, name, 0);
+        ok = false;
+    }
+    // Сброшенные страницы хвоста (и всего файла без O_DIRECT) из кеша:
+    // объект пишется один раз, а читается редко
+    if (ok && large) posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    close(dir_fd);
+    return ok;
+}
+
+static uint8_t *read_at(object_store_t *s, const char *rel, size_t *len, int *err) {
+    int fd = openat(s->root_fd, rel, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *err = errno;
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        *err = errno;
+        close(fd);
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        *err = ENOENT;
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    uint8_t *buf = malloc(size ? size : 1);
+    if (!buf) {
+        *err = ENOMEM;
+        close(fd);
+        return NULL;
+    }
+
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(fd, buf + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            // Файл укоротили под нами — считаем ошибкой ввода-вывода
+            *err = n < 0 ? errno : EIO;
+            free(buf);
+            close(fd);
+            return NULL;
+        }
+        got += (size_t)n;
+    }
+    close(fd);
+    *len = size;
+    return buf;
+}
+
+uint8_t *object_store_read(object_store_t *s, const char *id, size_t *len, int *err) {
+    char rel[REL_PATH_LEN];
+    if (!rel_path(id, rel)) {
+        *err = EINVAL;
+        return NULL;
+    }
+    uint8_t key[PACK_ID_LEN];
+    id_bytes(id, key);
+    if (s->pack) {
+        uint8_t *data = pack_store_read(s->pack, key, len, err);
+        if (data || *err != ENOENT) return data;
+    }
+    return read_at(s, rel, len, err);
+}
+
+uint8_t *object_store_read_flat(object_store_t *s, const char *name, size_t *len, int *err) {
+    if (!flat_name_valid(name)) {
+        *err = EINVAL;
+        return NULL;
+    }
+    return read_at(s, name, len, err);
+}
+
+bool object_store_link_flat(object_store_t *s, const char *name, const char *id, int *err) {
+    char rel[REL_PATH_LEN];
+    if (!flat_name_valid(name) || !rel_path(id, rel)) {
+        *err = EINVAL;
+        return false;
+    }
+
+    int dir_fd = open_fanout(s, rel, err);
+    if (dir_fd < 0) return false;
+    bool ok = linkat(s->root_fd, name, dir_fd, rel + 6, 0) == 0;
+    if (!ok) *err = errno;
+
+    // Документ получит id только после того, как ссылка на диске
+    if (ok && s->sync && !sync_group_wait(s->sync, dir_fd, -1, err)) {
+        unlinkat(dir_fd, rel + 6, 0);
+        ok = false;
+    }
+    close(dir_fd);
+    return ok;
+}
+
+bool object_store_remove(object_store_t *s, const char *id, int *err) {
+    char rel[REL_PATH_LEN];
+    if (!rel_path(id, rel)) {
+        *err = EINVAL;
+        return false;
+    }
+    uint8_t key[PACK_ID_LEN];
+    id_bytes(id, key);
+    if (s->pack && pack_store_remove(s->pack, key, err)) return true;
+    if (unlinkat(s->root_fd, rel, 0) != 0) {
+        *err = errno;
+        return false;
+    }
+    return true;
+}
+
+bool object_store_unlink_flat(object_store_t *s, const char *name, int *err) {
+    if (!flat_name_valid(name)) {
+        *err = EINVAL;
+        return false;
+    }
+    if (unlinkat(s->root_fd, name, 0) != 0) {
+        *err = errno;
+        return false;
+    }
+    return true;
+}
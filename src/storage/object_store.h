@@ -0,0 +1,121 @@
+#ifndef OBJECT_STORE_H
+#define OBJECT_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pack_store.h"
+
+// Хранилище зашифрованных объектов на диске. Объект называется не именем,
+// которое прислал клиент, а неизменяемым id (16 случайных байт в hex) и
+// лежит в root/xx/yy/<id>, где xx и yy — первые два байта id. Каталоги
+// веера создаются при первой записи; в каждом в среднем count / 65536
+// объектов, и загрузки разных клиентов с одним именем не затирают друг друга.
+//
+// Объекты не больше pack_max байт дописываются в сегменты root/pack
+// (storage/pack_store.h): ни inode, ни open на объект. Вызывающему не
+// важно, где лежит объект, — чтение и удаление ищут сначала в сегментах.
+//
+// Файлы прежней плоской раскладки (root/<filename>) читаются через
+// object_store_read_flat, пока layout_migrate их не перенесёт.
+//
+// Все пути — относительно открытого дескриптора root (openat и т.д.).
+// Модуль не логирует: ошибки возвращаются как errno в *err.
+
+#define OBJECT_ID_LEN 33 // 32 hex-символа и '\0'
+
+#define OBJECT_PACK_MAX_DEFAULT (16 * 1024)
+#define OBJECT_SEGMENT_MAX_DEFAULT (64ull * 1024 * 1024)
+#define OBJECT_COMPACT_PCT_DEFAULT 50
+#define OBJECT_DIRECT_MIN_DEFAULT (1024 * 1024)
+#define OBJECT_DIRECT_CHUNK (1024 * 1024)  // буфер пула для O_DIRECT
+#define OBJECT_DIRECT_BUFFERS 8            // свободных буферов в пуле
+
+typedef struct object_store object_store_t;
+
+typedef struct {
+    size_t pack_max;        // объекты до этого размера — в сегменты, 0 — не паковать
+    uint64_t segment_max;
+    unsigned compact_pct;   // мёртвого места в сегменте для уплотнения, 0 — не уплотнять
+    bool no_pack;           // не открывать сегменты: ими владеет работающий сервер
+    bool no_sync;           // не ждать сброса на диск (тесты, стенды)
+    unsigned sync_delay_us; // sync_group_options_t
+    size_t syncfs_min;
+    size_t direct_min;      // с этого размера — fallocate и O_DIRECT, 0 — никогда
+} object_store_options_t;
+
+void object_store_options_default(object_store_options_t *out);
+
+/**
+ * @brief Разбирает параметры хранилища поверх значений по умолчанию.
+ *
+ * Формат: "pack_max=16K,segment_max=64M,compact_pct=50,sync=1,sync_delay_us=0,
+ * syncfs_min=0,direct_min=1M"; суффиксы K, M, G.
+ *
+ * @return false — неизвестный ключ или значение
+ */
+bool object_store_parse_options(const char *spec, object_store_options_t *out);
+
+/**
+ * @brief Открывает (при необходимости создаёт) корневой каталог хранилища.
+ *
+ * @param options NULL — значения по умолчанию
+ * @return хранилище или NULL, причина в *err
+ */
+object_store_t *object_store_open(const char *root, const object_store_options_t *options,
+                                  int *err);
+
+// Ни один поток не должен быть внутри put/read/remove (сервер сначала
+// дожидается потоков клиентов)
+void object_store_close(object_store_t *s);
+
+const char *object_store_root(const object_store_t *s);
+
+// Новый случайный id; false — getrandom недоступен
+bool object_id_generate(char out[OBJECT_ID_LEN]);
+
+// Ровно 32 символа [0-9a-f]
+bool object_id_valid(const char *id);
+
+// root/xx/yy/<id> для журналов и событий proc (у упакованного объекта —
+// условное имя, файла нет); false — id некорректен
+bool object_store_path(const object_store_t *s, const char *id, char *out, size_t len);
+
+/**
+ * @brief Записывает объект целиком и ждёт сброса на диск.
+ *
+ * Файл пишется безымянным (O_TMPFILE) и получает имя linkat только
+ * дописанным: читатель не увидит половину объекта. Существующий объект не
+ * перезаписывается (EEXIST). Возврат — после группового сброса
+ * (storage/sync_group.h), поэтому документ в метаданных, вставленный
+ * после него, не укажет на потерянные при сбое данные.
+ */
+bool object_store_put(object_store_t *s, const char *id, const void *data, size_t len, int *err);
+
+/**
+ * @brief Читает объект целиком в буфер из malloc.
+ *
+ * @return буфер (освобождает вызывающий) или NULL; ENOENT — объекта нет
+ */
+uint8_t *object_store_read(object_store_t *s, const char *id, size_t *len, int *err);
+
+// То же для файла плоской раскладки root/<name>; name без '/'
+uint8_t *object_store_read_flat(object_store_t *s, const char *name, size_t *len, int *err);
+
+// Жёсткая ссылка на файл плоской раскладки под id (для переноса); как и
+// put, возвращается после сброса каталога
+bool object_store_link_flat(object_store_t *s, const char *name, const char *id, int *err);
+
+bool object_store_remove(object_store_t *s, const char *id, int *err);
+
+// Удаляет имя root/<name> плоской раскладки
+bool object_store_unlink_flat(object_store_t *s, const char *name, int *err);
+
+// Дескриптор корня для обхода плоской раскладки (не закрывать)
+int object_store_root_fd(const object_store_t *s);
+
+// Сегменты упаковки; NULL — открыто с no_pack
+pack_store_t *object_store_pack(object_store_t *s);
+
+#endif // OBJECT_STORE_H
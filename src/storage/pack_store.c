@@ -0,0 +1,726 @@
+// storage/pack_store.c
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "pack_store.h"
+
+#define PACK_MAGIC 0x31524b50u // "PKR1"
+#define PACK_FLAG_DEAD 0x1u
+#define PACK_INITIAL_SLOTS 1024
+#define PACK_NAME_LEN 16       // "%08u.pack"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t flags;
+    uint32_t len;
+    uint32_t reserved;
+    uint8_t id[PACK_ID_LEN];
+} pack_header_t;
+
+_Static_assert(sizeof(pack_header_t) == 32, "pack header is part of the on-disk format");
+
+typedef struct {
+    uint32_t no;
+    int fd;
+    uint64_t size;      // конец последней записи; меняется только у текущего
+    uint64_t live;      // байт живых записей (под lock)
+    uint64_t dead;
+    bool sealed;
+    atomic_uint refs;   // список сегментов + читатели и уплотнение
+} pack_segment_t;
+
+typedef struct {
+    uint8_t id[PACK_ID_LEN];
+    pack_segment_t *seg; // NULL — пустой слот
+    uint64_t off;        // смещение заголовка
+    uint32_t len;
+} pack_slot_t;
+
+struct pack_store {
+    int dir_fd;
+    pack_options_t opts;
+
+    pthread_rwlock_t lock;          // индекс, список сегментов, live/dead
+    pack_slot_t *slots;
+    size_t cap, count;
+    pack_segment_t **segs;          // по возрастанию номера
+    size_t n_segs, segs_cap;
+
+    pthread_mutex_t append_lock;    // порядок: append_lock, затем lock
+    pack_segment_t *active;         // NULL — создать при следующей записи
+    uint32_t next_no;
+
+    pthread_mutex_t compact_lock;   // один проход уплотнения за раз
+    pthread_mutex_t wake_lock;
+    pthread_cond_t wake;
+    bool wake_pending;
+    bool stopping;
+    bool compactor_started;
+    pthread_t compactor;
+};
+
+static void segment_name(uint32_t no, char out[PACK_NAME_LEN]) {
+    snprintf(out, PACK_NAME_LEN, "%08" PRIu32 ".pack", no);
+}
+
+static void segment_unref(pack_segment_t *seg) {
+    if (atomic_fetch_sub(&seg->refs, 1) == 1) {
+        close(seg->fd);
+        free(seg);
+    }
+}
+
+static bool pread_all(int fd, void *buf, size_t len, uint64_t off) {
+    uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n == 0) errno = EIO;
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+        off += (uint64_t)n;
+    }
+    return true;
+}
+
+// Флаг в заголовке, чтобы запись не воскресла при восстановлении индекса
+static void mark_dead(pack_segment_t *seg, uint64_t off) {
+    uint32_t flags = PACK_FLAG_DEAD;
+    if (pwrite(seg->fd, &flags, sizeof(flags), (off_t)(off + offsetof(pack_header_t, flags))) < 0) {
+        // Не страшно: после перезапуска запись станет живой, но без документа
+        // в метаданных до неё никто не дойдёт
+    }
+}
+
+// --- Индекс: открытая адресация, id случайны — хеш берётся из первых байт
+
+static size_t slot_home(const pack_store_t *p, const uint8_t id[PACK_ID_LEN]) {
+    uint64_t h;
+    memcpy(&h, id, sizeof(h));
+    return (size_t)h & (p->cap - 1);
+}
+
+static pack_slot_t *index_find(const pack_store_t *p, const uint8_t id[PACK_ID_LEN]) {
+    if (!p->slots) return NULL;
+    for (size_t i = slot_home(p, id);; i = (i + 1) & (p->cap - 1)) {
+        pack_slot_t *slot = &p->slots[i];
+        if (!slot->seg) return NULL;
+        if (memcmp(slot->id, id, PACK_ID_LEN) == 0) return slot;
+    }
+}
+
+static void index_place(pack_store_t *p, const pack_slot_t *entry) {
+    size_t i = slot_home(p, entry->id);
+    while (p->slots[i].seg) i = (i + 1) & (p->cap - 1);
+    p->slots[i] = *entry;
+}
+
+static bool index_insert(pack_store_t *p, const pack_slot_t *entry) {
+    if ((p->count + 1) * 10 > p->cap * 7) {
+        size_t cap = p->cap ? p->cap * 2 : PACK_INITIAL_SLOTS;
+        pack_slot_t *old = p->slots;
+        size_t old_cap = p->cap;
+        p->slots = calloc(cap, sizeof(*p->slots));
+        if (!p->slots) {
+            p->slots = old;
+            return false;
+        }
+        p->cap = cap;
+        for (size_t i = 0; i < old_cap; i++) {
+            if (old[i].seg) index_place(p, &old[i]);
+        }
+        free(old);
+    }
+    index_place(p, entry);
+    p->count++;
+    return true;
+}
+
+// Удаление со сдвигом назад: цепочки проб остаются без дыр
+static void index_erase(pack_store_t *p, pack_slot_t *slot) {
+    size_t mask = p->cap - 1;
+    size_t i = (size_t)(slot - p->slots);
+    for (size_t j = (i + 1) & mask; p->slots[j].seg; j = (j + 1) & mask) {
+        size_t home = slot_home(p, p->slots[j].id);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            p->slots[i] = p->slots[j];
+            i = j;
+        }
+    }
+    p->slots[i].seg = NULL;
+    p->count--;
+}
+
+// --- Сегменты
+
+static bool compact_due(const pack_store_t *p, const pack_segment_t *seg) {
+    return p->opts.compact_pct && seg->sealed && seg->size > 0 &&
+           seg->dead * 100 >= seg->size * p->opts.compact_pct;
+}
+
+static void wake_compactor(pack_store_t *p) {
+    if (!p->compactor_started) return;
+    pthread_mutex_lock(&p->wake_lock);
+    p->wake_pending = true;
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->wake_lock);
+}
+
+static pack_segment_t *segment_new(uint32_t no, int fd, uint64_t size) {
+    pack_segment_t *seg = calloc(1, sizeof(*seg));
+    if (!seg) return NULL;
+    seg->no = no;
+    seg->fd = fd;
+    seg->size = size;
+    atomic_init(&seg->refs, 1);
+    return seg;
+}
+
+// Под wrlock
+static bool segments_add(pack_store_t *p, pack_segment_t *seg) {
+    if (p->n_segs == p->segs_cap) {
+        size_t cap = p->segs_cap ? p->segs_cap * 2 : 16;
+        pack_segment_t **segs = realloc(p->segs, cap * sizeof(*segs));
+        if (!segs) return false;
+        p->segs = segs;
+        p->segs_cap = cap;
+    }
+    p->segs[p->n_segs++] = seg;
+    return true;
+}
+
+// Под append_lock
+static pack_segment_t *segment_create(pack_store_t *p, int *err) {
+    char name[PACK_NAME_LEN];
+    uint32_t no = p->next_no;
+    segment_name(no, name);
+    int fd = openat(p->dir_fd, name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        *err = errno;
+        return NULL;
+    }
+    // Имя сегмента на диске до первой записи, которую кто-то будет ждать
+    if (p->opts.sync && fsync(p->dir_fd) != 0) {
+        *err = errno;
+        close(fd);
+        unlinkat(p->dir_fd, name, 0);
+        return NULL;
+    }
+
+    pack_segment_t *seg = segment_new(no, fd, 0);
+    pthread_rwlock_wrlock(&p->lock);
+    bool added = seg && segments_add(p, seg);
+    pthread_rwlock_unlock(&p->lock);
+    if (!added) {
+        free(seg);
+        close(fd);
+        unlinkat(p->dir_fd, name, 0);
+        *err = ENOMEM;
+        return NULL;
+    }
+    p->next_no++;
+    p->active = seg;
+    return seg;
+}
+
+// Под append_lock
+static void segment_seal(pack_store_t *p, pack_segment_t *seg) {
+    pthread_rwlock_wrlock(&p->lock);
+    seg->sealed = true;
+    bool due = compact_due(p, seg);
+    pthread_rwlock_unlock(&p->lock);
+    p->active = NULL;
+    if (due) wake_compactor(p);
+}
+
+// Дописывает запись в текущий сегмент; под append_lock
+static bool append_record(pack_store_t *p, const uint8_t id[PACK_ID_LEN], const void *data,
+                          uint32_t len, pack_segment_t **seg_out, uint64_t *off_out, int *err) {
+    uint64_t rec = sizeof(pack_header_t) + len;
+    pack_segment_t *seg = p->active;
+    if (seg && seg->size > 0 && seg->size + rec > p->opts.segment_max) {
+        segment_seal(p, seg);
+        seg = NULL;
+    }
+    if (!seg && !(seg = segment_create(p, err))) return false;
+
+    pack_header_t h = { .magic = PACK_MAGIC, .len = len };
+    memcpy(h.id, id, PACK_ID_LEN);
+    struct iovec iov[2] = {
+        { .iov_base = &h, .iov_len = sizeof(h) },
+        { .iov_base = (void *)data, .iov_len = len },
+    };
+    ssize_t n;
+    do {
+        n = pwritev(seg->fd, iov, 2, (off_t)seg->size);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)rec) {
+        *err = n < 0 ? errno : ENOSPC;
+        // Обрывок записи в середине сегмента остановил бы восстановление
+        if (ftruncate(seg->fd, (off_t)seg->size) != 0) segment_seal(p, seg);
+        return false;
+    }
+
+    *seg_out = seg;
+    *off_out = seg->size;
+    seg->size += rec;
+    return true;
+}
+
+// Проход по записям сегмента при открытии; под lock не нужен — потоков ещё нет
+static bool segment_load(pack_store_t *p, pack_segment_t *seg, int *err) {
+    struct stat st;
+    if (fstat(seg->fd, &st) != 0) {
+        *err = errno;
+        return false;
+    }
+
+    uint64_t size = (uint64_t)st.st_size, off = 0;
+    pack_header_t h;
+    while (off + sizeof(h) <= size) {
+        if (!pread_all(seg->fd, &h, sizeof(h), off)) {
+            *err = errno;
+            return false;
+        }
+        uint64_t rec = sizeof(h) + h.len;
+        if (h.magic != PACK_MAGIC || off + rec > size) break;
+
+        if (h.flags & PACK_FLAG_DEAD) {
+            seg->dead += rec;
+        } else {
+            // Копия из прерванного уплотнения: побеждает более новый сегмент
+            pack_slot_t *slot = index_find(p, h.id);
+            if (slot) {
+                uint64_t old = sizeof(h) + slot->len;
+                slot->seg->live -= old;
+                slot->seg->dead += old;
+                slot->seg = seg;
+                slot->off = off;
+                slot->len = h.len;
+            } else {
+                pack_slot_t entry = { .seg = seg, .off = off, .len = h.len };
+                memcpy(entry.id, h.id, PACK_ID_LEN);
+                if (!index_insert(p, &entry)) {
+                    *err = ENOMEM;
+                    return false;
+                }
+            }
+            seg->live += rec;
+        }
+        off += rec;
+    }
+
+    // Недописанная запись после сбоя
+    if (off < size && ftruncate(seg->fd, (off_t)off) != 0) {
+        *err = errno;
+        return false;
+    }
+    seg->size = off;
+    return true;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static bool parse_segment_name(const char *name, uint32_t *no) {
+    if (strlen(name) != 8 + 5 || strcmp(name + 8, ".pack") != 0) return false;
+    uint32_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        if (name[i] < '0' || name[i] > '9') return false;
+        v = v * 10 + (uint32_t)(name[i] - '0');
+    }
+    *no = v;
+    return true;
+}
+
+static bool load_segments(pack_store_t *p, int *err) {
+    int fd = dup(p->dir_fd);
+    DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!dir) {
+        *err = errno;
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    uint32_t *nos = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent *de;
+    bool ok = true;
+    while ((de = readdir(dir)) != NULL) {
+        uint32_t no;
+        if (!parse_segment_name(de->d_name, &no)) continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 16;
+            uint32_t *grown = realloc(nos, cap * sizeof(*nos));
+            if (!grown) {
+                *err = ENOMEM;
+                ok = false;
+                break;
+            }
+            nos = grown;
+        }
+        nos[n++] = no;
+    }
+    closedir(dir);
+    if (n) qsort(nos, n, sizeof(*nos), cmp_u32);
+
+    for (size_t i = 0; ok && i < n; i++) {
+        char name[PACK_NAME_LEN];
+        segment_name(nos[i], name);
+        int seg_fd = openat(p->dir_fd, name, O_RDWR | O_CLOEXEC);
+        pack_segment_t *seg = seg_fd >= 0 ? segment_new(nos[i], seg_fd, 0) : NULL;
+        if (!seg) {
+            *err = seg_fd < 0 ? errno : ENOMEM;
+            if (seg_fd >= 0) close(seg_fd);
+            ok = false;
+        } else if (!segments_add(p, seg)) {
+            segment_unref(seg);
+            *err = ENOMEM;
+            ok = false;
+        } else {
+            ok = segment_load(p, seg, err);
+        }
+    }
+
+    if (ok && n) {
+        p->next_no = nos[n - 1] + 1;
+        for (size_t i = 0; i + 1 < p->n_segs; i++) p->segs[i]->sealed = true;
+        pack_segment_t *last = p->segs[p->n_segs - 1];
+        if (last->size < p->opts.segment_max) p->active = last;
+        else last->sealed = true;
+    }
+    free(nos);
+    return ok;
+}
+
+// --- Уплотнение
+
+static bool sync_newer(pack_store_t *p, uint32_t after) {
+    for (;;) {
+        pack_segment_t *next = NULL;
+        pthread_rwlock_rdlock(&p->lock);
+        for (size_t i = 0; i < p->n_segs && !next; i++) {
+            if (p->segs[i]->no > after) next = p->segs[i];
+        }
+        if (next) atomic_fetch_add(&next->refs, 1);
+        pthread_rwlock_unlock(&p->lock);
+        if (!next) return true;
+
+        int rc;
+        do {
+            rc = fdatasync(next->fd);
+        } while (rc != 0 && errno == EINTR);
+        after = next->no;
+        segment_unref(next);
+        if (rc != 0) return false;
+    }
+}
+
+// Переносит живые записи seg в текущий сегмент; true — seg удалён
+static bool compact_segment(pack_store_t *p, pack_segment_t *seg) {
+    uint64_t off = 0;
+    pack_header_t h;
+    while (off < seg->size) {
+        if (!pread_all(seg->fd, &h, sizeof(h), off) || h.magic != PACK_MAGIC) return false;
+        uint64_t rec = sizeof(h) + h.len;
+
+        pthread_rwlock_rdlock(&p->lock);
+        const pack_slot_t *slot = (h.flags & PACK_FLAG_DEAD) ? NULL : index_find(p, h.id);
+        bool live = slot && slot->seg == seg && slot->off == off;
+        pthread_rwlock_unlock(&p->lock);
+
+        if (live) {
+            uint8_t *buf = malloc(h.len ? h.len : 1);
+            if (!buf || !pread_all(seg->fd, buf, h.len, off + sizeof(h))) {
+                free(buf);
+                return false;
+            }
+
+            pthread_mutex_lock(&p->append_lock);
+            pack_segment_t *to;
+            uint64_t to_off;
+            int err;
+            bool copied = append_record(p, h.id, buf, h.len, &to, &to_off, &err);
+            bool moved = false;
+            if (copied) {
+                pthread_rwlock_wrlock(&p->lock);
+                pack_slot_t *cur = index_find(p, h.id);
+                moved = cur && cur->seg == seg && cur->off == off;
+                if (moved) {
+                    // Читатель, взявший старое место, дочитает по своей ссылке
+                    cur->seg = to;
+                    cur->off = to_off;
+                    seg->live -= rec;
+                    seg->dead += rec;
+                    to->live += rec;
+                } else {
+                    to->dead += rec; // удалили, пока копировали
+                }
+                pthread_rwlock_unlock(&p->lock);
+            }
+            pthread_mutex_unlock(&p->append_lock);
+            free(buf);
+            if (!copied) return false;
+            if (!moved) mark_dead(to, to_off);
+        }
+        off += rec;
+    }
+
+    // Копии на диске раньше, чем исчезнет оригинал: они только в более
+    // новых сегментах, а fdatasync чистого файла почти бесплатен
+    if (p->opts.sync && !sync_newer(p, seg->no)) return false;
+
+    pthread_rwlock_wrlock(&p->lock);
+    bool empty = seg->live == 0;
+    if (empty) {
+        for (size_t i = 0; i < p->n_segs; i++) {
+            if (p->segs[i] == seg) {
+                memmove(&p->segs[i], &p->segs[i + 1], (p->n_segs - i - 1) * sizeof(*p->segs));
+                p->n_segs--;
+                break;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&p->lock);
+    if (!empty) return false;
+
+    char name[PACK_NAME_LEN];
+    segment_name(seg->no, name);
+    unlinkat(p->dir_fd, name, 0);
+    // Ссылка списка сегментов; последнюю держит вызывающий
+    atomic_fetch_sub(&seg->refs, 1);
+    return true;
+}
+
+size_t pack_store_compact(pack_store_t *p) {
+    size_t done = 0;
+    pthread_mutex_lock(&p->compact_lock);
+    for (;;) {
+        pack_segment_t *pick = NULL;
+        pthread_rwlock_rdlock(&p->lock);
+        for (size_t i = 0; i < p->n_segs && !pick; i++) {
+            if (compact_due(p, p->segs[i])) pick = p->segs[i];
+        }
+        if (pick) atomic_fetch_add(&pick->refs, 1);
+        pthread_rwlock_unlock(&p->lock);
+        if (!pick) break;
+
+        bool removed = compact_segment(p, pick);
+        segment_unref(pick);
+        if (!removed) break; // ошибка ввода-вывода: следующая попытка по сигналу
+        done++;
+    }
+    pthread_mutex_unlock(&p->compact_lock);
+    return done;
+}
+
+static void *compactor_main(void *arg) {
+    pack_store_t *p = arg;
+    pthread_mutex_lock(&p->wake_lock);
+    while (!p->stopping) {
+        if (!p->wake_pending) {
+            pthread_cond_wait(&p->wake, &p->wake_lock);
+            continue;
+        }
+        p->wake_pending = false;
+        pthread_mutex_unlock(&p->wake_lock);
+        pack_store_compact(p);
+        pthread_mutex_lock(&p->wake_lock);
+    }
+    pthread_mutex_unlock(&p->wake_lock);
+    return NULL;
+}
+
+// --- Открытие и операции
+
+pack_store_t *pack_store_open(int dir_fd, const pack_options_t *opts, int *err) {
+    pack_store_t *p = calloc(1, sizeof(*p));
+    if (!p) {
+        *err = ENOMEM;
+        return NULL;
+    }
+    p->opts = *opts;
+    pthread_rwlock_init(&p->lock, NULL);
+    pthread_mutex_init(&p->append_lock, NULL);
+    pthread_mutex_init(&p->compact_lock, NULL);
+    pthread_mutex_init(&p->wake_lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+
+    // Второй процесс, дописывающий в те же сегменты, испортил бы их
+    // (своё открытие, а не dup: flock принадлежит открытому файлу)
+    p->dir_fd = openat(dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (p->dir_fd < 0 || flock(p->dir_fd, LOCK_EX | LOCK_NB) != 0) {
+        *err = errno;
+        pack_store_close(p);
+        return NULL;
+    }
+    if (!load_segments(p, err)) {
+        pack_store_close(p);
+        return NULL;
+    }
+
+    if (p->opts.background && p->opts.compact_pct) {
+        int rc = pthread_create(&p->compactor, NULL, compactor_main, p);
+        if (rc != 0) {
+            *err = rc;
+            pack_store_close(p);
+            return NULL;
+        }
+        p->compactor_started = true;
+        wake_compactor(p); // сегменты, набравшие мёртвое место до перезапуска
+    }
+    return p;
+}
+
+void pack_store_close(pack_store_t *p) {
+    if (!p) return;
+    if (p->compactor_started) {
+        pthread_mutex_lock(&p->wake_lock);
+        p->stopping = true;
+        pthread_cond_signal(&p->wake);
+        pthread_mutex_unlock(&p->wake_lock);
+        pthread_join(p->compactor, NULL);
+    }
+    for (size_t i = 0; i < p->n_segs; i++) segment_unref(p->segs[i]);
+    free(p->segs);
+    free(p->slots);
+    if (p->dir_fd >= 0) close(p->dir_fd);
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->wake_lock);
+    pthread_mutex_destroy(&p->compact_lock);
+    pthread_mutex_destroy(&p->append_lock);
+    pthread_rwlock_destroy(&p->lock);
+    free(p);
+}
+
+bool pack_store_put(pack_store_t *p, const uint8_t id[PACK_ID_LEN], const void *data, size_t len,
+                    int *err) {
+    if (len > UINT32_MAX - sizeof(pack_header_t)) {
+        *err = EFBIG;
+        return false;
+    }
+
+    // Под append_lock проверка и вставка не разделены другой записью
+    pthread_mutex_lock(&p->append_lock);
+    pthread_rwlock_rdlock(&p->lock);
+    bool exists = index_find(p, id) != NULL;
+    pthread_rwlock_unlock(&p->lock);
+    if (exists) {
+        pthread_mutex_unlock(&p->append_lock);
+        *err = EEXIST;
+        return false;
+    }
+
+    pack_segment_t *seg;
+    uint64_t off;
+    if (!append_record(p, id, data, (uint32_t)len, &seg, &off, err)) {
+        pthread_mutex_unlock(&p->append_lock);
+        return false;
+    }
+
+    uint64_t rec = sizeof(pack_header_t) + len;
+    pack_slot_t entry = { .seg = seg, .off = off, .len = (uint32_t)len };
+    memcpy(entry.id, id, PACK_ID_LEN);
+    pthread_rwlock_wrlock(&p->lock);
+    bool ok = index_insert(p, &entry);
+    if (ok) seg->live += rec;
+    else seg->dead += rec;
+    atomic_fetch_add(&seg->refs, 1); // сегмент переживёт уплотнение, пока ждём
+    pthread_rwlock_unlock(&p->lock);
+    pthread_mutex_unlock(&p->append_lock);
+
+    if (!ok) {
+        mark_dead(seg, off);
+        *err = ENOMEM;
+    } else if (p->opts.sync && !sync_group_wait(p->opts.sync, seg->fd, -1, err)) {
+        // Ждём вне append_lock: следующие записи успевают в ту же пачку
+        int ignored;
+        pack_store_remove(p, id, &ignored);
+        ok = false;
+    }
+    segment_unref(seg);
+    return ok;
+}
+
+uint8_t *pack_store_read(pack_store_t *p, const uint8_t id[PACK_ID_LEN], size_t *len, int *err) {
+    pthread_rwlock_rdlock(&p->lock);
+    const pack_slot_t *slot = index_find(p, id);
+    if (!slot) {
+        pthread_rwlock_unlock(&p->lock);
+        *err = ENOENT;
+        return NULL;
+    }
+    pack_segment_t *seg = slot->seg;
+    uint64_t off = slot->off + sizeof(pack_header_t);
+    uint32_t size = slot->len;
+    atomic_fetch_add(&seg->refs, 1);
+    pthread_rwlock_unlock(&p->lock);
+
+    uint8_t *buf = malloc(size ? size : 1);
+    if (!buf) {
+        *err = ENOMEM;
+    } else if (!pread_all(seg->fd, buf, size, off)) {
+        *err = errno;
+        free(buf);
+        buf = NULL;
+    } else {
+        *len = size;
+    }
+    segment_unref(seg);
+    return buf;
+}
+
+bool pack_store_remove(pack_store_t *p, const uint8_t id[PACK_ID_LEN], int *err) {
+    pthread_rwlock_wrlock(&p->lock);
+    pack_slot_t *slot = index_find(p, id);
+    if (!slot) {
+        pthread_rwlock_unlock(&p->lock);
+        *err = ENOENT;
+        return false;
+    }
+    pack_segment_t *seg = slot->seg;
+    uint64_t off = slot->off;
+    uint64_t rec = sizeof(pack_header_t) + slot->len;
+    index_erase(p, slot);
+    seg->live -= rec;
+    seg->dead += rec;
+    bool due = compact_due(p, seg);
+    atomic_fetch_add(&seg->refs, 1);
+    pthread_rwlock_unlock(&p->lock);
+
+    mark_dead(seg, off);
+    segment_unref(seg);
+    if (due) wake_compactor(p);
+    return true;
+}
+
+void pack_store_stats(pack_store_t *p, pack_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    pthread_rwlock_rdlock(&p->lock);
+    out->segments = p->n_segs;
+    out->objects = p->count;
+    for (size_t i = 0; i < p->n_segs; i++) {
+        out->live_bytes += p->segs[i]->live;
+        out->dead_bytes += p->segs[i]->dead;
+    }
+    pthread_rwlock_unlock(&p->lock);
+}
@@ -0,0 +1,70 @@
+#ifndef PACK_STORE_H
+#define PACK_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sync_group.h"
+
+// Мелкие объекты в сегментах: вместо файла на объект — запись в конце
+// общего сегмента dir/<номер>.pack. Индекс id -> (сегмент, смещение, длина)
+// держится в памяти и при открытии восстанавливается проходом по заголовкам
+// записей; чтение — один pread без open/stat.
+//
+// Запись: [заголовок 32 байта: magic, flags, len, id] [len байт]. Удаление
+// помечает заголовок флагом и добавляет запись к мёртвому месту сегмента.
+// Фоновый поток переписывает живые записи закрытого сегмента, в котором
+// мёртвого места не меньше compact_pct процентов, в текущий и удаляет его.
+//
+// Дописывание сериализовано: недописанной может быть только последняя
+// запись последнего сегмента, и при открытии она отрезается.
+// Модуль не логирует: ошибки возвращаются как errno в *err.
+
+#define PACK_ID_LEN 16 // сырые байты id объекта
+
+typedef struct pack_store pack_store_t;
+
+typedef struct {
+    uint64_t segment_max;   // размер, после которого сегмент закрывается
+    unsigned compact_pct;   // доля мёртвого места для уплотнения, 0 — не уплотнять
+    bool background;        // поток уплотнения; без него — pack_store_compact
+    sync_group_t *sync;     // put ждёт сброса сегмента; NULL — не ждать
+} pack_options_t;
+
+typedef struct {
+    size_t segments;
+    size_t objects;
+    uint64_t live_bytes;    // с заголовками
+    uint64_t dead_bytes;
+} pack_stats_t;
+
+/**
+ * @brief Открывает каталог сегментов, восстанавливает индекс.
+ *
+ * Каталог блокируется (flock): второе открытие, в том числе другим
+ * процессом, завершается с EWOULDBLOCK.
+ *
+ * @param dir_fd каталог сегментов (открывается заново, вызывающий закрывает свой)
+ * @return хранилище или NULL, причина в *err
+ */
+pack_store_t *pack_store_open(int dir_fd, const pack_options_t *opts, int *err);
+
+void pack_store_close(pack_store_t *p);
+
+// false и EEXIST — id уже в сегментах
+bool pack_store_put(pack_store_t *p, const uint8_t id[PACK_ID_LEN], const void *data, size_t len,
+                    int *err);
+
+// Буфер из malloc; NULL и ENOENT — id нет в сегментах
+uint8_t *pack_store_read(pack_store_t *p, const uint8_t id[PACK_ID_LEN], size_t *len, int *err);
+
+// false и ENOENT — id нет в сегментах
+bool pack_store_remove(pack_store_t *p, const uint8_t id[PACK_ID_LEN], int *err);
+
+// Уплотняет все подходящие закрытые сегменты сейчас; возвращает их число
+size_t pack_store_compact(pack_store_t *p);
+
+void pack_store_stats(pack_store_t *p, pack_stats_t *out);
+
+#endif // PACK_STORE_H
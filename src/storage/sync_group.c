@@ -0,0 +1,179 @@
+// storage/sync_group.c
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sync_group.h"
+
+// Запрос живёт на стеке ожидающего до done
+typedef struct sync_request {
+    int fd;
+    int dir_fd;
+    int err;
+    bool done;
+    struct sync_request *next;
+} sync_request_t;
+
+struct sync_group {
+    int fs_fd;
+    sync_group_options_t opts;
+    pthread_mutex_t lock;
+    pthread_cond_t work;        // появились запросы / остановка
+    pthread_cond_t done;        // пачка сброшена
+    sync_request_t *pending;
+    size_t n_pending;
+    bool stopping;
+    sync_group_stats_t stats;
+    pthread_t thread;
+};
+
+static int sync_fd(int fd, bool data_only) {
+    int rc;
+    do {
+        rc = data_only ? fdatasync(fd) : fsync(fd);
+    } while (rc != 0 && errno == EINTR);
+    return rc == 0 ? 0 : errno;
+}
+
+// Первый ли раз встречается дескриптор среди запросов до stop
+static bool first_of(const sync_request_t *head, const sync_request_t *stop, int fd, bool dir) {
+    for (const sync_request_t *r = head; r != stop; r = r->next) {
+        if ((dir ? r->dir_fd : r->fd) == fd) return false;
+    }
+    return true;
+}
+
+static void flush_batch(sync_group_t *g, sync_request_t *batch, size_t n) {
+    bool whole_fs = g->opts.syncfs_min && n >= g->opts.syncfs_min;
+    for (sync_request_t *r = batch; r && !whole_fs; r = r->next) {
+        if (r->fd < 0) whole_fs = true;
+    }
+
+    if (whole_fs) {
+        int err = syncfs(g->fs_fd) == 0 ? 0 : errno;
+        for (sync_request_t *r = batch; r; r = r->next) r->err = err;
+        return;
+    }
+
+    // Ошибка сброса файла относится ко всем, кто ждал этот файл
+    for (sync_request_t *r = batch; r; r = r->next) {
+        if (first_of(batch, r, r->fd, false)) {
+            r->err = sync_fd(r->fd, true);
+        } else {
+            for (sync_request_t *q = batch; q != r; q = q->next) {
+                if (q->fd == r->fd) {
+                    r->err = q->err;
+                    break;
+                }
+            }
+        }
+    }
+    for (sync_request_t *r = batch; r; r = r->next) {
+        if (r->dir_fd < 0 || !first_of(batch, r, r->dir_fd, true)) continue;
+        int err = sync_fd(r->dir_fd, false);
+        if (!err) continue;
+        for (sync_request_t *q = r; q; q = q->next) {
+            if (q->dir_fd == r->dir_fd && !q->err) q->err = err;
+        }
+    }
+}
+
+static void *sync_main(void *arg) {
+    sync_group_t *g = arg;
+    pthread_mutex_lock(&g->lock);
+    for (;;) {
+        while (!g->pending && !g->stopping) pthread_cond_wait(&g->work, &g->lock);
+        if (!g->pending) break; // остановка, всё сброшено
+
+        if (g->opts.delay_us && !g->stopping) {
+            pthread_mutex_unlock(&g->lock);
+            struct timespec ts = { .tv_sec = g->opts.delay_us / 1000000,
+                                   .tv_nsec = (long)(g->opts.delay_us % 1000000) * 1000 };
+            nanosleep(&ts, NULL);
+            pthread_mutex_lock(&g->lock);
+        }
+
+        sync_request_t *batch = g->pending;
+        size_t n = g->n_pending;
+        g->pending = NULL;
+        g->n_pending = 0;
+        pthread_mutex_unlock(&g->lock);
+
+        flush_batch(g, batch, n);
+
+        pthread_mutex_lock(&g->lock);
+        for (sync_request_t *r = batch; r; r = r->next) r->done = true;
+        g->stats.flushes++;
+        g->stats.requests += n;
+        pthread_cond_broadcast(&g->done);
+    }
+    pthread_mutex_unlock(&g->lock);
+    return NULL;
+}
+
+sync_group_t *sync_group_start(int fs_fd, const sync_group_options_t *opts, int *err) {
+    sync_group_t *g = calloc(1, sizeof(*g));
+    if (!g) {
+        *err = ENOMEM;
+        return NULL;
+    }
+    g->fs_fd = fs_fd;
+    g->opts = *opts;
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->work, NULL);
+    pthread_cond_init(&g->done, NULL);
+
+    int rc = pthread_create(&g->thread, NULL, sync_main, g);
+    if (rc != 0) {
+        *err = rc;
+        pthread_cond_destroy(&g->done);
+        pthread_cond_destroy(&g->work);
+        pthread_mutex_destroy(&g->lock);
+        free(g);
+        return NULL;
+    }
+    return g;
+}
+
+void sync_group_stop(sync_group_t *g) {
+    if (!g) return;
+    pthread_mutex_lock(&g->lock);
+    g->stopping = true;
+    pthread_cond_signal(&g->work);
+    pthread_mutex_unlock(&g->lock);
+    pthread_join(g->thread, NULL);
+
+    pthread_cond_destroy(&g->done);
+    pthread_cond_destroy(&g->work);
+    pthread_mutex_destroy(&g->lock);
+    free(g);
+}
+
+bool sync_group_wait(sync_group_t *g, int fd, int dir_fd, int *err) {
+    sync_request_t req = { .fd = fd, .dir_fd = dir_fd };
+    pthread_mutex_lock(&g->lock);
+    // Порядок в пачке не важен: добавляем в голову
+    req.next = g->pending;
+    g->pending = &req;
+    g->n_pending++;
+    pthread_cond_signal(&g->work);
+    while (!req.done) pthread_cond_wait(&g->done, &g->lock);
+    pthread_mutex_unlock(&g->lock);
+
+    if (req.err) {
+        *err = req.err;
+        return false;
+    }
+    return true;
+}
+
+void sync_group_stats(sync_group_t *g, sync_group_stats_t *out) {
+    pthread_mutex_lock(&g->lock);
+    *out = g->stats;
+    pthread_mutex_unlock(&g->lock);
+}
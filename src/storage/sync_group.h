@@ -0,0 +1,49 @@
+#ifndef SYNC_GROUP_H
+#define SYNC_GROUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Групповой сброс на диск. Загрузка после записи ждёт в sync_group_wait,
+// а один поток сбрасывает всех накопившихся ожидающих разом: пока идёт
+// сброс, следующие собираются в новую пачку. На пачку — fdatasync каждого
+// различного файла и fsync каждого различного каталога, а начиная с
+// syncfs_min запросов — один syncfs на всю файловую систему.
+// Модуль не логирует: ошибки возвращаются как errno в *err.
+
+typedef struct sync_group sync_group_t;
+
+typedef struct {
+    unsigned delay_us;  // подождать попутчиков перед сбросом, 0 — сразу
+    size_t syncfs_min;  // с этого размера пачки — syncfs, 0 — никогда
+} sync_group_options_t;
+
+typedef struct {
+    uint64_t flushes;   // пачек
+    uint64_t requests;  // ожиданий
+} sync_group_stats_t;
+
+/**
+ * @brief Запускает поток сброса.
+ *
+ * @param fs_fd любой дескриптор на нужной файловой системе (для syncfs;
+ *              должен жить дольше группы)
+ */
+sync_group_t *sync_group_start(int fs_fd, const sync_group_options_t *opts, int *err);
+
+// Дожидается текущих запросов и останавливает поток. Вызывающие
+// sync_group_wait должны к этому времени выйти: группа освобождается
+void sync_group_stop(sync_group_t *g);
+
+/**
+ * @brief Ждёт, пока данные fd и запись каталога dir_fd окажутся на диске.
+ *
+ * Дескрипторы должны оставаться открытыми до возврата. dir_fd = -1 —
+ * каталог не сбрасывать; fd = -1 — сбросить всю файловую систему.
+ */
+bool sync_group_wait(sync_group_t *g, int fd, int dir_fd, int *err);
+
+void sync_group_stats(sync_group_t *g, sync_group_stats_t *out);
+
+#endif // SYNC_GROUP_H
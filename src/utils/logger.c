@@ -0,0 +1,434 @@
+// utils/logger.c
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#define LOG_RING_SLOTS 128            // степень двойки; ~64 КиБ на поток
+#define LOG_LINE_MAX   496            // длиннее — обрезается
+#define LOG_FLUSH_MS   20
+#define LOG_BATCH_SIZE (64 * 1024)
+
+typedef struct {
+    uint64_t ts_ns;     // CLOCK_REALTIME
+    uint16_t len;
+    uint8_t level;
+    char text[LOG_LINE_MAX];
+} log_entry_t;
+
+// Кольцо одного потока: пишет только владелец (head), читает только
+// фоновый поток (tail)
+typedef struct log_ring {
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    atomic_uint_fast64_t dropped;
+    atomic_bool orphaned;   // поток завершился, кольцо освободит фоновый поток
+    struct log_ring *next;
+    log_entry_t entries[LOG_RING_SLOTS];
+} log_ring_t;
+
+atomic_int g_log_min_level = LOG_DEBUG;
+
+static struct {
+    int fd;
+    atomic_bool running;
+    atomic_uint generation;     // кольца прошлых запусков недействительны
+    bool stop;
+    pthread_t thread;
+
+    // Список колец и пробуждение фонового потока
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    log_ring_t *rings;
+    size_t n_rings;
+
+    atomic_uint_fast64_t written;
+    atomic_uint_fast64_t flushes;
+    atomic_uint_fast64_t dropped_other;  // нет памяти на кольцо, освобождённые кольца
+    uint64_t dropped_reported;
+
+    // Дальше — только фоновый поток
+    log_ring_t **active;
+    size_t *active_end;
+    size_t active_cap;
+    int64_t stamp_sec;
+    int stamp_ms;
+    char stamp[32];     // "YYYY-mm-dd HH:MM:SS.mmm"
+    char batch[LOG_BATCH_SIZE];
+    size_t batch_len;
+} g_log = {
+    .fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .stamp_sec = -1,
+};
+
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_ring_key;
+
+static __thread log_ring_t *t_ring;
+static __thread unsigned t_generation;
+
+static const char *const level_str[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+// Деструктор потока: TLS ещё доступен, кольцо отдаём фоновому потоку
+static void ring_release(void *unused) {
+    (void)unused;
+    if (t_ring && t_generation == atomic_load(&g_log.generation)) {
+        atomic_store_explicit(&t_ring->orphaned, true, memory_order_release);
+    }
+    t_ring = NULL;
+}
+
+static void create_key(void) {
+    pthread_key_create(&g_ring_key, ring_release);
+}
+
+static log_ring_t *thread_ring(void) {
+    unsigned gen = atomic_load_explicit(&g_log.generation, memory_order_relaxed);
+    if (t_ring && t_generation == gen) return t_ring;
+
+    log_ring_t *r = aligned_alloc(64, sizeof(log_ring_t));
+    if (!r) return NULL;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->dropped, 0);
+    atomic_init(&r->orphaned, false);
+
+    pthread_mutex_lock(&g_log.lock);
+    r->next = g_log.rings;
+    g_log.rings = r;
+    g_log.n_rings++;
+    pthread_mutex_unlock(&g_log.lock);
+
+    t_ring = r;
+    t_generation = gen;
+    pthread_setspecific(g_ring_key, r);
+    return r;
+}
+
+static void wake_flusher(void) {
+    pthread_mutex_lock(&g_log.lock);
+    pthread_cond_signal(&g_log.wake);
+    pthread_mutex_unlock(&g_log.lock);
+}
+
+void log_write(log_level_t level, const char *format, ...) {
+    if (!atomic_load_explicit(&g_log.running, memory_order_acquire)) return;
+    if ((int)level < atomic_load_explicit(&g_log_min_level, memory_order_relaxed)) return;
+
+    log_ring_t *r = thread_ring();
+    if (!r) {
+        atomic_fetch_add_explicit(&g_log.dropped_other, 1, memory_order_relaxed);
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t used = head - atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (used == LOG_RING_SLOTS) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    log_entry_t *e = &r->entries[head & (LOG_RING_SLOTS - 1)];
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    e->ts_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    e->level = (uint8_t)level;
+
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(e->text, sizeof(e->text), format, args);
+    va_end(args);
+    if (n < 0) n = 0;
+    if (n >= (int)sizeof(e->text)) n = (int)sizeof(e->text) - 1;
+    e->len = (uint16_t)n;
+
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+
+    // Ошибки — на диск сразу; кольцо наполовину заполнено — не ждём таймера
+    if (level >= LOG_ERROR || used + 1 == LOG_RING_SLOTS / 2) wake_flusher();
+}
+
+// --- фоновый поток ---
+
+static void write_all(const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(g_log.fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return; // журналу некуда сообщить об ошибке журнала
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+static void flush_batch(void) {
+    if (g_log.batch_len == 0) return;
+    write_all(g_log.batch, g_log.batch_len);
+    g_log.batch_len = 0;
+    atomic_fetch_add_explicit(&g_log.flushes, 1, memory_order_relaxed);
+}
+
+// Отметка времени: localtime_r и strftime — раз в секунду, миллисекунды — раз в мс
+static const char *format_stamp(uint64_t ts_ns) {
+    int64_t sec = (int64_t)(ts_ns / 1000000000ull);
+    int ms = (int)(ts_ns / 1000000ull % 1000);
+
+    if (sec != g_log.stamp_sec) {
+        time_t t = (time_t)sec;
+        struct tm tm_info;
+        localtime_r(&t, &tm_info);
+        strftime(g_log.stamp, sizeof(g_log.stamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+        g_log.stamp_sec = sec;
+        g_log.stamp_ms = -1;
+    }
+    if (ms != g_log.stamp_ms) {
+        snprintf(g_log.stamp + 19, sizeof(g_log.stamp) - 19, ".%03d", ms);
+        g_log.stamp_ms = ms;
+    }
+    return g_log.stamp;
+}
+
+static void append_line(uint64_t ts_ns, int level, const char *text, size_t len) {
+    // Префикс не длиннее 40 байт
+    if (g_log.batch_len + len + 48 > sizeof(g_log.batch)) flush_batch();
+
+    char *out = g_log.batch + g_log.batch_len;
+    int n = snprintf(out, sizeof(g_log.batch) - g_log.batch_len, "[%s] [%s] ",
+                     format_stamp(ts_ns), level_str[level]);
+    memcpy(out + n, text, len);
+    out[n + len] = '\n';
+    g_log.batch_len += (size_t)n + len + 1;
+}
+
+static uint64_t total_dropped_locked(void) {
+    uint64_t dropped = atomic_load_explicit(&g_log.dropped_other, memory_order_relaxed);
+    for (log_ring_t *r = g_log.rings; r; r = r->next) {
+        dropped += atomic_load_explicit(&r->dropped, memory_order_relaxed);
+    }
+    return dropped;
+}
+
+/**
+ * Сливает всё, что было в кольцах на момент вызова, в порядке времени
+ * записи: на каждом шаге берётся самая ранняя голова среди колец.
+ * Кольца только добавляются в начало списка и освобождаются этим же
+ * потоком, поэтому по снимку списка можно идти без блокировки.
+ */
+static void drain(void) {
+    pthread_mutex_lock(&g_log.lock);
+    log_ring_t *list = g_log.rings;
+    size_t n_rings = g_log.n_rings;
+    uint64_t dropped = total_dropped_locked();
+    pthread_mutex_unlock(&g_log.lock);
+
+    if (n_rings > g_log.active_cap) {
+        log_ring_t **active = realloc(g_log.active, n_rings * sizeof(log_ring_t *));
+        if (active) g_log.active = active;
+        size_t *end = realloc(g_log.active_end, n_rings * sizeof(size_t));
+        if (end) g_log.active_end = end;
+        if (!active || !end) return;
+        g_log.active_cap = n_rings;
+    }
+
+    size_t n = 0;
+    for (log_ring_t *r = list; r && n < n_rings; r = r->next) {
+        size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (head == atomic_load_explicit(&r->tail, memory_order_relaxed)) continue;
+        g_log.active[n] = r;
+        g_log.active_end[n] = head;
+        n++;
+    }
+
+    uint64_t written = 0;
+    while (n > 0) {
+        size_t best = 0;
+        uint64_t best_ts = UINT64_MAX;
+        for (size_t i = 0; i < n; i++) {
+            log_ring_t *r = g_log.active[i];
+            size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+            uint64_t ts = r->entries[tail & (LOG_RING_SLOTS - 1)].ts_ns;
+            if (ts < best_ts) {
+                best_ts = ts;
+                best = i;
+            }
+        }
+
+        log_ring_t *r = g_log.active[best];
+        size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        const log_entry_t *e = &r->entries[tail & (LOG_RING_SLOTS - 1)];
+        append_line(e->ts_ns, e->level, e->text, e->len);
+        written++;
+        atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+
+        if (tail + 1 == g_log.active_end[best]) {
+            g_log.active[best] = g_log.active[n - 1];
+            g_log.active_end[best] = g_log.active_end[n - 1];
+            n--;
+        }
+    }
+
+    if (dropped > g_log.dropped_reported) {
+        char msg[96];
+        int len = snprintf(msg, sizeof(msg), "%llu log lines dropped: thread buffer full",
+                           (unsigned long long)(dropped - g_log.dropped_reported));
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        append_line((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec,
+                    LOG_WARNING, msg, (size_t)len);
+        g_log.dropped_reported = dropped;
+    }
+
+    flush_batch();
+    atomic_fetch_add_explicit(&g_log.written, written, memory_order_relaxed);
+}
+
+// Освобождает пустые кольца завершившихся потоков (под g_log.lock)
+static void reap_orphans_locked(void) {
+    log_ring_t **pp = &g_log.rings;
+    while (*pp) {
+        log_ring_t *r = *pp;
+        if (atomic_load_explicit(&r->orphaned, memory_order_acquire) &&
+            atomic_load_explicit(&r->head, memory_order_acquire) ==
+            atomic_load_explicit(&r->tail, memory_order_relaxed)) {
+            *pp = r->next;
+            g_log.n_rings--;
+            atomic_fetch_add_explicit(&g_log.dropped_other,
+                                      atomic_load(&r->dropped), memory_order_relaxed);
+            free(r);
+            continue;
+        }
+        pp = &r->next;
+    }
+}
+
+static void *flusher_main(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_log.lock);
+    while (!g_log.stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_log.wake, &g_log.lock, &deadline);
+
+        pthread_mutex_unlock(&g_log.lock);
+        drain();
+        pthread_mutex_lock(&g_log.lock);
+        reap_orphans_locked();
+    }
+    pthread_mutex_unlock(&g_log.lock);
+
+    drain();
+    return NULL;
+}
+
+// --- управление ---
+
+bool log_init(const char *path, log_level_t min_level) {
+    if (atomic_load(&g_log.running)) return true;
+    pthread_once(&g_key_once, create_key);
+
+    g_log.fd = STDERR_FILENO;
+    if (path) {
+        int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            g_log.fd = fd;
+        } else {
+            fprintf(stderr, "Failed to open log file %s (%s), using stderr\n", path, strerror(errno));
+        }
+    }
+
+    // Кольца прошлого запуска: к этому моменту их потоки давно не пишут
+    pthread_mutex_lock(&g_log.lock);
+    while (g_log.rings) {
+        log_ring_t *r = g_log.rings;
+        g_log.rings = r->next;
+        free(r);
+    }
+    g_log.n_rings = 0;
+    pthread_mutex_unlock(&g_log.lock);
+
+    atomic_store(&g_log_min_level, (int)min_level);
+    atomic_fetch_add(&g_log.generation, 1);
+    g_log.stop = false;
+    g_log.dropped_reported = 0;
+    atomic_store(&g_log.dropped_other, 0);
+    atomic_store(&g_log.running, true);
+
+    if (pthread_create(&g_log.thread, NULL, flusher_main, NULL) != 0) {
+        atomic_store(&g_log.running, false);
+        if (g_log.fd != STDERR_FILENO) close(g_log.fd);
+        g_log.fd = -1;
+        return false;
+    }
+    return true;
+}
+
+// Строки, записанные после вызова, теряются
+void log_shutdown(void) {
+    if (!atomic_load(&g_log.running)) return;
+    atomic_store(&g_log.running, false);
+
+    pthread_mutex_lock(&g_log.lock);
+    g_log.stop = true;
+    pthread_cond_signal(&g_log.wake);
+    pthread_mutex_unlock(&g_log.lock);
+    pthread_join(g_log.thread, NULL);
+
+    // Кольца не освобождаем: поток, уже прошедший проверку running, может
+    // ещё дописывать строку. Их освободит следующий log_init().
+
+    free(g_log.active);
+    free(g_log.active_end);
+    g_log.active = NULL;
+    g_log.active_end = NULL;
+    g_log.active_cap = 0;
+
+    if (g_log.fd != STDERR_FILENO) close(g_log.fd);
+    g_log.fd = -1;
+}
+
+void log_set_level(log_level_t level) {
+    atomic_store(&g_log_min_level, (int)level);
+}
+
+bool log_parse_level(const char *name, log_level_t *out) {
+    static const char *const names[] = {"debug", "info", "warning", "error"};
+    for (int i = 0; i < 4; i++) {
+        if (strcasecmp(name, names[i]) == 0) {
+            *out = (log_level_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+log_stats_t log_get_stats(void) {
+    pthread_mutex_lock(&g_log.lock);
+    log_stats_t st = {
+        .written = atomic_load(&g_log.written),
+        .dropped = total_dropped_locked(),
+        .flushes = atomic_load(&g_log.flushes),
+        .threads = g_log.n_rings,
+    };
+    pthread_mutex_unlock(&g_log.lock);
+    return st;
+}
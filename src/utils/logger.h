@@ -0,0 +1,65 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Асинхронный журнал. Каждый поток пишет в свой кольцевой буфер без
+// блокировок; фоновый поток раз в несколько миллисекунд сливает буферы
+// по времени записи и выводит пачку одним write(). Отметка времени
+// форматируется в фоновом потоке и кэшируется на миллисекунду.
+//
+// Уровень проверяется до форматирования (в макросе logger, так что и
+// аргументы не вычисляются). Полный буфер потока — строка отбрасывается
+// и учитывается в счётчике; о потерях фоновый поток пишет отдельной строкой.
+
+typedef enum {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARNING,
+    LOG_ERROR
+} log_level_t;
+
+typedef struct {
+    uint64_t written;
+    uint64_t dropped;
+    uint64_t flushes;   // вызовов write()
+    uint64_t threads;   // буферов потоков сейчас
+} log_stats_t;
+
+// Не трогать напрямую: порог уровня для макроса logger
+extern atomic_int g_log_min_level;
+
+/**
+ * @brief Запускает фоновый поток записи.
+ *
+ * @param path      файл журнала (дописывается); NULL — stderr
+ * @param min_level строки ниже этого уровня не форматируются
+ * @return false, если не удалось создать поток (при недоступном файле
+ *         журнал уходит в stderr)
+ */
+bool log_init(const char *path, log_level_t min_level);
+
+// Дописывает всё накопленное и останавливает фоновый поток
+void log_shutdown(void);
+
+void log_set_level(log_level_t level);
+
+// "debug", "info", "warning", "error"; false — неизвестное имя
+bool log_parse_level(const char *name, log_level_t *out);
+
+void log_write(log_level_t level, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+log_stats_t log_get_stats(void);
+
+#define logger(level, ...)                                                      \
+    do {                                                                        \
+        if ((int)(level) >=                                                     \
+            atomic_load_explicit(&g_log_min_level, memory_order_relaxed)) {     \
+            log_write((level), __VA_ARGS__);                                    \
+        }                                                                       \
+    } while (0)
+
+#endif // LOGGER_H
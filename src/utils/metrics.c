@@ -0,0 +1,315 @@
+// utils/metrics.c
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "metrics.h"
+
+#define HIST_SUB_BITS 3
+#define HIST_SUB      (1u << HIST_SUB_BITS)
+#define HIST_MAX_EXP  40  // старшая степень двойки; больше — в последнюю корзину
+#define HIST_BUCKETS  ((HIST_MAX_EXP - HIST_SUB_BITS + 2) * HIST_SUB)
+#define HIST_SUM      HIST_BUCKETS  // слот суммы после корзин
+
+#define METRICS_MAX_DEFS (METRICS_MAX_SCALARS + METRICS_MAX_HISTOGRAMS)
+
+typedef enum {
+    KIND_COUNTER,
+    KIND_GAUGE,
+    KIND_HISTOGRAM
+} metric_kind_t;
+
+typedef struct {
+    metric_kind_t kind;
+    metrics_unit_t unit;
+    unsigned slot;      // индекс в scalars или hist шарда
+    char name[96];
+    char labels[96];
+    char help[160];
+} metric_def_t;
+
+// Шард пишут потоки, получившие его номер; датчики хранятся как uint64_t
+// в дополнительном коде, сумма по шардам даёт верное значение со знаком
+typedef struct {
+    _Alignas(64) _Atomic uint64_t scalars[METRICS_MAX_SCALARS];
+    _Atomic uint64_t hist[METRICS_MAX_HISTOGRAMS][HIST_BUCKETS + 1];
+} metrics_shard_t;
+
+static metrics_shard_t g_shards[METRICS_SHARDS];
+static _Atomic unsigned g_next_shard;
+static _Thread_local metrics_shard_t *t_shard;
+
+static pthread_mutex_t g_register_lock = PTHREAD_MUTEX_INITIALIZER;
+static metric_def_t g_defs[METRICS_MAX_DEFS];
+static _Atomic int g_ndefs;
+static unsigned g_nscalars;
+static unsigned g_nhistograms;
+
+static metrics_shard_t *my_shard(void) {
+    if (!t_shard) {
+        unsigned n = atomic_fetch_add_explicit(&g_next_shard, 1, memory_order_relaxed);
+        t_shard = &g_shards[n % METRICS_SHARDS];
+    }
+    return t_shard;
+}
+
+static unsigned bucket_of(uint64_t v) {
+    if (v < HIST_SUB) return (unsigned)v;
+    unsigned exp = 63u - (unsigned)__builtin_clzll(v);
+    if (exp > HIST_MAX_EXP) return HIST_BUCKETS - 1;
+    unsigned sub = (unsigned)(v >> (exp - HIST_SUB_BITS)) & (HIST_SUB - 1);
+    return (exp - HIST_SUB_BITS + 1) * HIST_SUB + sub;
+}
+
+static uint64_t bucket_upper(unsigned i) {
+    if (i < HIST_SUB) return i;
+    unsigned exp = i / HIST_SUB - 1 + HIST_SUB_BITS;
+    uint64_t sub = i % HIST_SUB;
+    return ((HIST_SUB + sub + 1) << (exp - HIST_SUB_BITS)) - 1;
+}
+
+static metric_id_t register_metric(metric_kind_t kind, const char *name, const char *labels,
+                                   const char *help, metrics_unit_t unit) {
+    if (!name) return -1;
+
+    pthread_mutex_lock(&g_register_lock);
+    int n = atomic_load_explicit(&g_ndefs, memory_order_relaxed);
+    unsigned *used = kind == KIND_HISTOGRAM ? &g_nhistograms : &g_nscalars;
+    unsigned limit = kind == KIND_HISTOGRAM ? METRICS_MAX_HISTOGRAMS : METRICS_MAX_SCALARS;
+    if (n == METRICS_MAX_DEFS || *used == limit) {
+        pthread_mutex_unlock(&g_register_lock);
+        return -1;
+    }
+
+    metric_def_t *d = &g_defs[n];
+    d->kind = kind;
+    d->unit = unit;
+    d->slot = (*used)++;
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    snprintf(d->labels, sizeof(d->labels), "%s", labels ? labels : "");
+    snprintf(d->help, sizeof(d->help), "%s", help ? help : "");
+    atomic_store_explicit(&g_ndefs, n + 1, memory_order_release);
+    pthread_mutex_unlock(&g_register_lock);
+    return n;
+}
+
+metric_id_t metrics_counter(const char *name, const char *labels, const char *help) {
+    return register_metric(KIND_COUNTER, name, labels, help, METRICS_UNIT_NONE);
+}
+
+metric_id_t metrics_gauge(const char *name, const char *labels, const char *help) {
+    return register_metric(KIND_GAUGE, name, labels, help, METRICS_UNIT_NONE);
+}
+
+metric_id_t metrics_histogram(const char *name, const char *labels, const char *help,
+                              metrics_unit_t unit) {
+    return register_metric(KIND_HISTOGRAM, name, labels, help, unit);
+}
+
+void metrics_add(metric_id_t counter, uint64_t n) {
+    if (counter < 0) return;
+    atomic_fetch_add_explicit(&my_shard()->scalars[g_defs[counter].slot], n,
+                              memory_order_relaxed);
+}
+
+void metrics_gauge_add(metric_id_t gauge, int64_t delta) {
+    if (gauge < 0) return;
+    atomic_fetch_add_explicit(&my_shard()->scalars[g_defs[gauge].slot], (uint64_t)delta,
+                              memory_order_relaxed);
+}
+
+void metrics_observe(metric_id_t histogram, uint64_t value) {
+    if (histogram < 0) return;
+    _Atomic uint64_t *h = my_shard()->hist[g_defs[histogram].slot];
+    atomic_fetch_add_explicit(&h[bucket_of(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h[HIST_SUM], value, memory_order_relaxed);
+}
+
+static uint64_t scalar_sum(unsigned slot) {
+    uint64_t total = 0;
+    for (unsigned s = 0; s < METRICS_SHARDS; s++) {
+        total += atomic_load_explicit(&g_shards[s].scalars[slot], memory_order_relaxed);
+    }
+    return total;
+}
+
+// Корзины гистограммы, сложенные по шардам; возвращает количество
+static uint64_t hist_sum(unsigned slot, uint64_t buckets[HIST_BUCKETS + 1]) {
+    memset(buckets, 0, sizeof(uint64_t) * (HIST_BUCKETS + 1));
+    for (unsigned s = 0; s < METRICS_SHARDS; s++) {
+        for (unsigned i = 0; i <= HIST_BUCKETS; i++) {
+            buckets[i] += atomic_load_explicit(&g_shards[s].hist[slot][i], memory_order_relaxed);
+        }
+    }
+    uint64_t count = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) count += buckets[i];
+    return count;
+}
+
+uint64_t metrics_counter_value(metric_id_t counter) {
+    return counter < 0 ? 0 : scalar_sum(g_defs[counter].slot);
+}
+
+int64_t metrics_gauge_value(metric_id_t gauge) {
+    return gauge < 0 ? 0 : (int64_t)scalar_sum(g_defs[gauge].slot);
+}
+
+uint64_t metrics_histogram_count(metric_id_t histogram) {
+    if (histogram < 0) return 0;
+    uint64_t buckets[HIST_BUCKETS + 1];
+    return hist_sum(g_defs[histogram].slot, buckets);
+}
+
+uint64_t metrics_histogram_percentile(metric_id_t histogram, double p) {
+    if (histogram < 0) return 0;
+    uint64_t buckets[HIST_BUCKETS + 1];
+    uint64_t count = hist_sum(g_defs[histogram].slot, buckets);
+    if (count == 0) return 0;
+
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)count + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > count) rank = count;
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) return bucket_upper(i);
+    }
+    return bucket_upper(HIST_BUCKETS - 1);
+}
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} text_buf_t;
+
+__attribute__((format(printf, 2, 3)))
+static void put(text_buf_t *b, const char *fmt, ...) {
+    if (b->failed) return;
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            b->failed = true;
+            return;
+        }
+        if ((size_t)n < b->cap - b->len) {
+            b->len += (size_t)n;
+            return;
+        }
+        size_t cap = b->cap * 2 + (size_t)n;
+        char *grown = realloc(b->data, cap);
+        if (!grown) {
+            b->failed = true;
+            return;
+        }
+        b->data = grown;
+        b->cap = cap;
+    }
+}
+
+// Значение в единицах вывода: наносекунды — секунды
+static void put_value(text_buf_t *b, metrics_unit_t unit, uint64_t v) {
+    if (unit == METRICS_UNIT_NANOSECONDS) put(b, "%.9g", (double)v / 1e9);
+    else put(b, "%llu", (unsigned long long)v);
+}
+
+// {labels} или {labels,extra}; пустые метки — без скобок
+static void put_labels(text_buf_t *b, const char *labels, const char *extra) {
+    if (!*labels && !extra) return;
+    put(b, "{%s%s%s}", labels, *labels && extra ? "," : "", extra ? extra : "");
+}
+
+static void render_histogram(text_buf_t *b, const metric_def_t *d) {
+    uint64_t buckets[HIST_BUCKETS + 1];
+    uint64_t count = hist_sum(d->slot, buckets);
+
+    // Границы le — концы степеней двойки: 2^k - 1 включительно
+    uint64_t cumulative = 0;
+    unsigned i = 0;
+    for (unsigned k = HIST_SUB_BITS; k <= HIST_MAX_EXP + 1; k++) {
+        unsigned end = (k - HIST_SUB_BITS + 1) * HIST_SUB;
+        for (; i < end; i++) cumulative += buckets[i];
+
+        char le[48];
+        uint64_t bound = (1ull << k) - 1;
+        if (d->unit == METRICS_UNIT_NANOSECONDS) {
+            snprintf(le, sizeof(le), "le=\"%.9g\"", (double)bound / 1e9);
+        } else {
+            snprintf(le, sizeof(le), "le=\"%llu\"", (unsigned long long)bound);
+        }
+        put(b, "%s_bucket", d->name);
+        put_labels(b, d->labels, le);
+        put(b, " %llu\n", (unsigned long long)cumulative);
+    }
+    put(b, "%s_bucket", d->name);
+    put_labels(b, d->labels, "le=\"+Inf\"");
+    put(b, " %llu\n", (unsigned long long)count);
+
+    put(b, "%s_sum", d->name);
+    put_labels(b, d->labels, NULL);
+    put(b, " ");
+    put_value(b, d->unit, buckets[HIST_SUM]);
+    put(b, "\n%s_count", d->name);
+    put_labels(b, d->labels, NULL);
+    put(b, " %llu\n", (unsigned long long)count);
+}
+
+char *metrics_render(size_t *len) {
+    text_buf_t b = { .cap = 16384 };
+    b.data = malloc(b.cap);
+    if (!b.data) return NULL;
+    b.data[0] = '\0';
+
+    int n = atomic_load_explicit(&g_ndefs, memory_order_acquire);
+    static const char *type_name[] = { "counter", "gauge", "histogram" };
+
+    // Семейство выводится одним блоком, даже если его метрики
+    // регистрировались вперемешку с другими
+    for (int i = 0; i < n; i++) {
+        bool seen = false;
+        for (int j = 0; j < i && !seen; j++) seen = strcmp(g_defs[j].name, g_defs[i].name) == 0;
+        if (seen) continue;
+
+        put(&b, "# HELP %s %s\n# TYPE %s %s\n", g_defs[i].name, g_defs[i].help,
+            g_defs[i].name, type_name[g_defs[i].kind]);
+
+        for (int j = i; j < n; j++) {
+            const metric_def_t *d = &g_defs[j];
+            if (strcmp(d->name, g_defs[i].name) != 0) continue;
+
+            if (d->kind == KIND_HISTOGRAM) {
+                render_histogram(&b, d);
+                continue;
+            }
+            put(&b, "%s", d->name);
+            put_labels(&b, d->labels, NULL);
+            if (d->kind == KIND_GAUGE) put(&b, " %lld\n", (long long)scalar_sum(d->slot));
+            else put(&b, " %llu\n", (unsigned long long)scalar_sum(d->slot));
+        }
+    }
+
+    if (b.failed) {
+        free(b.data);
+        return NULL;
+    }
+    if (len) *len = b.len;
+    return b.data;
+}
+
+uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
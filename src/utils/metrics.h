@@ -0,0 +1,76 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Реестр метрик процесса: счётчики, датчики и гистограммы.
+//
+// Значения разложены по шардам: поток при первой записи получает свой шард
+// (при числе потоков больше METRICS_SHARDS шард делят несколько), запись —
+// один atomic_fetch_add без блокировок и циклов CAS, то есть wait-free.
+// Чтение (metrics_render) складывает шарды и может видеть запись
+// наполовину — для мониторинга это допустимо.
+//
+// Гистограммы лог-линейные, как в HDR Histogram: 8 подкорзин на степень
+// двойки, относительная погрешность не хуже 12.5%, диапазон до 2^41.
+// Они накопительные и не сбрасываются; сводки за интервал в журнале
+// демона — core/latency_hist.h.
+//
+// Метрики регистрируются при старте, до первой записи; регистрация
+// потокобезопасна, но не предназначена для горячего пути.
+
+#define METRICS_SHARDS          16
+#define METRICS_MAX_SCALARS     64   // счётчики и датчики вместе
+#define METRICS_MAX_HISTOGRAMS  32
+
+typedef enum {
+    METRICS_UNIT_NONE,
+    METRICS_UNIT_BYTES,
+    METRICS_UNIT_NANOSECONDS  // в выводе — секунды, как принято в Prometheus
+} metrics_unit_t;
+
+// Идентификатор метрики; -1 — регистрация не удалась (запись в -1 игнорируется)
+typedef int metric_id_t;
+
+/**
+ * @param name   имя семейства, например "exchange_requests_total"
+ * @param labels метки без фигурных скобок, например "command=\"upload\"", или NULL
+ * @param help   строка # HELP; у семейства берётся из первой регистрации
+ */
+metric_id_t metrics_counter(const char *name, const char *labels, const char *help);
+metric_id_t metrics_gauge(const char *name, const char *labels, const char *help);
+metric_id_t metrics_histogram(const char *name, const char *labels, const char *help,
+                              metrics_unit_t unit);
+
+void metrics_add(metric_id_t counter, uint64_t n);
+
+static inline void metrics_inc(metric_id_t counter) {
+    metrics_add(counter, 1);
+}
+
+void metrics_gauge_add(metric_id_t gauge, int64_t delta);
+
+void metrics_observe(metric_id_t histogram, uint64_t value);
+
+// Сумма по шардам (для тестов и журнала)
+uint64_t metrics_counter_value(metric_id_t counter);
+int64_t metrics_gauge_value(metric_id_t gauge);
+uint64_t metrics_histogram_count(metric_id_t histogram);
+
+// Верхняя граница корзины, в которую попадает перцентиль p (0..100)
+uint64_t metrics_histogram_percentile(metric_id_t histogram, double p);
+
+/**
+ * @brief Текстовый формат Prometheus 0.0.4 для всех метрик.
+ *
+ * @param len длина результата
+ * @return строка (освобождать free()) или NULL при нехватке памяти
+ */
+char *metrics_render(size_t *len);
+
+// Монотонное время в наносекундах для замеров
+uint64_t metrics_now_ns(void);
+
+#endif // METRICS_H
@@ -0,0 +1,55 @@
+// utils/request_trace.c
+
+#include <stdio.h>
+
+#include "request_trace.h"
+
+static const char *const g_phase_names[TRACE_PHASES] = {
+    [TRACE_RECV] = "recv",
+    [TRACE_HASH] = "hash",
+    [TRACE_ENCRYPT] = "encrypt",
+    [TRACE_DECRYPT] = "decrypt",
+    [TRACE_READ] = "read",
+    [TRACE_WRITE] = "write",
+    [TRACE_MONGO] = "mongo",
+    [TRACE_SEND] = "send",
+};
+
+const char *trace_phase_name(trace_phase_t phase) {
+    return (unsigned)phase < TRACE_PHASES ? g_phase_names[phase] : "unknown";
+}
+
+size_t trace_format(const request_trace_t *t, char *buf, size_t len) {
+    size_t used = 0;
+    uint64_t traced = 0;
+
+    for (int i = 0; i < TRACE_PHASES; i++) {
+        if (!trace_has_phase(t, (trace_phase_t)i)) continue;
+        traced += t->phase_ns[i];
+        int n = snprintf(buf + (used < len ? used : len), used < len ? len - used : 0,
+                         "%s%s=%.1fms", used ? " " : "", g_phase_names[i],
+                         (double)t->phase_ns[i] / 1e6);
+        if (n > 0) used += (size_t)n;
+    }
+
+    uint64_t total = t->mark_ns - t->started_ns;
+    uint64_t other = total > traced ? total - traced : 0;
+    int n = snprintf(buf + (used < len ? used : len), used < len ? len - used : 0,
+                     "%sother=%.1fms", used ? " " : "", (double)other / 1e6);
+    if (n > 0) used += (size_t)n;
+    return used;
+}
+
+bool trace_sample(trace_sampler_t *s, uint64_t now_ns, uint64_t interval_ns,
+                  uint64_t *suppressed) {
+    uint64_t next = atomic_load_explicit(&s->next_ns, memory_order_relaxed);
+    // Одну строку за интервал получает тот, кто первым сдвинул границу
+    if (now_ns < next ||
+        !atomic_compare_exchange_strong_explicit(&s->next_ns, &next, now_ns + interval_ns,
+                                                 memory_order_relaxed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&s->suppressed, 1, memory_order_relaxed);
+        return false;
+    }
+    *suppressed = atomic_exchange_explicit(&s->suppressed, 0, memory_order_relaxed);
+    return true;
+}
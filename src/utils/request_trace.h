@@ -0,0 +1,116 @@
+#ifndef REQUEST_TRACE_H
+#define REQUEST_TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "metrics.h"
+
+// Разбивка времени одного запроса по фазам. trace_phase ставит отметку
+// монотонных часов и относит время с прошлой отметки к названной фазе;
+// фаза может встречаться несколько раз, время складывается. Мелкие
+// промежутки между фазами (сборка BSON, malloc) достаются следующей фазе.
+//
+// В каждой точке стоит USDT-пробник провайдера exchange, если при сборке
+// есть <sys/sdt.h> (systemtap-sdt-dev). Выключенный пробник — одна
+// инструкция nop, подключаются без пересборки:
+//   bpftrace -e 'usdt:./server:exchange:phase { @[arg1] = hist(arg2); }'
+//   perf probe -x ./server sdt_exchange:request__done
+//
+// request__start(command)
+// phase(command, phase, ns)
+// request__done(command, total_ns, bytes)
+
+#if defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define TRACE_HAVE_SDT 1
+#  endif
+#endif
+
+#ifdef TRACE_HAVE_SDT
+#  define TRACE_PROBE1(name, a)       DTRACE_PROBE1(exchange, name, a)
+#  define TRACE_PROBE3(name, a, b, c) DTRACE_PROBE3(exchange, name, a, b, c)
+#else
+#  define TRACE_PROBE1(name, a)       do { (void)(a); } while (0)
+#  define TRACE_PROBE3(name, a, b, c) do { (void)(a); (void)(b); (void)(c); } while (0)
+#endif
+
+typedef enum {
+    TRACE_RECV,
+    TRACE_HASH,
+    TRACE_ENCRYPT,
+    TRACE_DECRYPT,
+    TRACE_READ,     // чтение с диска
+    TRACE_WRITE,    // запись на диск
+    TRACE_MONGO,
+    TRACE_SEND,
+    TRACE_PHASES
+} trace_phase_t;
+
+typedef struct {
+    int command;
+    unsigned phases;                   // битовая маска встреченных фаз
+    uint64_t started_ns;
+    uint64_t mark_ns;
+    uint64_t bytes;                    // полезная нагрузка запроса
+    uint64_t phase_ns[TRACE_PHASES];
+} request_trace_t;
+
+// Ограничитель журнала медленных запросов: не чаще одной строки за интервал
+typedef struct {
+    _Atomic uint64_t next_ns;
+    _Atomic uint64_t suppressed;
+} trace_sampler_t;
+
+static inline void trace_begin(request_trace_t *t, int command) {
+    *t = (request_trace_t){ .command = command };
+    t->started_ns = t->mark_ns = metrics_now_ns();
+    TRACE_PROBE1(request__start, command);
+}
+
+static inline void trace_phase(request_trace_t *t, trace_phase_t phase) {
+    uint64_t now = metrics_now_ns();
+    uint64_t ns = now - t->mark_ns;
+    t->phase_ns[phase] += ns;
+    t->phases |= 1u << phase;
+    t->mark_ns = now;
+    TRACE_PROBE3(phase, t->command, (int)phase, ns);
+}
+
+static inline bool trace_has_phase(const request_trace_t *t, trace_phase_t phase) {
+    return t->phases & (1u << phase);
+}
+
+// Закрывает запрос; возвращает полное время в наносекундах
+static inline uint64_t trace_end(request_trace_t *t) {
+    t->mark_ns = metrics_now_ns();
+    uint64_t total = t->mark_ns - t->started_ns;
+    TRACE_PROBE3(request__done, t->command, total, t->bytes);
+    return total;
+}
+
+// "recv", "hash", ...
+const char *trace_phase_name(trace_phase_t phase);
+
+/**
+ * @brief Разбивка для журнала: "recv=12.0ms hash=1.3ms ... other=0.2ms".
+ *
+ * Выводятся встреченные фазы; other — время вне фаз. Вызывать после trace_end.
+ *
+ * @return длина строки (обрезается по len, как snprintf)
+ */
+size_t trace_format(const request_trace_t *t, char *buf, size_t len);
+
+/**
+ * @brief Решает, писать ли в журнал очередной медленный запрос.
+ *
+ * @param suppressed сколько медленных запросов пропущено с прошлой строки
+ * @return true не чаще раза в interval_ns
+ */
+bool trace_sample(trace_sampler_t *s, uint64_t now_ns, uint64_t interval_ns,
+                  uint64_t *suppressed);
+
+#endif // REQUEST_TRACE_H
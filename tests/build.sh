@@ -0,0 +1,29 @@
+#!/bin/bash
+set -e
+
+# BLAKE3 без SIMD: тестам важна корректность, не скорость
+BLAKE3_DIR=../deps/blake3
+BLAKE3_SRCS="$BLAKE3_DIR/blake3.c $BLAKE3_DIR/blake3_dispatch.c $BLAKE3_DIR/blake3_portable.c"
+BLAKE3_FLAGS="-I$BLAKE3_DIR -DBLAKE3_NO_SSE2 -DBLAKE3_NO_SSE41 -DBLAKE3_NO_AVX2 -DBLAKE3_NO_AVX512"
+
+# Тесты модулей без внешних зависимостей (MongoDB заменяет хранилище в памяти,
+# сеть и сертификаты — mocks/mock_ssl.h)
+gcc -o test_runner test_runner.c \
+    test_watch_map.c test_tree_walk.c test_event_coalescer.c test_reconcile.c \
+    test_hash_cache.c test_event_pipeline.c test_inotify_watcher.c \
+    test_checkpoint.c test_logger.c test_metrics.c test_request_trace.c test_meta_store.c \
+    test_loopback.c test_object_store.c test_pack_store.c test_sync_group.c test_chunk_cache.c \
+    test_flight_group.c test_notify_bus.c test_handlers.c \
+    ../src/core/watch_map.c ../src/core/tree_walk.c ../src/core/event_coalescer.c \
+    ../src/core/reconcile.c ../src/core/hash_cache.c ../src/core/event_pipeline.c \
+    ../src/core/inotify_watcher.c ../src/core/latency_hist.c ../src/core/checkpoint.c \
+    ../src/utils/logger.c ../src/utils/metrics.c ../src/net/metrics_http.c ../src/utils/request_trace.c \
+    ../src/db/meta_store.c ../src/db/meta_store_mem.c \
+    ../src/storage/object_store.c ../src/storage/pack_store.c ../src/storage/sync_group.c \
+    ../src/storage/buffer_pool.c ../src/storage/chunk_cache.c ../src/storage/flight_group.c \
+    ../src/storage/layout_migrate.c ../src/net/notify_bus.c ../src/crypto/aes_gcm.c \
+    ../src/client/client_proto.c \
+    ../src/common/hash_utils.c $BLAKE3_SRCS $BLAKE3_FLAGS \
+    -Wall -Wextra -g -lpthread -lssl -lcrypto
+
+./test_runner
@@ -1 +1,38 @@
-o
\ No newline at end of file
+#ifndef MOCK_MONGO_H
+#define MOCK_MONGO_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/db/meta_store.h"
+
+// MongoDB для тестов — хранилище метаданных в памяти (db/meta_store_mem.c):
+// те же выборки, что делают обработчики, без сервера и libbson.
+
+static inline meta_store_t *mock_mongo_open(void) {
+    return meta_store_open_memory(NULL);
+}
+
+// Каждая fail_every-я операция из маски ops завершается ошибкой
+static inline meta_store_t *mock_mongo_open_failing(uint32_t fail_every, unsigned ops) {
+    meta_mem_options_t o = { .fail_every = fail_every, .fail_ops = ops };
+    return meta_store_open_memory(&o);
+}
+
+// Документ загрузки; content_hash заполняется байтом hash_byte (0 — без хеша)
+static inline meta_file_t mock_mongo_file(const char *filename, const char *owner,
+                                          const char *recipient, bool is_public,
+                                          int64_t uploaded_at, uint8_t hash_byte) {
+    meta_file_t f = { .is_public = is_public, .encrypted = true,
+                      .size = (int64_t)strlen(filename), .uploaded_at = uploaded_at };
+    snprintf(f.filename, sizeof(f.filename), "%s", filename);
+    snprintf(f.owner, sizeof(f.owner), "%s", owner);
+    if (recipient) snprintf(f.recipient, sizeof(f.recipient), "%s", recipient);
+    if (hash_byte) {
+        memset(f.content_hash, hash_byte, sizeof(f.content_hash));
+        f.hashed = true;
+    }
+    return f;
+}
+
+#endif // MOCK_MONGO_H
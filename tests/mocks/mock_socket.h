@@ -0,0 +1,30 @@
+#ifndef MOCK_SOCKET_H
+#define MOCK_SOCKET_H
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Соединение без сети: socketpair(AF_UNIX), без TCP, портов и loopback.
+// fds[0] — сторона сервера, fds[1] — клиента.
+
+static inline bool mock_socket_pair(int fds[2]) {
+    return socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0;
+}
+
+static inline bool mock_socket_set_nonblocking(int fd, bool on) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1) return false;
+    flags = on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    return fcntl(fd, F_SETFL, flags) == 0;
+}
+
+static inline void mock_socket_close_pair(int fds[2]) {
+    for (int i = 0; i < 2; i++) {
+        if (fds[i] >= 0) close(fds[i]);
+        fds[i] = -1;
+    }
+}
+
+#endif // MOCK_SOCKET_H
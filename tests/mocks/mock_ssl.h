@@ -0,0 +1,229 @@
+#ifndef MOCK_SSL_H
+#define MOCK_SSL_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include "../../include/protocol.h"
+#include "mock_socket.h"
+
+// mTLS без файлов и сети: CA, сертификаты сервера и клиента (EC P-256)
+// выписываются в памяти, контексты настроены как в init_ssl сервера
+// (проверка клиента обязательна, глубина цепочки 1).
+//
+// Два транспорта:
+//  - mock_ssl_connect — поверх mock_socket_pair; SSL блокирующие, стороны
+//    работают в разных потоках (обработчики сервера пишут и читают до конца);
+//  - mock_ssl_connect_memory — пара BIO в памяти; всё в одном потоке, запись
+//    одной стороны не больше MOCK_SSL_BIO_SIZE до чтения другой.
+//
+// Рукопожатие в обоих случаях идёт в вызывающем потоке попеременными шагами.
+
+#define MOCK_SSL_BIO_SIZE (256 * 1024)
+#define MOCK_SSL_HANDSHAKE_STEPS 1000
+
+typedef struct {
+    EVP_PKEY *key;
+    X509 *cert;
+} mock_ssl_identity_t;
+
+typedef struct {
+    mock_ssl_identity_t ca;
+    mock_ssl_identity_t server;
+    mock_ssl_identity_t client;
+    SSL_CTX *server_ctx;
+    SSL_CTX *client_ctx;
+} mock_ssl_env_t;
+
+typedef struct {
+    int fds[2];     // -1 у соединения в памяти
+    SSL *server;
+    SSL *client;
+} mock_ssl_conn_t;
+
+static inline void mock_ssl_identity_free(mock_ssl_identity_t *id) {
+    EVP_PKEY_free(id->key);
+    X509_free(id->cert);
+    id->key = NULL;
+    id->cert = NULL;
+}
+
+// Ключ и сертификат cn, подписанный ca; ca == NULL — самоподписанный CA
+static inline bool mock_ssl_issue(const char *cn, const mock_ssl_identity_t *ca,
+                                  mock_ssl_identity_t *out) {
+    static long serial = 1;
+    out->key = EVP_EC_gen("P-256");
+    out->cert = X509_new();
+    if (!out->key || !out->cert) goto fail;
+
+    X509_set_version(out->cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(out->cert), serial++);
+    X509_gmtime_adj(X509_getm_notBefore(out->cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(out->cert), 86400);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(out->cert), "CN", MBSTRING_ASC,
+                               (const unsigned char *)cn, -1, -1, 0);
+    const mock_ssl_identity_t *issuer = ca ? ca : out;
+    if (!ca) {
+        // Без basicConstraints OpenSSL не примет v3-сертификат как CA
+        X509V3_CTX v3;
+        X509V3_set_ctx(&v3, out->cert, out->cert, NULL, NULL, 0);
+        X509_EXTENSION *ext = X509V3_EXT_conf_nid(NULL, &v3, NID_basic_constraints,
+                                                  "critical,CA:TRUE");
+        bool added = ext && X509_add_ext(out->cert, ext, -1) == 1;
+        X509_EXTENSION_free(ext);
+        if (!added) goto fail;
+    }
+    if (X509_set_issuer_name(out->cert, X509_get_subject_name(issuer->cert)) != 1 ||
+        X509_set_pubkey(out->cert, out->key) != 1 ||
+        X509_sign(out->cert, issuer->key, EVP_sha256()) <= 0) {
+        goto fail;
+    }
+    return true;
+
+fail:
+    mock_ssl_identity_free(out);
+    return false;
+}
+
+static inline bool mock_ssl_ctx_use(SSL_CTX *ctx, const mock_ssl_identity_t *id,
+                                    const mock_ssl_identity_t *ca) {
+    return SSL_CTX_use_certificate(ctx, id->cert) == 1 &&
+           SSL_CTX_use_PrivateKey(ctx, id->key) == 1 &&
+           SSL_CTX_check_private_key(ctx) == 1 &&
+           X509_STORE_add_cert(SSL_CTX_get_cert_store(ctx), ca->cert) == 1;
+}
+
+static inline void mock_ssl_env_free(mock_ssl_env_t *env) {
+    SSL_CTX_free(env->server_ctx);
+    SSL_CTX_free(env->client_ctx);
+    mock_ssl_identity_free(&env->client);
+    mock_ssl_identity_free(&env->server);
+    mock_ssl_identity_free(&env->ca);
+    memset(env, 0, sizeof(*env));
+}
+
+static inline bool mock_ssl_env_init(mock_ssl_env_t *env) {
+    memset(env, 0, sizeof(*env));
+    if (!mock_ssl_issue("mock-ca", NULL, &env->ca) ||
+        !mock_ssl_issue("mock-server", &env->ca, &env->server) ||
+        !mock_ssl_issue("mock-client", &env->ca, &env->client)) {
+        goto fail;
+    }
+
+    env->server_ctx = SSL_CTX_new(TLS_server_method());
+    env->client_ctx = SSL_CTX_new(TLS_client_method());
+    if (!env->server_ctx || !env->client_ctx ||
+        !mock_ssl_ctx_use(env->server_ctx, &env->server, &env->ca) ||
+        !mock_ssl_ctx_use(env->client_ctx, &env->client, &env->ca)) {
+        goto fail;
+    }
+    SSL_CTX_set_verify(env->server_ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    SSL_CTX_set_verify_depth(env->server_ctx, 1);
+    SSL_CTX_set_verify(env->client_ctx, SSL_VERIFY_PEER, NULL);
+    return true;
+
+fail:
+    mock_ssl_env_free(env);
+    return false;
+}
+
+static inline void mock_ssl_conn_close(mock_ssl_conn_t *c) {
+    SSL_free(c->server);
+    SSL_free(c->client);
+    c->server = NULL;
+    c->client = NULL;
+    mock_socket_close_pair(c->fds);
+}
+
+// Шаг рукопожатия: true — можно продолжать (готово или ждёт данных)
+static inline bool mock_ssl_step(SSL *ssl, int (*fn)(SSL *), bool *done) {
+    if (*done) return true;
+    int rc = fn(ssl);
+    if (rc == 1) {
+        *done = true;
+        return true;
+    }
+    int err = SSL_get_error(ssl, rc);
+    return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE;
+}
+
+static inline bool mock_ssl_handshake(mock_ssl_conn_t *c) {
+    bool server_done = false, client_done = false;
+    for (int i = 0; i < MOCK_SSL_HANDSHAKE_STEPS && !(server_done && client_done); i++) {
+        if (!mock_ssl_step(c->client, SSL_connect, &client_done) ||
+            !mock_ssl_step(c->server, SSL_accept, &server_done)) {
+            return false;
+        }
+    }
+    return server_done && client_done;
+}
+
+static inline bool mock_ssl_connect(mock_ssl_env_t *env, mock_ssl_conn_t *c) {
+    *c = (mock_ssl_conn_t){ .fds = { -1, -1 } };
+    if (!mock_socket_pair(c->fds)) return false;
+
+    c->server = SSL_new(env->server_ctx);
+    c->client = SSL_new(env->client_ctx);
+    if (!c->server || !c->client ||
+        SSL_set_fd(c->server, c->fds[0]) != 1 || SSL_set_fd(c->client, c->fds[1]) != 1 ||
+        !mock_socket_set_nonblocking(c->fds[0], true) ||
+        !mock_socket_set_nonblocking(c->fds[1], true) ||
+        !mock_ssl_handshake(c) ||
+        !mock_socket_set_nonblocking(c->fds[0], false) ||
+        !mock_socket_set_nonblocking(c->fds[1], false)) {
+        mock_ssl_conn_close(c);
+        return false;
+    }
+    return true;
+}
+
+static inline bool mock_ssl_connect_memory(mock_ssl_env_t *env, mock_ssl_conn_t *c) {
+    *c = (mock_ssl_conn_t){ .fds = { -1, -1 } };
+    BIO *server_bio = NULL, *client_bio = NULL;
+    if (BIO_new_bio_pair(&server_bio, MOCK_SSL_BIO_SIZE, &client_bio, MOCK_SSL_BIO_SIZE) != 1) {
+        return false;
+    }
+
+    c->server = SSL_new(env->server_ctx);
+    c->client = SSL_new(env->client_ctx);
+    if (!c->server || !c->client) {
+        BIO_free(server_bio);
+        BIO_free(client_bio);
+        mock_ssl_conn_close(c);
+        return false;
+    }
+    // Каждый SSL владеет своей половиной пары
+    SSL_set_bio(c->server, server_bio, server_bio);
+    SSL_set_bio(c->client, client_bio, client_bio);
+
+    if (!mock_ssl_handshake(c)) {
+        mock_ssl_conn_close(c);
+        return false;
+    }
+    return true;
+}
+
+// Отпечаток сертификата собеседника, как его считает handle_client
+static inline bool mock_ssl_fingerprint(SSL *ssl, char out[FINGERPRINT_LEN]) {
+    X509 *cert = SSL_get1_peer_certificate(ssl);
+    if (!cert) return false;
+
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    bool ok = X509_digest(cert, EVP_sha256(), hash, &len) == 1 && len * 2 + 1 == FINGERPRINT_LEN;
+    X509_free(cert);
+    if (!ok) return false;
+
+    for (unsigned int i = 0; i < len; i++) {
+        snprintf(&out[i * 2], 3, "%02x", hash[i]);
+    }
+    return true;
+}
+
+#endif // MOCK_SSL_H
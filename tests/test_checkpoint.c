@@ -0,0 +1,159 @@
+// test_checkpoint.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/core/checkpoint.h"
+
+typedef struct {
+    char log[1024];
+} change_log_t;
+
+static void log_change(void *ctx, reconcile_change_t change, const file_state_t *st) {
+    change_log_t *l = ctx;
+    static const char *names[] = { "created", "modified", "deleted" };
+    const char *name = strrchr(st->path, '/') + 1;
+    size_t len = strlen(l->log);
+    snprintf(l->log + len, sizeof(l->log) - len, "%s %s;", names[change], name);
+}
+
+static void write_file(const char *path, const char *data) {
+    FILE *fp = fopen(path, "a");
+    assert(fp);
+    fputs(data, fp);
+    fclose(fp);
+}
+
+static void put_stat(checkpoint_t *cp, const char *path) {
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+    assert(checkpoint_put_file(cp, path, st.st_ino, st.st_size, mtime));
+}
+
+void test_checkpoint_restart() {
+    char root[] = "/tmp/checkpoint_XXXXXX";
+    assert(mkdtemp(root));
+    char cpfile[512], a[512], sub[512], b[512], c[512], nd[512], d[512];
+    snprintf(cpfile, sizeof(cpfile), "%s.cp", root);
+    snprintf(a, sizeof(a), "%s/a", root);
+    snprintf(sub, sizeof(sub), "%s/sub", root);
+    snprintf(b, sizeof(b), "%s/sub/b", root);
+    snprintf(c, sizeof(c), "%s/c", root);
+    snprintf(nd, sizeof(nd), "%s/new", root);
+    snprintf(d, sizeof(d), "%s/new/d", root);
+
+    write_file(a, "a");
+    assert(mkdir(sub, 0755) == 0);
+    write_file(b, "b");
+
+    checkpoint_t *cp = checkpoint_open(cpfile, 16, NULL);
+    assert(cp);
+    assert(!checkpoint_usable(cp));
+    put_stat(cp, a);
+    put_stat(cp, b);
+    assert(checkpoint_add_dirs(cp, root, 2) == 0);
+
+    // Файлы под каталогом (каталог ушёл из дерева), без самого каталога
+    file_state_set_t under = {0};
+    assert(checkpoint_collect_prefix(cp, sub, &under) == 1);
+    assert(strcmp(under.items[0].path, b) == 0);
+    file_state_set_free(&under);
+    checkpoint_close(cp);
+
+    // Пока демон не работал: правка, удаление, новый файл, новый каталог
+    write_file(a, "more");
+    assert(unlink(b) == 0);
+    write_file(c, "c");
+    assert(mkdir(nd, 0755) == 0);
+    write_file(d, "d");
+
+    cp = checkpoint_open(cpfile, 16, NULL);
+    assert(cp);
+    assert(checkpoint_usable(cp));
+    checkpoint_stats_t st = checkpoint_get_stats(cp);
+    assert(st.files == 2 && st.dirs == 2 && st.invalid == 0);
+
+    change_log_t l = {0};
+    checkpoint_verify_stats_t vs = checkpoint_verify(cp, log_change, &l);
+    assert(strcmp(l.log, "deleted b;modified a;created c;created d;") == 0);
+    assert(vs.changes.created == 2 && vs.changes.modified == 1 && vs.changes.deleted == 1);
+    assert(vs.dirs_rescanned == 3); // корень, sub и новый каталог
+
+    // Найденное записано: повторная проверка ничего не находит
+    put_stat(cp, a);
+    put_stat(cp, c);
+    put_stat(cp, d);
+    checkpoint_remove(cp, b);
+    checkpoint_commit_dirs(cp);
+    memset(&l, 0, sizeof(l));
+    vs = checkpoint_verify(cp, log_change, &l);
+    assert(l.log[0] == '\0');
+    assert(vs.changes.unchanged == 3 && vs.dirs_rescanned == 0);
+    checkpoint_close(cp);
+
+    unlink(a); unlink(c); unlink(d);
+    rmdir(sub); rmdir(nd); rmdir(root);
+    unlink(cpfile);
+}
+
+void test_checkpoint_grow_and_torn() {
+    char cpfile[] = "/tmp/checkpoint_grow_XXXXXX";
+    int fd = mkstemp(cpfile);
+    assert(fd >= 0);
+    close(fd);
+    unlink(cpfile);
+
+    checkpoint_t *cp = checkpoint_open(cpfile, 1000, NULL);
+    assert(cp);
+    char path[64];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(path, sizeof(path), "/exchange/dir%d/file%d", i % 50, i);
+        assert(checkpoint_put_file(cp, path, (uint64_t)i + 1, i, i));
+    }
+    assert(checkpoint_put_dir(cp, "/exchange", 1));
+    for (int i = 0; i < 5000; i += 2) {
+        snprintf(path, sizeof(path), "/exchange/dir%d/file%d", i % 50, i);
+        checkpoint_remove(cp, path);
+    }
+    checkpoint_stats_t st = checkpoint_get_stats(cp);
+    assert(st.files == 2500 && st.seq == 7501);
+    checkpoint_close(cp);
+
+    cp = checkpoint_open(cpfile, 1000, NULL);
+    assert(cp && checkpoint_usable(cp));
+    st = checkpoint_get_stats(cp);
+    assert(st.files == 2500 && st.dirs == 1);
+    checkpoint_close(cp);
+
+    // Оборванная запись: портим хеш пути в первом занятом слоте
+    fd = open(cpfile, O_RDWR);
+    assert(fd >= 0);
+    const off_t header = 64, slot = 56;
+    for (off_t off = header;; off += slot) {
+        uint32_t state;
+        assert(pread(fd, &state, sizeof(state), off + 52) == sizeof(state));
+        if (state == 1) {
+            uint64_t junk = 0x5a5a5a5a5a5a5a5aull;
+            assert(pwrite(fd, &junk, sizeof(junk), off) == sizeof(junk));
+            break;
+        }
+    }
+    close(fd);
+
+    cp = checkpoint_open(cpfile, 1000, NULL);
+    assert(cp && !checkpoint_usable(cp));
+    st = checkpoint_get_stats(cp);
+    assert(st.invalid == 1 && st.files == 2499);
+
+    // После сброса заполняется заново
+    checkpoint_reset(cp);
+    assert(checkpoint_put_dir(cp, "/exchange", 1));
+    assert(checkpoint_usable(cp));
+    checkpoint_close(cp);
+    unlink(cpfile);
+}
@@ -0,0 +1,109 @@
+// test_chunk_cache.c
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "../src/storage/chunk_cache.h"
+
+#define CACHE_THREADS 8
+#define CACHE_ITERATIONS 20000
+
+static const char *key_a = "0123456789abcdef0123456789abcdef";
+static const char *key_b = "fedcba9876543210fedcba9876543210";
+
+void test_chunk_cache_basic() {
+    chunk_cache_options_t opts;
+    assert(chunk_cache_parse_options("budget=16K,shards=1,chunk=4K", &opts));
+    assert(opts.budget == 16384 && opts.shards == 1 && opts.chunk == 4096);
+    assert(!chunk_cache_parse_options("chunk=1", &opts));
+    assert(!chunk_cache_parse_options("size=1M", &opts));
+    opts.budget = 0;
+    assert(chunk_cache_create(&opts) == NULL);
+
+    assert(chunk_cache_parse_options("budget=16K,shards=1,chunk=4K", &opts));
+    chunk_cache_t *c = chunk_cache_create(&opts);
+    assert(c && chunk_cache_chunk_size(c) == 4096);
+
+    uint8_t chunk[4096];
+    for (uint32_t i = 0; i < 4; i++) {
+        memset(chunk, (int)i, sizeof(chunk));
+        assert(chunk_cache_put(c, key_a, i, chunk, sizeof(chunk)));
+    }
+    assert(!chunk_cache_put(c, key_a, 9, chunk, 16385)); // больше шарда
+
+    const chunk_ref_t *ref = chunk_cache_get(c, key_a, 2);
+    size_t len = 0;
+    assert(ref && chunk_ref_data(ref, &len)[0] == 2 && len == 4096);
+    assert(chunk_cache_get(c, key_b, 2) == NULL);
+
+    // Бюджет полон: 2 отмечен обращением, стрелка вытесняет 0, затем 1
+    assert(chunk_cache_put(c, key_b, 0, chunk, sizeof(chunk)));
+    assert(chunk_cache_put(c, key_b, 1, chunk, sizeof(chunk)));
+    const chunk_ref_t *miss = chunk_cache_get(c, key_a, 0);
+    assert(miss == NULL);
+    const chunk_ref_t *kept = chunk_cache_get(c, key_a, 2);
+    assert(kept);
+    chunk_cache_release(kept);
+
+    chunk_cache_stats_t st;
+    chunk_cache_stats(c, &st);
+    assert(st.bytes == 16384 && st.chunks == 4 && st.evictions == 2);
+    assert(st.hits == 2 && st.misses == 2);
+
+    // Выданный кусок переживает удаление из кэша
+    chunk_cache_invalidate(c, key_a, 4);
+    assert(chunk_cache_get(c, key_a, 2) == NULL);
+    assert(chunk_ref_data(ref, &len)[4095] == 2);
+    chunk_cache_release(ref);
+
+    chunk_cache_stats(c, &st);
+    assert(st.bytes == 8192 && st.chunks == 2);
+    chunk_cache_destroy(c);
+}
+
+typedef struct {
+    chunk_cache_t *c;
+    int n;
+} cache_worker_t;
+
+static void *cache_worker(void *arg) {
+    cache_worker_t *w = arg;
+    uint8_t chunk[1024];
+    for (int i = 0; i < CACHE_ITERATIONS; i++) {
+        uint32_t index = (uint32_t)((i * 7 + w->n) % 64);
+        const chunk_ref_t *ref = chunk_cache_get(w->c, key_a, index);
+        if (ref) {
+            size_t len;
+            const uint8_t *data = chunk_ref_data(ref, &len);
+            assert(len == sizeof(chunk) && data[0] == (uint8_t)index && data[len - 1] == (uint8_t)index);
+            chunk_cache_release(ref);
+        } else {
+            memset(chunk, (int)index, sizeof(chunk));
+            chunk_cache_put(w->c, key_a, index, chunk, sizeof(chunk));
+        }
+        if (i % 1000 == 0) chunk_cache_invalidate(w->c, key_a, 4);
+    }
+    return NULL;
+}
+
+void test_chunk_cache_threads() {
+    chunk_cache_options_t opts;
+    assert(chunk_cache_parse_options("budget=32K,shards=4,chunk=4K", &opts));
+    chunk_cache_t *c = chunk_cache_create(&opts);
+    assert(c);
+
+    pthread_t threads[CACHE_THREADS];
+    cache_worker_t workers[CACHE_THREADS];
+    for (int i = 0; i < CACHE_THREADS; i++) {
+        workers[i] = (cache_worker_t){ .c = c, .n = i };
+        assert(pthread_create(&threads[i], NULL, cache_worker, &workers[i]) == 0);
+    }
+    for (int i = 0; i < CACHE_THREADS; i++) pthread_join(threads[i], NULL);
+
+    chunk_cache_stats_t st;
+    chunk_cache_stats(c, &st);
+    assert(st.bytes <= 32768 && st.bytes == st.chunks * 1024);
+    assert(st.hits + st.misses >= (uint64_t)CACHE_THREADS * CACHE_ITERATIONS);
+    assert(st.evictions > 0);
+    chunk_cache_destroy(c);
+}
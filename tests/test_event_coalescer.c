@@ -0,0 +1,133 @@
+// test_event_coalescer.c
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/core/event_coalescer.h"
+
+#define MS 1000000ull
+
+typedef struct {
+    int n;
+    fs_event_kind_t kind[16];
+    char path[16][64];
+    char old_path[16][64];
+    uint32_t merged[16];
+} captured_t;
+
+static void capture(void *ctx, const fs_event_t *ev) {
+    captured_t *cap = ctx;
+    assert(cap->n < 16);
+    cap->kind[cap->n] = ev->kind;
+    snprintf(cap->path[cap->n], 64, "%s", ev->path);
+    snprintf(cap->old_path[cap->n], 64, "%s", ev->old_path ? ev->old_path : "");
+    cap->merged[cap->n] = ev->merged;
+    cap->n++;
+}
+
+void test_coalescer_collapse_modifies() {
+    captured_t cap = {0};
+    coalescer_t *c = coalescer_new(200 * MS, 0, capture, &cap);
+    assert(c);
+
+    uint64_t t = 1000 * MS;
+    for (int i = 0; i < 5; i++) {
+        coalescer_modified(c, "/x/a", t + i * 50 * MS);
+    }
+    assert(coalescer_pending(c) == 1);
+
+    // Окно отсчитывается от последнего изменения
+    coalescer_advance(c, t + 300 * MS);
+    assert(cap.n == 0);
+    assert(coalescer_next_deadline(c) >= t + 400 * MS);
+
+    coalescer_advance(c, t + 410 * MS);
+    assert(cap.n == 1);
+    assert(cap.kind[0] == FS_EVENT_MODIFIED);
+    assert(strcmp(cap.path[0], "/x/a") == 0);
+    assert(cap.merged[0] == 5);
+    assert(coalescer_pending(c) == 0);
+    assert(coalescer_next_deadline(c) == 0);
+
+    coalescer_stats_t st = coalescer_get_stats(c);
+    assert(st.raw_events == 5 && st.emitted == 1);
+    coalescer_free(c);
+}
+
+void test_coalescer_rename_pair() {
+    captured_t cap = {0};
+    coalescer_t *c = coalescer_new(200 * MS, 0, capture, &cap);
+    uint64_t t = 1000 * MS;
+
+    // Типичное сохранение редактора: запись во временный файл и rename поверх
+    coalescer_modified(c, "/x/.a.swp", t);
+    coalescer_moved_from(c, "/x/.a.swp", 7, t + 1 * MS);
+    coalescer_moved_to(c, "/x/a", 7, t + 1 * MS);
+    // Цепочка переименований сводится к одному
+    coalescer_moved_from(c, "/x/a", 8, t + 2 * MS);
+    coalescer_moved_to(c, "/x/b", 8, t + 2 * MS);
+    // Каталог переименован целиком: пара уже известна наблюдателю
+    coalescer_renamed(c, "/x/b", "/y/b", t + 3 * MS);
+
+    coalescer_advance(c, t + 500 * MS);
+    assert(cap.n == 1);
+    assert(cap.kind[0] == FS_EVENT_RENAMED);
+    assert(strcmp(cap.path[0], "/y/b") == 0);
+    assert(strcmp(cap.old_path[0], "/x/.a.swp") == 0);
+    assert(coalescer_get_stats(c).renames_paired == 3);
+    coalescer_free(c);
+}
+
+void test_coalescer_unpaired_moves() {
+    captured_t cap = {0};
+    coalescer_t *c = coalescer_new(100 * MS, 0, capture, &cap);
+    uint64_t t = 1000 * MS;
+
+    // Ушёл из дерева — удаление; пришёл снаружи — moved_to
+    coalescer_moved_from(c, "/x/gone", 1, t);
+    coalescer_moved_to(c, "/x/new", 2, t);
+    coalescer_advance(c, t + 150 * MS);
+    coalescer_advance(c, t + 300 * MS);
+
+    assert(cap.n == 2);
+    int gone = strcmp(cap.path[0], "/x/gone") == 0 ? 0 : 1;
+    assert(cap.kind[gone] == FS_EVENT_DELETED);
+    assert(strcmp(cap.path[1 - gone], "/x/new") == 0);
+    assert(cap.kind[1 - gone] == FS_EVENT_MOVED_TO);
+    coalescer_free(c);
+}
+
+void test_coalescer_delete_after_rename() {
+    captured_t cap = {0};
+    coalescer_t *c = coalescer_new(100 * MS, 0, capture, &cap);
+    uint64_t t = 1000 * MS;
+
+    coalescer_moved_from(c, "/x/a", 3, t);
+    coalescer_moved_to(c, "/x/b", 3, t);
+    coalescer_deleted(c, "/x/b", t + 10 * MS);
+    coalescer_flush(c);
+
+    // Итог: исчезли оба пути, о переименовании писать незачем
+    assert(cap.n == 2);
+    assert(cap.kind[0] == FS_EVENT_DELETED && cap.kind[1] == FS_EVENT_DELETED);
+    assert((strcmp(cap.path[0], "/x/a") == 0) != (strcmp(cap.path[1], "/x/a") == 0));
+    assert(coalescer_pending(c) == 0);
+    coalescer_free(c);
+}
+
+void test_coalescer_max_pending() {
+    captured_t cap = {0};
+    coalescer_t *c = coalescer_new(100 * MS, 2, capture, &cap);
+    uint64_t t = 1000 * MS;
+
+    coalescer_modified(c, "/x/1", t);
+    coalescer_modified(c, "/x/2", t);
+    coalescer_modified(c, "/x/3", t); // сверх предела — сразу наружу
+    assert(cap.n == 1 && strcmp(cap.path[0], "/x/3") == 0);
+    coalescer_modified(c, "/x/1", t); // уже накоплен — склеивается
+    assert(cap.n == 1);
+
+    coalescer_flush(c);
+    assert(cap.n == 3);
+    coalescer_free(c);
+}
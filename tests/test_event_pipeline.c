@@ -0,0 +1,221 @@
+// test_event_pipeline.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/core/event_pipeline.h"
+
+#define PATHS 8
+#define EVENTS_PER_PATH 200
+
+typedef struct {
+    pthread_mutex_t lock;
+    int n;
+    int last_seq[PATHS];
+    unsigned worker_of[PATHS];
+    bool ordered;
+    bool same_worker;
+    bool hashed_a;
+    uint8_t hash_a[HASH_SIZE];
+} pipeline_results_t;
+
+static void collect(void *ctx, unsigned worker, const pipeline_event_t *ev) {
+    pipeline_results_t *r = ctx;
+    const char *slash = strrchr(ev->path, '/');
+    int idx = slash[1] == 'a' ? 0 : atoi(slash + 2);
+
+    pthread_mutex_lock(&r->lock);
+    r->n++;
+    // first_ns используется как порядковый номер события своего пути
+    if ((int)ev->first_ns <= r->last_seq[idx]) r->ordered = false;
+    r->last_seq[idx] = (int)ev->first_ns;
+    if (r->worker_of[idx] == (unsigned)-1) r->worker_of[idx] = worker;
+    else if (r->worker_of[idx] != worker) r->same_worker = false;
+    if (idx == 0 && ev->hashed) {
+        r->hashed_a = true;
+        memcpy(r->hash_a, ev->hash, HASH_SIZE);
+    }
+    pthread_mutex_unlock(&r->lock);
+}
+
+void test_pipeline_order_and_hash() {
+    char dir[] = "/tmp/pipeline_XXXXXX";
+    assert(mkdtemp(dir));
+    char paths[PATHS][512];
+
+    const char *data = "hello, exchange";
+    for (int i = 0; i < PATHS; i++) {
+        if (i == 0) snprintf(paths[i], sizeof(paths[i]), "%s/a", dir);
+        else snprintf(paths[i], sizeof(paths[i]), "%s/f%d", dir, i);
+        FILE *fp = fopen(paths[i], "w");
+        assert(fp);
+        fputs(data, fp);
+        fclose(fp);
+    }
+
+    pipeline_results_t r = { .lock = PTHREAD_MUTEX_INITIALIZER, .ordered = true, .same_worker = true };
+    for (int i = 0; i < PATHS; i++) r.worker_of[i] = (unsigned)-1;
+
+    // Маленькие очереди: производитель упирается в противодавление
+    hash_cache_t *hc = hash_cache_open(NULL, 0);
+    event_pipeline_t *p = pipeline_new(3, 16, 8, hc, collect, &r);
+    assert(p);
+    assert(pipeline_worker_count(p) == 3);
+
+    for (int seq = 1; seq <= EVENTS_PER_PATH; seq++) {
+        for (int i = 0; i < PATHS; i++) {
+            fs_event_t ev = {
+                .kind = seq == EVENTS_PER_PATH ? FS_EVENT_DELETED : FS_EVENT_MODIFIED,
+                .path = paths[i],
+                .first_ns = (uint64_t)seq,
+                .merged = 1,
+            };
+            assert(pipeline_submit(p, &ev));
+        }
+    }
+
+    pipeline_wait_idle(p);
+    assert(r.n == PATHS * EVENTS_PER_PATH);
+    assert(r.ordered);
+    assert(r.same_worker);
+
+    uint8_t expected[HASH_SIZE];
+    compute_buffer_blake3((const uint8_t *)data, strlen(data), expected);
+    assert(r.hashed_a && memcmp(r.hash_a, expected, HASH_SIZE) == 0);
+
+    pipeline_stats_t st = pipeline_get_stats(p);
+    assert(st.submitted == PATHS * EVENTS_PER_PATH);
+    assert(st.hashed + st.cache_hits + st.skipped + st.failed == PATHS * (EVENTS_PER_PATH - 1));
+    assert(st.cache_hits > 0);
+
+    uint64_t processed = 0;
+    for (unsigned w = 0; w < pipeline_worker_count(p); w++) {
+        pipeline_worker_stats_t ws = pipeline_get_worker_stats(p, w);
+        assert(ws.occupancy == 0);
+        assert(ws.high_watermark <= 16);
+        processed += ws.processed;
+    }
+    assert(processed == PATHS * EVENTS_PER_PATH);
+
+    pipeline_free(p);
+    hash_cache_close(hc);
+
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    assert(system(cmd) == 0);
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    unsigned worker_of_old;
+    unsigned worker_of_new;
+    unsigned source_worker;
+    unsigned target_worker;
+    int halves;
+} rename_results_t;
+
+static void collect_rename(void *ctx, unsigned worker, const pipeline_event_t *ev) {
+    rename_results_t *r = ctx;
+    pthread_mutex_lock(&r->lock);
+    if (ev->kind == FS_EVENT_RENAMED) {
+        r->halves++;
+        if (ev->rename_source) r->source_worker = worker;
+        else r->target_worker = worker;
+        assert(strcmp(ev->old_path, "/nonexistent/old") == 0);
+        assert(!ev->rename_source || !ev->hashed);
+    } else if (strcmp(ev->path, "/nonexistent/old") == 0) {
+        r->worker_of_old = worker;
+    } else {
+        r->worker_of_new = worker;
+    }
+    pthread_mutex_unlock(&r->lock);
+}
+
+void test_pipeline_rename_halves() {
+    rename_results_t r = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    event_pipeline_t *p = pipeline_new(4, 16, 8, NULL, collect_rename, &r);
+    assert(p);
+
+    // Прежний путь пишется в потоке прежнего пути: иначе он гонится с
+    // событиями, которые позже придут для этого пути
+    fs_event_t evs[] = {
+        { .kind = FS_EVENT_MODIFIED, .path = "/nonexistent/old", .merged = 1 },
+        { .kind = FS_EVENT_MODIFIED, .path = "/nonexistent/new", .merged = 1 },
+        { .kind = FS_EVENT_RENAMED, .path = "/nonexistent/new",
+          .old_path = "/nonexistent/old", .merged = 1 },
+    };
+    for (size_t i = 0; i < sizeof(evs) / sizeof(evs[0]); i++) {
+        assert(pipeline_submit(p, &evs[i]));
+    }
+    pipeline_wait_idle(p);
+
+    assert(r.halves == 2);
+    assert(r.source_worker == r.worker_of_old);
+    assert(r.target_worker == r.worker_of_new);
+    assert(pipeline_get_stats(p).submitted == 3);
+
+    pipeline_free(p);
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool open;
+    int n;
+    bool ordered;
+} gated_results_t;
+
+static void collect_gated(void *ctx, unsigned worker, const pipeline_event_t *ev) {
+    (void)worker;
+    gated_results_t *r = ctx;
+    pthread_mutex_lock(&r->lock);
+    while (!r->open) pthread_cond_wait(&r->cond, &r->lock);
+    if ((int)ev->first_ns != r->n + 1) r->ordered = false;
+    r->n++;
+    pthread_mutex_unlock(&r->lock);
+}
+
+void test_pipeline_spill() {
+    gated_results_t r = {
+        .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER, .ordered = true,
+    };
+    event_pipeline_t *p = pipeline_new(1, 16, 8, NULL, collect_gated, &r);
+    assert(p);
+
+    // Поток стоит, а производитель не ждёт: лишнее уходит в список ожидания
+    for (int seq = 1; seq <= 100; seq++) {
+        fs_event_t ev = {
+            .kind = FS_EVENT_DELETED, .path = "/nonexistent/x",
+            .first_ns = (uint64_t)seq, .merged = 1,
+        };
+        assert(pipeline_submit(p, &ev));
+    }
+    pipeline_stats_t st = pipeline_get_stats(p);
+    assert(st.spill_pending > 0 && st.spilled == st.spill_pending);
+    // Метка учитывает и ожидающие места события
+    pipeline_mark_t *m = pipeline_mark(p);
+    assert(m && !pipeline_mark_reached(p, m));
+
+    pthread_mutex_lock(&r.lock);
+    r.open = true;
+    pthread_cond_broadcast(&r.cond);
+    pthread_mutex_unlock(&r.lock);
+
+    // Место освобождается — цикл событий узнаёт об этом через eventfd
+    struct pollfd pfd = { .fd = pipeline_spill_fd(p), .events = POLLIN };
+    while (pipeline_get_stats(p).spill_pending > 0) {
+        assert(poll(&pfd, 1, 5000) == 1);
+        pipeline_resume(p);
+    }
+    pipeline_wait_mark(p, m);
+    assert(r.n == 100 && r.ordered);
+    free(m);
+    pipeline_wait_idle(p);
+    assert(pipeline_get_worker_stats(p, 0).high_watermark <= 16);
+
+    pipeline_free(p);
+}
@@ -0,0 +1,85 @@
+// test_flight_group.c
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/storage/flight_group.h"
+
+#define FLIGHT_THREADS 8
+
+static const char *flight_key = "0123456789abcdef0123456789abcdef";
+
+typedef struct {
+    flight_group_t *g;
+    flight_t *f;
+    const uint8_t *data;
+    size_t len;
+    int status;
+} flight_follower_t;
+
+static void *flight_follower(void *arg) {
+    flight_follower_t *w = arg;
+    w->data = flight_wait(w->g, w->f, &w->len, &w->status);
+    return NULL;
+}
+
+static void wait_followers(flight_group_t *g, uint64_t n) {
+    flight_stats_t st;
+    for (;;) {
+        flight_group_stats(g, &st);
+        if (st.followers >= n) return;
+        usleep(1000);
+    }
+}
+
+void test_flight_group_coalesce() {
+    flight_group_t *g = flight_group_create();
+    assert(g);
+
+    bool leader = false;
+    flight_t *lead = flight_join(g, flight_key, &leader);
+    assert(lead && leader);
+
+    // Пришедшие до завершения присоединяются и ждут
+    pthread_t threads[FLIGHT_THREADS];
+    flight_follower_t workers[FLIGHT_THREADS];
+    for (int i = 0; i < FLIGHT_THREADS; i++) {
+        workers[i] = (flight_follower_t){ .g = g };
+        workers[i].f = flight_join(g, flight_key, &leader);
+        assert(workers[i].f == lead && !leader);
+        assert(pthread_create(&threads[i], NULL, flight_follower, &workers[i]) == 0);
+    }
+    wait_followers(g, FLIGHT_THREADS);
+
+    uint8_t *data = malloc(5);
+    memcpy(data, "hello", 5);
+    flight_finish(g, lead, data, 5, 0);
+    for (int i = 0; i < FLIGHT_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        assert(workers[i].data == data && workers[i].len == 5 && workers[i].status == 0);
+        flight_release(g, workers[i].f);
+    }
+
+    // Завершённый полёт убран из таблицы: следующий запрос ведёт новый
+    flight_t *next = flight_join(g, flight_key, &leader);
+    assert(next && next != lead && leader);
+    flight_release(g, lead);
+
+    flight_t *follower = flight_join(g, flight_key, &leader);
+    assert(follower == next && !leader);
+    flight_finish(g, next, NULL, 0, 7);
+    size_t len;
+    int status = 0;
+    assert(flight_wait(g, follower, &len, &status) == NULL && status == 7);
+    flight_release(g, follower);
+
+    // Пока полёт не отпущен, группа не освобождается
+    assert(!flight_group_destroy(g));
+    flight_release(g, next);
+
+    flight_stats_t st;
+    flight_group_stats(g, &st);
+    assert(st.leaders == 2 && st.followers == FLIGHT_THREADS + 1);
+    assert(flight_group_destroy(g));
+}
@@ -0,0 +1,485 @@
+// test_handlers.c
+//
+// Обработчики сервера целиком: server.c включается (main переименован), как
+// в bench/bench_handlers.c. Соединения — mTLS в памяти поверх socketpair
+// (mocks/mock_ssl.h), метаданные — memory-реализация meta_store, файлы —
+// во временном каталоге.
+#define _GNU_SOURCE
+#define main exchange_server_main
+#define STORAGE_DIR g_storage_dir
+static char g_storage_dir[64];
+#include "../src/server/server.c"
+#undef main
+
+#include <assert.h>
+#include <ftw.h>
+
+#include "../src/client/client_proto.h"
+#include "mocks/mock_ssl.h"
+
+// В тестах MongoDB не линкуется
+meta_store_t *meta_store_open_mongo(const char *uri, const char *database,
+                                    const char *collection, meta_error_t *error) {
+    (void)uri;
+    (void)database;
+    (void)collection;
+    meta_set_error(error, "MongoDB is not linked into tests");
+    return NULL;
+}
+
+typedef struct {
+    mock_ssl_conn_t conn;
+    pthread_t thread;
+} handler_conn_t;
+
+// Поток сервера: заголовок и обработчик, как в handle_client
+static void *handler_serve(void *arg) {
+    SSL *ssl = arg;
+    char fingerprint[FINGERPRINT_LEN];
+    if (!mock_ssl_fingerprint(ssl, fingerprint)) return NULL;
+
+    RequestHeader req;
+    while (SSL_read(ssl, &req, sizeof(req)) == sizeof(req)) {
+        int command = (int)req.command >= 0 && req.command < CMD_UNKNOWN ? (int)req.command : CMD_UNKNOWN;
+        request_trace_t trace;
+        trace_begin(&trace, command);
+        switch (req.command) {
+            case CMD_UPLOAD:   handle_upload_request(ssl, &req, fingerprint, &trace); break;
+            case CMD_DOWNLOAD: handle_download_request(ssl, &req, fingerprint, &trace); break;
+            case CMD_STAT:
+                if (handle_stat_request(ssl, &req, fingerprint) != 0) return NULL;
+                break;
+            case CMD_SUBSCRIBE:
+                if (handle_subscribe_request(ssl, SSL_get_fd(ssl), fingerprint) != 0) return NULL;
+                break;
+            default: {
+                ResponseHeader resp = { .status = RESP_UNKNOWN_COMMAND };
+                ssl_send_all(ssl, &resp, sizeof(resp));
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void handlers_setup(const char *meta_spec) {
+    static bool once;
+    if (!once) {
+        signal(SIGPIPE, SIG_IGN);
+        setenv("EXCHANGE_METRICS_PORT", "0", 0);
+        init_metrics();
+        once = true;
+    }
+    assert(log_init("/dev/null", LOG_ERROR));
+
+    snprintf(g_storage_dir, sizeof(g_storage_dir), "/tmp/test-handlers.XXXXXX");
+    assert(mkdtemp(g_storage_dir));
+    meta_mem_options_t meta_options;
+    assert(meta_mem_parse_options(meta_spec, &meta_options));
+    g_meta = meta_store_open_memory(&meta_options);
+    object_store_options_t store_options;
+    assert(object_store_parse_options("sync=0", &store_options));
+    int err = 0;
+    g_objects = object_store_open(g_storage_dir, &store_options, &err);
+    assert(g_meta && g_objects && init_cryptography());
+
+    chunk_cache_options_t cache_options;
+    assert(chunk_cache_parse_options("budget=8M,shards=4,chunk=64K", &cache_options));
+    g_chunks = chunk_cache_create(&cache_options);
+    g_flights = flight_group_create();
+    g_uploads = flight_group_create();
+    assert(g_chunks && g_flights && g_uploads);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static void handlers_teardown(void) {
+    chunk_cache_destroy(g_chunks);
+    assert(flight_group_destroy(g_flights));
+    assert(flight_group_destroy(g_uploads));
+    object_store_close(g_objects);
+    meta_store_close(g_meta);
+    g_chunks = NULL;
+    g_flights = NULL;
+    g_uploads = NULL;
+    g_objects = NULL;
+    g_meta = NULL;
+    assert(nftw(g_storage_dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+    log_shutdown();
+}
+
+static void handler_connect(mock_ssl_env_t *env, handler_conn_t *c) {
+    assert(mock_ssl_connect(env, &c->conn));
+    assert(pthread_create(&c->thread, NULL, handler_serve, c->conn.server) == 0);
+}
+
+static void handler_close(handler_conn_t *c) {
+    shutdown(c->conn.fds[1], SHUT_RDWR);
+    pthread_join(c->thread, NULL);
+    mock_ssl_conn_close(&c->conn);
+}
+
+static uint8_t *handler_payload(size_t len, uint8_t seed, uint8_t hash[BLAKE3_HASH_LEN]) {
+    uint8_t *data = malloc(len);
+    assert(data);
+    for (size_t i = 0; i < len; i++) data[i] = (uint8_t)(i * 7 + seed);
+    compute_buffer_blake3(data, len, hash);
+    return data;
+}
+
+typedef struct {
+    const uint8_t *data;
+    size_t expect;
+    size_t len;
+    bool ok;
+} download_check_t;
+
+static int check_sink(void *ctx, const uint8_t *data, size_t len) {
+    download_check_t *c = ctx;
+    if (c->len + len > c->expect) return -1;
+    c->ok = c->ok && memcmp(c->data + c->len, data, len) == 0;
+    c->len += len;
+    return 0;
+}
+
+static bool handler_download_matches(SSL *ssl, const char *name, const uint8_t *data, size_t len) {
+    download_check_t check = { .data = data, .expect = len, .ok = true };
+    long long size = 0;
+    int status = -1;
+    return proto_download(ssl, name, check_sink, &check, &size, &status) == 0 &&
+           status == RESP_SUCCESS && (size_t)size == len && check.len == len && check.ok;
+}
+
+// Клиентский контекст с новым сертификатом того же CA: следующие
+// соединения env идут от другого клиента. Прежний контекст возвращается
+static SSL_CTX *handler_switch_client(mock_ssl_env_t *env, const char *cn, mock_ssl_identity_t *id) {
+    assert(mock_ssl_issue(cn, &env->ca, id));
+    SSL_CTX *prev = env->client_ctx;
+    env->client_ctx = SSL_CTX_new(TLS_client_method());
+    assert(env->client_ctx && mock_ssl_ctx_use(env->client_ctx, id, &env->ca));
+    SSL_CTX_set_verify(env->client_ctx, SSL_VERIFY_PEER, NULL);
+    return prev;
+}
+
+void test_handlers_recipient_download() {
+    handlers_setup("");
+    mock_ssl_env_t env;
+    assert(mock_ssl_env_init(&env));
+    handler_conn_t owner;
+    handler_connect(&env, &owner);
+
+    mock_ssl_identity_t recipient_id = { 0 }, stranger_id = { 0 };
+    SSL_CTX *owner_ctx = handler_switch_client(&env, "mock-recipient", &recipient_id);
+    handler_conn_t recipient;
+    handler_connect(&env, &recipient);
+    char recipient_fp[FINGERPRINT_LEN];
+    assert(mock_ssl_fingerprint(recipient.conn.server, recipient_fp));
+
+    size_t len = 64 * 1024;
+    uint8_t hash[BLAKE3_HASH_LEN];
+    uint8_t *data = handler_payload(len, 6, hash);
+    int status = -1;
+    assert(proto_upload(owner.conn.client, "private.bin", data, len, hash, recipient_fp, &status) == 0);
+
+    // Адресный файл скачивают владелец и получатель
+    assert(handler_download_matches(owner.conn.client, "private.bin", data, len));
+    assert(handler_download_matches(recipient.conn.client, "private.bin", data, len));
+
+    // Третьему клиенту файл не виден
+    SSL_CTX *recipient_ctx = handler_switch_client(&env, "mock-stranger", &stranger_id);
+    handler_conn_t stranger;
+    handler_connect(&env, &stranger);
+    download_check_t check = { .data = data, .expect = len, .ok = true };
+    long long size = 0;
+    assert(proto_download(stranger.conn.client, "private.bin", check_sink, &check, &size, &status) != 0);
+    assert(status == RESP_FILE_NOT_FOUND && check.len == 0);
+
+    handler_close(&stranger);
+    handler_close(&recipient);
+    handler_close(&owner);
+    SSL_CTX_free(recipient_ctx);
+    SSL_CTX_free(env.client_ctx);
+    env.client_ctx = owner_ctx;
+    mock_ssl_identity_free(&recipient_id);
+    mock_ssl_identity_free(&stranger_id);
+    free(data);
+    mock_ssl_env_free(&env);
+    handlers_teardown();
+}
+
+static StatQuery stat_by_name(const char *name) {
+    StatQuery q = { .by_hash = 0 };
+    snprintf(q.filename, sizeof(q.filename), "%s", name);
+    return q;
+}
+
+static StatQuery stat_by_hash(const uint8_t hash[BLAKE3_HASH_LEN]) {
+    StatQuery q = { .by_hash = 1 };
+    memcpy(q.file_hash, hash, BLAKE3_HASH_LEN);
+    return q;
+}
+
+void test_handlers_stat_duplicates() {
+    handlers_setup("");
+    mock_ssl_env_t env;
+    assert(mock_ssl_env_init(&env));
+    handler_conn_t a;
+    handler_connect(&env, &a);
+    SSL *ssl = a.conn.client;
+
+    // Две загрузки одного имени: по имени отвечает свежая, по хешу — своя
+    uint8_t old_hash[BLAKE3_HASH_LEN], new_hash[BLAKE3_HASH_LEN];
+    uint8_t *old_data = handler_payload(1000, 7, old_hash);
+    uint8_t *new_data = handler_payload(2000, 8, new_hash);
+    int status = -1;
+    assert(proto_upload(ssl, "dup.bin", old_data, 1000, old_hash, NULL, &status) == 0);
+    usleep(2000); // uploaded_at в миллисекундах
+    assert(proto_upload(ssl, "dup.bin", new_data, 2000, new_hash, NULL, &status) == 0);
+
+    // Один документ заполняет все совпавшие записи батча, в любом порядке
+    StatQuery queries[] = {
+        stat_by_name("dup.bin"), stat_by_hash(new_hash), stat_by_name("missing.bin"),
+        stat_by_hash(old_hash),  stat_by_name("dup.bin"), stat_by_hash(new_hash),
+        stat_by_hash(old_hash),  stat_by_name("dup.bin"),
+    };
+    size_t n = sizeof(queries) / sizeof(queries[0]);
+    RequestHeader req = { .command = CMD_STAT, .filesize = (long long)n };
+    ResponseHeader resp;
+    StatEntry entries[sizeof(queries) / sizeof(queries[0])];
+    assert(proto_send_all(ssl, &req, sizeof(req)) == 0);
+    assert(proto_send_all(ssl, queries, sizeof(queries)) == 0);
+    assert(proto_recv_all(ssl, &resp, sizeof(resp)) == 0);
+    assert(resp.status == RESP_SUCCESS && resp.filesize == (long long)n);
+    assert(proto_recv_all(ssl, entries, sizeof(entries)) == 0);
+
+    for (size_t i = 0; i < n; i++) {
+        if (i == 2) {
+            assert(!entries[i].exists);
+            continue;
+        }
+        bool old = queries[i].by_hash && memcmp(queries[i].file_hash, old_hash, BLAKE3_HASH_LEN) == 0;
+        assert(entries[i].exists && entries[i].size == (old ? 1000 : 2000));
+        assert(memcmp(entries[i].file_hash, old ? old_hash : new_hash, BLAKE3_HASH_LEN) == 0);
+        assert(entries[i].permission == (STAT_PERM_OWNER | STAT_PERM_PUBLIC));
+    }
+
+    handler_close(&a);
+    free(old_data);
+    free(new_data);
+    mock_ssl_env_free(&env);
+    handlers_teardown();
+}
+
+typedef struct {
+    handler_conn_t c;
+    char name[32];
+    const uint8_t *data;
+    size_t len;
+    const uint8_t *hash;
+    int status;
+} upload_job_t;
+
+static void *upload_job(void *arg) {
+    upload_job_t *j = arg;
+    if (proto_upload(j->c.conn.client, j->name, j->data, j->len, j->hash, NULL, &j->status) < 0) {
+        j->status = -1;
+    }
+    return NULL;
+}
+
+// Одновременные загрузки одного содержимого под разными именами
+static void upload_concurrently(mock_ssl_env_t *env, upload_job_t *jobs, int n,
+                                const uint8_t *data, size_t len, const uint8_t *hash) {
+    pthread_t threads[n];
+    for (int i = 0; i < n; i++) {
+        jobs[i] = (upload_job_t){ .data = data, .len = len, .hash = hash, .status = -1 };
+        snprintf(jobs[i].name, sizeof(jobs[i].name), "fleet-%d.bin", i);
+        handler_connect(env, &jobs[i].c);
+    }
+    for (int i = 0; i < n; i++) assert(pthread_create(&threads[i], NULL, upload_job, &jobs[i]) == 0);
+    for (int i = 0; i < n; i++) {
+        pthread_join(threads[i], NULL);
+        handler_close(&jobs[i].c);
+    }
+}
+
+static size_t g_object_files;
+
+static int count_object(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    if (flag == FTW_F && !strstr(path, "/pack/")) g_object_files++;
+    return 0;
+}
+
+// Объекты отдельными файлами (мелкие ушли бы в пачки)
+static size_t handler_object_files(void) {
+    g_object_files = 0;
+    assert(nftw(g_storage_dir, count_object, 8, FTW_PHYS) == 0);
+    return g_object_files;
+}
+
+#define FLEET_UPLOADS 8
+
+void test_handlers_upload_coalesce() {
+    // Задержка вставки держит полёт ведущего, пока подтягиваются остальные
+    handlers_setup("latency_us=200000");
+    mock_ssl_env_t env;
+    assert(mock_ssl_env_init(&env));
+
+    size_t len = 256 * 1024;
+    uint8_t hash[BLAKE3_HASH_LEN];
+    uint8_t *data = handler_payload(len, 3, hash);
+    upload_job_t jobs[FLEET_UPLOADS];
+    upload_concurrently(&env, jobs, FLEET_UPLOADS, data, len, hash);
+
+    // Один объект на диске, документы всех загрузок ссылаются на него
+    handler_conn_t a;
+    handler_connect(&env, &a);
+    char fingerprint[FINGERPRINT_LEN];
+    assert(mock_ssl_fingerprint(a.conn.server, fingerprint));
+    char object_id[OBJECT_ID_LEN] = "";
+    for (int i = 0; i < FLEET_UPLOADS; i++) {
+        assert(jobs[i].status == RESP_SUCCESS);
+        meta_file_t meta;
+        meta_error_t error;
+        assert(meta_find_latest(g_meta, jobs[i].name, fingerprint, &meta, &error) == 1);
+        if (i == 0) memcpy(object_id, meta.object_id, sizeof(object_id));
+        assert(strcmp(meta.object_id, object_id) == 0);
+    }
+    assert(handler_object_files() == 1);
+    flight_stats_t st;
+    flight_group_stats(g_uploads, &st);
+    assert(st.leaders == 1 && st.followers == FLEET_UPLOADS - 1);
+
+    assert(handler_download_matches(a.conn.client, jobs[FLEET_UPLOADS - 1].name, data, len));
+    handler_close(&a);
+
+    free(data);
+    mock_ssl_env_free(&env);
+    handlers_teardown();
+}
+
+void test_handlers_upload_coalesce_fallback() {
+    // Каждая вторая вставка падает: первая — подготовительная, вторая — ведущего
+    handlers_setup("latency_us=200000,fail_every=2,fail_ops=insert");
+    mock_ssl_env_t env;
+    assert(mock_ssl_env_init(&env));
+
+    size_t len = 256 * 1024;
+    uint8_t hash[BLAKE3_HASH_LEN];
+    uint8_t *other = handler_payload(len, 4, hash);
+    handler_conn_t a;
+    handler_connect(&env, &a);
+    int status = -1;
+    assert(proto_upload(a.conn.client, "other.bin", other, len, hash, NULL, &status) == 0);
+    assert(status == RESP_SUCCESS);
+    handler_close(&a);
+    free(other);
+
+    // Ведущий не вставил документ: свой объект он удаляет, ждавший
+    // загружает содержимое сам
+    uint8_t *data = handler_payload(len, 5, hash);
+    upload_job_t jobs[2];
+    upload_concurrently(&env, jobs, 2, data, len, hash);
+    int leader = jobs[0].status == RESP_ERROR ? 0 : 1;
+    assert(jobs[leader].status == RESP_ERROR && jobs[!leader].status == RESP_SUCCESS);
+    flight_stats_t st;
+    flight_group_stats(g_uploads, &st);
+    assert(st.followers == 1);
+    assert(handler_object_files() == 2);
+
+    handler_connect(&env, &a);
+    assert(handler_download_matches(a.conn.client, jobs[!leader].name, data, len));
+    handler_close(&a);
+
+    free(data);
+    mock_ssl_env_free(&env);
+    handlers_teardown();
+}
+
+void test_handlers_subscribe_end() {
+    handlers_setup("");
+    mock_ssl_env_t env;
+    assert(mock_ssl_env_init(&env));
+    handler_conn_t a;
+    handler_connect(&env, &a);
+    SSL *ssl = a.conn.client;
+
+    size_t before = notify_bus_subscriber_count();
+    RequestHeader req = { .command = CMD_SUBSCRIBE };
+    ResponseHeader resp;
+    assert(proto_send_all(ssl, &req, sizeof(req)) == 0);
+    assert(proto_recv_all(ssl, &resp, sizeof(resp)) == 0 && resp.status == RESP_SUCCESS);
+    while (notify_bus_subscriber_count() == before) usleep(1000);
+
+    NotifyMessage note = { .type = NOTIFY_FILE_UPLOADED, .filesize = 42, .flags = 0x01 };
+    assert(notify_bus_publish(&note, "") == 1);
+    assert(proto_recv_all(ssl, &note, sizeof(note)) == 0);
+    assert(note.type == NOTIFY_FILE_UPLOADED && note.filesize == 42);
+
+    // Следующий запрос: до его ответа — только уведомления и NOTIFY_END
+    req.command = CMD_UNKNOWN;
+    assert(proto_send_all(ssl, &req, sizeof(req)) == 0);
+    do {
+        assert(proto_recv_all(ssl, &note, sizeof(note)) == 0);
+        assert(note.type == NOTIFY_KEEPALIVE || note.type == NOTIFY_END);
+    } while (note.type != NOTIFY_END);
+    assert(proto_recv_all(ssl, &resp, sizeof(resp)) == 0 && resp.status == RESP_UNKNOWN_COMMAND);
+    assert(notify_bus_subscriber_count() == before);
+
+    handler_close(&a);
+    mock_ssl_env_free(&env);
+    handlers_teardown();
+}
+
+void test_handlers_cached_download_disconnect() {
+    handlers_setup("");
+    mock_ssl_env_t env;
+    assert(mock_ssl_env_init(&env));
+    handler_conn_t a;
+    handler_connect(&env, &a);
+
+    size_t len = 1024 * 1024;
+    uint8_t hash[BLAKE3_HASH_LEN];
+    uint8_t *data = handler_payload(len, 1, hash);
+    int status = -1;
+    assert(proto_upload(a.conn.client, "cached.bin", data, len, hash, NULL, &status) == 0);
+
+    // Первое скачивание заполняет кэш, второе отдаётся из него
+    assert(handler_download_matches(a.conn.client, "cached.bin", data, len));
+    assert(handler_download_matches(a.conn.client, "cached.bin", data, len));
+    chunk_cache_stats_t st;
+    chunk_cache_stats(g_chunks, &st);
+    assert(st.hits == 16);
+
+    char fingerprint[FINGERPRINT_LEN];
+    assert(mock_ssl_fingerprint(a.conn.server, fingerprint));
+    meta_file_t meta;
+    meta_error_t error;
+    assert(meta_find_latest(g_meta, "cached.bin", fingerprint, &meta, &error) == 1);
+    char path[PATH_MAX];
+    assert(object_store_path(g_objects, meta.object_id, path, sizeof(path)));
+    // Событие пишется после отправки: считаем, когда поток сервера завершён
+    handler_close(&a);
+    assert(meta_mem_event_count(g_meta, path) == 3);
+
+    // Клиент отключился сразу после запроса: отправка из кэша прерывается,
+    // события успешного скачивания нет
+    handler_conn_t b;
+    handler_connect(&env, &b);
+    RequestHeader req = { .command = CMD_DOWNLOAD };
+    snprintf(req.filename, sizeof(req.filename), "cached.bin");
+    assert(SSL_write(b.conn.client, &req, sizeof(req)) == sizeof(req));
+    handler_close(&b);
+    assert(meta_mem_event_count(g_meta, path) == 3);
+
+    free(data);
+    mock_ssl_env_free(&env);
+    handlers_teardown();
+}
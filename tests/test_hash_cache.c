@@ -0,0 +1,84 @@
+// test_hash_cache.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/core/hash_cache.h"
+
+void test_hash_cache_persist() {
+    char dir[] = "/tmp/hash_cache_XXXXXX";
+    assert(mkdtemp(dir));
+    char path[512];
+    snprintf(path, sizeof(path), "%s/cache", dir);
+
+    uint8_t h1[HASH_SIZE], h2[HASH_SIZE], out[HASH_SIZE];
+    memset(h1, 0x11, sizeof(h1));
+    memset(h2, 0x22, sizeof(h2));
+
+    hash_cache_t *hc = hash_cache_open(path, 0);
+    assert(hc);
+    assert(!hash_cache_lookup(hc, 1, 100, 10, 1000, out));
+    hash_cache_store(hc, 1, 100, 10, 1000, h1);
+    hash_cache_store(hc, 1, 200, 20, 2000, h1);
+    // Файл изменился: новая запись для того же inode замещает старую
+    hash_cache_store(hc, 1, 100, 11, 1100, h2);
+
+    assert(hash_cache_lookup(hc, 1, 200, 20, 2000, out) && memcmp(out, h1, HASH_SIZE) == 0);
+    assert(!hash_cache_lookup(hc, 1, 100, 10, 1000, out));
+    assert(!hash_cache_lookup(hc, 2, 200, 20, 2000, out)); // другое устройство
+    hash_cache_close(hc);
+
+    // После перезапуска действуют последние записи журнала
+    hc = hash_cache_open(path, 0);
+    assert(hc);
+    hash_cache_stats_t st = hash_cache_get_stats(hc);
+    assert(st.entries == 2);
+    assert(hash_cache_lookup(hc, 1, 100, 11, 1100, out) && memcmp(out, h2, HASH_SIZE) == 0);
+    assert(hash_cache_lookup(hc, 1, 200, 20, 2000, out) && memcmp(out, h1, HASH_SIZE) == 0);
+    hash_cache_close(hc);
+
+    // Оборванная запись в конце журнала не мешает загрузке
+    FILE *fp = fopen(path, "a");
+    assert(fp);
+    fputs("torn", fp);
+    fclose(fp);
+    hc = hash_cache_open(path, 0);
+    assert(hc);
+    assert(hash_cache_get_stats(hc).entries == 2);
+    hash_cache_close(hc);
+
+    // Повторы не пишутся, перезаписи одних и тех же inode уплотняются на ходу
+    hc = hash_cache_open(path, 0);
+    assert(hc);
+    uint64_t records = hash_cache_get_stats(hc).log_records;
+    hash_cache_store(hc, 1, 200, 20, 2000, h1);
+    assert(hash_cache_get_stats(hc).log_records == records);
+    for (int64_t i = 0; i < 10000; i++) {
+        hash_cache_store(hc, 1, 300 + (uint64_t)(i % 8), i, i, h2);
+    }
+    st = hash_cache_get_stats(hc);
+    assert(st.entries == 10);
+    assert(st.log_records < 4096 + 10);
+    hash_cache_close(hc);
+    hc = hash_cache_open(path, 0);
+    assert(hash_cache_get_stats(hc).entries == 10);
+    assert(hash_cache_lookup(hc, 1, 307, 9999, 9999, out));
+    hash_cache_close(hc);
+
+    snprintf(path, sizeof(path), "rm -rf %s", dir);
+    assert(system(path) == 0);
+}
+
+void test_hash_cache_limit() {
+    uint8_t h[HASH_SIZE] = {0}, out[HASH_SIZE];
+    hash_cache_t *hc = hash_cache_open(NULL, 100);
+    assert(hc);
+    for (uint64_t ino = 1; ino <= 250; ino++) {
+        hash_cache_store(hc, 1, ino, 1, 1, h);
+    }
+    assert(hash_cache_get_stats(hc).entries <= 100);
+    assert(hash_cache_lookup(hc, 1, 250, 1, 1, out));
+    hash_cache_close(hc);
+}
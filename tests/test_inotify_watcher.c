@@ -0,0 +1,196 @@
+// test_inotify_watcher.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/core/inotify_watcher.h"
+
+typedef struct {
+    char log[4096];
+    int overflows;
+} sink_log_t;
+
+static void log_append(sink_log_t *l, const char *kind, const char *path, uint32_t cookie) {
+    // Пути в журнале — относительно временного корня, поэтому только имя после последнего '/'
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    size_t len = strlen(l->log);
+    snprintf(l->log + len, sizeof(l->log) - len, "%s %s%s;", kind, name, cookie ? " paired" : "");
+}
+
+static void on_modified(void *ctx, const char *path, uint64_t now_ns) {
+    (void)now_ns;
+    log_append(ctx, "modified", path, 0);
+}
+
+static void on_deleted(void *ctx, const char *path, uint64_t now_ns) {
+    (void)now_ns;
+    log_append(ctx, "deleted", path, 0);
+}
+
+static void on_moved_from(void *ctx, const char *path, uint32_t cookie, uint64_t now_ns) {
+    (void)now_ns;
+    log_append(ctx, "moved_from", path, cookie);
+}
+
+static void on_moved_to(void *ctx, const char *path, uint32_t cookie, uint64_t now_ns) {
+    (void)now_ns;
+    log_append(ctx, "moved_to", path, cookie);
+}
+
+// Последние два компонента пути: для переименованных целиком каталогов
+// важно и имя каталога
+static const char *dir_and_name(const char *path) {
+    const char *p = strrchr(path, '/');
+    while (p > path && p[-1] != '/') p--;
+    return p;
+}
+
+static void on_renamed(void *ctx, const char *old_path, const char *path, uint64_t now_ns) {
+    (void)now_ns;
+    sink_log_t *l = ctx;
+    size_t len = strlen(l->log);
+    snprintf(l->log + len, sizeof(l->log) - len, "renamed %s -> %s;",
+             dir_and_name(old_path), dir_and_name(path));
+}
+
+static void on_subtree_removed(void *ctx, const char *dir, uint64_t now_ns) {
+    (void)now_ns;
+    log_append(ctx, "subtree_removed", dir, 0);
+}
+
+static void on_overflow(void *ctx) {
+    ((sink_log_t *)ctx)->overflows++;
+}
+
+static const watcher_sink_t sink = {
+    .modified = on_modified,
+    .deleted = on_deleted,
+    .moved_from = on_moved_from,
+    .moved_to = on_moved_to,
+    .renamed = on_renamed,
+    .subtree_removed = on_subtree_removed,
+    .overflow = on_overflow,
+};
+
+static void write_file(const char *path) {
+    FILE *fp = fopen(path, "w");
+    assert(fp);
+    fputs("data", fp);
+    fclose(fp);
+}
+
+// Один и тот же сценарий для обоих бэкендов
+static void run_scenario(watcher_t *w, const char *root, sink_log_t *l) {
+    char a[512], b[512], sub[512], c[512];
+    snprintf(a, sizeof(a), "%s/a", root);
+    snprintf(b, sizeof(b), "%s/b", root);
+    snprintf(sub, sizeof(sub), "%s/sub", root);
+    snprintf(c, sizeof(c), "%s/sub/c", root);
+
+    write_file(a);
+    assert(rename(a, b) == 0);
+    assert(unlink(b) == 0);
+    assert(watcher_process(w));
+    assert(strcmp(l->log, "modified a;moved_from a paired;moved_to b paired;deleted b;") == 0);
+
+    // Файл в новом каталоге: либо событие, либо догоняющее при постановке наблюдения
+    l->log[0] = '\0';
+    assert(mkdir(sub, 0755) == 0);
+    write_file(c);
+    assert(watcher_process(w));
+    assert(strcmp(l->log, "modified c;") == 0);
+
+    // Каталог переименован внутри дерева: его файлы — парами
+    char moved[512], moved_c[512], outside[512];
+    snprintf(moved, sizeof(moved), "%s/moved", root);
+    snprintf(moved_c, sizeof(moved_c), "%s/moved/c", root);
+    snprintf(outside, sizeof(outside), "%s.outside", root);
+    l->log[0] = '\0';
+    assert(rename(sub, moved) == 0);
+    assert(watcher_process(w));
+    assert(strcmp(l->log, "renamed sub/c -> moved/c;") == 0);
+
+    // Ушёл из дерева: получатель сам удаляет записанное под ним
+    l->log[0] = '\0';
+    assert(rename(moved, outside) == 0);
+    assert(watcher_process(w));
+    assert(strcmp(l->log, "subtree_removed moved;") == 0);
+
+    // Вернулся снаружи: файлы приходят как moved_to
+    l->log[0] = '\0';
+    assert(rename(outside, sub) == 0);
+    assert(watcher_process(w));
+    assert(strcmp(l->log, "moved_to c;") == 0);
+
+    unlink(c);
+    rmdir(sub);
+    rmdir(root);
+}
+
+void test_watcher_inotify() {
+    char root[] = "/tmp/watcher_XXXXXX";
+    assert(mkdtemp(root));
+
+    sink_log_t l = {0};
+    watcher_t *w = watcher_open(WATCHER_INOTIFY, root, &sink, &l, NULL);
+    assert(w);
+    assert(watcher_backend(w) == WATCHER_INOTIFY);
+    assert(watcher_fd(w) >= 0);
+
+    run_scenario(w, root, &l);
+    assert(l.overflows == 0);
+    watcher_close(w);
+}
+
+void test_watcher_fanotify() {
+    char root[] = "/tmp/watcher_XXXXXX";
+    assert(mkdtemp(root));
+
+    sink_log_t l = {0};
+    int err = 0;
+    watcher_t *w = watcher_open(WATCHER_FANOTIFY, root, &sink, &l, &err);
+    if (!w) {
+        // Без CAP_SYS_ADMIN или на ядре без FAN_REPORT_DFID_NAME
+        printf("    skipped: %s\n", strerror(err));
+        rmdir(root);
+        return;
+    }
+
+    // Метка на всю ФС: события вне корня отбрасываются
+    char outside[] = "/tmp/watcher_outside_XXXXXX";
+    int fd = mkstemp(outside);
+    assert(fd >= 0);
+    close(fd);
+    unlink(outside);
+    assert(watcher_process(w));
+    assert(l.log[0] == '\0');
+
+    run_scenario(w, root, &l);
+    watcher_stats_t st = watcher_get_stats(w);
+    assert(st.outside_root > 0);
+    assert(st.handle_cache_hits > 0);
+
+    // Переименование чужого каталога не вымывает кэш дескрипторов
+    assert(mkdir(root, 0700) == 0);
+    char a[512], dir_a[] = "/tmp/watcher_churn_XXXXXX", dir_b[64];
+    snprintf(a, sizeof(a), "%s/a", root);
+    snprintf(dir_b, sizeof(dir_b), "%s.b", dir_a);
+    write_file(a);
+    assert(watcher_process(w));
+    assert(mkdtemp(dir_a));
+    assert(watcher_process(w));
+    uint64_t misses = watcher_get_stats(w).handle_cache_misses;
+    assert(rename(dir_a, dir_b) == 0);
+    assert(rmdir(dir_b) == 0);
+    write_file(a);
+    assert(watcher_process(w));
+    assert(watcher_get_stats(w).handle_cache_misses == misses);
+    unlink(a);
+    rmdir(root);
+    watcher_close(w);
+}
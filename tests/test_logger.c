@@ -0,0 +1,74 @@
+// test_logger.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/utils/logger.h"
+
+#define LOG_THREADS 4
+#define LOG_LINES   500
+
+static int g_evaluated;
+
+static int count_evaluation(void) {
+    return ++g_evaluated;
+}
+
+static void *log_thread(void *arg) {
+    int id = (int)(intptr_t)arg;
+    for (int i = 0; i < LOG_LINES; i++) {
+        logger(LOG_INFO, "thread %d line %d", id, i);
+        logger(LOG_DEBUG, "filtered %d", count_evaluation());
+        if (i % 64 == 0) usleep(1000);
+    }
+    return NULL;
+}
+
+void test_logger_threads() {
+    char path[] = "/tmp/logger_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    assert(log_init(path, LOG_INFO));
+    pthread_t threads[LOG_THREADS];
+    for (int t = 0; t < LOG_THREADS; t++) {
+        assert(pthread_create(&threads[t], NULL, log_thread, (void *)(intptr_t)t) == 0);
+    }
+    for (int t = 0; t < LOG_THREADS; t++) pthread_join(threads[t], NULL);
+    log_shutdown();
+
+    // Отфильтрованные строки даже не вычисляют аргументы
+    assert(g_evaluated == 0);
+
+    log_stats_t st = log_get_stats();
+    assert(st.written + st.dropped == LOG_THREADS * LOG_LINES);
+
+    // Каждая строка целая, порядок внутри потока сохранён
+    FILE *fp = fopen(path, "r");
+    assert(fp);
+    int next[LOG_THREADS] = {0};
+    uint64_t lines = 0;
+    bool drop_notice = false;
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        assert(line[0] == '[' && line[strlen(line) - 1] == '\n');
+        int id, n;
+        const char *msg = strstr(line, "] [INFO] ");
+        if (msg && sscanf(msg, "] [INFO] thread %d line %d", &id, &n) == 2) {
+            assert(id >= 0 && id < LOG_THREADS && n >= next[id]);
+            next[id] = n + 1;
+            lines++;
+        } else {
+            assert(strstr(line, "[WARNING] ") && strstr(line, "log lines dropped"));
+            drop_notice = true;
+        }
+    }
+    fclose(fp);
+    assert(lines == st.written);
+    assert(drop_notice == (st.dropped > 0));
+    unlink(path);
+}
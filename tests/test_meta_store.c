@@ -0,0 +1,182 @@
+// test_meta_store.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/utils/metrics.h"
+#include "mocks/mock_mongo.h"
+
+#define META_THREADS 4
+#define META_EVENTS  2000
+
+typedef struct {
+    size_t n;
+    meta_file_t files[16];
+} collected_t;
+
+static void collect(void *ctx, const meta_file_t *file) {
+    collected_t *c = ctx;
+    assert(c->n < 16);
+    c->files[c->n++] = *file;
+}
+
+static bool collect_state(void *ctx, const char *path, int64_t size, int64_t mtime_ns) {
+    (void)mtime_ns;
+    char *out = ctx;
+    char line[128];
+    snprintf(line, sizeof(line), "%s:%lld;", path, (long long)size);
+    strcat(out, line);
+    return true;
+}
+
+void test_meta_store_files() {
+    meta_store_t *s = mock_mongo_open();
+    assert(s && s->backend == META_BACKEND_MEMORY);
+
+    // Две версии a.txt у alice (вторая вставлена раньше по времени), личный
+    // файл для bob и публичный у carol
+    meta_file_t files[] = {
+        mock_mongo_file("a.txt", "alice", NULL, false, 200, 0xa2),
+        mock_mongo_file("a.txt", "alice", NULL, false, 100, 0xa1),
+        mock_mongo_file("b.txt", "alice", "bob", false, 300, 0xb1),
+        mock_mongo_file("c.txt", "carol", NULL, true, 400, 0xa1),
+    };
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        assert(meta_insert_file(s, &files[i], NULL));
+    }
+
+    meta_file_t f;
+    assert(meta_find_latest(s, "a.txt", "alice", &f, NULL) == 1);
+    assert(f.uploaded_at == 200 && f.content_hash[0] == 0xa2 && f.encrypted);
+    assert(meta_find_latest(s, "a.txt", "bob", &f, NULL) == 0);
+    assert(meta_find_latest(s, "b.txt", "bob", &f, NULL) == 1);
+    assert(meta_find_latest(s, "c.txt", "bob", &f, NULL) == 1);
+    assert(meta_find_latest(s, "missing", "alice", &f, NULL) == 0);
+
+    // $or владелец / получатель / публичный, в порядке вставки
+    collected_t c = {0};
+    assert(meta_list_visible(s, "bob", collect, &c, NULL));
+    assert(c.n == 2 && strcmp(c.files[0].filename, "b.txt") == 0 &&
+           strcmp(c.files[1].filename, "c.txt") == 0);
+
+    // STAT: по имени и по хешу, от старых к новым, без повторов
+    const char *names[] = { "a.txt", "c.txt" };
+    uint8_t hashes[2][BLAKE3_HASH_LEN];
+    memset(hashes[0], 0xa1, BLAKE3_HASH_LEN);
+    memset(hashes[1], 0xee, BLAKE3_HASH_LEN);
+    memset(&c, 0, sizeof(c));
+    assert(meta_stat_batch(s, names, 2, (const uint8_t (*)[BLAKE3_HASH_LEN])hashes, 2,
+                           "alice", collect, &c, NULL));
+    assert(c.n == 3);
+    assert(c.files[0].uploaded_at == 100 && c.files[1].uploaded_at == 200 &&
+           c.files[2].uploaded_at == 400);
+
+    // Чужие приватные файлы для STAT не существуют
+    memset(&c, 0, sizeof(c));
+    assert(meta_stat_batch(s, names, 1, NULL, 0, "bob", collect, &c, NULL));
+    assert(c.n == 0);
+
+    // Индексы переживают рост таблиц
+    for (int i = 0; i < 500; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "bulk-%d", i);
+        meta_file_t b = mock_mongo_file(name, "dave", NULL, false, 1000 + i, (uint8_t)(i | 1));
+        assert(meta_insert_file(s, &b, NULL));
+    }
+    assert(meta_find_latest(s, "bulk-321", "dave", &f, NULL) == 1 && f.uploaded_at == 1321);
+    assert(meta_find_latest(s, "a.txt", "alice", &f, NULL) == 1 && f.uploaded_at == 200);
+
+    meta_store_close(s);
+}
+
+static meta_store_t *g_event_store;
+
+static void *event_thread(void *arg) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tree/dir/worker-%d", (int)(intptr_t)arg);
+    meta_state_t st = { .exists = true, .size = 1, .mtime_ns = 1 };
+    meta_event_t ev = { .type = "modified", .status = "success", .state = &st };
+    for (int i = 0; i < META_EVENTS; i++) {
+        uint64_t seq = 0;
+        assert(meta_append_event(g_event_store, path, &ev, &seq, NULL));
+        assert(seq == (uint64_t)i + 1);
+    }
+    return NULL;
+}
+
+void test_meta_store_events() {
+    meta_store_t *s = mock_mongo_open();
+
+    meta_state_t present = { .exists = true, .size = 10, .mtime_ns = 5 };
+    meta_state_t gone = { .exists = false };
+    meta_event_t created = { .type = "created", .status = "success", .state = &present };
+    meta_event_t deleted = { .type = "deleted", .status = "n/a", .state = &gone };
+    meta_event_t upload = { .type = "upload", .status = "success" };
+
+    assert(meta_append_event(s, "/tree/b", &created, NULL, NULL));
+    assert(meta_append_event(s, "/tree/a", &created, NULL, NULL));
+    assert(meta_append_event(s, "/tree/d", &created, NULL, NULL));
+    assert(meta_append_event(s, "/tree/d", &deleted, NULL, NULL));
+    assert(meta_append_event(s, "/tree/legacy", &upload, NULL, NULL)); // без state
+    assert(meta_append_event(s, "/tree0/x", &created, NULL, NULL));
+    assert(meta_append_event(s, "/tre/y", &created, NULL, NULL));
+    assert(meta_mem_event_count(s, "/tree/d") == 2);
+    assert(meta_mem_event_count(s, "/tree/none") == 0);
+
+    // Диапазон "root/" <= путь < "root0", по возрастанию пути; удалённые
+    // не приходят, документы без state — с размером -1
+    char out[512] = "";
+    assert(meta_load_states(s, "/tree", collect_state, out, NULL));
+    assert(strcmp(out, "/tree/a:10;/tree/b:10;/tree/legacy:-1;") == 0);
+
+    // Номера событий одного пути идут подряд при записи из разных потоков
+    g_event_store = s;
+    pthread_t th[META_THREADS];
+    for (int i = 0; i < META_THREADS; i++) {
+        assert(pthread_create(&th[i], NULL, event_thread, (void *)(intptr_t)i) == 0);
+    }
+    for (int i = 0; i < META_THREADS; i++) pthread_join(th[i], NULL);
+    assert(meta_mem_event_count(s, "/tree/dir/worker-0") == META_EVENTS);
+
+    meta_store_close(s);
+}
+
+void test_meta_store_faults() {
+    meta_mem_options_t o;
+    assert(meta_mem_parse_options("latency_us=300,jitter_us=50,fail_every=3,fail_ops=insert+find", &o));
+    assert(o.latency_us == 300 && o.jitter_us == 50 && o.fail_every == 3);
+    assert(o.fail_ops == ((1u << META_OP_INSERT) | (1u << META_OP_FIND)));
+    assert(meta_mem_parse_options("", &o) && o.latency_us == 0 && o.fail_ops == 0);
+    assert(!meta_mem_parse_options("latency=1", &o));
+    assert(!meta_mem_parse_options("fail_ops=delete", &o));
+    assert(!meta_mem_parse_options("fail_every=-1", &o));
+
+    meta_backend_t b;
+    assert(meta_parse_backend("memory", &b) && b == META_BACKEND_MEMORY);
+    assert(meta_parse_backend("mongo", &b) && b == META_BACKEND_MONGO);
+    assert(!meta_parse_backend("sqlite", &b));
+
+    // Отказывает каждая вторая вставка; поиск не затронут
+    meta_store_t *s = mock_mongo_open_failing(2, 1u << META_OP_INSERT);
+    meta_file_t f = mock_mongo_file("x", "alice", NULL, true, 1, 0x11);
+    meta_error_t err = {{0}};
+    assert(meta_insert_file(s, &f, &err));
+    assert(!meta_insert_file(s, &f, &err));
+    assert(strstr(err.message, "insert"));
+    assert(meta_insert_file(s, &f, &err));
+
+    collected_t c = {0};
+    assert(meta_list_visible(s, "bob", collect, &c, NULL) && c.n == 2);
+    meta_store_close(s);
+
+    // Задержка выдерживается на каждой операции
+    o = (meta_mem_options_t){ .latency_us = 2000 };
+    s = meta_store_open_memory(&o);
+    uint64_t started = metrics_now_ns();
+    meta_file_t out;
+    assert(meta_find_latest(s, "x", "alice", &out, NULL) == 0);
+    assert(metrics_now_ns() - started >= 2000000);
+    meta_store_close(s);
+}
@@ -0,0 +1,129 @@
+// test_metrics.c
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../src/net/metrics_http.h"
+#include "../src/utils/metrics.h"
+
+#define METRIC_THREADS 8
+#define METRIC_ADDS    100000
+
+static metric_id_t g_test_counter;
+static metric_id_t g_test_gauge;
+
+static void *add_thread(void *arg) {
+    (void)arg;
+    for (int i = 0; i < METRIC_ADDS; i++) {
+        metrics_inc(g_test_counter);
+        metrics_gauge_add(g_test_gauge, -1);
+    }
+    return NULL;
+}
+
+void test_metrics_registry() {
+    g_test_counter = metrics_counter("test_ops_total", "kind=\"a\"", "Test operations");
+    g_test_gauge = metrics_gauge("test_level", NULL, "Test level");
+    metric_id_t other = metrics_counter("test_other_total", NULL, "Other");
+    metric_id_t second = metrics_counter("test_ops_total", "kind=\"b\"", "Test operations");
+    metric_id_t latency = metrics_histogram("test_latency_seconds", NULL, "Test latency",
+                                            METRICS_UNIT_NANOSECONDS);
+    assert(g_test_counter >= 0 && g_test_gauge >= 0 && other >= 0 && second >= 0 && latency >= 0);
+
+    // Запись из многих потоков не теряется, датчик уходит в минус
+    pthread_t th[METRIC_THREADS];
+    for (int i = 0; i < METRIC_THREADS; i++) {
+        assert(pthread_create(&th[i], NULL, add_thread, NULL) == 0);
+    }
+    for (int i = 0; i < METRIC_THREADS; i++) pthread_join(th[i], NULL);
+    assert(metrics_counter_value(g_test_counter) == METRIC_THREADS * METRIC_ADDS);
+    assert(metrics_gauge_value(g_test_gauge) == -METRIC_THREADS * METRIC_ADDS);
+    metrics_add(second, 7);
+    metrics_add(-1, 7); // незарегистрированная метрика молча игнорируется
+
+    // Перцентиль — верхняя граница корзины, погрешность не больше 12.5%
+    for (uint64_t v = 1; v <= 1000; v++) metrics_observe(latency, v * 1000);
+    assert(metrics_histogram_count(latency) == 1000);
+    uint64_t p50 = metrics_histogram_percentile(latency, 50);
+    uint64_t p99 = metrics_histogram_percentile(latency, 99);
+    assert(p50 >= 500000 && p50 <= 500000 * 9 / 8);
+    assert(p99 >= 990000 && p99 <= 990000 * 9 / 8);
+    assert(metrics_histogram_percentile(latency, 100) >= 1000000);
+
+    size_t len = 0;
+    char *text = metrics_render(&len);
+    assert(text && len == strlen(text));
+    // Метрики одного семейства идут подряд под одним HELP/TYPE
+    char *a = strstr(text, "test_ops_total{kind=\"a\"} 800000\n");
+    char *b = strstr(text, "test_ops_total{kind=\"b\"} 7\n");
+    char *o = strstr(text, "# TYPE test_other_total counter");
+    assert(a && b && o && a < b && b < o);
+    assert(strstr(text, "# HELP test_ops_total Test operations\n# TYPE test_ops_total counter\n"));
+    assert(strstr(text, "test_level -800000\n"));
+    assert(strstr(text, "# TYPE test_latency_seconds histogram"));
+    assert(strstr(text, "test_latency_seconds_bucket{le=\"+Inf\"} 1000\n"));
+    assert(strstr(text, "test_latency_seconds_count 1000\n"));
+    assert(strstr(text, "test_latency_seconds_sum 0.5005\n"));
+    free(text);
+}
+
+// Читает ответ точки сбора целиком; сервер закрывает соединение сам
+static char *http_get(uint16_t port, const char *path) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    assert(fd >= 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    char req[256];
+    int n = snprintf(req, sizeof(req), "GET %s HTTP/1.0\r\nHost: localhost\r\n\r\n", path);
+    assert(send(fd, req, (size_t)n, MSG_NOSIGNAL) == n);
+
+    size_t len = 0, cap = 65536;
+    char *buf = malloc(cap);
+    assert(buf);
+    for (;;) {
+        ssize_t r = recv(fd, buf + len, cap - 1 - len, 0);
+        assert(r >= 0);
+        if (r == 0) break;
+        len += (size_t)r;
+        if (len + 1 == cap) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+            assert(buf);
+        }
+    }
+    buf[len] = '\0';
+    close(fd);
+    return buf;
+}
+
+void test_metrics_http() {
+    metric_id_t hits = metrics_counter("test_http_hits_total", NULL, "Hits");
+    metrics_add(hits, 3);
+
+    int err = 0;
+    assert(metrics_http_start(0, &err));
+    uint16_t port = metrics_http_port();
+    assert(port != 0);
+
+    char *resp = http_get(port, "/metrics");
+    assert(strncmp(resp, "HTTP/1.0 200", 12) == 0);
+    assert(strstr(resp, "text/plain; version=0.0.4"));
+    assert(strstr(resp, "\r\n\r\n# HELP "));
+    assert(strstr(resp, "test_http_hits_total 3\n"));
+    free(resp);
+
+    resp = http_get(port, "/other");
+    assert(strncmp(resp, "HTTP/1.0 404", 12) == 0);
+    free(resp);
+
+    metrics_http_stop();
+    assert(metrics_http_port() == 0);
+}
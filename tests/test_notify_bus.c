@@ -0,0 +1,75 @@
+// test_notify_bus.c
+#include <assert.h>
+#include <poll.h>
+#include <string.h>
+#include "../src/net/notify_bus.h"
+
+static const char *fp_a = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+static const char *fp_b = "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb";
+
+static bool notify_ready(notify_subscriber_t *sub) {
+    struct pollfd pfd = { .fd = notify_subscriber_fd(sub), .events = POLLIN };
+    return poll(&pfd, 1, 0) == 1;
+}
+
+static NotifyMessage notify_note(long long n, bool is_public) {
+    NotifyMessage msg = { .type = NOTIFY_FILE_UPLOADED, .filesize = n, .flags = is_public ? 0x01 : 0x00 };
+    return msg;
+}
+
+void test_notify_bus_fanout() {
+    size_t before = notify_bus_subscriber_count();
+    notify_subscriber_t *a = notify_bus_subscribe(fp_a);
+    notify_subscriber_t *b = notify_bus_subscribe(fp_b);
+    assert(a && b && notify_bus_subscriber_count() == before + 2);
+    assert(!notify_ready(a) && !notify_ready(b));
+
+    // Адресное — только получателю, без получателя — никому
+    NotifyMessage msg = notify_note(1, false);
+    assert(notify_bus_publish(&msg, fp_a) == 1);
+    assert(notify_bus_publish(&msg, "") == 0);
+    assert(notify_ready(a) && !notify_ready(b));
+
+    // Публичное — всем, получатель не важен
+    msg = notify_note(2, true);
+    assert(notify_bus_publish(&msg, fp_a) == 2);
+
+    NotifyMessage out[4];
+    bool overflowed = true;
+    assert(notify_subscriber_drain(a, out, 4, &overflowed) == 2 && !overflowed);
+    assert(out[0].filesize == 1 && out[1].filesize == 2);
+    assert(notify_subscriber_drain(b, out, 4, &overflowed) == 1 && out[0].filesize == 2);
+    assert(!notify_ready(a) && !notify_ready(b));
+
+    notify_bus_unsubscribe(a);
+    notify_bus_unsubscribe(b);
+    assert(notify_bus_subscriber_count() == before);
+}
+
+void test_notify_bus_overflow() {
+    notify_subscriber_t *a = notify_bus_subscribe(fp_a);
+    assert(a);
+
+    // Сверх ёмкости очереди события не ставятся, но помечаются
+    for (long long i = 0; i < NOTIFY_QUEUE_CAP + 5; i++) {
+        NotifyMessage msg = notify_note(i, false);
+        assert(notify_bus_publish(&msg, fp_a) == (i < NOTIFY_QUEUE_CAP ? 1u : 0u));
+    }
+
+    // Больше max в очереди: eventfd взводится снова, пока не разобрано всё
+    static NotifyMessage out[NOTIFY_QUEUE_CAP];
+    size_t total = 0;
+    bool overflowed = false, seen = false;
+    while (notify_ready(a)) {
+        size_t n = notify_subscriber_drain(a, out + total, 100, &overflowed);
+        seen = seen || overflowed;
+        total += n;
+        assert(n == 100 || total == NOTIFY_QUEUE_CAP);
+    }
+    assert(total == NOTIFY_QUEUE_CAP && seen);
+    for (size_t i = 0; i < total; i++) assert(out[i].filesize == (long long)i);
+
+    // Флаг сбрасывается прочтением
+    assert(notify_subscriber_drain(a, out, 1, &overflowed) == 0 && !overflowed);
+    notify_bus_unsubscribe(a);
+}
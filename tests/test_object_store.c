@@ -0,0 +1,260 @@
+// test_object_store.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <ftw.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/storage/buffer_pool.h"
+#include "../src/storage/layout_migrate.h"
+#include "../src/storage/object_store.h"
+#include "mocks/mock_mongo.h"
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    return type == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static void write_file(const char *root, const char *name, const char *data) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    FILE *fp = fopen(path, "w");
+    assert(fp);
+    fputs(data, fp);
+    fclose(fp);
+}
+
+static bool exists(const char *root, const char *name) {
+    char path[512];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    return stat(path, &st) == 0;
+}
+
+static void count_error(const char *name, const char *message, void *ctx) {
+    (void)name;
+    assert(message[0]);
+    (*(int *)ctx)++;
+}
+
+void test_object_store_layout() {
+    char root[] = "/tmp/object_store_XXXXXX";
+    assert(mkdtemp(root));
+    object_store_options_t opts;
+    object_store_options_default(&opts);
+    opts.pack_max = 0; // проверяется раскладка файлов
+    int err = 0;
+    object_store_t *s = object_store_open(root, &opts, &err);
+    assert(s);
+
+    char id[OBJECT_ID_LEN], other[OBJECT_ID_LEN];
+    assert(object_id_generate(id) && object_id_generate(other));
+    assert(object_id_valid(id) && strcmp(id, other) != 0);
+    assert(!object_id_valid("0123") && !object_id_valid("../../etc/passwd"));
+    char upper[OBJECT_ID_LEN];
+    memcpy(upper, id, sizeof(upper));
+    upper[0] = 'A';
+    assert(!object_id_valid(upper));
+
+    // root/xx/yy/<id>: каталоги веера появляются при первой записи
+    char path[512], expected[512];
+    assert(object_store_path(s, id, path, sizeof(path)));
+    snprintf(expected, sizeof(expected), "%s/%.2s/%.2s/%s", root, id, id + 2, id);
+    assert(strcmp(path, expected) == 0);
+    assert(object_store_put(s, id, "cipher", 6, &err));
+    struct stat st;
+    assert(stat(expected, &st) == 0 && st.st_size == 6);
+
+    // Файл пишется безымянным: в каталоге веера нет ничего, кроме объекта
+    snprintf(expected, sizeof(expected), "%s/%.2s/%.2s", root, id, id + 2);
+    DIR *dir = opendir(expected);
+    assert(dir);
+    size_t entries = 0;
+    for (struct dirent *de; (de = readdir(dir));) {
+        if (strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+            assert(strcmp(de->d_name, id) == 0);
+            entries++;
+        }
+    }
+    closedir(dir);
+    assert(entries == 1);
+
+    size_t len = 0;
+    uint8_t *data = object_store_read(s, id, &len, &err);
+    assert(data && len == 6 && memcmp(data, "cipher", 6) == 0);
+    free(data);
+
+    // Объект неизменяем; отсутствующий — ENOENT
+    assert(!object_store_put(s, id, "x", 1, &err) && err == EEXIST);
+    assert(!object_store_read(s, other, &len, &err) && err == ENOENT);
+    assert(!object_store_read(s, "nothex", &len, &err) && err == EINVAL);
+
+    // Плоская раскладка: только имена без '/'
+    write_file(root, "legacy.txt", "flat");
+    data = object_store_read_flat(s, "legacy.txt", &len, &err);
+    assert(data && len == 4 && memcmp(data, "flat", 4) == 0);
+    free(data);
+    assert(!object_store_read_flat(s, "../legacy.txt", &len, &err) && err == EINVAL);
+    assert(!object_store_read_flat(s, "..", &len, &err) && err == EINVAL);
+
+    // Пустой объект — тоже файл: при pack_max=0 в пачки не пишется
+    assert(object_store_put(s, other, "", 0, &err));
+    assert(object_store_path(s, other, path, sizeof(path)) && stat(path, &st) == 0 && st.st_size == 0);
+    data = object_store_read(s, other, &len, &err);
+    assert(data && len == 0);
+    free(data);
+
+    assert(object_store_remove(s, id, &err));
+    assert(!object_store_remove(s, id, &err) && err == ENOENT);
+
+    object_store_close(s);
+    assert(nftw(root, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+}
+
+void test_object_store_migrate() {
+    char root[] = "/tmp/layout_migrate_XXXXXX";
+    assert(mkdtemp(root));
+    object_store_options_t store_opts;
+    object_store_options_default(&store_opts);
+    store_opts.no_pack = true;
+    int err = 0;
+    object_store_t *s = object_store_open(root, &store_opts, &err);
+    assert(s);
+    meta_store_t *meta = mock_mongo_open();
+    meta_error_t error;
+
+    // "a" загружали дважды: на диске шифротекст второй загрузки. Третья
+    // загрузка уже новым сервером — с object_id, её перенос не трогает
+    meta_file_t a1 = mock_mongo_file("a", "owner", NULL, true, 1, 0);
+    meta_file_t a2 = mock_mongo_file("a", "owner", NULL, true, 2, 0);
+    meta_file_t a3 = mock_mongo_file("a", "owner", NULL, true, 3, 0);
+    assert(object_id_generate(a3.object_id));
+    meta_file_t b = mock_mongo_file("b", "owner", NULL, true, 1, 0);
+    assert(meta_insert_file(meta, &a1, &error) && meta_insert_file(meta, &a2, &error) &&
+           meta_insert_file(meta, &a3, &error) && meta_insert_file(meta, &b, &error));
+    write_file(root, "a", "second");
+    write_file(root, "b", "bee");
+    write_file(root, "orphan", "nobody");
+    write_file(root, ".hidden", "skip");
+
+    layout_migrate_options_t opts;
+    layout_migrate_options_default(&opts);
+    opts.batch = 1;
+    opts.grace_ms = 0;
+    layout_migrate_report_t report;
+
+    opts.dry_run = true;
+    assert(layout_migrate(s, meta, &opts, &report, &err));
+    assert(report.scanned == 3 && report.migrated == 0 && exists(root, "a"));
+
+    opts.dry_run = false;
+    assert(layout_migrate(s, meta, &opts, &report, &err));
+    assert(report.scanned == 3 && report.migrated == 2 && report.orphaned == 1);
+    assert(report.failed == 0 && report.already_linked == 0);
+    assert(!exists(root, "a") && !exists(root, "b"));
+    assert(exists(root, "orphan") && exists(root, ".hidden"));
+
+    // Самая свежая видимая загрузка "a" по-прежнему третья; вторая
+    // получила id со старым шифротекстом
+    meta_file_t found;
+    assert(meta_find_latest(meta, "a", "viewer", &found, &error) == 1);
+    assert(found.uploaded_at == 3 && strcmp(found.object_id, a3.object_id) == 0);
+    assert(meta_claim_legacy(meta, "a", a3.object_id, &error) == 1); // первая загрузка
+    assert(meta_claim_legacy(meta, "a", a3.object_id, &error) == 0);
+
+    assert(meta_find_latest(meta, "b", "viewer", &found, &error) == 1);
+    assert(object_id_valid(found.object_id));
+    size_t len = 0;
+    uint8_t *data = object_store_read(s, found.object_id, &len, &err);
+    assert(data && len == 3 && memcmp(data, "bee", 3) == 0);
+    free(data);
+
+    // Прерванный запуск: у плоского файла уже есть вторая ссылка
+    write_file(root, "c", "sea");
+    char from[512], to[512];
+    snprintf(from, sizeof(from), "%s/c", root);
+    snprintf(to, sizeof(to), "%s/c.link", root);
+    assert(link(from, to) == 0);
+    assert(layout_migrate(s, meta, &opts, &report, &err));
+    assert(report.scanned == 3 && report.already_linked == 2 && report.orphaned == 1);
+    assert(exists(root, "c") && exists(root, "c.link"));
+    meta_store_close(meta);
+
+    // Ошибка записи метаданных: ссылка убирается, плоский файл остаётся
+    meta = mock_mongo_open_failing(1, 1u << META_OP_CLAIM);
+    meta_file_t d = mock_mongo_file("d", "owner", NULL, true, 1, 0);
+    assert(meta_insert_file(meta, &d, &error));
+    assert(unlink(to) == 0 && unlink(from) == 0);
+    write_file(root, "d", "dee");
+    int errors = 0;
+    opts.on_error = count_error;
+    opts.ctx = &errors;
+    assert(layout_migrate(s, meta, &opts, &report, &err));
+    assert(report.failed == 2 && errors == 2); // "d" и "orphan"
+    struct stat st;
+    snprintf(from, sizeof(from), "%s/d", root);
+    assert(stat(from, &st) == 0 && st.st_nlink == 1);
+
+    // Без пачек пустой объект пишется файлом
+    char empty[OBJECT_ID_LEN];
+    assert(object_id_generate(empty) && object_store_put(s, empty, "", 0, &err));
+    data = object_store_read(s, empty, &len, &err);
+    assert(data && len == 0);
+    free(data);
+
+    meta_store_close(meta);
+    object_store_close(s);
+    assert(nftw(root, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+}
+
+void test_object_store_direct() {
+    // Пул: буферы выровнены по странице и переиспользуются
+    buffer_pool_t *pool = buffer_pool_create(5000, 1);
+    assert(pool && buffer_pool_size(pool) == 2 * BUFFER_POOL_ALIGN);
+    void *a = buffer_pool_get(pool), *b = buffer_pool_get(pool);
+    assert(a && b && ((uintptr_t)a % BUFFER_POOL_ALIGN) == 0 && ((uintptr_t)b % BUFFER_POOL_ALIGN) == 0);
+    buffer_pool_put(pool, a);
+    buffer_pool_put(pool, b); // сверх max_free — освобождается
+    assert(buffer_pool_get(pool) == a);
+    buffer_pool_put(pool, a);
+    buffer_pool_destroy(pool);
+
+    char root[] = "/tmp/object_direct_XXXXXX";
+    assert(mkdtemp(root));
+    object_store_options_t opts;
+    assert(object_store_parse_options("pack_max=0,direct_min=4K", &opts));
+    assert(opts.direct_min == 4096);
+    int err = 0;
+    object_store_t *s = object_store_open(root, &opts, &err);
+    assert(s);
+
+    // Несколько буферов пула, невыровненный хвост; ровно выровненный; меньше страницы
+    size_t sizes[] = { 3 * OBJECT_DIRECT_CHUNK + 2 * 4096 + 123, 8192, 4096 + 1 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint8_t *data = malloc(sizes[i]);
+        assert(data);
+        for (size_t j = 0; j < sizes[i]; j++) data[j] = (uint8_t)(j * 13 + i);
+
+        char id[OBJECT_ID_LEN], path[512];
+        assert(object_id_generate(id));
+        assert(object_store_put(s, id, data, sizes[i], &err));
+        assert(object_store_path(s, id, path, sizeof(path)));
+        struct stat st;
+        assert(stat(path, &st) == 0 && (size_t)st.st_size == sizes[i]);
+
+        size_t len = 0;
+        uint8_t *back = object_store_read(s, id, &len, &err);
+        assert(back && len == sizes[i] && memcmp(back, data, len) == 0);
+        free(back);
+        free(data);
+    }
+
+    object_store_close(s);
+    assert(nftw(root, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+}
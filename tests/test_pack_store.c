@@ -0,0 +1,295 @@
+// test_pack_store.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/storage/object_store.h"
+#include "../src/storage/pack_store.h"
+
+#define PACK_THREADS 4
+#define PACK_OPS     2000
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    return type == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static void make_id(uint32_t n, uint8_t id[PACK_ID_LEN]) {
+    // Как у настоящих id: первые байты распределены равномерно
+    uint64_t h = n * 0x9e3779b97f4a7c15ull;
+    memset(id, 0, PACK_ID_LEN);
+    memcpy(id, &h, sizeof(h));
+    memcpy(id + 8, &n, sizeof(n));
+}
+
+static void make_data(uint32_t n, uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) buf[i] = (uint8_t)(n * 31 + i);
+}
+
+static void check_object(pack_store_t *p, uint32_t n, size_t expected_len) {
+    uint8_t id[PACK_ID_LEN], want[512];
+    make_id(n, id);
+    make_data(n, want, expected_len);
+    size_t len = 0;
+    int err = 0;
+    uint8_t *data = pack_store_read(p, id, &len, &err);
+    assert(data && len == expected_len && memcmp(data, want, len) == 0);
+    free(data);
+}
+
+static size_t count_segments(int dir_fd) {
+    size_t n = 0;
+    char name[32];
+    for (uint32_t no = 0; no < 64; no++) {
+        snprintf(name, sizeof(name), "%08u.pack", no);
+        struct stat st;
+        if (fstatat(dir_fd, name, &st, 0) == 0) n++;
+    }
+    return n;
+}
+
+void test_pack_store_basic() {
+    char dir[] = "/tmp/pack_store_XXXXXX";
+    assert(mkdtemp(dir));
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    assert(dir_fd >= 0);
+
+    // Сегмент на ~4 записи по 100 байт
+    pack_options_t opts = { .segment_max = 4 * (32 + 100), .compact_pct = 50 };
+    int err = 0;
+    pack_store_t *p = pack_store_open(dir_fd, &opts, &err);
+    assert(p);
+
+    // Второй владелец тех же сегментов не допускается
+    assert(!pack_store_open(dir_fd, &opts, &err) && err == EWOULDBLOCK);
+
+    uint8_t id[PACK_ID_LEN], buf[512];
+    for (uint32_t n = 0; n < 10; n++) {
+        make_id(n, id);
+        make_data(n, buf, 100);
+        assert(pack_store_put(p, id, buf, 100, &err));
+    }
+    make_id(3, id);
+    assert(!pack_store_put(p, id, buf, 100, &err) && err == EEXIST);
+    make_id(10, id);
+    assert(pack_store_put(p, id, "", 0, &err));
+    for (uint32_t n = 0; n < 10; n++) check_object(p, n, 100);
+    check_object(p, 10, 0);
+
+    pack_stats_t st;
+    pack_store_stats(p, &st);
+    assert(st.segments == 3 && st.objects == 11 && st.dead_bytes == 0);
+    assert(count_segments(dir_fd) == 3);
+
+    make_id(2, id);
+    assert(pack_store_remove(p, id, &err));
+    assert(!pack_store_remove(p, id, &err) && err == ENOENT);
+    assert(!pack_store_read(p, id, &(size_t){0}, &err) && err == ENOENT);
+    pack_store_close(p);
+
+    // Индекс восстанавливается по заголовкам; удалённая запись не воскресает,
+    // оборванный хвост отрезается
+    char path[512];
+    snprintf(path, sizeof(path), "%s/00000002.pack", dir);
+    struct stat before;
+    assert(stat(path, &before) == 0);
+    FILE *fp = fopen(path, "a");
+    assert(fp);
+    fwrite("PKR1 torn", 1, 9, fp);
+    fclose(fp);
+
+    p = pack_store_open(dir_fd, &opts, &err);
+    assert(p);
+    struct stat after;
+    assert(stat(path, &after) == 0 && after.st_size == before.st_size);
+    pack_store_stats(p, &st);
+    assert(st.objects == 10 && st.dead_bytes == 32 + 100);
+    assert(!pack_store_read(p, id, &(size_t){0}, &err) && err == ENOENT);
+    for (uint32_t n = 0; n < 10; n++) {
+        if (n != 2) check_object(p, n, 100);
+    }
+
+    // Дописывание продолжается в последний сегмент
+    make_id(11, id);
+    make_data(11, buf, 100);
+    assert(pack_store_put(p, id, buf, 100, &err));
+    pack_store_stats(p, &st);
+    assert(st.segments == 3);
+    pack_store_close(p);
+
+    close(dir_fd);
+    assert(nftw(dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+}
+
+void test_pack_store_compact() {
+    char dir[] = "/tmp/pack_compact_XXXXXX";
+    assert(mkdtemp(dir));
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    assert(dir_fd >= 0);
+
+    pack_options_t opts = { .segment_max = 4 * (32 + 100), .compact_pct = 50 };
+    int err = 0;
+    pack_store_t *p = pack_store_open(dir_fd, &opts, &err);
+    assert(p);
+
+    uint8_t id[PACK_ID_LEN], buf[512];
+    for (uint32_t n = 0; n < 12; n++) {
+        make_id(n, id);
+        make_data(n, buf, 100);
+        assert(pack_store_put(p, id, buf, 100, &err));
+    }
+
+    // Сегмент 0: удалена одна запись из четырёх — ниже порога
+    make_id(0, id);
+    assert(pack_store_remove(p, id, &err));
+    assert(pack_store_compact(p) == 0);
+
+    // Сегмент 1: удалены две — порог достигнут; живые записи уходят в
+    // текущий сегмент 2, а заполненный закрывается
+    make_id(4, id);
+    assert(pack_store_remove(p, id, &err));
+    make_id(5, id);
+    assert(pack_store_remove(p, id, &err));
+    assert(pack_store_compact(p) == 1);
+
+    pack_stats_t st;
+    pack_store_stats(p, &st);
+    assert(st.objects == 9 && st.segments == 3);
+    assert(st.dead_bytes == 32 + 100);
+    char path[512];
+    snprintf(path, sizeof(path), "%s/00000001.pack", dir);
+    assert(access(path, F_OK) != 0);
+    for (uint32_t n = 1; n < 12; n++) {
+        if (n != 4 && n != 5) check_object(p, n, 100);
+    }
+    pack_store_close(p);
+
+    // Перенесённые записи находятся и после перезапуска
+    p = pack_store_open(dir_fd, &opts, &err);
+    assert(p);
+    pack_store_stats(p, &st);
+    assert(st.objects == 9);
+    check_object(p, 6, 100);
+    check_object(p, 7, 100);
+    pack_store_close(p);
+
+    close(dir_fd);
+    assert(nftw(dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+}
+
+typedef struct {
+    pack_store_t *p;
+    uint32_t base;
+} pack_worker_t;
+
+static void *pack_worker(void *arg) {
+    pack_worker_t *w = arg;
+    uint8_t id[PACK_ID_LEN], buf[512];
+    int err = 0;
+    for (uint32_t i = 0; i < PACK_OPS; i++) {
+        uint32_t n = w->base + i;
+        size_t len = 64 + n % 256;
+        make_id(n, id);
+        make_data(n, buf, len);
+        assert(pack_store_put(w->p, id, buf, len, &err));
+        check_object(w->p, n, len);
+        // Три из четырёх удаляются: фоновое уплотнение работает всё время
+        if (i % 4 != 0) {
+            assert(pack_store_remove(w->p, id, &err));
+        } else if (i >= 4) {
+            uint32_t prev = n - 4;
+            check_object(w->p, prev, 64 + prev % 256);
+        }
+    }
+    return NULL;
+}
+
+void test_pack_store_threads() {
+    char dir[] = "/tmp/pack_threads_XXXXXX";
+    assert(mkdtemp(dir));
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    assert(dir_fd >= 0);
+
+    pack_options_t opts = { .segment_max = 16 * 1024, .compact_pct = 50, .background = true };
+    int err = 0;
+    pack_store_t *p = pack_store_open(dir_fd, &opts, &err);
+    assert(p);
+
+    pthread_t threads[PACK_THREADS];
+    pack_worker_t workers[PACK_THREADS];
+    for (int t = 0; t < PACK_THREADS; t++) {
+        workers[t] = (pack_worker_t){ .p = p, .base = (uint32_t)t * PACK_OPS };
+        assert(pthread_create(&threads[t], NULL, pack_worker, &workers[t]) == 0);
+    }
+    for (int t = 0; t < PACK_THREADS; t++) pthread_join(threads[t], NULL);
+
+    pack_stats_t st;
+    pack_store_stats(p, &st);
+    assert(st.objects == PACK_THREADS * PACK_OPS / 4);
+    pack_store_close(p);
+
+    // После перезапуска видны ровно выжившие записи
+    p = pack_store_open(dir_fd, &opts, &err);
+    assert(p);
+    pack_store_stats(p, &st);
+    assert(st.objects == PACK_THREADS * PACK_OPS / 4);
+    for (uint32_t n = 0; n < PACK_THREADS * PACK_OPS; n += 4) check_object(p, n, 64 + n % 256);
+    pack_store_close(p);
+
+    close(dir_fd);
+    assert(nftw(dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+}
+
+void test_object_store_packed() {
+    object_store_options_t opts;
+    assert(object_store_parse_options("pack_max=1K,segment_max=1M,compact_pct=25", &opts));
+    assert(opts.pack_max == 1024 && opts.segment_max == 1u << 20 && opts.compact_pct == 25);
+    assert(object_store_parse_options("", &opts) && opts.pack_max == OBJECT_PACK_MAX_DEFAULT);
+    assert(!object_store_parse_options("pack_max=1X", &opts));
+    assert(!object_store_parse_options("compact_pct=101", &opts));
+    assert(!object_store_parse_options("unknown=1", &opts));
+
+    char root[] = "/tmp/object_packed_XXXXXX";
+    assert(mkdtemp(root));
+    assert(object_store_parse_options("pack_max=1K", &opts));
+    int err = 0;
+    object_store_t *s = object_store_open(root, &opts, &err);
+    assert(s);
+
+    // Мелкий объект — в сегменте, крупный — отдельным файлом
+    char small_id[OBJECT_ID_LEN], big_id[OBJECT_ID_LEN], path[512];
+    static uint8_t big[4096];
+    memset(big, 0xab, sizeof(big));
+    assert(object_id_generate(small_id) && object_id_generate(big_id));
+    assert(object_store_put(s, small_id, "tiny", 4, &err));
+    assert(object_store_put(s, big_id, big, sizeof(big), &err));
+    assert(!object_store_put(s, small_id, "tiny", 4, &err) && err == EEXIST);
+
+    assert(object_store_path(s, small_id, path, sizeof(path)));
+    assert(access(path, F_OK) != 0);
+    assert(object_store_path(s, big_id, path, sizeof(path)));
+    assert(access(path, F_OK) == 0);
+
+    size_t len = 0;
+    uint8_t *data = object_store_read(s, small_id, &len, &err);
+    assert(data && len == 4 && memcmp(data, "tiny", 4) == 0);
+    free(data);
+    data = object_store_read(s, big_id, &len, &err);
+    assert(data && len == sizeof(big) && memcmp(data, big, len) == 0);
+    free(data);
+
+    assert(object_store_remove(s, small_id, &err) && object_store_remove(s, big_id, &err));
+    assert(!object_store_read(s, small_id, &len, &err) && err == ENOENT);
+    assert(!object_store_read(s, big_id, &len, &err) && err == ENOENT);
+
+    object_store_close(s);
+    assert(nftw(root, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+}
@@ -0,0 +1,92 @@
+// test_reconcile.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/core/reconcile.h"
+
+typedef struct {
+    int created, modified, deleted;
+    char last_deleted[256];
+} diff_counts_t;
+
+static void count_change(void *ctx, reconcile_change_t change, const file_state_t *st) {
+    diff_counts_t *d = ctx;
+    switch (change) {
+        case RECONCILE_CREATED:  d->created++; break;
+        case RECONCILE_MODIFIED: d->modified++; break;
+        case RECONCILE_DELETED:
+            d->deleted++;
+            snprintf(d->last_deleted, sizeof(d->last_deleted), "%s", st->path);
+            break;
+    }
+}
+
+static void write_file(const char *path, const char *data) {
+    FILE *fp = fopen(path, "w");
+    assert(fp);
+    fputs(data, fp);
+    fclose(fp);
+}
+
+void test_reconcile_scan() {
+    char root[] = "/tmp/reconcile_XXXXXX";
+    assert(mkdtemp(root));
+
+    char path[512];
+    for (int i = 0; i < 5; i++) {
+        snprintf(path, sizeof(path), "%s/d%d", root, i);
+        assert(mkdir(path, 0755) == 0);
+        for (int k = 0; k < 4; k++) {
+            snprintf(path, sizeof(path), "%s/d%d/f%d", root, i, k);
+            write_file(path, "abc");
+        }
+    }
+    // Симлинки в снимок не попадают
+    snprintf(path, sizeof(path), "%s/d0/link", root);
+    assert(symlink("f0", path) == 0);
+
+    file_state_set_t actual = {0};
+    tree_walk_stats_t ws;
+    assert(reconcile_scan(root, 3, &actual, &ws) == 0);
+    assert(actual.len == 20);
+    for (size_t i = 1; i < actual.len; i++) {
+        assert(strcmp(actual.items[i - 1].path, actual.items[i].path) < 0);
+    }
+    assert(actual.items[0].size == 3);
+
+    file_state_set_free(&actual);
+    snprintf(path, sizeof(path), "rm -rf %s", root);
+    assert(system(path) == 0);
+}
+
+void test_reconcile_diff() {
+    file_state_set_t recorded = {0}, actual = {0};
+
+    assert(file_state_set_add(&recorded, "/x/same", 10, 100));
+    assert(file_state_set_add(&recorded, "/x/changed", 10, 100));
+    assert(file_state_set_add(&recorded, "/x/gone", 10, 100));
+    assert(file_state_set_add(&recorded, "/x/legacy", -1, 0));
+    assert(file_state_set_add(&recorded, "/x/same", 10, 100)); // повтор
+    file_state_set_sort(&recorded);
+    assert(recorded.len == 4);
+
+    assert(file_state_set_add(&actual, "/x/new", 1, 1));
+    assert(file_state_set_add(&actual, "/x/same", 10, 100));
+    assert(file_state_set_add(&actual, "/x/changed", 10, 200));
+    assert(file_state_set_add(&actual, "/x/legacy", 5, 5));
+    file_state_set_sort(&actual);
+
+    diff_counts_t d = {0};
+    reconcile_stats_t rs = reconcile_diff(&recorded, &actual, count_change, &d);
+    assert(d.created == 1 && rs.created == 1);
+    assert(d.modified == 2 && rs.modified == 2);
+    assert(d.deleted == 1 && strcmp(d.last_deleted, "/x/gone") == 0);
+    assert(rs.unchanged == 1);
+
+    file_state_set_free(&recorded);
+    file_state_set_free(&actual);
+}
@@ -0,0 +1,53 @@
+// test_request_trace.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../src/utils/request_trace.h"
+
+static void spin_ms(unsigned ms) {
+    struct timespec ts = { .tv_nsec = (long)ms * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+void test_request_trace() {
+    request_trace_t t;
+    trace_begin(&t, 0);
+    spin_ms(2);
+    trace_phase(&t, TRACE_RECV);
+    spin_ms(1);
+    trace_phase(&t, TRACE_MONGO);
+    spin_ms(1);
+    trace_phase(&t, TRACE_SEND);
+    // Повтор фазы складывается с прежним временем
+    spin_ms(1);
+    trace_phase(&t, TRACE_MONGO);
+    uint64_t total = trace_end(&t);
+
+    assert(trace_has_phase(&t, TRACE_RECV) && trace_has_phase(&t, TRACE_MONGO));
+    assert(!trace_has_phase(&t, TRACE_HASH));
+    assert(t.phase_ns[TRACE_RECV] >= 2000000);
+    assert(t.phase_ns[TRACE_MONGO] >= 2000000);
+    assert(total >= t.phase_ns[TRACE_RECV] + t.phase_ns[TRACE_MONGO] + t.phase_ns[TRACE_SEND]);
+
+    char buf[256];
+    size_t len = trace_format(&t, buf, sizeof(buf));
+    assert(len == strlen(buf));
+    assert(strncmp(buf, "recv=", 5) == 0);
+    assert(strstr(buf, " mongo=") && strstr(buf, " send=") && strstr(buf, " other="));
+    assert(!strstr(buf, "hash="));
+    // Короткий буфер: обрезка как у snprintf, длина — полная
+    char small[8];
+    assert(trace_format(&t, small, sizeof(small)) == len);
+    assert(strlen(small) == sizeof(small) - 1);
+
+    // Не больше одной строки за интервал, пропущенные считаются
+    trace_sampler_t s = {0};
+    uint64_t suppressed = 99;
+    assert(trace_sample(&s, 1000, 100, &suppressed) && suppressed == 0);
+    assert(!trace_sample(&s, 1050, 100, &suppressed));
+    assert(!trace_sample(&s, 1099, 100, &suppressed));
+    assert(trace_sample(&s, 1100, 100, &suppressed) && suppressed == 2);
+    assert(strcmp(trace_phase_name(TRACE_DECRYPT), "decrypt") == 0);
+}
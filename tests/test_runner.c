@@ -0,0 +1,109 @@
+// test_runner.c
+#include <stdio.h>
+
+void test_watch_map_basic();
+void test_watch_map_grow();
+void test_watch_map_remove_prefix();
+void test_tree_walk_counts();
+void test_coalescer_collapse_modifies();
+void test_coalescer_rename_pair();
+void test_coalescer_unpaired_moves();
+void test_coalescer_delete_after_rename();
+void test_coalescer_max_pending();
+void test_reconcile_scan();
+void test_reconcile_diff();
+void test_hash_cache_persist();
+void test_hash_cache_limit();
+void test_pipeline_order_and_hash();
+void test_pipeline_rename_halves();
+void test_pipeline_spill();
+void test_watcher_inotify();
+void test_watcher_fanotify();
+void test_checkpoint_restart();
+void test_checkpoint_grow_and_torn();
+void test_logger_threads();
+void test_metrics_registry();
+void test_metrics_http();
+void test_request_trace();
+void test_meta_store_files();
+void test_meta_store_events();
+void test_meta_store_faults();
+void test_loopback_socketpair();
+void test_loopback_bio_pair();
+void test_object_store_layout();
+void test_object_store_migrate();
+void test_object_store_direct();
+void test_pack_store_basic();
+void test_pack_store_compact();
+void test_pack_store_threads();
+void test_object_store_packed();
+void test_sync_group_batches();
+void test_chunk_cache_basic();
+void test_chunk_cache_threads();
+void test_flight_group_coalesce();
+void test_notify_bus_fanout();
+void test_notify_bus_overflow();
+void test_handlers_subscribe_end();
+void test_handlers_recipient_download();
+void test_handlers_stat_duplicates();
+void test_handlers_upload_coalesce();
+void test_handlers_upload_coalesce_fallback();
+void test_handlers_cached_download_disconnect();
+
+#define RUN(test) do { printf("  %s\n", #test); test(); } while (0)
+
+int main(void) {
+    printf("Running tests:\n");
+
+    RUN(test_watch_map_basic);
+    RUN(test_watch_map_grow);
+    RUN(test_watch_map_remove_prefix);
+    RUN(test_tree_walk_counts);
+    RUN(test_coalescer_collapse_modifies);
+    RUN(test_coalescer_rename_pair);
+    RUN(test_coalescer_unpaired_moves);
+    RUN(test_coalescer_delete_after_rename);
+    RUN(test_coalescer_max_pending);
+    RUN(test_reconcile_scan);
+    RUN(test_reconcile_diff);
+    RUN(test_hash_cache_persist);
+    RUN(test_hash_cache_limit);
+    RUN(test_pipeline_order_and_hash);
+    RUN(test_pipeline_rename_halves);
+    RUN(test_pipeline_spill);
+    RUN(test_watcher_inotify);
+    RUN(test_watcher_fanotify);
+    RUN(test_checkpoint_restart);
+    RUN(test_checkpoint_grow_and_torn);
+    RUN(test_logger_threads);
+    RUN(test_metrics_registry);
+    RUN(test_metrics_http);
+    RUN(test_request_trace);
+    RUN(test_meta_store_files);
+    RUN(test_meta_store_events);
+    RUN(test_meta_store_faults);
+    RUN(test_loopback_socketpair);
+    RUN(test_loopback_bio_pair);
+    RUN(test_object_store_layout);
+    RUN(test_object_store_migrate);
+    RUN(test_object_store_direct);
+    RUN(test_pack_store_basic);
+    RUN(test_pack_store_compact);
+    RUN(test_pack_store_threads);
+    RUN(test_object_store_packed);
+    RUN(test_sync_group_batches);
+    RUN(test_chunk_cache_basic);
+    RUN(test_chunk_cache_threads);
+    RUN(test_flight_group_coalesce);
+    RUN(test_notify_bus_fanout);
+    RUN(test_notify_bus_overflow);
+    RUN(test_handlers_subscribe_end);
+    RUN(test_handlers_recipient_download);
+    RUN(test_handlers_stat_duplicates);
+    RUN(test_handlers_upload_coalesce);
+    RUN(test_handlers_upload_coalesce_fallback);
+    RUN(test_handlers_cached_download_disconnect);
+
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+// test_sync_group.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/storage/sync_group.h"
+
+#define SYNC_THREADS 8
+
+typedef struct {
+    sync_group_t *g;
+    pthread_barrier_t *start;
+    int dir_fd;
+    int n;
+} sync_worker_t;
+
+static void *sync_worker(void *arg) {
+    sync_worker_t *w = arg;
+    char name[32];
+    snprintf(name, sizeof(name), "f%d", w->n);
+    int fd = openat(w->dir_fd, name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    assert(write(fd, name, strlen(name)) == (ssize_t)strlen(name));
+
+    pthread_barrier_wait(w->start);
+    int err = 0;
+    assert(sync_group_wait(w->g, fd, w->dir_fd, &err));
+    close(fd);
+    return NULL;
+}
+
+void test_sync_group_batches() {
+    char dir[] = "/tmp/sync_group_XXXXXX";
+    assert(mkdtemp(dir));
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    assert(dir_fd >= 0);
+
+    // Попутчики ждут 20 мс: все восемь загрузок укладываются в одну-две пачки
+    sync_group_options_t opts = { .delay_us = 20000 };
+    int err = 0;
+    sync_group_t *g = sync_group_start(dir_fd, &opts, &err);
+    assert(g);
+
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, SYNC_THREADS);
+    pthread_t threads[SYNC_THREADS];
+    sync_worker_t workers[SYNC_THREADS];
+    for (int i = 0; i < SYNC_THREADS; i++) {
+        workers[i] = (sync_worker_t){ .g = g, .start = &start, .dir_fd = dir_fd, .n = i };
+        assert(pthread_create(&threads[i], NULL, sync_worker, &workers[i]) == 0);
+    }
+    for (int i = 0; i < SYNC_THREADS; i++) pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&start);
+
+    sync_group_stats_t st;
+    sync_group_stats(g, &st);
+    assert(st.requests == SYNC_THREADS && st.flushes >= 1 && st.flushes < SYNC_THREADS);
+
+    // Ошибка сброса возвращается ожидающему: канал fdatasync не поддерживает
+    int pipe_fds[2];
+    assert(pipe(pipe_fds) == 0);
+    assert(!sync_group_wait(g, pipe_fds[0], -1, &err) && err == EINVAL);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+
+    // fd = -1 — вся файловая система
+    assert(sync_group_wait(g, -1, -1, &err));
+    sync_group_stop(g);
+
+    // syncfs_min: пачка из одного запроса уже сбрасывается через syncfs
+    opts = (sync_group_options_t){ .syncfs_min = 1 };
+    g = sync_group_start(dir_fd, &opts, &err);
+    assert(g);
+    assert(pipe(pipe_fds) == 0);
+    assert(sync_group_wait(g, pipe_fds[0], -1, &err));
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    sync_group_stop(g);
+
+    char path[512];
+    for (int i = 0; i < SYNC_THREADS; i++) {
+        snprintf(path, sizeof(path), "%s/f%d", dir, i);
+        assert(unlink(path) == 0);
+    }
+    close(dir_fd);
+    assert(rmdir(dir) == 0);
+}
@@ -0,0 +1,74 @@
+// test_tree_walk.c
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/core/tree_walk.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    int dirs;
+    int files;
+} walk_counts_t;
+
+static bool count_dir(void *ctx, unsigned worker, const char *path, int dirfd) {
+    (void)worker; (void)path; (void)dirfd;
+    walk_counts_t *c = ctx;
+    pthread_mutex_lock(&c->lock);
+    c->dirs++;
+    pthread_mutex_unlock(&c->lock);
+    return true;
+}
+
+static void count_file(void *ctx, unsigned worker, const char *dir_path, int dirfd,
+                       const char *name, unsigned char d_type) {
+    (void)worker; (void)dir_path; (void)dirfd; (void)name;
+    walk_counts_t *c = ctx;
+    if (d_type != DT_REG) return;
+    pthread_mutex_lock(&c->lock);
+    c->files++;
+    pthread_mutex_unlock(&c->lock);
+}
+
+void test_tree_walk_counts() {
+    char root[] = "/tmp/tree_walk_XXXXXX";
+    assert(mkdtemp(root));
+
+    // 10 каталогов по 10 подкаталогов, в каждом листе по 3 файла
+    char path[512];
+    for (int i = 0; i < 10; i++) {
+        snprintf(path, sizeof(path), "%s/d%d", root, i);
+        assert(mkdir(path, 0755) == 0);
+        for (int j = 0; j < 10; j++) {
+            snprintf(path, sizeof(path), "%s/d%d/s%d", root, i, j);
+            assert(mkdir(path, 0755) == 0);
+            for (int k = 0; k < 3; k++) {
+                snprintf(path, sizeof(path), "%s/d%d/s%d/f%d", root, i, j, k);
+                FILE *fp = fopen(path, "w");
+                assert(fp);
+                fclose(fp);
+            }
+        }
+    }
+
+    walk_counts_t c = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    tree_walk_ops_t ops = { .on_dir = count_dir, .on_entry = count_file };
+    tree_walk_stats_t stats;
+
+    assert(tree_walk_parallel(root, 4, &ops, &c, &stats) == 0);
+    assert(c.dirs == 1 + 10 + 100);
+    assert(c.files == 300);
+    assert(stats.dirs == 111);
+    assert(stats.entries == 300);
+    assert(stats.errors == 0);
+
+    assert(tree_walk_parallel("/nonexistent/tree_walk", 2, &ops, &c, &stats) == -1);
+
+    snprintf(path, sizeof(path), "rm -rf %s", root);
+    assert(system(path) == 0);
+}
@@ -0,0 +1,75 @@
+// test_watch_map.c
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "../src/core/watch_map.h"
+
+static void count_removed(void *ctx, int wd) {
+    (void)wd;
+    (*(int *)ctx)++;
+}
+
+void test_watch_map_basic() {
+    watch_map_t m;
+    assert(watch_map_init(&m, 4));
+
+    assert(watch_map_put(&m, 1, "/exchange"));
+    assert(watch_map_put(&m, 2, "/exchange/a"));
+    assert(strcmp(watch_map_get(&m, 1), "/exchange") == 0);
+    assert(strcmp(watch_map_get(&m, 2), "/exchange/a") == 0);
+    assert(watch_map_get(&m, 3) == NULL);
+
+    // Повторный wd заменяет путь (каталог перемещён)
+    assert(watch_map_put(&m, 2, "/exchange/b"));
+    assert(strcmp(watch_map_get(&m, 2), "/exchange/b") == 0);
+    assert(watch_map_count(&m) == 2);
+
+    assert(watch_map_remove(&m, 1));
+    assert(!watch_map_remove(&m, 1));
+    assert(watch_map_get(&m, 1) == NULL);
+    assert(watch_map_count(&m) == 1);
+
+    watch_map_destroy(&m);
+}
+
+void test_watch_map_grow() {
+    watch_map_t m;
+    assert(watch_map_init(&m, 1));
+
+    char path[64];
+    for (int wd = 1; wd <= 100000; wd++) {
+        snprintf(path, sizeof(path), "/d/%d", wd);
+        assert(watch_map_put(&m, wd, path));
+    }
+    // Удаления оставляют tombstones — поиск должен их перешагивать
+    for (int wd = 1; wd <= 100000; wd += 2) {
+        assert(watch_map_remove(&m, wd));
+    }
+    for (int wd = 2; wd <= 100000; wd += 2) {
+        snprintf(path, sizeof(path), "/d/%d", wd);
+        assert(strcmp(watch_map_get(&m, wd), path) == 0);
+    }
+    assert(watch_map_count(&m) == 50000);
+
+    watch_map_destroy(&m);
+}
+
+void test_watch_map_remove_prefix() {
+    watch_map_t m;
+    assert(watch_map_init(&m, 8));
+
+    watch_map_put(&m, 1, "/x");
+    watch_map_put(&m, 2, "/x/sub");
+    watch_map_put(&m, 3, "/x/sub/deep");
+    watch_map_put(&m, 4, "/x/subling"); // общий префикс, но другой каталог
+
+    int removed = 0;
+    assert(watch_map_remove_prefix(&m, "/x/sub", count_removed, &removed) == 2);
+    assert(removed == 2);
+    assert(watch_map_get(&m, 1) != NULL);
+    assert(watch_map_get(&m, 4) != NULL);
+    assert(watch_map_get(&m, 2) == NULL);
+    assert(watch_map_get(&m, 3) == NULL);
+
+    watch_map_destroy(&m);
+}